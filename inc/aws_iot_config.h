@@ -33,9 +33,23 @@
 // =================================================
 
 // MQTT PubSub
-#define AWS_IOT_MQTT_TX_BUF_LEN 512 ///< Any time a message is sent out through the MQTT layer. The message is copied into this buffer anytime a publish is done. This will also be used in the case of Thing Shadow
+#define AWS_IOT_MQTT_TX_BUF_LEN 512 ///< Any time a message is sent out through the MQTT layer. Publish headers are serialized into this buffer, payloads are copied behind them only when they fit. This will also be used in the case of Thing Shadow
 #define AWS_IOT_MQTT_RX_BUF_LEN 512 ///< Any message that comes into the device should be less than this buffer size. If a received message is bigger than this buffer size the message will be dropped.
-#define AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS 5 ///< Maximum number of topic filters the MQTT client can handle at any given time. This should be increased appropriately when using Thing Shadow
+#define AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS 16 ///< Number of topic filters held by the built-in subscription table. Larger tables can be supplied at runtime with aws_iot_mqtt_set_subscription_table
+#define AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET 8 ///< Most topic filters packed into one SUBSCRIBE or UNSUBSCRIBE packet. Resubscribe sends as many packets as needed without waiting for the SUBACKs in between
+#define AWS_IOT_MQTT_TOPIC_TRIE_NODES (4 * AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS) ///< Number of topic levels the built-in dispatch trie can hold. Filters sharing a prefix share its nodes
+#define AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH 8 ///< Maximum number of asynchronous QoS1 publishes waiting for a PUBACK at any given time
+#define AWS_IOT_MQTT_INFLIGHT_RETRY_INTERVAL 5000 ///< Time in ms after which an unacknowledged asynchronous QoS1 publish is sent again with the DUP flag set
+#define AWS_IOT_MQTT_INFLIGHT_MAX_RETRIES 3 ///< Number of retransmissions before an asynchronous QoS1 publish completes with MQTT_REQUEST_TIMEOUT_ERROR
+#define AWS_IOT_MQTT_OUTBOUND_QUEUE_SLOTS 16 ///< Number of pre-serialized packets the outbound queue can hold. Must be a power of two
+#define AWS_IOT_MQTT_OUTBOUND_SLOT_LEN 256 ///< Largest packet, fixed header included, that fits in one outbound queue slot. Must not exceed AWS_IOT_MQTT_TX_BUF_LEN
+#define AWS_IOT_MQTT_TOPIC_ALIAS_MAX 8 ///< MQTT 5 only. Number of topic aliases kept for each direction, the broker is told how many it can use for the publishes it sends
+#define AWS_IOT_MQTT_TOPIC_ALIAS_LEN 96 ///< MQTT 5 only. Longest topic held by a topic alias, publishes on longer topics always carry the topic in full
+#define AWS_IOT_MQTT_SESSION_EXPIRY_INTERVAL 3600 ///< MQTT 5 only. Time in seconds the broker keeps a persistent session (isCleanSession false) once the connection is lost
+#define AWS_IOT_MQTT_PUBLISH_RATE_LIMIT 100 ///< Publishes per second sent on a connection, AWS IoT throttles above 100. 0 disables the limit
+#define AWS_IOT_MQTT_PUBLISH_BYTE_RATE_LIMIT (512 * 1024) ///< Publish bytes per second sent on a connection, AWS IoT throttles above 512 KB. 0 disables the limit
+#define AWS_IOT_MQTT_PUBLISH_BURST_MS 1000 ///< Sending time saved up while idle, publishes up to the limits times this can go out at once
+#define AWS_IOT_TIMER_WHEEL_TICK_MS 10 ///< Resolution of the timing wheels holding the in-flight retransmission and shadow ack deadlines
 
 // Thing Shadow specific configs
 #define SHADOW_MAX_SIZE_OF_RX_BUFFER (AWS_IOT_MQTT_RX_BUF_LEN+1) ///< Maximum size of the SHADOW buffer to store the received Shadow message, including terminating NULL byte.
@@ -52,6 +66,12 @@
 // Auto Reconnect specific config
 #define AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL 1000 ///< Minimum time before the First reconnect attempt is made as part of the exponential back-off algorithm
 #define AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL 128000 ///< Maximum time interval after which exponential back-off will stop attempting to reconnect.
+#define AWS_IOT_MQTT_RECONNECT_PROBE_INTERVAL 2000 ///< Time in ms between reachability probes of the endpoint while waiting to reconnect, 0 disables probing. An endpoint becoming reachable again cuts the wait short
+
+// Keep alive specific config
+#define AWS_IOT_MQTT_KEEPALIVE_MIN_INTERVAL 30000 ///< Idle time in ms before a PINGREQ while no longer interval is known to keep the connection alive. Longer intervals are probed from here up to the keep alive interval of the connection
+#define AWS_IOT_MQTT_KEEPALIVE_PROBE_RESOLUTION 15000 ///< The search for the longest safe idle interval stops once the longest working and the shortest failing interval are closer than this, in ms
+#define AWS_IOT_MQTT_PINGRESP_TIMEOUT 10000 ///< Time in ms to wait for PINGRESP before the connection is considered lost
 
 #define DISABLE_METRICS false ///< Disable the collection of metrics by setting this to true
 
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MQTT_JOURNAL_H__
+#define __MQTT_JOURNAL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Append-only journal of outbound messages that could not be published.
+ * Records live in a memory mapped file so they survive an application crash,
+ * they are replayed once the connection is back and removed when acknowledged.
+ *
+ * Replay: mqtt_journal_peek returns the next record, mqtt_journal_sent must be
+ * called before it is handed to the client and mqtt_journal_complete once the
+ * client is done with it. A record completed without an ack is replayed again.
+ */
+
+typedef struct {
+	uint32_t id;		/* passed back to mqtt_journal_sent / mqtt_journal_complete */
+	const char *topic;	/* points into the journal, valid until the record is completed */
+	uint16_t topic_len;
+	const void *payload;	/* points into the journal, valid until the record is completed */
+	size_t payload_len;
+} mqtt_journal_record_s;
+
+/*
+ * Records older than max_age_sec are skipped by replay once the wall clock is
+ * synced, 0 disables expiry. Records written before the first sync never
+ * expire by age and are bounded by the journal size only.
+ */
+int mqtt_journal_open(const char *path, size_t size, unsigned int max_age_sec);
+void mqtt_journal_flush(void);
+
+int mqtt_journal_append(const char *topic, uint16_t topic_len, const void *payload, size_t payload_len);
+bool mqtt_journal_is_empty(void);
+
+int mqtt_journal_peek(mqtt_journal_record_s *record);
+void mqtt_journal_sent(uint32_t id);
+void mqtt_journal_complete(uint32_t id, bool is_acked);
+
+#endif
@@ -38,6 +38,12 @@ extern "C" {
  * Values greater than 0 are specific non-error return codes
  */
 typedef enum {
+	/** Returned while an asynchronous connect waits for the socket to become writable */
+			NETWORK_CONNECT_WANT_WRITE = 9,
+	/** Returned while an asynchronous connect waits for the socket to become readable */
+			NETWORK_CONNECT_WANT_READ = 8,
+	/** Returned when a reachability probe of the endpoint has been started but not completed yet */
+			NETWORK_PROBE_IN_PROGRESS = 7,
 	/** Returned when the Network physical layer is connected */
 			NETWORK_PHYSICAL_LAYER_CONNECTED = 6,
 	/** Returned when the Network is manually disconnected */
@@ -156,7 +162,25 @@ typedef enum {
 	/** Some limit has been exceeded, e.g. the maximum number of subscriptions has been reached */
 			LIMIT_EXCEEDED_ERROR = -51,
 	/** Invalid input topic type */
-			INVALID_TOPIC_TYPE_ERROR = -52
+			INVALID_TOPIC_TYPE_ERROR = -52,
+	/** All in-flight slots are waiting for a PUBACK. Retry once a pending publish completes */
+			MQTT_INFLIGHT_WINDOW_FULL_ERROR = -53,
+	/** Condition variable initialization failed */
+			COND_INIT_ERROR = -54,
+	/** Condition variable wait failed */
+			COND_WAIT_ERROR = -55,
+	/** Condition variable was not signalled before the wait timed out */
+			COND_WAIT_TIMEOUT_ERROR = -56,
+	/** Condition variable signal or broadcast failed */
+			COND_SIGNAL_ERROR = -57,
+	/** Condition variable destroy failed */
+			COND_DESTROY_ERROR = -58,
+	/** All slots of the outbound queue are taken, the message was dropped */
+			MQTT_OUTBOUND_QUEUE_FULL_ERROR = -59,
+	/** The broker refused the request with an MQTT 5 reason code of 0x80 or above */
+			MQTT_REASON_CODE_ERROR = -60,
+	/** The publish rate or byte rate limit was reached, the message was not sent. Retry later */
+			MQTT_PUBLISH_THROTTLED_ERROR = -61
 } IoT_Error_t;
 
 #ifdef __cplusplus
@@ -56,6 +56,7 @@ extern "C" {
 /* Platform specific implementation header files */
 #include "network_interface.h"
 #include "timer_interface.h"
+#include "aws_iot_timer_wheel.h"
 
 #ifdef _ENABLE_THREAD_SUPPORT_
 #include "threads_interface.h"
@@ -63,6 +64,9 @@ extern "C" {
 
 #define MAX_PACKET_ID 65535
 
+/* Returned by aws_iot_mqtt_get_next_timeout_ms when the client has nothing scheduled */
+#define AWS_IOT_MQTT_NO_TIMEOUT_MS 0xFFFFFFFF
+
 typedef struct _Client AWS_IoT_Client;
 
 /**
@@ -95,11 +99,13 @@ typedef struct {
 /**
  * @brief MQTT Version Type
  *
- * Defining an MQTT version type. Only 3.1.1 is supported at this time
+ * Defining an MQTT version type.
+ * MQTT 5 connections use topic aliases for the topics of outbound publishes when the broker allows them.
  *
  */
 typedef enum {
-	MQTT_3_1_1 = 4    ///< MQTT 3.1.1 (protocol message byte = 4)
+	MQTT_3_1_1 = 4,   ///< MQTT 3.1.1 (protocol message byte = 4)
+	MQTT_5 = 5        ///< MQTT 5.0 (protocol message byte = 5)
 } MQTT_Ver_t;
 
 /**
@@ -155,6 +161,15 @@ extern const IoT_Client_Connect_Params iotClientConnectParamsDefault;
  */
 typedef void (*iot_disconnect_handler)(AWS_IoT_Client *, void *);
 
+/**
+ * @brief Connect Completion Handler Type
+ *
+ * Defining a TYPE for definition of connect completion callback function pointers.
+ * Called once an asynchronous connect succeeded (rc = SUCCESS) or failed
+ *
+ */
+typedef void (*pConnectCompleteHandler_t)(AWS_IoT_Client *pClient, IoT_Error_t rc, void *pData);
+
 /**
  * @brief MQTT Initialization Parameters
  *
@@ -175,6 +190,8 @@ typedef struct {
 	bool isSSLHostnameVerify;			///< Client should perform server certificate hostname validation
 	iot_disconnect_handler disconnectHandler;	///< Callback to be invoked upon connection loss
 	void *disconnectHandlerData;			///< Data to pass as argument when disconnect handler is called
+	TLSCipherProfile tlsCipherProfile;		///< Cipher suites offered in the TLS handshake
+	TLSCurveProfile tlsCurveProfile;		///< Curves offered for the TLS key exchange
 #ifdef _ENABLE_THREAD_SUPPORT_
 	bool isBlockOnThreadLockEnabled;		///< Timeout for Thread blocking calls. Set to 0 to block until lock is obtained. In milliseconds
 #endif
@@ -182,9 +199,9 @@ typedef struct {
 extern const IoT_Client_Init_Params iotClientInitParamsDefault;
 
 #ifdef _ENABLE_THREAD_SUPPORT_
-#define IoT_Client_Init_Params_initializer { true, NULL, 0, NULL, NULL, NULL, 2000, 20000, 5000, true, NULL, NULL, false }
+#define IoT_Client_Init_Params_initializer { true, NULL, 0, NULL, NULL, NULL, 2000, 20000, 5000, true, NULL, NULL, TLS_CIPHER_PROFILE_DEFAULT, TLS_CURVE_PROFILE_DEFAULT, false }
 #else
-#define IoT_Client_Init_Params_initializer { true, NULL, 0, NULL, NULL, NULL, 2000, 20000, 5000, true, NULL, NULL }
+#define IoT_Client_Init_Params_initializer { true, NULL, 0, NULL, NULL, NULL, 2000, 20000, 5000, true, NULL, NULL, TLS_CIPHER_PROFILE_DEFAULT, TLS_CURVE_PROFILE_DEFAULT }
 #endif
 
 /**
@@ -220,6 +237,39 @@ typedef enum _ClientState {
 typedef void (*pApplicationHandler_t)(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
 									  IoT_Publish_Message_Params *pParams, void *pClientData);
 
+/**
+ * @brief Application Stream Callback Handler Type
+ *
+ * Defining a TYPE for definition of streaming application callback function pointers.
+ * Used to send incoming data to the application in chunks. pParams->payload and
+ * pParams->payloadLen describe the current chunk only, chunkOffset is its position
+ * in the message payload of totalLen bytes. The last chunk has isFinal set.
+ * Messages that fit in the RX buffer are delivered as a single final chunk.
+ *
+ */
+typedef void (*pStreamApplicationHandler_t)(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+											IoT_Publish_Message_Params *pParams, size_t chunkOffset,
+											size_t totalLen, bool isFinal, void *pClientData);
+
+/* SUBACK return code of a topic filter refused by the broker */
+#define AWS_IOT_MQTT_SUBACK_FAILURE 0x80
+
+/**
+ * @brief Subscribe Parameters Type
+ *
+ * Defines a type for one topic filter of aws_iot_mqtt_subscribe_batch.
+ * pTopicName and pApplicationHandlerData need to be static in memory since no malloc are performed by the SDK
+ *
+ */
+typedef struct {
+	const char *pTopicName;		///< Topic filter to subscribe to
+	uint16_t topicNameLen;		///< Length of the topic filter
+	QoS qos;			///< Requested QoS of the subscription
+	pApplicationHandler_t pApplicationHandler;	///< Handler of the messages matching the filter
+	void *pApplicationHandlerData;	///< Data passed to the handler
+	uint8_t returnCode;		///< Set from the SUBACK: granted QoS, or AWS_IOT_MQTT_SUBACK_FAILURE if refused or not acknowledged
+} IoT_Subscribe_Params;
+
 /**
  * @brief MQTT Message Handler
  *
@@ -232,9 +282,227 @@ typedef struct _MessageHandlers {
 	uint16_t topicNameLen;
 	QoS qos;
 	pApplicationHandler_t pApplicationHandler;
+	pStreamApplicationHandler_t pStreamApplicationHandler;
 	void *pApplicationHandlerData;
+	bool isDecompressEnabled;	///< Compressed payloads are decompressed before reaching the handler
+	uint16_t trieNode;	///< Trie node holding this filter, AWS_IOT_MQTT_TRIE_NONE when not linked
+	uint16_t nextHandler;	///< Next handler registered on the same trie node
 } MessageHandlers;   /* Message handlers are indexed by subscription topic */
 
+/* Index value marking the end of a trie list */
+#define AWS_IOT_MQTT_TRIE_NONE 0xFFFF
+
+/**
+ * @brief Topic Trie Level Type
+ *
+ * Defining a type for the kind of topic level a trie node matches
+ *
+ */
+typedef enum _TopicTrieLevelType {
+	TOPIC_TRIE_LEVEL_FREE = 0,	///< Node is not in use
+	TOPIC_TRIE_LEVEL_ROOT = 1,	///< Root node, matches nothing by itself
+	TOPIC_TRIE_LEVEL_LITERAL = 2,	///< Matches one topic level with the same text
+	TOPIC_TRIE_LEVEL_SINGLE = 3,	///< '+', matches exactly one topic level
+	TOPIC_TRIE_LEVEL_MULTI = 4	///< '#', matches the parent level and all levels below it
+} TopicTrieLevelType;
+
+/**
+ * @brief Topic Trie Node
+ *
+ * Defining a type for the nodes of the trie used to dispatch incoming messages.
+ * Each node is one level of one or more subscribed topic filters. Literal levels
+ * are compared by length and hash, matches are confirmed against the filter
+ * text before a handler is called.
+ *
+ */
+typedef struct _TopicTrieNode {
+	uint32_t levelHash;
+	uint16_t levelLen;
+	uint16_t parent;
+	uint16_t firstChild;
+	uint16_t nextSibling;
+	uint16_t firstHandler;
+	uint8_t levelType;
+} TopicTrieNode;
+
+/**
+ * @brief Publish Completion Handler Type
+ *
+ * Defining a TYPE for definition of publish completion callback function pointers.
+ * Called once the PUBACK of an asynchronous QoS1 publish is received (rc = SUCCESS)
+ * or when the message is dropped after all retransmissions timed out
+ *
+ */
+typedef void (*pPublishCompleteHandler_t)(AWS_IoT_Client *pClient, uint16_t packetId, IoT_Error_t rc,
+										  void *pClientData);
+
+/**
+ * @brief In-flight QoS1 Publish
+ *
+ * Defining a type for asynchronous QoS1 publishes waiting for their PUBACK.
+ * Entries are keyed by packet id, a packet id of 0 marks a free entry
+ *
+ */
+typedef struct _InFlightPublish {
+	uint16_t packetId;
+	uint8_t isRetained;
+	uint8_t retryCount;
+	const char *pTopicName;
+	uint16_t topicNameLen;
+	const void *pPayload;
+	size_t payloadLen;
+	TimerWheelEntry retryEntry;	///< Retransmission deadline in inFlightRetryWheel
+	pPublishCompleteHandler_t pCompleteHandler;
+	void *pCompleteHandlerData;
+} InFlightPublish;
+
+/**
+ * @brief Publish Priority Type
+ *
+ * Defining the classes of the publish shaper. A class only gets tokens while the
+ * buckets hold more than its reserve, so lower classes run dry first and leave
+ * headroom for higher ones during a burst
+ *
+ */
+typedef enum {
+	PUBLISH_PRIORITY_HIGH = 0,	///< Commands and acknowledgements, may empty the buckets
+	PUBLISH_PRIORITY_NORMAL = 1,	///< Default class, leaves a quarter of the buckets
+	PUBLISH_PRIORITY_LOW = 2	///< Telemetry and bulk data, leaves half of the buckets
+} PublishPriority;
+
+#define PUBLISH_PRIORITY_COUNT 3
+
+/**
+ * @brief Publish Priority Rule
+ *
+ * Defining a type for the rules mapping topics to a priority class. The first rule
+ * whose prefix starts the topic gives the class, topics matching no rule are NORMAL
+ *
+ */
+typedef struct _PublishPriorityRule {
+	const char *pTopicPrefix;
+	uint16_t topicPrefixLen;
+	PublishPriority priority;
+} PublishPriorityRule;
+
+/**
+ * @brief Publish Shaper State
+ *
+ * Defining a type for the token buckets in front of the publish calls. Every publish
+ * takes one message token and one byte token per byte of its PUBLISH packet. Buckets
+ * refill at the configured rates and hold at most AWS_IOT_MQTT_PUBLISH_BURST_MS worth.
+ * Tokens are counted in thousandths so slow rates refill smoothly. Guarded by the write lock
+ *
+ */
+typedef struct _PublishShaper {
+	uint32_t messageRate;		///< Publishes per second, 0 for no limit
+	uint32_t byteRate;		///< Bytes per second, 0 for no limit
+	uint64_t messageTokens;
+	uint64_t byteTokens;
+	uint32_t lastRefillMs;
+	const PublishPriorityRule *pRules;
+	uint32_t ruleCount;
+} PublishShaper;
+
+/**
+ * @brief Publish Shaper Statistics
+ *
+ * Defining a type for the counters of the publish shaper.
+ * Counters wrap around, only their differences are meaningful over long runs
+ *
+ */
+typedef struct _PublishShaperStats {
+	uint32_t messageTokens;		///< Publishes that could go out now, ignoring the reserves
+	uint32_t byteTokens;		///< Bytes that could go out now, ignoring the reserves
+	uint32_t passed[PUBLISH_PRIORITY_COUNT];	///< Publishes sent, by priority
+	uint32_t deferred[PUBLISH_PRIORITY_COUNT];	///< Publishes refused with MQTT_PUBLISH_THROTTLED_ERROR, by priority
+	uint32_t retryAfterMs;		///< Time until the last refused publish would pass, 0 once a publish passed
+} PublishShaperStats;
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+/**
+ * @brief Outbound Queue Slot
+ *
+ * Defining a type for the entries of the outbound queue. Each slot holds one
+ * serialized packet. The sequence number tells producers and the writer whether
+ * the slot is free, being filled or ready to be written
+ *
+ */
+typedef struct _OutboundQueueSlot {
+	uint32_t sequence;
+	uint32_t enqueueTimeMs;
+	uint16_t packetLen;
+	uint8_t priority;	///< PublishPriority of the topic, looked up when the packet is queued
+	unsigned char packet[AWS_IOT_MQTT_OUTBOUND_SLOT_LEN];
+} OutboundQueueSlot;
+
+/**
+ * @brief Outbound Queue Statistics
+ *
+ * Defining a type for the counters of the outbound queue.
+ * Counters wrap around, only their differences are meaningful over long runs
+ *
+ */
+typedef struct _OutboundQueueStats {
+	uint32_t depth;			///< Packets waiting to be written
+	uint32_t maxDepth;		///< Highest depth seen since init
+	uint32_t enqueued;		///< Packets accepted by aws_iot_mqtt_publish_enqueue
+	uint32_t dropped;		///< Packets rejected because the queue was full
+	uint32_t written;		///< Packets passed to the TLS layer
+	uint32_t writes;		///< TLS writes used for them, lower than written when packets are coalesced
+	uint32_t lastDrainLatencyMs;	///< Time the last written packet spent in the queue
+	uint32_t maxDrainLatencyMs;	///< Longest time a packet spent in the queue
+} OutboundQueueStats;
+
+/**
+ * @brief Publish Waiter
+ *
+ * Defining a type for a blocking QoS1 publish waiting for its PUBACK. The waiter lives on
+ * the stack of the publishing thread and is linked in the client while it waits. The
+ * completion handler finds it by id, so a waiter that gave up is never written to
+ *
+ */
+typedef struct _PublishWaiter {
+	uint32_t id;
+	bool isDone;
+	IoT_Error_t rc;
+	struct _PublishWaiter *pNext;
+} PublishWaiter;
+#endif
+
+/**
+ * @brief Keep Alive Statistics
+ *
+ * Defining a type for the state of the adaptive keep alive.
+ * PINGREQ is sent after pingIntervalMs without any traffic. The interval is
+ * searched between the longest idle time that kept the connection alive and the
+ * shortest one that lost it, typically to a NAT binding timing out. Whatever the
+ * interval, PINGREQ is also sent once nothing was sent for the keep alive interval,
+ * since the broker only counts packets from the client.
+ *
+ */
+typedef struct _KeepAliveStats {
+	uint32_t pingIntervalMs;	///< Idle time before the next PINGREQ
+	uint32_t safeIntervalMs;	///< Longest idle time answered by a PINGRESP, 0 if none yet
+	uint32_t failedIntervalMs;	///< Shortest idle time after which PINGRESP never came, 0 if none yet
+	uint32_t lastRttMs;		///< Round trip time of the last PINGREQ
+	uint32_t smoothedRttMs;		///< Smoothed round trip time, 0 until the first PINGRESP
+	uint32_t pingsSent;
+	uint32_t pingTimeouts;		///< PINGREQs left unanswered, each one dropped the connection
+} KeepAliveStats;
+
+/**
+ * @brief MQTT 5 Topic Alias
+ *
+ * Defining a type for one entry of the topic alias tables. The alias is the
+ * index of the entry plus one. Aliases only live as long as the connection.
+ *
+ */
+typedef struct _TopicAlias {
+	uint16_t topicNameLen;	///< 0 while the alias is not assigned
+	char topicName[AWS_IOT_MQTT_TOPIC_ALIAS_LEN];
+} TopicAlias;
+
 /**
  * @brief MQTT Client Status
  *
@@ -243,9 +511,10 @@ typedef struct _MessageHandlers {
  *
  */
 typedef struct _ClientStatus {
-	ClientState clientState;
+	ClientState clientState;	///< Only accessed with atomic operations, transitions are a compare and swap
 	bool isPingOutstanding;
 	bool isAutoReconnectEnabled;
+	bool isSessionPresent;	///< Session present flag of the last CONNACK, the broker kept subscriptions and queued messages
 } ClientStatus;
 
 /**
@@ -261,7 +530,16 @@ typedef struct _ClientData {
 	uint32_t packetTimeoutMs;
 	uint32_t commandTimeoutMs;
 	uint16_t keepAliveInterval;
-	uint32_t currentReconnectWaitInterval;
+	uint32_t lastActivityMs;	///< Time of the last packet sent or received, written with atomic stores
+	uint32_t lastSentMs;	///< Time of the last packet sent, written with atomic stores
+	uint32_t pingSentMs;
+	uint32_t pingIdleMs;	///< Idle interval tested by the outstanding PINGREQ
+	KeepAliveStats keepAliveStats;
+	uint32_t currentReconnectWaitInterval;	///< Upper bound of the next reconnect wait, doubled once the waits add up to it
+	uint32_t reconnectJitterWaitInterval;	///< Last reconnect wait picked by the decorrelated jitter
+	uint32_t reconnectWaitSpent;	///< Sum of the reconnect waits since currentReconnectWaitInterval was last doubled
+	uint32_t reconnectRandomState;	///< xorshift state for the jitter, seeded on first use
+	bool isReconnectProbeFailed;	///< Last reachability probe found the endpoint unreachable
 	uint32_t counterNetworkDisconnected;
 
 	/* The below values are initialized with the
@@ -269,23 +547,62 @@ typedef struct _ClientData {
 	 * afterwards */
 	size_t writeBufSize;
 	size_t readBufSize;
-    size_t readBufIndex;
+    size_t readBufIndex;	///< Number of bytes held in readBuf, may extend past the current packet
+	size_t readBufPacketLen;	///< Length of the packet at the start of readBuf, dropped on the next read
 	unsigned char writeBuf[AWS_IOT_MQTT_TX_BUF_LEN];
 	unsigned char readBuf[AWS_IOT_MQTT_RX_BUF_LEN];
 
 #ifdef _ENABLE_THREAD_SUPPORT_
 	bool isBlockOnThreadLockEnabled;
 	IoT_Mutex_t state_change_mutex;
+	IoT_Cond_t state_change_cond;	///< Broadcast under state_change_mutex when the client state changes and stateWaiterCount is not 0
+	uintptr_t callbackThreadId;	///< Thread running callbacks while in CONNECTED_WAIT_FOR_CB_RETURN
+	uint32_t stateWaiterCount;	///< Threads waiting for the client state on state_change_cond, atomic
+	PublishWaiter *pPublishWaiters;	///< Blocking publishes waiting for their PUBACK, guarded by state_change_mutex
+	uint32_t nextPublishWaiterId;	///< Guarded by state_change_mutex
 	IoT_Mutex_t tls_read_mutex;
-	IoT_Mutex_t tls_write_mutex;
+	IoT_Mutex_t tls_write_mutex;	///< Guards writeBuf, the socket write side and inFlightPublishes
+	uint32_t outboundEnqueuePos;	///< Next slot claimed by a producer, advanced with compare and swap
+	uint32_t outboundDequeuePos;	///< Next slot written to the network, only advanced by the writer
+	OutboundQueueStats outboundStats;
+	OutboundQueueSlot outboundQueue[AWS_IOT_MQTT_OUTBOUND_QUEUE_SLOTS];
 #endif
 
 	IoT_Client_Connect_Params options;
 
+	/* Subscription table in use, points to the arrays below unless
+	 * replaced with aws_iot_mqtt_set_subscription_table */
+	MessageHandlers *pMessageHandlers;
+	uint32_t messageHandlerCount;
+	TopicTrieNode *pTopicTrieNodes;
+	uint32_t topicTrieNodeCount;
+	uint32_t dispatchDepth;
+
 	MessageHandlers messageHandlers[AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS];
+	TopicTrieNode topicTrieNodes[AWS_IOT_MQTT_TOPIC_TRIE_NODES];
+	InFlightPublish inFlightPublishes[AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH];
+	TimerWheel inFlightRetryWheel;	///< Guarded by the write lock like inFlightPublishes
+
+	/* MQTT 5 topic aliases, cleared on every connect */
+	uint16_t topicAliasMax;	///< Outbound aliases usable on this connection, the lower of the broker limit and AWS_IOT_MQTT_TOPIC_ALIAS_MAX
+	uint16_t nextTopicAlias;	///< Outbound entry reassigned next once all are in use
+	TopicAlias outboundTopicAliases[AWS_IOT_MQTT_TOPIC_ALIAS_MAX];	///< Guarded by the write lock
+	TopicAlias inboundTopicAliases[AWS_IOT_MQTT_TOPIC_ALIAS_MAX];	///< Only used by the read path
+
+	PublishShaper shaper;
+	PublishShaperStats shaperStats;	///< Written under the write lock, read with atomic loads
+
+	unsigned char *pDecompressBuf;	///< Compressed payloads are delivered from here, NULL delivers them as received
+	size_t decompressBufLen;
 	iot_disconnect_handler disconnectHandler;
 
 	void *disconnectHandlerData;
+
+	/* Asynchronous connect, the client state stays CONNECTING until it completes */
+	bool isConnectAsync;	///< A connect started by aws_iot_mqtt_connect_async is in progress
+	bool isConnackPending;	///< The CONNECT packet of that connect was sent
+	pConnectCompleteHandler_t connectCompleteHandler;
+	void *connectCompleteHandlerData;
 } ClientData;
 
 /**
@@ -297,10 +614,14 @@ typedef struct _ClientData {
 struct _Client {
 	Timer pingTimer;
 	Timer reconnectDelayTimer;
+	Timer reconnectProbeTimer;
+	Timer connectTimer;	///< Bounds the handshake, then the CONNACK wait, of an asynchronous connect
 
 	ClientStatus clientStatus;
 	ClientData clientData;
 	Network networkStack;
+
+	void *pShadowContext;	///< Shadow instance using this client, set by aws_iot_shadow_init
 };
 
 /**
@@ -352,6 +673,19 @@ bool aws_iot_mqtt_is_client_connected(AWS_IoT_Client *pClient);
  */
 ClientState aws_iot_mqtt_get_client_state(AWS_IoT_Client *pClient);
 
+/**
+ * @brief Did the broker resume a stored session?
+ *
+ * Called to get the session present flag of the last CONNACK. Only set when connecting
+ * with isCleanSession = false and the broker still held the session. Reconnects then skip
+ * resubscribing since the broker kept the subscriptions.
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return true = session resumed, false = new session
+ */
+bool aws_iot_mqtt_is_session_present(AWS_IoT_Client *pClient);
+
 /**
  * @brief Is the MQTT client set to reconnect automatically?
  *
@@ -411,6 +745,221 @@ uint32_t aws_iot_mqtt_get_network_disconnected_count(AWS_IoT_Client *pClient);
  */
 void aws_iot_mqtt_reset_network_disconnected_count(AWS_IoT_Client *pClient);
 
+/**
+ * @brief Replace the subscription table of the client
+ *
+ * Called to give the client larger handler and trie node arrays than the built-in ones
+ * sized by AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS and AWS_IOT_MQTT_TOPIC_TRIE_NODES, for
+ * devices subscribing to hundreds of topic filters. Must be called while the client
+ * holds no subscriptions. Both arrays need to be static in memory since no malloc are
+ * performed by the SDK.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pMessageHandlers Array used to store the subscribed topic filters
+ * @param messageHandlerCount Number of entries in pMessageHandlers, less than AWS_IOT_MQTT_TRIE_NONE
+ * @param pTopicTrieNodes Array used to store the dispatch trie
+ * @param topicTrieNodeCount Number of entries in pTopicTrieNodes, less than AWS_IOT_MQTT_TRIE_NONE
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_set_subscription_table(AWS_IoT_Client *pClient, MessageHandlers *pMessageHandlers,
+												uint32_t messageHandlerCount, TopicTrieNode *pTopicTrieNodes,
+												uint32_t topicTrieNodeCount);
+
+/**
+ * @brief Set the buffer compressed payloads are decompressed into
+ *
+ * Received payloads starting with a codec byte of aws_iot_mqtt_client_compress.h are
+ * decompressed straight into pBuf for the subscriptions enabled with
+ * aws_iot_mqtt_set_subscription_decompression, and handed to their callbacks from there.
+ * The buffer is reused by the next message, callbacks keeping the payload must copy it.
+ * Payloads larger than AWS_IOT_MQTT_RX_BUF_LEN are streamed in chunks and delivered as
+ * received. Payloads that fail to decompress are delivered as received as well.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pBuf Buffer for decompressed payloads, NULL to deliver compressed payloads as received
+ * @param bufLen Size of pBuf
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_set_decompression_buffer(AWS_IoT_Client *pClient, unsigned char *pBuf, size_t bufLen);
+
+/**
+ * @brief Enable decompression of the payloads received on a subscription
+ *
+ * Subscriptions start with decompression disabled and get payloads as received, a binary
+ * payload that happens to start with a codec byte is never altered for them. The setting
+ * lasts until the filter is unsubscribed.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicFilter Topic filter of an existing subscription
+ * @param isEnabled true to decompress the payloads delivered to the subscription
+ *
+ * @return IoT_Error_t Type defining successful/failed API call, FAILURE if the filter is not subscribed
+ */
+IoT_Error_t aws_iot_mqtt_set_subscription_decompression(AWS_IoT_Client *pClient, const char *pTopicFilter,
+														bool isEnabled);
+
+/**
+ * @brief Get count of asynchronous QoS1 publishes waiting for a PUBACK
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return uint32_t number of occupied in-flight entries, at most AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH
+ */
+uint32_t aws_iot_mqtt_get_inflight_publish_count(AWS_IoT_Client *pClient);
+
+/**
+ * @brief Get the state of the adaptive keep alive
+ *
+ * The round trip time of PINGREQ is a cheap health signal for the link. The safe and
+ * failed intervals can be persisted and handed back with
+ * aws_iot_mqtt_set_keepalive_intervals after a restart so the search is not repeated.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pStats Filled with the current values
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_get_keepalive_stats(AWS_IoT_Client *pClient, KeepAliveStats *pStats);
+
+/**
+ * @brief Restore the idle intervals learned by the adaptive keep alive
+ *
+ * Call before connecting, typically with values saved from aws_iot_mqtt_get_keepalive_stats.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param safeIntervalMs Longest idle time known to keep the connection alive, 0 if unknown
+ * @param failedIntervalMs Shortest idle time known to lose the connection, 0 if unknown
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_set_keepalive_intervals(AWS_IoT_Client *pClient, uint32_t safeIntervalMs,
+												 uint32_t failedIntervalMs);
+
+/**
+ * @brief Set the limits of the publish shaper
+ *
+ * AWS IoT throttles or disconnects clients publishing faster than the per connection
+ * limits. aws_iot_mqtt_publish waits for publishes above the rates set here to pass, up to
+ * the command timeout. Asynchronous and queued publishes above the rates are refused with
+ * MQTT_PUBLISH_THROTTLED_ERROR before they reach the network, the caller keeps the message
+ * and retries later, after the retryAfterMs of aws_iot_mqtt_get_publish_shaper_stats.
+ * aws_iot_mqtt_init sets AWS_IOT_MQTT_PUBLISH_RATE_LIMIT and AWS_IOT_MQTT_PUBLISH_BYTE_RATE_LIMIT.
+ * Retransmissions of QoS1 messages are not shaped, they were counted when first sent.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param messagesPerSecond Publishes per second, 0 for no limit
+ * @param bytesPerSecond Bytes of PUBLISH packets per second, 0 for no limit
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_set_publish_rate_limit(AWS_IoT_Client *pClient, uint32_t messagesPerSecond,
+												uint32_t bytesPerSecond);
+
+/**
+ * @brief Set the rules giving the priority class of published topics
+ *
+ * The rules are checked in order on every publish. The array needs to be static in
+ * memory since no malloc are performed by the SDK.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pRules Rules to use, NULL to publish every topic as PUBLISH_PRIORITY_NORMAL
+ * @param ruleCount Number of entries in pRules
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_set_publish_priority_rules(AWS_IoT_Client *pClient, const PublishPriorityRule *pRules,
+													uint32_t ruleCount);
+
+/**
+ * @brief Get the state and counters of the publish shaper
+ *
+ * Can be called from any thread.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pStats Filled with the current values
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_get_publish_shaper_stats(AWS_IoT_Client *pClient, PublishShaperStats *pStats);
+
+/**
+ * @brief Get the TLS handshake counters
+ *
+ * Reconnects offer the TLS session of the previous connection. A resumed session skips
+ * the key exchange and the certificate chain verification. The counters give the time
+ * of the handshakes and how often the server accepted the session. Can be called from any thread.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pStats Filled with the current counters
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_get_tls_handshake_stats(AWS_IoT_Client *pClient, TLSHandshakeStats *pStats);
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+/**
+ * @brief Get the counters of the outbound queue
+ *
+ * Can be called from any thread. The values are read without stopping producers or the
+ * writer, so they may be slightly out of step with each other.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pStats Filled with the current counters
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_get_outbound_queue_stats(AWS_IoT_Client *pClient, OutboundQueueStats *pStats);
+#endif
+
+/**
+ * @brief Get the socket descriptor of the MQTT connection
+ *
+ * Called to get the descriptor of the socket used by the client so the application can
+ * drive the client from an event loop (poll/epoll, ecore_main_fd_handler) and call yield
+ * only when the socket becomes readable. The descriptor changes on every reconnect, so
+ * it must be queried again after yield returns NETWORK_RECONNECTED.
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * While an asynchronous connect is in progress the descriptor of that connect is returned,
+ * aws_iot_mqtt_connect_continue then tells which readiness to wait for.
+ *
+ * @return socket descriptor, -1 if the client is neither connected nor connecting asynchronously
+ */
+int aws_iot_mqtt_get_network_fd(AWS_IoT_Client *pClient);
+
+/**
+ * @brief Does the client hold received data not signalled by the socket?
+ *
+ * A single TLS record can carry several MQTT packets. Once the record is decrypted the
+ * remaining packets no longer make the socket readable, so an event driven caller must
+ * keep calling yield while this returns true before waiting on the descriptor again.
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return true = buffered data is waiting to be processed, false = wait on the socket
+ */
+bool aws_iot_mqtt_has_pending_data(AWS_IoT_Client *pClient);
+
+/**
+ * @brief Time until the client needs processing time without any incoming data
+ *
+ * Called to get the number of milliseconds until the next keepalive, reconnect or
+ * in-flight publish retransmission deadline, or until an asynchronous connect times out.
+ * An event driven caller arms a single timer with this value and calls yield when either
+ * the timer fires or the socket becomes readable. An asynchronous publish made on another
+ * thread can add a deadline earlier than the armed one, the publishing thread then has to
+ * wake the waiting thread so it arms the timer again.
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return milliseconds until the next deadline, 0 if it has already passed,
+ *         AWS_IOT_MQTT_NO_TIMEOUT_MS if nothing is scheduled
+ */
+uint32_t aws_iot_mqtt_get_next_timeout_ms(AWS_IoT_Client *pClient);
+
 #ifdef __cplusplus
 }
 #endif
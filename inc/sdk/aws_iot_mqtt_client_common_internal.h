@@ -75,6 +75,15 @@ typedef enum msgTypes {
 #define MQTT_HEADER_FIELD_QOS(_byte)	((_byte & (3 << 1)) >> 1)
 #define MQTT_HEADER_FIELD_RETAIN(_byte)	((_byte & (1 << 0)) >> 0)
 
+/* MQTT 5 property identifiers used by the client */
+#define MQTT_PROPERTY_SESSION_EXPIRY_INTERVAL	0x11
+#define MQTT_PROPERTY_SERVER_KEEP_ALIVE		0x13
+#define MQTT_PROPERTY_TOPIC_ALIAS_MAXIMUM	0x22
+#define MQTT_PROPERTY_TOPIC_ALIAS		0x23
+
+/* MQTT 5 reason codes from this value up report a failure */
+#define MQTT_REASON_CODE_FAILURE	0x80
+
 /**
  * Bitfields for the MQTT header byte.
  */
@@ -90,6 +99,12 @@ IoT_Error_t aws_iot_mqtt_internal_serialize_ack(unsigned char *pTxBuf, size_t tx
 												uint32_t *pSerializedLen);
 IoT_Error_t aws_iot_mqtt_internal_deserialize_ack(unsigned char *, unsigned char *,
 												  uint16_t *, unsigned char *, size_t);
+IoT_Error_t aws_iot_mqtt_internal_serialize_publish_header(unsigned char *pTxBuf, size_t txBufLen,
+														   MQTT_Ver_t version, uint8_t dup, QoS qos,
+														   uint8_t retained, uint16_t packetId,
+														   const char *pTopicName, uint16_t topicNameLen,
+														   uint16_t topicAlias, size_t payloadLen,
+														   uint32_t *pSerializedLen);
 
 uint32_t aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(uint32_t rem_len);
 
@@ -97,6 +112,11 @@ size_t aws_iot_mqtt_internal_write_len_to_buffer(unsigned char *buf, uint32_t le
 IoT_Error_t aws_iot_mqtt_internal_decode_remaining_length_from_buffer(unsigned char *buf, uint32_t *decodedLen,
 																	  uint32_t *readBytesLen);
 
+IoT_Error_t aws_iot_mqtt_internal_read_properties_length(unsigned char **pptr, unsigned char *enddata,
+														 unsigned char **pPropertiesEnd);
+IoT_Error_t aws_iot_mqtt_internal_read_property(unsigned char **pptr, unsigned char *enddata, uint8_t *pId,
+												uint32_t *pValue);
+
 uint16_t aws_iot_mqtt_internal_read_uint16_t(unsigned char **pptr);
 void aws_iot_mqtt_internal_write_uint_16(unsigned char **pptr, uint16_t anInt);
 
@@ -105,7 +125,13 @@ void aws_iot_mqtt_internal_write_char(unsigned char **pptr, unsigned char c);
 void aws_iot_mqtt_internal_write_utf8_string(unsigned char **pptr, const char *string, uint16_t stringLen);
 
 IoT_Error_t aws_iot_mqtt_internal_flushBuffers( AWS_IoT_Client *pClient );
+bool aws_iot_mqtt_internal_has_buffered_packet(AWS_IoT_Client *pClient);
+IoT_Error_t aws_iot_mqtt_internal_lock_write(AWS_IoT_Client *pClient);
+IoT_Error_t aws_iot_mqtt_internal_unlock_write(AWS_IoT_Client *pClient);
 IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t length, Timer *pTimer);
+IoT_Error_t aws_iot_mqtt_internal_send_packet_with_payload(AWS_IoT_Client *pClient, size_t length,
+														   const unsigned char *pPayload, size_t payloadLen,
+														   Timer *pTimer);
 IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTimer, uint8_t *pPacketType);
 IoT_Error_t aws_iot_mqtt_internal_wait_for_read(AWS_IoT_Client *pClient, uint8_t packetType, Timer *pTimer);
 IoT_Error_t aws_iot_mqtt_internal_serialize_zero(unsigned char *pTxBuf, size_t txBufLen,
@@ -118,6 +144,34 @@ IoT_Error_t aws_iot_mqtt_internal_deserialize_publish(uint8_t *dup, QoS *qos,
 
 IoT_Error_t aws_iot_mqtt_set_client_state(AWS_IoT_Client *pClient, ClientState expectedCurrentState,
 										  ClientState newState);
+bool aws_iot_mqtt_internal_is_client_available(AWS_IoT_Client *pClient, bool isCbReturnAllowed);
+void aws_iot_mqtt_internal_force_client_state(AWS_IoT_Client *pClient, ClientState newState);
+IoT_Error_t aws_iot_mqtt_internal_acquire_client_state(AWS_IoT_Client *pClient, ClientState newState,
+													   bool isCbReturnAllowed, uint32_t timeout_ms,
+													   ClientState *pPrevState);
+
+void aws_iot_mqtt_internal_trie_init(AWS_IoT_Client *pClient);
+IoT_Error_t aws_iot_mqtt_internal_trie_insert(AWS_IoT_Client *pClient, uint32_t handlerIndex);
+void aws_iot_mqtt_internal_trie_remove(AWS_IoT_Client *pClient, uint32_t handlerIndex);
+uint32_t aws_iot_mqtt_internal_trie_dispatch(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+											 IoT_Publish_Message_Params *pMessageParams, size_t chunkOffset,
+											 size_t totalLen, bool isFinal);
+
+IoT_Error_t aws_iot_mqtt_internal_complete_inflight_publish(AWS_IoT_Client *pClient, uint16_t packetId,
+															IoT_Error_t result);
+IoT_Error_t aws_iot_mqtt_internal_resend_inflight_publishes(AWS_IoT_Client *pClient);
+IoT_Error_t aws_iot_mqtt_internal_restart_inflight_publishes(AWS_IoT_Client *pClient);
+
+void aws_iot_mqtt_internal_shaper_reset(AWS_IoT_Client *pClient);
+PublishPriority aws_iot_mqtt_internal_get_publish_priority(AWS_IoT_Client *pClient, const char *pTopicName,
+														   uint16_t topicNameLen);
+IoT_Error_t aws_iot_mqtt_internal_shape_publish(AWS_IoT_Client *pClient, PublishPriority priority,
+												uint32_t packetLen);
+
+void aws_iot_mqtt_internal_note_activity(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_note_sent(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_start_keepalive(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_handle_pingresp(AWS_IoT_Client *pClient);
 
 #ifdef _ENABLE_THREAD_SUPPORT_
 
@@ -125,6 +179,8 @@ IoT_Error_t aws_iot_mqtt_client_lock_mutex(AWS_IoT_Client *pClient, IoT_Mutex_t
 
 IoT_Error_t aws_iot_mqtt_client_unlock_mutex(AWS_IoT_Client *pClient, IoT_Mutex_t *pMutex);
 
+void aws_iot_mqtt_internal_outbound_queue_init(AWS_IoT_Client *pClient);
+
 #endif
 
 #ifdef __cplusplus
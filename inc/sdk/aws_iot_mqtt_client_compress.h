@@ -0,0 +1,96 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_client_compress.h
+ * @brief Payload codec for compressed MQTT messages
+ *
+ * A compressed payload starts with a codec byte followed by the length of the
+ * original payload as an MQTT variable length integer, then the compressed data.
+ * The codec bytes 0xC0 and 0xC1 never appear in UTF-8 text, so compressed payloads
+ * can not be mistaken for JSON. A receiver not knowing the codec byte gets the
+ * payload as it was sent.
+ *
+ * AWS_IOT_MQTT_CODEC_LZ4_JSON is an LZ4 block preceded by a built-in dictionary of
+ * the JSON vocabulary of shadow, jobs and door documents. The dictionary is part of
+ * the codec, a new dictionary needs a new codec byte.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_MQTT_COMPRESS_H
+#define AWS_IOT_SDK_SRC_IOT_MQTT_COMPRESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aws_iot_error.h"
+
+/* LZ4 block with the built-in JSON dictionary */
+#define AWS_IOT_MQTT_CODEC_LZ4_JSON 0xC1
+
+/* Codec byte and the longest encoding of the original length */
+#define AWS_IOT_MQTT_CODEC_HEADER_MAX_LEN 5
+
+/**
+ * @brief Compress a payload
+ *
+ * @param pIn Payload to compress
+ * @param inLen Length of the payload
+ * @param pOut Buffer receiving the compressed payload
+ * @param outSize Size of pOut
+ * @param pOutLen Set to the length of the compressed payload
+ *
+ * @return SUCCESS, MAX_SIZE_ERROR if the payload is too large for the codec,
+ *         FAILURE if the compressed payload does not fit in pOut
+ */
+IoT_Error_t aws_iot_mqtt_compress_payload(const unsigned char *pIn, size_t inLen, unsigned char *pOut,
+										  size_t outSize, size_t *pOutLen);
+
+/**
+ * @brief Check if a payload was compressed by a codec of this SDK
+ *
+ * @param pPayload Received payload
+ * @param payloadLen Length of the payload
+ *
+ * @return true if the payload starts with a known codec byte
+ */
+bool aws_iot_mqtt_is_payload_compressed(const unsigned char *pPayload, size_t payloadLen);
+
+/**
+ * @brief Decompress a payload
+ *
+ * The payload is decompressed straight into pOut, nothing is copied on the way.
+ *
+ * @param pIn Compressed payload
+ * @param inLen Length of the compressed payload
+ * @param pOut Buffer receiving the original payload
+ * @param outSize Size of pOut
+ * @param pOutLen Set to the length of the original payload
+ *
+ * @return SUCCESS, MQTT_RX_BUFFER_TOO_SHORT_ERROR if the original payload does not fit in pOut,
+ *         FAILURE if the payload is not a valid compressed payload
+ */
+IoT_Error_t aws_iot_mqtt_decompress_payload(const unsigned char *pIn, size_t inLen, unsigned char *pOut,
+											size_t outSize, size_t *pOutLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_MQTT_COMPRESS_H */
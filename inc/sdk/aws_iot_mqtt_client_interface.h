@@ -93,6 +93,40 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, IoT_Client_Init_Params *p
  */
 IoT_Error_t aws_iot_mqtt_connect(AWS_IoT_Client *pClient, IoT_Client_Connect_Params *pConnectParams);
 
+/**
+ * @brief MQTT Connection Function that does not block
+ *
+ * Called to start a connection with the AWS IoT Service and return at once. The socket
+ * connect, the TLS handshake and the CONNACK wait are advanced by aws_iot_mqtt_connect_continue,
+ * called whenever the descriptor of aws_iot_mqtt_get_network_fd is ready for the direction it
+ * asked for or the deadline of aws_iot_mqtt_get_next_timeout_ms has passed.
+ * The client state stays CONNECTING until pCompleteHandler is called with the result.
+ * Falls back to aws_iot_mqtt_connect when the network layer has no asynchronous connect.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pConnectParams Pointer to MQTT connection parameters
+ * @param pCompleteHandler Handler called once the connect succeeded or failed, can be NULL
+ * @param pCompleteHandlerData Pointer to data passed to the completion handler
+ *
+ * @return NETWORK_CONNECT_WANT_WRITE or NETWORK_CONNECT_WANT_READ once the connect is started,
+ *         the result of the connect if it already completed, an error if it could not be started
+ */
+IoT_Error_t aws_iot_mqtt_connect_async(AWS_IoT_Client *pClient, IoT_Client_Connect_Params *pConnectParams,
+									   pConnectCompleteHandler_t pCompleteHandler, void *pCompleteHandlerData);
+
+/**
+ * @brief Advance a connection started by aws_iot_mqtt_connect_async
+ *
+ * Does the work the socket allows without blocking. The completion handler is called from
+ * here once the connect succeeded or failed, it may already use the client.
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return NETWORK_CONNECT_WANT_WRITE or NETWORK_CONNECT_WANT_READ while waiting for the socket,
+ *         SUCCESS once connected, the error the connect failed with otherwise
+ */
+IoT_Error_t aws_iot_mqtt_connect_continue(AWS_IoT_Client *pClient);
+
 /**
  * @brief Publish an MQTT message on a topic
  *
@@ -100,17 +134,115 @@ IoT_Error_t aws_iot_mqtt_connect(AWS_IoT_Client *pClient, IoT_Client_Connect_Par
  * @note Call is blocking.  In the case of a QoS 0 message the function returns
  * after the message was successfully passed to the TLS layer.  In the case of QoS 1
  * the function returns after the receipt of the PUBACK control packet.
+ * Payloads that do not fit in the TX buffer are written to the network straight
+ * from pParams->payload, up to the 256 MB limit of MQTT.
+ * With _ENABLE_THREAD_SUPPORT_ the call does not wait for a yield running on another
+ * thread. QoS 1 messages then take an in-flight entry until their PUBACK is read
+ * by that yield, see aws_iot_mqtt_publish_async.
  *
  * @param pClient Reference to the IoT Client
  * @param pTopicName Topic Name to publish to
  * @param topicNameLen Length of the topic name
  * @param pParams Pointer to Publish Message parameters
  *
- * @return An IoT Error Type defining successful/failed publish
+ * @return An IoT Error Type defining successful/failed publish.
+ *         MQTT_PUBLISH_THROTTLED_ERROR if the publish shaper would hold the message back past the command
+ *         timeout, nothing was sent. Shorter waits for the shaper are spent in the call, see
+ *         aws_iot_mqtt_set_publish_rate_limit
  */
 IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
 								 IoT_Publish_Message_Params *pParams);
 
+/**
+ * @brief Publish an MQTT message on a topic without waiting for the PUBACK
+ *
+ * Called to publish a QoS1 message and return as soon as it was passed to the TLS layer.
+ * The message is kept in the in-flight table until its PUBACK is received by yield, which
+ * then calls pCompleteHandler. Unacknowledged messages are sent again with the DUP flag
+ * every AWS_IOT_MQTT_INFLIGHT_RETRY_INTERVAL and dropped after AWS_IOT_MQTT_INFLIGHT_MAX_RETRIES.
+ * Up to AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH messages can be outstanding at the same time.
+ * QoS0 messages are not tracked, the call then behaves like aws_iot_mqtt_publish and
+ * pCompleteHandler is not called.
+ * @warning pTopicName and the payload need to stay valid until pCompleteHandler is called
+ * since no malloc are performed by the SDK.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic Name to publish to
+ * @param topicNameLen Length of the topic name
+ * @param pParams Pointer to Publish Message parameters. pParams->id is set to the packet id used
+ * @param pCompleteHandler Handler called once the message is acknowledged or dropped, can be NULL
+ * @param pCompleteHandlerData Pointer to data passed to the completion handler
+ *
+ * @return An IoT Error Type defining successful/failed publish.
+ *         MQTT_INFLIGHT_WINDOW_FULL_ERROR if all in-flight entries are in use,
+ *         MQTT_PUBLISH_THROTTLED_ERROR if the publish shaper refused the message
+ */
+IoT_Error_t aws_iot_mqtt_publish_async(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+									   IoT_Publish_Message_Params *pParams,
+									   pPublishCompleteHandler_t pCompleteHandler, void *pCompleteHandlerData);
+
+/**
+ * @brief Publish an MQTT message with a compressed payload
+ *
+ * Called like aws_iot_mqtt_publish for topics whose subscribers know the codec of
+ * aws_iot_mqtt_client_compress.h. The payload is compressed into pWorkBuf and published
+ * from there. Payloads that do not get smaller are published as they are, so the
+ * receiver has to check the codec byte. Shadow and jobs topics are read by AWS services
+ * and must not be published compressed.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic Name to publish to
+ * @param topicNameLen Length of the topic name
+ * @param pParams Pointer to Publish Message parameters. pParams->id is set to the packet id used
+ * @param pWorkBuf Buffer receiving the compressed payload, needs to stay valid until the call returns
+ * @param workBufLen Size of pWorkBuf
+ *
+ * @return An IoT Error Type defining successful/failed publish
+ */
+IoT_Error_t aws_iot_mqtt_publish_compressed(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+											IoT_Publish_Message_Params *pParams, unsigned char *pWorkBuf,
+											size_t workBufLen);
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+/**
+ * @brief Queue an MQTT message for the writer thread
+ *
+ * Called to serialize a QoS0 publish into a slot of the outbound queue and return without
+ * touching the network or taking any lock, so it is safe to call from threads that must not
+ * block. The queue is a bounded ring shared by any number of producer threads. A single
+ * writer thread sends the queued packets with aws_iot_mqtt_drain_outbound_queue.
+ * Messages queued while the client is reconnecting are sent once the connection is back.
+ * The topic and payload are copied, they can be reused as soon as the call returns.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic Name to publish to
+ * @param topicNameLen Length of the topic name
+ * @param pParams Pointer to Publish Message parameters, only QoS0 is supported
+ *
+ * @return An IoT Error Type defining successful/failed enqueue.
+ *         MQTT_TX_BUFFER_TOO_SHORT_ERROR if the packet is larger than AWS_IOT_MQTT_OUTBOUND_SLOT_LEN,
+ *         MQTT_OUTBOUND_QUEUE_FULL_ERROR if all slots are taken
+ */
+IoT_Error_t aws_iot_mqtt_publish_enqueue(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+										 IoT_Publish_Message_Params *pParams);
+
+/**
+ * @brief Write the queued messages to the network
+ *
+ * Called from the single writer thread. Adjacent packets are copied into the TX buffer
+ * back to back and passed to the TLS layer in one write. Packets are only removed from the
+ * queue once they were written, on failure they stay queued for the next call.
+ * Must not be called from more than one thread at a time.
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return An IoT Error Type defining successful/failed write.
+ *         SUCCESS once the queue is empty, NETWORK_DISCONNECTED_ERROR while the client is not connected,
+ *         MQTT_PUBLISH_THROTTLED_ERROR when the publish shaper holds back the next packet
+ */
+IoT_Error_t aws_iot_mqtt_drain_outbound_queue(AWS_IoT_Client *pClient);
+#endif
+
 /**
  * @brief Subscribe to an MQTT topic.
  *
@@ -132,11 +264,61 @@ IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName
 IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
 								   QoS qos, pApplicationHandler_t pApplicationHandler, void *pApplicationHandlerData);
 
+/**
+ * @brief Subscribe to an MQTT topic with a streaming handler.
+ *
+ * Same as aws_iot_mqtt_subscribe, but payloads are handed to the application in chunks.
+ * Messages larger than the RX buffer, which are otherwise dropped, are read from the
+ * network and delivered one buffer-sized chunk at a time, so job documents or shadow
+ * documents of any size can be consumed without raising AWS_IOT_MQTT_RX_BUF_LEN.
+ * A chunk with offset 0 starts a new message. A message interrupted by a network
+ * error never gets its final chunk.
+ * @note Call is blocking.  The call returns after the receipt of the SUBACK control packet.
+ * @note The handler is called while the payload is being read, it must not call blocking MQTT APIs.
+ * @warning pTopicName and pApplicationHandlerData need to be static in memory.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic Name to subscribe to. pTopicName needs to be static in memory since
+ *     no malloc are performed by the SDK
+ * @param topicNameLen Length of the topic name
+ * @param qos Requested QoS of the subscription
+ * @param pStreamApplicationHandler Reference to the streaming handler function for this subscription
+ * @param pApplicationHandlerData Point to data passed to the callback.
+ *    pApplicationHandlerData also needs to be static in memory  since no malloc are performed by the SDK
+ *
+ * @return An IoT Error Type defining successful/failed subscription
+ */
+IoT_Error_t aws_iot_mqtt_subscribe_stream(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+										  QoS qos, pStreamApplicationHandler_t pStreamApplicationHandler,
+										  void *pApplicationHandlerData);
+
+/**
+ * @brief Subscribe to several MQTT topics at once.
+ *
+ * Sends all the topic filters in a single SUBSCRIBE packet and waits for its SUBACK,
+ * so the subscriptions cost one round trip instead of one per filter.
+ * The returnCode of every entry is set from the SUBACK. Refused filters are not
+ * subscribed, the others stay subscribed even if the call fails because of them.
+ * @note Call is blocking.  The call returns after the receipt of the SUBACK control packet.
+ * @warning The topic names and handler data need to be static in memory.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pParams Array of topic filters to subscribe to
+ * @param count Number of entries in pParams, at most AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET
+ *
+ * @return SUCCESS if every filter was granted, FAILURE if the broker refused any of them,
+ *         another IoT Error Type if the SUBACK was not received
+ */
+IoT_Error_t aws_iot_mqtt_subscribe_batch(AWS_IoT_Client *pClient, IoT_Subscribe_Params *pParams, uint32_t count);
+
 /**
  * @brief Subscribe to an MQTT topic.
  *
  * Called to resubscribe to the topics that the client has active subscriptions on.
- * Internally called when autoreconnect is enabled
+ * Internally called when autoreconnect is enabled, unless the broker resumed a
+ * persistent session (see aws_iot_mqtt_is_session_present)
+ * The filters are packed into as few SUBSCRIBE packets as possible, all of them are
+ * sent before the SUBACKs are read.
  *
  * @note Call is blocking.  The call returns after the receipt of the SUBACK control packet.
  *
@@ -161,6 +343,22 @@ IoT_Error_t aws_iot_mqtt_resubscribe(AWS_IoT_Client *pClient);
  */
 IoT_Error_t aws_iot_mqtt_unsubscribe(AWS_IoT_Client *pClient, const char *pTopicFilter, uint16_t topicFilterLen);
 
+/**
+ * @brief Unsubscribe from several MQTT topics at once.
+ *
+ * Sends all the topic filters in a single UNSUBSCRIBE packet and waits for its UNSUBACK.
+ * @note Call is blocking.  The call returns after the receipt of the UNSUBACK control packet.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicFilters Array of topic filters, each one must be subscribed
+ * @param pTopicFilterLens Array of the lengths of the topic filters
+ * @param count Number of topic filters, at most AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET
+ *
+ * @return An IoT Error Type defining successful/failed unsubscribe call
+ */
+IoT_Error_t aws_iot_mqtt_unsubscribe_batch(AWS_IoT_Client *pClient, const char **pTopicFilters,
+										   uint16_t *pTopicFilterLens, uint32_t count);
+
 /**
  * @brief Disconnect an MQTT Connection
  *
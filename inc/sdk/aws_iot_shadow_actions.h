@@ -22,7 +22,7 @@ extern "C" {
 
 #include "aws_iot_shadow_interface.h"
 
-IoT_Error_t aws_iot_shadow_internal_action(const char *pThingName, ShadowActions_t action,
+IoT_Error_t aws_iot_shadow_internal_action(ShadowContext_t *pShadow, const char *pThingName, ShadowActions_t action,
 										   const char *pJsonDocumentToBeSent, size_t jsonSize, fpActionCallback_t callback,
 										   void *pCallbackContext, uint32_t timeout_seconds, bool isSticky);
 
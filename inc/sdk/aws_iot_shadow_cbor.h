@@ -0,0 +1,87 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_SHADOW_CBOR_H_
+#define AWS_IOT_SDK_SRC_IOT_SHADOW_CBOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file aws_iot_shadow_cbor.h
+ * @brief CBOR (RFC 7049) encoding of the jsonStruct_t name value pairs
+ *
+ * A document is a CBOR map of text string keys, built from the same jsonStruct_t
+ * descriptors as the shadow JSON documents. Numbers are written in binary, so neither
+ * side formats or scans text. The AWS IoT shadow and jobs services only read JSON,
+ * CBOR documents are meant for custom topics.
+ *
+ * Value mapping:
+ * - SHADOW_JSON_INT* and SHADOW_JSON_UINT* are integers in their shortest encoding
+ * - SHADOW_JSON_FLOAT is a single precision float
+ * - SHADOW_JSON_DOUBLE is a single precision float if that is exact, a double otherwise
+ * - SHADOW_JSON_BOOL is true or false
+ * - SHADOW_JSON_STRING is a text string of the null terminated pData
+ * - SHADOW_JSON_OBJECT is dataLength bytes of pData holding an encoded CBOR item,
+ *   e.g. a nested document from aws_iot_cbor_encode_document
+ *
+ * Decoding accepts any well-formed document with definite lengths, which is what
+ * common CBOR libraries write by default. Half precision floats are read as well.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+#include "aws_iot_error.h"
+#include "aws_iot_shadow_json_data.h"
+
+/**
+ * @brief Encode jsonStruct_t name value pairs into a CBOR map
+ *
+ * This is a variadic function like aws_iot_shadow_add_reported, count is the number of
+ * jsonStruct_t pointers passed in the arguments. Nothing is allocated.
+ *
+ * @param pBuffer The CBOR document is written to this buffer
+ * @param bufferSize Size of pBuffer
+ * @param pEncodedLength Set to the length of the CBOR document
+ * @param count total number of arguments(jsonStruct_t object) passed in the arguments
+ * @return SUCCESS, NULL_VALUE_ERROR or SHADOW_JSON_BUFFER_TRUNCATED if the document does not fit
+ */
+IoT_Error_t aws_iot_cbor_encode_document(unsigned char *pBuffer, size_t bufferSize, size_t *pEncodedLength,
+										 uint8_t count, ...);
+
+/**
+ * @brief Update jsonStruct_t values from a CBOR map
+ *
+ * For every jsonStruct_t passed whose key is in the top level map, pData is updated and
+ * the callback is called with the encoded CBOR item of the value. Strings are copied with
+ * their null terminator and need to fit in dataLength. SHADOW_JSON_OBJECT values are not
+ * copied, the callback gets the encoded item. Values of another type, out of range or too
+ * long are skipped with a warning. Keys not registered are ignored.
+ *
+ * @param pBuffer The CBOR document
+ * @param bufferLength Length of the CBOR document
+ * @param count total number of arguments(jsonStruct_t object) passed in the arguments
+ * @return SUCCESS, NULL_VALUE_ERROR or JSON_PARSE_ERROR if the document is not a valid CBOR map
+ */
+IoT_Error_t aws_iot_cbor_decode_document(const unsigned char *pBuffer, size_t bufferLength, uint8_t count, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_SHADOW_CBOR_H_ */
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_SHADOW_CONTEXT_H_
+#define AWS_IOT_SDK_SRC_IOT_SHADOW_CONTEXT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file aws_iot_shadow_context.h
+ * @brief State of one shadow instance
+ *
+ * Everything the shadow client keeps between calls lives in a ShadowContext_t owned by the
+ * application and bound to one MQTT client by aws_iot_shadow_init. Instances share no state
+ * apart from the client token sequence, so each connection can be driven from its own thread
+ * without a global lock. Calls on one instance are serialized by the caller as before.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "aws_iot_config.h"
+#include "aws_iot_shadow_interface.h"
+#include "aws_iot_shadow_json.h"
+#include "aws_iot_timer_wheel.h"
+
+#define MAX_TOPICS_AT_ANY_GIVEN_TIME 2*MAX_THINGNAME_HANDLED_AT_ANY_GIVEN_TIME
+
+typedef struct {
+	char clientTokenID[MAX_SIZE_CLIENT_ID_WITH_SEQUENCE];
+	char thingName[MAX_SIZE_OF_THING_NAME];
+	ShadowActions_t action;
+	fpActionCallback_t callback;
+	void *pCallbackContext;
+	bool isFree;
+	TimerWheelEntry timeoutEntry;
+} ToBeReceivedAckRecord_t;
+
+typedef struct {
+	const char *pKey;
+	void *pStruct;
+	jsonStructCallback_t callback;
+	bool isFree;
+} JsonTokenTable_t;
+
+typedef struct {
+	char Topic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	uint8_t count;
+	bool isFree;
+	bool isSticky;
+} SubscriptionRecord_t;
+
+struct _ShadowContext {
+	AWS_IoT_Client *pMqttClient;	///< Client the instance publishes and subscribes on
+	char myThingName[MAX_SIZE_OF_THING_NAME];
+	char mqttClientID[MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES];	///< Prefix of the client tokens of get and delete requests
+	char shadowDeltaTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	char deleteAcceptedTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+
+	ToBeReceivedAckRecord_t AckWaitList[MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME];
+	TimerWheel AckTimeoutWheel;	///< Times out the records of AckWaitList
+	SubscriptionRecord_t SubscriptionList[MAX_TOPICS_AT_ANY_GIVEN_TIME];
+
+	JsonTokenTable_t tokenTable[MAX_JSON_TOKEN_EXPECTED];
+	uint32_t tokenTableIndex;
+	bool deltaTopicSubscribedFlag;
+
+	uint32_t shadowJsonVersionNum;	///< Last version received on get/accepted or delta
+	bool shadowDiscardOldDeltaFlag;	///< Ignore deltas not newer than shadowJsonVersionNum
+
+	char shadowRxBuf[SHADOW_MAX_SIZE_OF_RX_BUFFER];
+	ShadowJsonParser_t jsonParser;	///< Tokens of the document in shadowRxBuf
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_SHADOW_CONTEXT_H_ */
@@ -40,6 +40,14 @@ extern "C" {
 #include "aws_iot_mqtt_client_interface.h"
 #include "aws_iot_shadow_json_data.h"
 
+/*!
+ * @brief Shadow instance state
+ *
+ * Records, subscriptions, delta tokens and receive buffer of one shadow connection. Defined in
+ * aws_iot_shadow_context.h, include it to allocate one instance per connection.
+ */
+typedef struct _ShadowContext ShadowContext_t;
+
 /*!
  * @brief Shadow Initialization parameters
  *
@@ -57,6 +65,7 @@ typedef struct {
 	char *pClientKey; ///< Location of Device private key
 	bool enableAutoReconnect;        ///< Set to true to enable auto reconnect
 	iot_disconnect_handler disconnectHandler;    ///< Callback to be invoked upon connection loss.
+	ShadowContext_t *pContext;	///< State of this shadow instance, NULL uses the single built-in instance
 } ShadowInitParameters_t;
 
 /*!
@@ -107,6 +116,7 @@ IoT_Error_t aws_iot_shadow_free(AWS_IoT_Client *pClient);
  * @brief Initialize the Thing Shadow before use
  *
  * This function takes care of initializing the internal book-keeping data structures and initializing the IoT client.
+ * Every client needs its own ShadowInitParameters_t::pContext, independent instances can then run on separate threads.
  *
  * @param pClient A new MQTT Client to be used as the protocol layer. Will be initialized with pParams.
  * @return An IoT Error Type defining successful/failed Initialization
@@ -258,10 +268,11 @@ IoT_Error_t aws_iot_shadow_register_delta(AWS_IoT_Client *pClient, jsonStruct_t
 /**
  * @brief Reset the last received version number to zero.
  * This will be useful if the Thing Shadow is deleted and would like to to reset the local version
+ * @param pClient MQTT Client used as the protocol layer
  * @return no return values
  *
  */
-void aws_iot_shadow_reset_last_received_version(void);
+void aws_iot_shadow_reset_last_received_version(AWS_IoT_Client *pClient);
 
 /**
  * @brief Version of a document is received with every accepted/rejected and the SDK keeps track of the last received version of the JSON document of #AWS_IOT_MY_THING_NAME shadow
@@ -269,22 +280,27 @@ void aws_iot_shadow_reset_last_received_version(void);
  * One exception to this version tracking is that, the SDK will ignore the version from update/accepted topic. Rest of the responses will be scanned to update the version number.
  * Accepting version change for update/accepted may cause version conflicts for delta message if the update message is received before the delta.
  *
+ * @param pClient MQTT Client used as the protocol layer
  * @return version number of the last received response
  *
  */
-uint32_t aws_iot_shadow_get_last_received_version(void);
+uint32_t aws_iot_shadow_get_last_received_version(AWS_IoT_Client *pClient);
 
 /**
  * @brief Enable the ignoring of delta messages with old version number
  *
  * As we use MQTT underneath, there could be more than 1 of the same message if we use QoS 0. To avoid getting called for the same message, this functionality should be enabled. All the old message will be ignored
+ *
+ * @param pClient MQTT Client used as the protocol layer
  */
-void aws_iot_shadow_enable_discard_old_delta_msgs(void);
+void aws_iot_shadow_enable_discard_old_delta_msgs(AWS_IoT_Client *pClient);
 
 /**
  * @brief Disable the ignoring of delta messages with old version number
+ *
+ * @param pClient MQTT Client used as the protocol layer
  */
-void aws_iot_shadow_disable_discard_old_delta_msgs(void);
+void aws_iot_shadow_disable_discard_old_delta_msgs(AWS_IoT_Client *pClient);
 
 /**
  * @brief This function is used to enable or disable autoreconnect
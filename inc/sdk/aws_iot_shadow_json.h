@@ -23,24 +23,39 @@ extern "C" {
 #include <stdbool.h>
 #include <stdarg.h>
 
+#include "aws_iot_config.h"
 #include "aws_iot_error.h"
 #include "aws_iot_shadow_json_data.h"
+#include "jsmn.h"
+
+/**
+ * @brief Shadow JSON Parser Type
+ *
+ * Parser state and tokens of the last parsed document. Passed as pJsonHandler, every
+ * shadow instance owns one so instances parse on separate threads.
+ *
+ */
+typedef struct {
+	jsmn_parser parser;
+	jsmntok_t tokens[MAX_JSON_TOKEN_EXPECTED];
+} ShadowJsonParser_t;
 
 bool isJsonValidAndParse(const char *pJsonDocument, size_t jsonSize, void *pJsonHandler, int32_t *pTokenCount);
 
 bool isJsonKeyMatchingAndUpdateValue(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount,
 									 jsonStruct_t *pDataStruct, uint32_t *pDataLength, int32_t *pDataPosition);
 
-IoT_Error_t aws_iot_shadow_internal_get_request_json(char *pBuffer, size_t bufferSize);
+IoT_Error_t aws_iot_shadow_internal_get_request_json(const char *pClientID, char *pBuffer, size_t bufferSize);
 
-IoT_Error_t aws_iot_shadow_internal_delete_request_json(char *pBuffer, size_t bufferSize);
+IoT_Error_t aws_iot_shadow_internal_delete_request_json(const char *pClientID, char *pBuffer, size_t bufferSize);
 
-void resetClientTokenSequenceNum(void);
+void setClientTokenPrefix(const char *pClientID);
 
 
-bool isReceivedJsonValid(const char *pJsonDocument, size_t jsonSize);
+bool isReceivedJsonValid(const char *pJsonDocument, size_t jsonSize, void *pJsonHandler);
 
-bool extractClientToken(const char *pJsonDocument, size_t jsonSize, char *pExtractedClientToken, size_t clientTokenSize);
+bool extractClientToken(const char *pJsonDocument, size_t jsonSize, void *pJsonHandler, char *pExtractedClientToken,
+						size_t clientTokenSize);
 
 bool extractVersionNumber(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount, uint32_t *pVersionNumber);
 
@@ -23,30 +23,24 @@ extern "C" {
 #include <stdbool.h>
 
 #include "aws_iot_shadow_interface.h"
+#include "aws_iot_shadow_context.h"
 #include "aws_iot_config.h"
 
-
-extern uint32_t shadowJsonVersionNum;
-extern bool shadowDiscardOldDeltaFlag;
-
-extern char myThingName[MAX_SIZE_OF_THING_NAME];
-extern uint16_t myThingNameLen;
-extern char mqttClientID[MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES];
-extern uint16_t mqttClientIDLen;
-
-void initializeRecords(AWS_IoT_Client *pClient);
-bool isSubscriptionPresent(const char *pThingName, ShadowActions_t action);
-IoT_Error_t subscribeToShadowActionAcks(const char *pThingName, ShadowActions_t action, bool isSticky);
-void incrementSubscriptionCnt(const char *pThingName, ShadowActions_t action, bool isSticky);
-
-IoT_Error_t publishToShadowAction(const char *pThingName, ShadowActions_t action, const char *pJsonDocumentToBeSent);
-void addToAckWaitList(uint8_t indexAckWaitList, const char *pThingName, ShadowActions_t action,
-					  const char *pExtractedClientToken, fpActionCallback_t callback, void *pCallbackContext,
-					  uint32_t timeout_seconds);
-bool getNextFreeIndexOfAckWaitList(uint8_t *pIndex);
-void HandleExpiredResponseCallbacks(void);
-void initDeltaTokens(void);
-IoT_Error_t registerJsonTokenOnDelta(jsonStruct_t *pStruct);
+void initializeRecords(ShadowContext_t *pShadow, AWS_IoT_Client *pClient);
+bool isSubscriptionPresent(ShadowContext_t *pShadow, const char *pThingName, ShadowActions_t action);
+IoT_Error_t subscribeToShadowActionAcks(ShadowContext_t *pShadow, const char *pThingName, ShadowActions_t action,
+										bool isSticky);
+void incrementSubscriptionCnt(ShadowContext_t *pShadow, const char *pThingName, ShadowActions_t action, bool isSticky);
+
+IoT_Error_t publishToShadowAction(ShadowContext_t *pShadow, const char *pThingName, ShadowActions_t action,
+								  const char *pJsonDocumentToBeSent);
+void addToAckWaitList(ShadowContext_t *pShadow, uint8_t indexAckWaitList, const char *pThingName,
+					  ShadowActions_t action, const char *pExtractedClientToken, fpActionCallback_t callback,
+					  void *pCallbackContext, uint32_t timeout_seconds);
+bool getNextFreeIndexOfAckWaitList(ShadowContext_t *pShadow, uint8_t *pIndex);
+void HandleExpiredResponseCallbacks(ShadowContext_t *pShadow);
+void initDeltaTokens(ShadowContext_t *pShadow);
+IoT_Error_t registerJsonTokenOnDelta(ShadowContext_t *pShadow, jsonStruct_t *pStruct);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_TIMER_WHEEL_H_
+#define AWS_IOT_SDK_SRC_IOT_TIMER_WHEEL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file aws_iot_timer_wheel.h
+ * @brief Hierarchical timing wheel for deadlines owned by the SDK
+ *
+ * Entries are embedded in the records they time out, nothing is allocated.
+ * Scheduling and cancelling are O(1). Each entry is moved down at most once per level
+ * before it expires, so expiring is O(1) per entry as well. The time to the earliest
+ * deadline is found from the per level occupancy bitmaps without walking the entries.
+ *
+ * Deadlines are rounded up to AWS_IOT_TIMER_WHEEL_TICK_MS and checked against the coarse
+ * clock, an entry expires late by up to a tick but never early. Timeouts longer than
+ * the range of the wheel, 2^24 ticks, are clamped to it.
+ *
+ * A wheel is not thread safe, the owner serializes the calls.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AWS_IOT_TIMER_WHEEL_LEVEL_BITS 6
+#define AWS_IOT_TIMER_WHEEL_SLOTS (1u << AWS_IOT_TIMER_WHEEL_LEVEL_BITS)
+#define AWS_IOT_TIMER_WHEEL_LEVELS 4
+#define AWS_IOT_TIMER_WHEEL_NO_TIMEOUT 0xFFFFFFFF
+
+/**
+ * @brief Timing Wheel Entry Type
+ *
+ * Defining a type for a deadline held by a timing wheel. The entry is embedded in
+ * the record it times out and points back at it with pData.
+ *
+ */
+typedef struct _TimerWheelEntry {
+	struct _TimerWheelEntry *pNext;
+	struct _TimerWheelEntry **ppPrev;	///< Link pointing at this entry, NULL if the entry is not scheduled
+	uint32_t expiryTick;
+	uint16_t slotIndex;	///< Slot holding the entry, level * AWS_IOT_TIMER_WHEEL_SLOTS + slot
+	void *pData;	///< Record the entry belongs to, set by aws_iot_timer_wheel_init_entry
+} TimerWheelEntry;
+
+/**
+ * @brief Timing Wheel Type
+ *
+ * Level 0 slots are one tick wide, every level above covers AWS_IOT_TIMER_WHEEL_SLOTS
+ * slots of the level below. Entries that expired wait on the expired list until
+ * aws_iot_timer_wheel_expire hands them out.
+ *
+ */
+typedef struct _TimerWheel {
+	TimerWheelEntry *pSlots[AWS_IOT_TIMER_WHEEL_LEVELS][AWS_IOT_TIMER_WHEEL_SLOTS];
+	uint64_t occupied[AWS_IOT_TIMER_WHEEL_LEVELS];	///< Bit n is set if slot n of the level holds entries
+	TimerWheelEntry *pExpired;
+	uint32_t currentTick;	///< Next tick to process
+	uint32_t lastTickMs;	///< Coarse time at which currentTick started
+	uint32_t entryCount;	///< Entries in the slots, the expired list is not counted
+} TimerWheel;
+
+/**
+ * @brief Initialize a timing wheel
+ *
+ * @param pWheel Timing wheel to initialize
+ */
+void aws_iot_timer_wheel_init(TimerWheel *pWheel);
+
+/**
+ * @brief Initialize a timing wheel entry
+ *
+ * Called once for every entry before it is scheduled.
+ *
+ * @param pEntry Entry to initialize
+ * @param pData Record the entry belongs to
+ */
+void aws_iot_timer_wheel_init_entry(TimerWheelEntry *pEntry, void *pData);
+
+/**
+ * @brief Schedule an entry
+ *
+ * An entry that is already scheduled or expired is moved to the new deadline.
+ *
+ * @param pWheel Timing wheel
+ * @param pEntry Entry to schedule
+ * @param timeoutMs Time in ms after which the entry expires
+ */
+void aws_iot_timer_wheel_schedule(TimerWheel *pWheel, TimerWheelEntry *pEntry, uint32_t timeoutMs);
+
+/**
+ * @brief Cancel an entry
+ *
+ * Does nothing if the entry is not scheduled.
+ *
+ * @param pWheel Timing wheel
+ * @param pEntry Entry to cancel
+ */
+void aws_iot_timer_wheel_cancel(TimerWheel *pWheel, TimerWheelEntry *pEntry);
+
+/**
+ * @brief Check if an entry is scheduled
+ *
+ * @param pEntry Entry to check
+ * @return true if the entry waits in the wheel or on the expired list
+ */
+bool aws_iot_timer_wheel_is_scheduled(const TimerWheelEntry *pEntry);
+
+/**
+ * @brief Take the next expired entry
+ *
+ * Advances the wheel to the current time and removes one expired entry. Called in a loop
+ * until it returns NULL, the caller may schedule or cancel entries between the calls.
+ *
+ * @param pWheel Timing wheel
+ * @return An expired entry, no longer scheduled, or NULL if no entry expired
+ */
+TimerWheelEntry *aws_iot_timer_wheel_expire(TimerWheel *pWheel);
+
+/**
+ * @brief Time until the earliest deadline
+ *
+ * Entries of the upper levels are counted from the tick their slot is moved down, so the
+ * result can be early but is never late. Waking up early only costs an empty expire call.
+ *
+ * @param pWheel Timing wheel
+ * @return Time in ms until an entry may expire, 0 if entries already expired or
+ *         AWS_IOT_TIMER_WHEEL_NO_TIMEOUT if nothing is scheduled
+ */
+uint32_t aws_iot_timer_wheel_next_timeout_ms(const TimerWheel *pWheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_TIMER_WHEEL_H_ */
@@ -32,6 +32,23 @@ extern "C" {
 #include <stdbool.h>
 #include "sdk/aws_iot_error.h"
 #include "sdk/timer_interface.h"
+
+/**
+ * @brief TLS Handshake Statistics
+ *
+ * Defining a type for the counters of the TLS handshakes done by a network object.
+ * The resumption hit rate is resumed / resumptionsOffered.
+ *
+ */
+typedef struct _TLSHandshakeStats {
+	uint32_t handshakes;		///< Handshakes completed
+	uint32_t resumptionsOffered;	///< Handshakes started with the session of the previous connection
+	uint32_t resumed;		///< Handshakes the server completed by resuming that session
+	uint32_t lastHandshakeMs;	///< Duration of the last handshake
+	uint32_t lastFullHandshakeMs;	///< Duration of the last handshake that was not resumed, 0 if none yet
+	uint32_t lastResumedHandshakeMs;	///< Duration of the last resumed handshake, 0 if none yet
+} TLSHandshakeStats;
+
 #include "sdk/network_platform.h"
 
 /**
@@ -41,6 +58,33 @@ extern "C" {
  */
 typedef struct Network Network;
 
+/**
+ * @brief TLS Cipher Suite Profile
+ *
+ * Restricts the cipher suites offered in the client hello. The profiles other than the
+ * default offer AEAD suites with ECDHE key exchange only, for servers authenticating with
+ * an ECDSA or an RSA certificate, so the server must accept one of them. AES-GCM is the
+ * fastest on cores with AES instructions, ChaCha20-Poly1305 on cores without.
+ */
+typedef enum {
+	TLS_CIPHER_PROFILE_DEFAULT = 0,	///< Cipher suites enabled in the mbedTLS configuration, in its order
+	TLS_CIPHER_PROFILE_AES_GCM = 1,	///< ECDHE with AES-128-GCM, then AES-256-GCM
+	TLS_CIPHER_PROFILE_CHACHAPOLY = 2	///< ECDHE with ChaCha20-Poly1305
+} TLSCipherProfile;
+
+/**
+ * @brief TLS Curve Profile
+ *
+ * Restricts the elliptic curves offered for the ECDHE key exchange. The curves also bound
+ * the ECDSA certificates the server may use, both profiles other than the default accept
+ * P-256 certificates only.
+ */
+typedef enum {
+	TLS_CURVE_PROFILE_DEFAULT = 0,	///< Curves enabled in the mbedTLS configuration, in its order
+	TLS_CURVE_PROFILE_P256 = 1,	///< NIST P-256 only
+	TLS_CURVE_PROFILE_X25519 = 2	///< Curve25519 for the key exchange, then P-256
+} TLSCurveProfile;
+
 /**
  * @brief TLS Connection Parameters
  *
@@ -55,6 +99,8 @@ typedef struct {
 	uint16_t DestinationPort;            ///< Integer defining the connection port of the MQTT service.
 	uint32_t timeout_ms;                ///< Unsigned integer defining the TLS handshake timeout value in milliseconds.
 	bool ServerVerificationFlag;        ///< Boolean.  True = perform server certificate hostname validation.  False = skip validation \b NOT recommended.
+	TLSCipherProfile cipherProfile;        ///< Cipher suites offered in the handshake, TLS_CIPHER_PROFILE_DEFAULT after iot_tls_init
+	TLSCurveProfile curveProfile;        ///< Curves offered for the key exchange, TLS_CURVE_PROFILE_DEFAULT after iot_tls_init
 } TLSConnectParams;
 
 /**
@@ -70,6 +116,12 @@ struct Network {
 	IoT_Error_t (*disconnect)(Network *);    ///< Function pointer pointing to the network function to disconnect from the network
 	IoT_Error_t (*isConnected)(Network *);    ///< Function pointer pointing to the network function to check if TLS is connected
 	IoT_Error_t (*destroy)(Network *);        ///< Function pointer pointing to the network function to destroy the network object
+	int (*getSocketFd)(Network *);        ///< Function pointer pointing to the network function to get the underlying socket descriptor
+	size_t (*getBytesAvailable)(Network *);    ///< Function pointer pointing to the network function to get the number of decrypted bytes already buffered
+	IoT_Error_t (*probeReachability)(Network *);    ///< Function pointer pointing to the network function to check if the endpoint accepts TCP connections again, may be NULL
+	IoT_Error_t (*getHandshakeStats)(Network *, TLSHandshakeStats *);    ///< Function pointer pointing to the network function to get the handshake counters, may be NULL
+	IoT_Error_t (*connectStart)(Network *, TLSConnectParams *);    ///< Function pointer pointing to the network function to start a connect that does not block, may be NULL
+	IoT_Error_t (*connectContinue)(Network *);    ///< Function pointer pointing to the network function to advance the connect started by connectStart, NULL if connectStart is
 
 	TLSConnectParams tlsConnectParams;        ///< TLSConnect params structure containing the common connection parameters
 	TLSDataParams tlsDataParams;            ///< TLSData params structure containing the connection data parameters that are specific to the library being used
@@ -101,6 +153,8 @@ IoT_Error_t iot_tls_init(Network *pNetwork, char *pRootCALocation, char *pDevice
  * @brief Create a TLS socket and open the connection
  *
  * Creates an open socket connection including TLS handshake.
+ * The first connect reads and parses the credentials, later ones reuse them until TLSParams
+ * changes them. The files may hold DER instead of PEM, which skips the base64 decoding.
  *
  * @param pNetwork - Pointer to a Network struct defining the network interface.
  * @param TLSParams - TLSConnectParams defines the properties of the TLS connection.
@@ -108,6 +162,33 @@ IoT_Error_t iot_tls_init(Network *pNetwork, char *pRootCALocation, char *pDevice
  */
 IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *TLSParams);
 
+/**
+ * @brief Start a TLS connection without blocking
+ *
+ * Resolves the endpoint and starts the TCP connect on a non-blocking socket. The TCP
+ * and TLS handshakes are then advanced by iot_tls_connect_continue, called whenever the
+ * descriptor of iot_tls_get_socket_fd is ready for the direction it last asked for.
+ * Only the name resolution can still block. TLSParams is handled like in iot_tls_connect.
+ *
+ * @param pNetwork - Pointer to a Network struct defining the network interface.
+ * @param TLSParams - TLSConnectParams defines the properties of the TLS connection.
+ * @return IoT_Error_t - NETWORK_CONNECT_WANT_WRITE once the TCP connect is started or TLS error
+ */
+IoT_Error_t iot_tls_connect_start(Network *pNetwork, TLSConnectParams *TLSParams);
+
+/**
+ * @brief Advance a TLS connection started by iot_tls_connect_start
+ *
+ * Runs the handshake steps the socket allows without blocking. The whole connect is
+ * bounded by the timeout of the connect parameters. Once it succeeds the socket is made
+ * blocking again and the connection is used like one opened by iot_tls_connect.
+ *
+ * @param pNetwork - Pointer to a Network struct defining the network interface.
+ * @return IoT_Error_t - SUCCESS once connected, NETWORK_CONNECT_WANT_READ or NETWORK_CONNECT_WANT_WRITE
+ *         while waiting for the socket, TLS error otherwise
+ */
+IoT_Error_t iot_tls_connect_continue(Network *pNetwork);
+
 /**
  * @brief Write bytes to the network socket
  *
@@ -123,6 +204,9 @@ IoT_Error_t iot_tls_write(Network *, unsigned char *, size_t, Timer *, size_t *)
 /**
  * @brief Read bytes from the network socket
  *
+ * Sleeps on the socket descriptor until data arrives or the timer expires, an expired
+ * timer returns at once when neither the TLS layer nor the socket holds data.
+ *
  * @param Network - Pointer to a Network struct defining the network interface.
  * @param unsigned char pointer - pointer to buffer where read bytes should be copied
  * @param size_t - number of bytes to read
@@ -144,12 +228,24 @@ IoT_Error_t iot_tls_disconnect(Network *pNetwork);
  * @brief Perform any tear-down or cleanup of TLS layer
  *
  * Called to cleanup any resources required for the TLS layer.
+ * State kept for the next connection, the parsed credentials, the SSL configuration and the
+ * session to resume, is not released.
  *
  * @param Network - Pointer to a Network struct defining the network interface
  * @return IoT_Error_t - successful cleanup or TLS error code
  */
 IoT_Error_t iot_tls_destroy(Network *pNetwork);
 
+/**
+ * @brief Release the state the TLS layer keeps across connections
+ *
+ * Called once the network object is no longer used, after the last iot_tls_destroy.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface
+ * @return IoT_Error_t - successful cleanup or TLS error code
+ */
+IoT_Error_t iot_tls_free(Network *pNetwork);
+
 /**
  * @brief Check if TLS layer is still connected
  *
@@ -160,6 +256,57 @@ IoT_Error_t iot_tls_destroy(Network *pNetwork);
  */
 IoT_Error_t iot_tls_is_connected(Network *pNetwork);
 
+/**
+ * @brief Get the socket descriptor of the TLS connection
+ *
+ * Called to get the descriptor of the underlying TCP socket so the caller can wait
+ * for readability (poll/epoll, ecore fd handlers) instead of polling the read function.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface
+ * @return int - socket descriptor, -1 if there is no open socket
+ */
+int iot_tls_get_socket_fd(Network *pNetwork);
+
+/**
+ * @brief Get the number of bytes buffered by the TLS layer
+ *
+ * Decrypted data already pulled from the socket is not reported by the socket descriptor
+ * as readable. Callers waiting on the descriptor must drain these bytes first, a read
+ * with an expired timer does so without blocking.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface
+ * @return size_t - number of decrypted bytes that can be read without touching the socket
+ */
+size_t iot_tls_get_bytes_available(Network *pNetwork);
+
+/**
+ * @brief Check if the endpoint of the last connection is reachable
+ *
+ * Opens a plain TCP connection to the address of the last successful connection and
+ * closes it again as soon as the handshake completes. No DNS lookup and no TLS handshake
+ * is done, so the probe is cheap enough to run while waiting for the next reconnect attempt.
+ * The probe does not block, it has to be called again until it stops returning
+ * NETWORK_PROBE_IN_PROGRESS.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface
+ * @return IoT_Error_t - NETWORK_PHYSICAL_LAYER_CONNECTED if the endpoint accepted the connection,
+ *         NETWORK_PROBE_IN_PROGRESS while waiting for the answer, an error code otherwise
+ */
+IoT_Error_t iot_tls_probe_reachability(Network *pNetwork);
+
+/**
+ * @brief Get the handshake counters
+ *
+ * The session of the last successful handshake is offered to the server on the next
+ * connect, by session ID and by session ticket. A server that no longer knows it answers
+ * with a full handshake. Can be called from any thread.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface
+ * @param TLSHandshakeStats - Filled with the current counters
+ * @return IoT_Error_t - SUCCESS or NULL_VALUE_ERROR
+ */
+IoT_Error_t iot_tls_get_handshake_stats(Network *pNetwork, TLSHandshakeStats *pStats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,6 +15,8 @@
 
 #ifndef IOTSDKC_NETWORK_MBEDTLS_PLATFORM_H_H
 
+#include <sys/socket.h>
+
 #include "mbedtls/config.h"
 
 #include "mbedtls/platform.h"
@@ -32,6 +34,15 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Phases of a connect started by iot_tls_connect_start
+ */
+typedef enum _TLSConnectPhase {
+	TLS_CONNECT_PHASE_NONE = 0,	///< No asynchronous connect in progress
+	TLS_CONNECT_PHASE_TCP = 1,	///< Waiting for the TCP handshake
+	TLS_CONNECT_PHASE_HANDSHAKE = 2	///< Stepping through the TLS handshake
+} TLSConnectPhase;
+
 /**
  * @brief TLS Connection Parameters
  *
@@ -48,6 +59,17 @@ typedef struct _TLSDataParams {
 	mbedtls_x509_crt clicert;
 	mbedtls_pk_context pkey;
 	mbedtls_net_context server_fd;
+	struct sockaddr_storage peerAddr;	///< Address of the last successful connection, probed while reconnecting
+	socklen_t peerAddrLen;	///< 0 until a connection has succeeded
+	int probeFd;	///< Socket of the pending reachability probe, -1 when no probe is running
+	uint32_t probeStartMs;
+	bool isConfigLoaded;	///< DRBG, credentials and conf above are kept across connections once loaded
+	mbedtls_ssl_session savedSession;	///< Session of the last successful handshake, offered on the next connect
+	bool isSessionSaved;
+	TLSHandshakeStats handshakeStats;
+	TLSConnectPhase connectPhase;
+	uint32_t connectStartMs;	///< Start of the asynchronous connect, bounded by the handshake timeout
+	uint32_t handshakeStartMs;
 }TLSDataParams;
 
 #define IOTSDKC_NETWORK_MBEDTLS_PLATFORM_H_H
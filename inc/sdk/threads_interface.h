@@ -36,6 +36,7 @@ extern "C" {
  */
 #include "threads_platform.h"
 
+#include <stdint.h>
 #include <aws_iot_error.h>
 
 /**
@@ -100,6 +101,69 @@ IoT_Error_t aws_iot_thread_mutex_unlock(IoT_Mutex_t *);
  */
 IoT_Error_t aws_iot_thread_mutex_destroy(IoT_Mutex_t *);
 
+/**
+ * @brief Get an identifier of the calling thread
+ *
+ * Identifiers are only compared for equality, e.g. to recognize calls made
+ * from within a callback running on the thread that dispatched it.
+ *
+ * @return uintptr_t - identifier of the calling thread
+ */
+uintptr_t aws_iot_thread_get_id(void);
+
+/**
+ * @brief Condition Variable Type
+ *
+ * Forward declaration of a condition variable struct.  The definition of this
+ * struct is platform dependent.  When porting to a new platform add this
+ * definition in "threads_platform.h".
+ *
+ */
+typedef struct _IoT_Cond_t IoT_Cond_t;
+
+/**
+ * @brief Initialize the provided condition variable
+ *
+ * Call this function to initialize the condition variable. Timed waits are
+ * measured against a monotonic clock where the platform provides one.
+ *
+ * @param IoT_Cond_t - pointer to the condition variable to be initialized
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_cond_init(IoT_Cond_t *);
+
+/**
+ * @brief Wait on the provided condition variable
+ *
+ * The mutex must be locked by the caller. It is released while waiting and
+ * locked again before this call returns, whatever the result.
+ * This is a blocking call.
+ *
+ * @param IoT_Cond_t - pointer to the condition variable to wait on
+ * @param IoT_Mutex_t - pointer to the mutex protecting the awaited condition
+ * @param uint32_t - maximum time to wait in milliseconds
+ * @return IoT_Error_t - COND_WAIT_TIMEOUT_ERROR if the timeout elapsed first
+ */
+IoT_Error_t aws_iot_thread_cond_wait(IoT_Cond_t *, IoT_Mutex_t *, uint32_t);
+
+/**
+ * @brief Wake every thread waiting on the provided condition variable
+ *
+ * @param IoT_Cond_t - pointer to the condition variable to be signalled
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_cond_broadcast(IoT_Cond_t *);
+
+/**
+ * @brief Destroy the provided condition variable
+ *
+ * Call this function to destroy the condition variable
+ *
+ * @param IoT_Cond_t - pointer to the condition variable to be destroyed
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_cond_destroy(IoT_Cond_t *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -34,6 +34,16 @@ struct _IoT_Mutex_t {
 	pthread_mutex_t lock;
 };
 
+/**
+ * @brief Condition Variable Type
+ *
+ * definition of the Condition Variable struct. Platform specific
+ *
+ */
+struct _IoT_Cond_t {
+	pthread_cond_t cond;
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -98,6 +98,36 @@ uint32_t left_ms(Timer *);
  */
 void init_timer(Timer *);
 
+/**
+ * @brief Current time (milliseconds)
+ *
+ * Returns a free running millisecond counter. Only the difference between two readings is
+ * meaningful, the counter is allowed to wrap.
+ *
+ * @return uint32_t - current time in milliseconds
+ */
+uint32_t get_time_ms(void);
+
+/**
+ * @brief Current time of the coarse clock (milliseconds)
+ *
+ * Same counter as get_time_ms but cheaper to read and with the resolution of the system
+ * tick. It never runs ahead of get_time_ms, meant for deadline checks in hot loops.
+ *
+ * @return uint32_t - current coarse time in milliseconds
+ */
+uint32_t get_coarse_time_ms(void);
+
+/**
+ * @brief Sleep (milliseconds)
+ *
+ * Blocks the calling thread for at least the given time. Used where the client has
+ * nothing to read or write until a deadline, for instance while the publish shaper refills.
+ *
+ * @param uint32_t - time to sleep in milliseconds
+ */
+void sleep_ms(uint32_t);
+
 #ifdef __cplusplus
 }
 #endif
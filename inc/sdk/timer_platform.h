@@ -23,6 +23,7 @@ extern "C" {
 /**
  * @file timer_platform.h
  */
+#include <stdint.h>
 #include <sys/time.h>
 #include <sys/select.h>
 #include "timer_interface.h"
@@ -31,7 +32,7 @@ extern "C" {
  * definition of the Timer struct. Platform specific
  */
 struct Timer {
-	struct timeval end_time;
+	uint64_t end_ms;	///< Deadline on CLOCK_MONOTONIC in milliseconds
 };
 
 #ifdef __cplusplus
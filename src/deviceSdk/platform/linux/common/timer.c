@@ -22,51 +22,72 @@
 extern "C" {
 #endif
 
+#include <errno.h>
 #include <stddef.h>
 #include <sys/types.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 
 #include "sdk/timer_platform.h"
 
+/* Timers run on CLOCK_MONOTONIC so stepping the wall clock (NTP, RTC sync) does not
+ * stall or fire them. Expiry checks sit in the read and yield loops and use the coarse
+ * clock, which the vDSO serves without a syscall at the resolution of the kernel tick.
+ * The coarse clock never runs ahead of CLOCK_MONOTONIC, so a deadline set with the
+ * precise clock is checked up to one tick late but never early. */
+#ifdef CLOCK_MONOTONIC_COARSE
+#define TIMER_COARSE_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+#define TIMER_COARSE_CLOCK CLOCK_MONOTONIC
+#endif
+
+static uint64_t read_clock_ms(clockid_t clock) {
+	struct timespec now;
+	clock_gettime(clock, &now);
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
 bool has_timer_expired(Timer *timer) {
-	struct timeval now, res;
-	gettimeofday(&now, NULL);
-	timersub(&timer->end_time, &now, &res);
-	return res.tv_sec < 0 || (res.tv_sec == 0 && res.tv_usec <= 0);
+	return read_clock_ms(TIMER_COARSE_CLOCK) >= timer->end_ms;
 }
 
 void countdown_ms(Timer *timer, uint32_t timeout) {
-	struct timeval now;
-#ifdef __cplusplus
-	struct timeval interval = {timeout / 1000, static_cast<int>((timeout % 1000) * 1000)};
-#else
-	struct timeval interval = {timeout / 1000, (int)((timeout % 1000) * 1000)};
-#endif
-	gettimeofday(&now, NULL);
-	timeradd(&now, &interval, &timer->end_time);
+	timer->end_ms = read_clock_ms(CLOCK_MONOTONIC) + timeout;
 }
 
 uint32_t left_ms(Timer *timer) {
-	struct timeval now, res;
+	uint64_t now = read_clock_ms(TIMER_COARSE_CLOCK);
 	uint32_t result_ms = 0;
-	gettimeofday(&now, NULL);
-	timersub(&timer->end_time, &now, &res);
-	if(res.tv_sec >= 0) {
-		result_ms = (uint32_t) (res.tv_sec * 1000 + res.tv_usec / 1000);
+	if(timer->end_ms > now) {
+		result_ms = (timer->end_ms - now > UINT32_MAX) ? UINT32_MAX : (uint32_t) (timer->end_ms - now);
 	}
 	return result_ms;
 }
 
 void countdown_sec(Timer *timer, uint32_t timeout) {
-	struct timeval now;
-	struct timeval interval = {timeout, 0};
-	gettimeofday(&now, NULL);
-	timeradd(&now, &interval, &timer->end_time);
+	timer->end_ms = read_clock_ms(CLOCK_MONOTONIC) + (uint64_t) timeout * 1000;
 }
 
 void init_timer(Timer *timer) {
-	timer->end_time = (struct timeval) {0, 0};
+	timer->end_ms = 0;
+}
+
+uint32_t get_time_ms(void) {
+	return (uint32_t) read_clock_ms(CLOCK_MONOTONIC);
+}
+
+uint32_t get_coarse_time_ms(void) {
+	return (uint32_t) read_clock_ms(TIMER_COARSE_CLOCK);
+}
+
+void sleep_ms(uint32_t timeout) {
+	struct timespec remaining;
+	remaining.tv_sec = timeout / 1000;
+	remaining.tv_nsec = (long) (timeout % 1000) * 1000000;
+	/* nanosleep leaves the time still to sleep in remaining when a signal cuts it short */
+	while(0 != nanosleep(&remaining, &remaining) && EINTR == errno) {
+	}
 }
 
 #ifdef __cplusplus
@@ -19,6 +19,13 @@ extern "C" {
 
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 #include "sdk/timer_platform.h"
 #include "sdk/network_interface.h"
 
@@ -31,6 +38,9 @@ extern "C" {
 /* This is the value used for ssl read timeout */
 #define IOT_SSL_READ_TIMEOUT 10
 
+/* Time in ms a reachability probe waits for the TCP handshake before the endpoint is reported unreachable */
+#define IOT_TLS_PROBE_TIMEOUT 1000
+
 /* This defines the value of the debug buffer that gets allocated.
  * The value can be altered based on memory constraints
  */
@@ -72,11 +82,35 @@ void _iot_tls_set_connect_params(Network *pNetwork, char *pRootCALocation, char
 	pNetwork->tlsConnectParams.ServerVerificationFlag = ServerVerificationFlag;
 }
 
+/* Cipher suite lists of the profiles, indexed by TLSCipherProfile. Referenced by the configuration, not copied */
+static const int aesGcmCiphersuites[] = {
+	MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+	MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+	MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+	MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+	0
+};
+static const int chachapolyCiphersuites[] = {
+	MBEDTLS_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,
+	MBEDTLS_TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256,
+	0
+};
+static const int *const profileCiphersuites[] = { NULL, aesGcmCiphersuites, chachapolyCiphersuites };
+
+#if defined(MBEDTLS_ECP_C)
+/* Curve lists of the profiles, indexed by TLSCurveProfile */
+static const mbedtls_ecp_group_id p256Curves[] = { MBEDTLS_ECP_DP_SECP256R1, MBEDTLS_ECP_DP_NONE };
+static const mbedtls_ecp_group_id x25519Curves[] = { MBEDTLS_ECP_DP_CURVE25519, MBEDTLS_ECP_DP_SECP256R1, MBEDTLS_ECP_DP_NONE };
+static const mbedtls_ecp_group_id *const profileCurves[] = { NULL, p256Curves, x25519Curves };
+#endif
+
 IoT_Error_t iot_tls_init(Network *pNetwork, char *pRootCALocation, char *pDeviceCertLocation,
 						 char *pDevicePrivateKeyLocation, char *pDestinationURL,
 						 uint16_t destinationPort, uint32_t timeout_ms, bool ServerVerificationFlag) {
 	_iot_tls_set_connect_params(pNetwork, pRootCALocation, pDeviceCertLocation, pDevicePrivateKeyLocation,
 								pDestinationURL, destinationPort, timeout_ms, ServerVerificationFlag);
+	pNetwork->tlsConnectParams.cipherProfile = TLS_CIPHER_PROFILE_DEFAULT;
+	pNetwork->tlsConnectParams.curveProfile = TLS_CURVE_PROFILE_DEFAULT;
 
 	pNetwork->connect = iot_tls_connect;
 	pNetwork->read = iot_tls_read;
@@ -84,8 +118,23 @@ IoT_Error_t iot_tls_init(Network *pNetwork, char *pRootCALocation, char *pDevice
 	pNetwork->disconnect = iot_tls_disconnect;
 	pNetwork->isConnected = iot_tls_is_connected;
 	pNetwork->destroy = iot_tls_destroy;
+	pNetwork->getSocketFd = iot_tls_get_socket_fd;
+	pNetwork->getBytesAvailable = iot_tls_get_bytes_available;
+	pNetwork->probeReachability = iot_tls_probe_reachability;
+	pNetwork->getHandshakeStats = iot_tls_get_handshake_stats;
+	pNetwork->connectStart = iot_tls_connect_start;
+	pNetwork->connectContinue = iot_tls_connect_continue;
 
 	pNetwork->tlsDataParams.flags = 0;
+	pNetwork->tlsDataParams.peerAddrLen = 0;
+	pNetwork->tlsDataParams.probeFd = -1;
+	mbedtls_ssl_session_init(&(pNetwork->tlsDataParams.savedSession));
+	pNetwork->tlsDataParams.isSessionSaved = false;
+	pNetwork->tlsDataParams.isConfigLoaded = false;
+	pNetwork->tlsDataParams.connectPhase = TLS_CONNECT_PHASE_NONE;
+	memset(&(pNetwork->tlsDataParams.handshakeStats), 0, sizeof(TLSHandshakeStats));
+	/* No socket until the first connect */
+	mbedtls_net_init(&(pNetwork->tlsDataParams.server_fd));
 
 	return SUCCESS;
 }
@@ -95,43 +144,151 @@ IoT_Error_t iot_tls_is_connected(Network *pNetwork) {
 	return NETWORK_PHYSICAL_LAYER_CONNECTED;
 }
 
-IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
-	int ret = 0;
-	const char *pers = "aws_iot_tls_wrapper";
-	TLSDataParams *tlsDataParams = NULL;
-	char portBuffer[6];
-	char vrfy_buf[512];
-	const char *alpnProtocols[] = { "x-amzn-mqtt-ca", NULL };
+int iot_tls_get_socket_fd(Network *pNetwork) {
+	return pNetwork->tlsDataParams.server_fd.fd;
+}
 
-#ifdef ENABLE_IOT_DEBUG
-	unsigned char buf[MBEDTLS_DEBUG_BUFFER_SIZE];
-#endif
+size_t iot_tls_get_bytes_available(Network *pNetwork) {
+	if(0 > pNetwork->tlsDataParams.server_fd.fd) {
+		return 0;
+	}
+	return mbedtls_ssl_get_bytes_avail(&(pNetwork->tlsDataParams.ssl));
+}
 
-	if(NULL == pNetwork) {
-		return NULL_VALUE_ERROR;
+static void _iot_tls_close_probe(TLSDataParams *tlsDataParams) {
+	/* Reset instead of FIN so neither side keeps the probe in TIME_WAIT */
+	struct linger abortive = { 1, 0 };
+
+	if(0 > tlsDataParams->probeFd) {
+		return;
 	}
+	(void) setsockopt(tlsDataParams->probeFd, SOL_SOCKET, SO_LINGER, &abortive, sizeof(abortive));
+	close(tlsDataParams->probeFd);
+	tlsDataParams->probeFd = -1;
+}
 
-	if(NULL != params) {
-		_iot_tls_set_connect_params(pNetwork, params->pRootCALocation, params->pDeviceCertLocation,
-									params->pDevicePrivateKeyLocation, params->pDestinationURL,
-									params->DestinationPort, params->timeout_ms, params->ServerVerificationFlag);
+IoT_Error_t iot_tls_probe_reachability(Network *pNetwork) {
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+	struct pollfd pfd;
+	int error = 0;
+	socklen_t errorLen = sizeof(error);
+
+	if(0 > tlsDataParams->probeFd) {
+		if(0 == tlsDataParams->peerAddrLen) {
+			return NETWORK_ERR_NET_UNKNOWN_HOST;
+		}
+
+		tlsDataParams->probeFd = socket(tlsDataParams->peerAddr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+										IPPROTO_TCP);
+		if(0 > tlsDataParams->probeFd) {
+			return NETWORK_ERR_NET_SOCKET_FAILED;
+		}
+
+		if(0 == connect(tlsDataParams->probeFd, (struct sockaddr *) &(tlsDataParams->peerAddr),
+						tlsDataParams->peerAddrLen)) {
+			_iot_tls_close_probe(tlsDataParams);
+			return NETWORK_PHYSICAL_LAYER_CONNECTED;
+		}
+		if(EINPROGRESS != errno) {
+			_iot_tls_close_probe(tlsDataParams);
+			return NETWORK_PHYSICAL_LAYER_DISCONNECTED;
+		}
+
+		tlsDataParams->probeStartMs = get_time_ms();
+		return NETWORK_PROBE_IN_PROGRESS;
 	}
 
-	tlsDataParams = &(pNetwork->tlsDataParams);
+	pfd.fd = tlsDataParams->probeFd;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+	if(0 >= poll(&pfd, 1, 0)) {
+		if(IOT_TLS_PROBE_TIMEOUT > get_time_ms() - tlsDataParams->probeStartMs) {
+			return NETWORK_PROBE_IN_PROGRESS;
+		}
+		_iot_tls_close_probe(tlsDataParams);
+		return NETWORK_PHYSICAL_LAYER_DISCONNECTED;
+	}
+
+	if(0 != getsockopt(tlsDataParams->probeFd, SOL_SOCKET, SO_ERROR, &error, &errorLen) || 0 != error) {
+		_iot_tls_close_probe(tlsDataParams);
+		return NETWORK_PHYSICAL_LAYER_DISCONNECTED;
+	}
+
+	_iot_tls_close_probe(tlsDataParams);
+	return NETWORK_PHYSICAL_LAYER_CONNECTED;
+}
+
+static void _iot_tls_forget_session(TLSDataParams *tlsDataParams) {
+	if(tlsDataParams->isSessionSaved) {
+		mbedtls_ssl_session_free(&(tlsDataParams->savedSession));
+		tlsDataParams->isSessionSaved = false;
+	}
+}
+
+/* Keeps the session of the handshake that just completed, with the ticket the server may have sent */
+static void _iot_tls_save_session(TLSDataParams *tlsDataParams) {
+	_iot_tls_forget_session(tlsDataParams);
+	if(0 == mbedtls_ssl_get_session(&(tlsDataParams->ssl), &(tlsDataParams->savedSession))) {
+		tlsDataParams->isSessionSaved = true;
+	} else {
+		mbedtls_ssl_session_free(&(tlsDataParams->savedSession));
+	}
+}
+
+static void _iot_tls_count_handshake(TLSDataParams *tlsDataParams, bool isResumed, uint32_t durationMs) {
+	TLSHandshakeStats *pStats = &(tlsDataParams->handshakeStats);
+
+	/* Stores are atomic for iot_tls_get_handshake_stats */
+	__atomic_store_n(&(pStats->handshakes), pStats->handshakes + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&(pStats->lastHandshakeMs), durationMs, __ATOMIC_RELAXED);
+	if(isResumed) {
+		__atomic_store_n(&(pStats->resumed), pStats->resumed + 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&(pStats->lastResumedHandshakeMs), durationMs, __ATOMIC_RELAXED);
+	} else {
+		__atomic_store_n(&(pStats->lastFullHandshakeMs), durationMs, __ATOMIC_RELAXED);
+	}
+}
+
+static void _iot_tls_free_config(TLSDataParams *tlsDataParams) {
+	if(!tlsDataParams->isConfigLoaded) {
+		return;
+	}
+
+	mbedtls_x509_crt_free(&(tlsDataParams->clicert));
+	mbedtls_x509_crt_free(&(tlsDataParams->cacert));
+	mbedtls_pk_free(&(tlsDataParams->pkey));
+	mbedtls_ssl_config_free(&(tlsDataParams->conf));
+	mbedtls_ctr_drbg_free(&(tlsDataParams->ctr_drbg));
+	mbedtls_entropy_free(&(tlsDataParams->entropy));
+	tlsDataParams->isConfigLoaded = false;
+}
+
+/*
+ * Seeds the DRBG, parses the credentials and builds the SSL configuration. Everything is
+ * kept until the connect parameters change or iot_tls_free, so reconnects do no file I/O,
+ * no PEM decoding and no key parsing.
+ */
+static IoT_Error_t _iot_tls_load_config(Network *pNetwork) {
+	int ret = 0;
+	const char *pers = "aws_iot_tls_wrapper";
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+	/* Referenced by the configuration, not copied */
+	static const char *alpnProtocols[] = { "x-amzn-mqtt-ca", NULL };
 
-	mbedtls_net_init(&(tlsDataParams->server_fd));
-	mbedtls_ssl_init(&(tlsDataParams->ssl));
 	mbedtls_ssl_config_init(&(tlsDataParams->conf));
 	mbedtls_ctr_drbg_init(&(tlsDataParams->ctr_drbg));
 	mbedtls_x509_crt_init(&(tlsDataParams->cacert));
 	mbedtls_x509_crt_init(&(tlsDataParams->clicert));
 	mbedtls_pk_init(&(tlsDataParams->pkey));
+	mbedtls_entropy_init(&(tlsDataParams->entropy));
+	/* From here on a failure releases whatever was loaded */
+	tlsDataParams->isConfigLoaded = true;
 
 	IOT_DEBUG("\n  . Seeding the random number generator...");
-	mbedtls_entropy_init(&(tlsDataParams->entropy));
 	if((ret = mbedtls_ctr_drbg_seed(&(tlsDataParams->ctr_drbg), mbedtls_entropy_func, &(tlsDataParams->entropy),
 									(const unsigned char *) pers, strlen(pers))) != 0) {
 		IOT_ERROR(" failed\n  ! mbedtls_ctr_drbg_seed returned -0x%x\n", -ret);
+		_iot_tls_free_config(tlsDataParams);
 		return NETWORK_MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
 	}
 
@@ -139,6 +296,7 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 	ret = mbedtls_x509_crt_parse_file(&(tlsDataParams->cacert), pNetwork->tlsConnectParams.pRootCALocation);
 	if(ret < 0) {
 		IOT_ERROR(" failed\n  !  mbedtls_x509_crt_parse returned -0x%x while parsing root cert\n\n", -ret);
+		_iot_tls_free_config(tlsDataParams);
 		return NETWORK_X509_ROOT_CRT_PARSE_ERROR;
 	}
 	IOT_DEBUG(" ok (%d skipped)\n", ret);
@@ -147,6 +305,7 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 	ret = mbedtls_x509_crt_parse_file(&(tlsDataParams->clicert), pNetwork->tlsConnectParams.pDeviceCertLocation);
 	if(ret != 0) {
 		IOT_ERROR(" failed\n  !  mbedtls_x509_crt_parse returned -0x%x while parsing device cert\n\n", -ret);
+		_iot_tls_free_config(tlsDataParams);
 		return NETWORK_X509_DEVICE_CRT_PARSE_ERROR;
 	}
 
@@ -154,35 +313,16 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 	if(ret != 0) {
 		IOT_ERROR(" failed\n  !  mbedtls_pk_parse_key returned -0x%x while parsing private key\n\n", -ret);
 		IOT_DEBUG(" path : %s ", pNetwork->tlsConnectParams.pDevicePrivateKeyLocation);
+		_iot_tls_free_config(tlsDataParams);
 		return NETWORK_PK_PRIVATE_KEY_PARSE_ERROR;
 	}
 	IOT_DEBUG(" ok\n");
-	snprintf(portBuffer, 6, "%d", pNetwork->tlsConnectParams.DestinationPort);
-	IOT_DEBUG("  . Connecting to %s/%s...", pNetwork->tlsConnectParams.pDestinationURL, portBuffer);
-	if((ret = mbedtls_net_connect(&(tlsDataParams->server_fd), pNetwork->tlsConnectParams.pDestinationURL,
-								  portBuffer, MBEDTLS_NET_PROTO_TCP)) != 0) {
-		IOT_ERROR(" failed\n  ! mbedtls_net_connect returned -0x%x\n\n", -ret);
-		switch(ret) {
-			case MBEDTLS_ERR_NET_SOCKET_FAILED:
-				return NETWORK_ERR_NET_SOCKET_FAILED;
-			case MBEDTLS_ERR_NET_UNKNOWN_HOST:
-				return NETWORK_ERR_NET_UNKNOWN_HOST;
-			case MBEDTLS_ERR_NET_CONNECT_FAILED:
-			default:
-				return NETWORK_ERR_NET_CONNECT_FAILED;
-		};
-	}
-
-	ret = mbedtls_net_set_block(&(tlsDataParams->server_fd));
-	if(ret != 0) {
-		IOT_ERROR(" failed\n  ! net_set_(non)block() returned -0x%x\n\n", -ret);
-		return SSL_CONNECTION_ERROR;
-	} IOT_DEBUG(" ok\n");
 
 	IOT_DEBUG("  . Setting up the SSL/TLS structure...");
 	if((ret = mbedtls_ssl_config_defaults(&(tlsDataParams->conf), MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
 										  MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
 		IOT_ERROR(" failed\n  ! mbedtls_ssl_config_defaults returned -0x%x\n\n", -ret);
+		_iot_tls_free_config(tlsDataParams);
 		return SSL_CONNECTION_ERROR;
 	}
 
@@ -198,50 +338,162 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 	if((ret = mbedtls_ssl_conf_own_cert(&(tlsDataParams->conf), &(tlsDataParams->clicert), &(tlsDataParams->pkey))) !=
 	   0) {
 		IOT_ERROR(" failed\n  ! mbedtls_ssl_conf_own_cert returned %d\n\n", ret);
+		_iot_tls_free_config(tlsDataParams);
 		return SSL_CONNECTION_ERROR;
 	}
 
-	mbedtls_ssl_conf_read_timeout(&(tlsDataParams->conf), pNetwork->tlsConnectParams.timeout_ms);
+	if((uint32_t) pNetwork->tlsConnectParams.cipherProfile > TLS_CIPHER_PROFILE_CHACHAPOLY
+	   || (uint32_t) pNetwork->tlsConnectParams.curveProfile > TLS_CURVE_PROFILE_X25519) {
+		IOT_ERROR(" failed\n  ! unknown cipher profile %d or curve profile %d\n\n",
+				  pNetwork->tlsConnectParams.cipherProfile, pNetwork->tlsConnectParams.curveProfile);
+		_iot_tls_free_config(tlsDataParams);
+		return SSL_CONNECTION_ERROR;
+	}
+	if(NULL != profileCiphersuites[pNetwork->tlsConnectParams.cipherProfile]) {
+		mbedtls_ssl_conf_ciphersuites(&(tlsDataParams->conf), profileCiphersuites[pNetwork->tlsConnectParams.cipherProfile]);
+	}
+#if defined(MBEDTLS_ECP_C)
+	if(NULL != profileCurves[pNetwork->tlsConnectParams.curveProfile]) {
+		mbedtls_ssl_conf_curves(&(tlsDataParams->conf), profileCurves[pNetwork->tlsConnectParams.curveProfile]);
+	}
+#endif
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+	/* Servers keeping no session cache can still resume from the ticket they issued */
+	mbedtls_ssl_conf_session_tickets(&(tlsDataParams->conf), MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
 
 	/* Use the AWS IoT ALPN extension for MQTT if port 443 is requested. */
 	if(443 == pNetwork->tlsConnectParams.DestinationPort) {
 		if((ret = mbedtls_ssl_conf_alpn_protocols(&(tlsDataParams->conf), alpnProtocols)) != 0) {
 			IOT_ERROR(" failed\n  ! mbedtls_ssl_conf_alpn_protocols returned -0x%x\n\n", -ret);
+			_iot_tls_free_config(tlsDataParams);
 			return SSL_CONNECTION_ERROR;
 		}
 	}
+	IOT_DEBUG(" ok\n");
+
+	return SUCCESS;
+}
+
+/* Releases the socket and the SSL context of a connect that failed, the configuration is kept */
+static IoT_Error_t _iot_tls_connect_failed(TLSDataParams *tlsDataParams, IoT_Error_t rc) {
+	tlsDataParams->connectPhase = TLS_CONNECT_PHASE_NONE;
+	mbedtls_ssl_free(&(tlsDataParams->ssl));
+	mbedtls_net_free(&(tlsDataParams->server_fd));
+	return rc;
+}
+
+/* Applies new connect parameters, loads the configuration if needed and resets the contexts of the connection */
+static IoT_Error_t _iot_tls_prepare_connect(Network *pNetwork, TLSConnectParams *params) {
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+	IoT_Error_t rc;
+
+	/* An asynchronous connect still in progress is dropped */
+	if(TLS_CONNECT_PHASE_NONE != tlsDataParams->connectPhase) {
+		(void) _iot_tls_connect_failed(tlsDataParams, FAILURE);
+	}
+
+	if(NULL != params) {
+		_iot_tls_set_connect_params(pNetwork, params->pRootCALocation, params->pDeviceCertLocation,
+									params->pDevicePrivateKeyLocation, params->pDestinationURL,
+									params->DestinationPort, params->timeout_ms, params->ServerVerificationFlag);
+		pNetwork->tlsConnectParams.cipherProfile = params->cipherProfile;
+		pNetwork->tlsConnectParams.curveProfile = params->curveProfile;
+		/* The session and the credentials belong to the previous parameters */
+		_iot_tls_forget_session(tlsDataParams);
+		_iot_tls_free_config(tlsDataParams);
+	}
+
+	_iot_tls_close_probe(tlsDataParams);
+
+	if(!tlsDataParams->isConfigLoaded) {
+		rc = _iot_tls_load_config(pNetwork);
+		if(SUCCESS != rc) {
+			return rc;
+		}
+	}
+
+	mbedtls_net_init(&(tlsDataParams->server_fd));
+	mbedtls_ssl_init(&(tlsDataParams->ssl));
+
+	return SUCCESS;
+}
+
+/* Remember the resolved address, the reachability probe reuses it without a DNS lookup */
+static void _iot_tls_save_peer_addr(TLSDataParams *tlsDataParams) {
+	tlsDataParams->peerAddrLen = sizeof(tlsDataParams->peerAddr);
+	if(0 != getpeername(tlsDataParams->server_fd.fd, (struct sockaddr *) &(tlsDataParams->peerAddr),
+						&(tlsDataParams->peerAddrLen))) {
+		tlsDataParams->peerAddrLen = 0;
+	}
+}
+
+/* Binds the SSL context to the configuration, the caller sets the BIO callbacks */
+static IoT_Error_t _iot_tls_setup_ssl(Network *pNetwork) {
+	int ret = 0;
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
 
 	/* Assign the resulting configuration to the SSL context. */
 	if((ret = mbedtls_ssl_setup(&(tlsDataParams->ssl), &(tlsDataParams->conf))) != 0) {
 		IOT_ERROR(" failed\n  ! mbedtls_ssl_setup returned -0x%x\n\n", -ret);
-		return SSL_CONNECTION_ERROR;
+		return _iot_tls_connect_failed(tlsDataParams, SSL_CONNECTION_ERROR);
 	}
 	if((ret = mbedtls_ssl_set_hostname(&(tlsDataParams->ssl), pNetwork->tlsConnectParams.pDestinationURL)) != 0) {
 		IOT_ERROR(" failed\n  ! mbedtls_ssl_set_hostname returned %d\n\n", ret);
-		return SSL_CONNECTION_ERROR;
+		return _iot_tls_connect_failed(tlsDataParams, SSL_CONNECTION_ERROR);
 	}
-	IOT_DEBUG("\n\nSSL state connect : %d ", tlsDataParams->ssl.state);
-	mbedtls_ssl_set_bio(&(tlsDataParams->ssl), &(tlsDataParams->server_fd), mbedtls_net_send, NULL,
-						mbedtls_net_recv_timeout);
-	IOT_DEBUG(" ok\n");
 
-	IOT_DEBUG("\n\nSSL state connect : %d ", tlsDataParams->ssl.state);
-	IOT_DEBUG("  . Performing the SSL/TLS handshake...");
-	while((ret = mbedtls_ssl_handshake(&(tlsDataParams->ssl))) != 0) {
-		if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
-			IOT_ERROR(" failed\n  ! mbedtls_ssl_handshake returned -0x%x\n", -ret);
-			if(ret == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) {
-				IOT_ERROR("    Unable to verify the server's certificate. "
-							  "Either it is invalid,\n"
-							  "    or you didn't set ca_file or ca_path "
-							  "to an appropriate value.\n"
-							  "    Alternatively, you may want to use "
-							  "auth_mode=optional for testing purposes.\n");
-			}
-			return SSL_CONNECTION_ERROR;
+	/* Offer the previous session, a server that no longer knows it falls back to a full handshake */
+	if(tlsDataParams->isSessionSaved) {
+		if((ret = mbedtls_ssl_set_session(&(tlsDataParams->ssl), &(tlsDataParams->savedSession))) == 0) {
+			__atomic_store_n(&(tlsDataParams->handshakeStats.resumptionsOffered),
+							 tlsDataParams->handshakeStats.resumptionsOffered + 1, __ATOMIC_RELAXED);
+		} else {
+			IOT_WARN("mbedtls_ssl_set_session returned -0x%x, doing a full handshake\n", -ret);
+			_iot_tls_forget_session(tlsDataParams);
 		}
 	}
 
+	return SUCCESS;
+}
+
+static IoT_Error_t _iot_tls_handshake_failed(TLSDataParams *tlsDataParams, int ret) {
+	IOT_ERROR(" failed\n  ! mbedtls_ssl_handshake returned -0x%x\n", -ret);
+	/* Do not offer a session the server may have choked on again */
+	_iot_tls_forget_session(tlsDataParams);
+	if(ret == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) {
+		IOT_ERROR("    Unable to verify the server's certificate. "
+					  "Either it is invalid,\n"
+					  "    or you didn't set ca_file or ca_path "
+					  "to an appropriate value.\n"
+					  "    Alternatively, you may want to use "
+					  "auth_mode=optional for testing purposes.\n");
+	}
+	return _iot_tls_connect_failed(tlsDataParams, SSL_CONNECTION_ERROR);
+}
+
+/* Checks the peer and keeps the session of a handshake that just completed */
+static IoT_Error_t _iot_tls_finish_connect(Network *pNetwork) {
+	int ret = 0;
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+	char vrfy_buf[512];
+	bool isResumed = false;
+
+#ifdef ENABLE_IOT_DEBUG
+	unsigned char buf[MBEDTLS_DEBUG_BUFFER_SIZE];
+#endif
+
+	/* A session still saved was offered, a resumed session keeps the master secret
+	 * while a full handshake derives a new one */
+	if(tlsDataParams->isSessionSaved) {
+		isResumed = (0 == memcmp(tlsDataParams->ssl.session->master, tlsDataParams->savedSession.master,
+								 sizeof(tlsDataParams->savedSession.master)));
+	}
+	_iot_tls_count_handshake(tlsDataParams, isResumed, get_time_ms() - tlsDataParams->handshakeStartMs);
+	IOT_INFO("TLS handshake %s in %u ms with %s\n", isResumed ? "resumed" : "completed",
+			 tlsDataParams->handshakeStats.lastHandshakeMs, mbedtls_ssl_get_ciphersuite(&(tlsDataParams->ssl)));
+
 	IOT_DEBUG(" ok\n    [ Protocol is %s ]\n    [ Ciphersuite is %s ]\n", mbedtls_ssl_get_version(&(tlsDataParams->ssl)),
 		  mbedtls_ssl_get_ciphersuite(&(tlsDataParams->ssl)));
 	if((ret = mbedtls_ssl_get_record_expansion(&(tlsDataParams->ssl))) >= 0) {
@@ -275,11 +527,219 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 	}
 #endif
 
+	if(SUCCESS != ret) {
+		_iot_tls_forget_session(tlsDataParams);
+		return _iot_tls_connect_failed(tlsDataParams, (IoT_Error_t) ret);
+	}
+	_iot_tls_save_session(tlsDataParams);
+
 	mbedtls_ssl_conf_read_timeout(&(tlsDataParams->conf), IOT_SSL_READ_TIMEOUT);
 
 	return (IoT_Error_t) ret;
 }
 
+IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
+	int ret = 0;
+	TLSDataParams *tlsDataParams = NULL;
+	char portBuffer[6];
+	IoT_Error_t rc;
+
+	if(NULL == pNetwork) {
+		return NULL_VALUE_ERROR;
+	}
+
+	tlsDataParams = &(pNetwork->tlsDataParams);
+
+	rc = _iot_tls_prepare_connect(pNetwork, params);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	snprintf(portBuffer, 6, "%d", pNetwork->tlsConnectParams.DestinationPort);
+	IOT_DEBUG("  . Connecting to %s/%s...", pNetwork->tlsConnectParams.pDestinationURL, portBuffer);
+	if((ret = mbedtls_net_connect(&(tlsDataParams->server_fd), pNetwork->tlsConnectParams.pDestinationURL,
+								  portBuffer, MBEDTLS_NET_PROTO_TCP)) != 0) {
+		IOT_ERROR(" failed\n  ! mbedtls_net_connect returned -0x%x\n\n", -ret);
+		switch(ret) {
+			case MBEDTLS_ERR_NET_SOCKET_FAILED:
+				return _iot_tls_connect_failed(tlsDataParams, NETWORK_ERR_NET_SOCKET_FAILED);
+			case MBEDTLS_ERR_NET_UNKNOWN_HOST:
+				return _iot_tls_connect_failed(tlsDataParams, NETWORK_ERR_NET_UNKNOWN_HOST);
+			case MBEDTLS_ERR_NET_CONNECT_FAILED:
+			default:
+				return _iot_tls_connect_failed(tlsDataParams, NETWORK_ERR_NET_CONNECT_FAILED);
+		};
+	}
+
+	_iot_tls_save_peer_addr(tlsDataParams);
+
+	ret = mbedtls_net_set_block(&(tlsDataParams->server_fd));
+	if(ret != 0) {
+		IOT_ERROR(" failed\n  ! net_set_(non)block() returned -0x%x\n\n", -ret);
+		return _iot_tls_connect_failed(tlsDataParams, SSL_CONNECTION_ERROR);
+	} IOT_DEBUG(" ok\n");
+
+	/* Set on every connect, it is lowered again once the handshake is done */
+	mbedtls_ssl_conf_read_timeout(&(tlsDataParams->conf), pNetwork->tlsConnectParams.timeout_ms);
+
+	rc = _iot_tls_setup_ssl(pNetwork);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	IOT_DEBUG("\n\nSSL state connect : %d ", tlsDataParams->ssl.state);
+	mbedtls_ssl_set_bio(&(tlsDataParams->ssl), &(tlsDataParams->server_fd), mbedtls_net_send, NULL,
+						mbedtls_net_recv_timeout);
+	IOT_DEBUG(" ok\n");
+
+	IOT_DEBUG("\n\nSSL state connect : %d ", tlsDataParams->ssl.state);
+	IOT_DEBUG("  . Performing the SSL/TLS handshake...");
+	tlsDataParams->handshakeStartMs = get_time_ms();
+	while((ret = mbedtls_ssl_handshake(&(tlsDataParams->ssl))) != 0) {
+		if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+			return _iot_tls_handshake_failed(tlsDataParams, ret);
+		}
+	}
+
+	return _iot_tls_finish_connect(pNetwork);
+}
+
+IoT_Error_t iot_tls_connect_start(Network *pNetwork, TLSConnectParams *params) {
+	TLSDataParams *tlsDataParams = NULL;
+	struct addrinfo hints;
+	struct addrinfo *addrList, *cur;
+	char portBuffer[6];
+	int fd;
+	IoT_Error_t rc;
+
+	if(NULL == pNetwork) {
+		return NULL_VALUE_ERROR;
+	}
+
+	tlsDataParams = &(pNetwork->tlsDataParams);
+
+	rc = _iot_tls_prepare_connect(pNetwork, params);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	snprintf(portBuffer, 6, "%d", pNetwork->tlsConnectParams.DestinationPort);
+	IOT_DEBUG("  . Connecting to %s/%s...", pNetwork->tlsConnectParams.pDestinationURL, portBuffer);
+	if(0 != getaddrinfo(pNetwork->tlsConnectParams.pDestinationURL, portBuffer, &hints, &addrList)) {
+		IOT_ERROR(" failed\n  ! getaddrinfo failed\n\n");
+		return _iot_tls_connect_failed(tlsDataParams, NETWORK_ERR_NET_UNKNOWN_HOST);
+	}
+
+	/* Like mbedtls_net_connect, move on to the next address while connect fails at once */
+	rc = NETWORK_ERR_NET_CONNECT_FAILED;
+	for(cur = addrList; NULL != cur; cur = cur->ai_next) {
+		fd = socket(cur->ai_family, cur->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, cur->ai_protocol);
+		if(0 > fd) {
+			rc = NETWORK_ERR_NET_SOCKET_FAILED;
+			continue;
+		}
+
+		if(0 == connect(fd, cur->ai_addr, cur->ai_addrlen) || EINPROGRESS == errno) {
+			tlsDataParams->server_fd.fd = fd;
+			rc = SUCCESS;
+			break;
+		}
+
+		close(fd);
+		rc = NETWORK_ERR_NET_CONNECT_FAILED;
+	}
+	freeaddrinfo(addrList);
+
+	if(SUCCESS != rc) {
+		IOT_ERROR(" failed\n  ! connect failed [%d]\n\n", errno);
+		return _iot_tls_connect_failed(tlsDataParams, rc);
+	}
+
+	tlsDataParams->connectStartMs = get_time_ms();
+	tlsDataParams->connectPhase = TLS_CONNECT_PHASE_TCP;
+
+	return NETWORK_CONNECT_WANT_WRITE;
+}
+
+IoT_Error_t iot_tls_connect_continue(Network *pNetwork) {
+	TLSDataParams *tlsDataParams = NULL;
+	struct pollfd pfd;
+	int ret = 0;
+	int error = 0;
+	socklen_t errorLen = sizeof(error);
+	IoT_Error_t rc;
+
+	if(NULL == pNetwork) {
+		return NULL_VALUE_ERROR;
+	}
+
+	tlsDataParams = &(pNetwork->tlsDataParams);
+
+	if(TLS_CONNECT_PHASE_NONE == tlsDataParams->connectPhase) {
+		return NETWORK_DISCONNECTED_ERROR;
+	}
+
+	if(pNetwork->tlsConnectParams.timeout_ms <= get_time_ms() - tlsDataParams->connectStartMs) {
+		IOT_ERROR(" failed\n  ! connect timed out in phase %d\n\n", tlsDataParams->connectPhase);
+		return _iot_tls_connect_failed(tlsDataParams, NETWORK_SSL_CONNECT_TIMEOUT_ERROR);
+	}
+
+	if(TLS_CONNECT_PHASE_TCP == tlsDataParams->connectPhase) {
+		pfd.fd = tlsDataParams->server_fd.fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		if(0 >= poll(&pfd, 1, 0)) {
+			return NETWORK_CONNECT_WANT_WRITE;
+		}
+
+		if(0 != getsockopt(tlsDataParams->server_fd.fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) || 0 != error) {
+			IOT_ERROR(" failed\n  ! connect returned %d\n\n", error);
+			return _iot_tls_connect_failed(tlsDataParams, NETWORK_ERR_NET_CONNECT_FAILED);
+		}
+		IOT_DEBUG(" ok\n");
+
+		_iot_tls_save_peer_addr(tlsDataParams);
+
+		rc = _iot_tls_setup_ssl(pNetwork);
+		if(SUCCESS != rc) {
+			return rc;
+		}
+		/* The socket is still non-blocking, the handshake stops whenever it would wait */
+		mbedtls_ssl_set_bio(&(tlsDataParams->ssl), &(tlsDataParams->server_fd), mbedtls_net_send, mbedtls_net_recv,
+							NULL);
+
+		IOT_DEBUG("  . Performing the SSL/TLS handshake...");
+		tlsDataParams->handshakeStartMs = get_time_ms();
+		tlsDataParams->connectPhase = TLS_CONNECT_PHASE_HANDSHAKE;
+	}
+
+	ret = mbedtls_ssl_handshake(&(tlsDataParams->ssl));
+	if(MBEDTLS_ERR_SSL_WANT_READ == ret) {
+		return NETWORK_CONNECT_WANT_READ;
+	} else if(MBEDTLS_ERR_SSL_WANT_WRITE == ret) {
+		return NETWORK_CONNECT_WANT_WRITE;
+	} else if(0 != ret) {
+		return _iot_tls_handshake_failed(tlsDataParams, ret);
+	}
+
+	tlsDataParams->connectPhase = TLS_CONNECT_PHASE_NONE;
+
+	/* From here on the connection behaves like one opened by iot_tls_connect */
+	ret = mbedtls_net_set_block(&(tlsDataParams->server_fd));
+	if(ret != 0) {
+		IOT_ERROR(" failed\n  ! net_set_(non)block() returned -0x%x\n\n", -ret);
+		return _iot_tls_connect_failed(tlsDataParams, SSL_CONNECTION_ERROR);
+	}
+	mbedtls_ssl_set_bio(&(tlsDataParams->ssl), &(tlsDataParams->server_fd), mbedtls_net_send, NULL,
+						mbedtls_net_recv_timeout);
+
+	return _iot_tls_finish_connect(pNetwork);
+}
+
 IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *written_len) {
 	size_t written_so_far;
 	bool isErrorFlag = false;
@@ -315,13 +775,40 @@ IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Ti
 	return SUCCESS;
 }
 
+/* Waits up to timeout_ms for the TLS layer or the socket to hold data, without a syscall
+ * when plaintext or a record is already buffered. Errors and hang ups count as readable,
+ * mbedtls_ssl_read reports them */
+static bool _iot_tls_wait_readable(TLSDataParams *tlsDataParams, uint32_t timeout_ms) {
+	struct pollfd pfd;
+	int ret;
+
+	if(0 < mbedtls_ssl_get_bytes_avail(&(tlsDataParams->ssl)) || mbedtls_ssl_check_pending(&(tlsDataParams->ssl))) {
+		return true;
+	}
+
+	pfd.fd = tlsDataParams->server_fd.fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	do {
+		ret = poll(&pfd, 1, (INT_MAX < timeout_ms) ? INT_MAX : (int) timeout_ms);
+	} while(0 > ret && EINTR == errno);
+
+	return 0 < ret;
+}
+
 IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *read_len) {
 	mbedtls_ssl_context *ssl = &(pNetwork->tlsDataParams.ssl);
 	size_t rxLen = 0;
 	int ret;
 
 	while (len > 0) {
-		// This read will timeout after IOT_SSL_READ_TIMEOUT if there's no data to be read
+		/* Sleep in poll until data arrives or the timer expires instead of waking up every
+		 * IOT_SSL_READ_TIMEOUT, an expired timer makes this a non blocking check */
+		if (!_iot_tls_wait_readable(&(pNetwork->tlsDataParams), left_ms(timer))) {
+			break;
+		}
+
+		// This read will timeout after IOT_SSL_READ_TIMEOUT if only part of a record arrived
 		ret = mbedtls_ssl_read(ssl, pMsg, len);
 		if (ret > 0) {
 			rxLen += ret;
@@ -331,14 +818,15 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
 			return NETWORK_SSL_READ_ERROR;
 		}
 
-		// Evaluate timeout after the read to make sure read is done at least once
 		if (has_timer_expired(timer)) {
 			break;
 		}
 	}
 
+	/* Report partial reads too, the caller keeps the bytes and resumes on the next read */
+	*read_len = rxLen;
+
 	if (len == 0) {
-		*read_len = rxLen;
 		return SUCCESS;
 	}
 
@@ -365,15 +853,39 @@ IoT_Error_t iot_tls_disconnect(Network *pNetwork) {
 IoT_Error_t iot_tls_destroy(Network *pNetwork) {
 	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
 
+	_iot_tls_close_probe(tlsDataParams);
+	tlsDataParams->connectPhase = TLS_CONNECT_PHASE_NONE;
 	mbedtls_net_free(&(tlsDataParams->server_fd));
-
-	mbedtls_x509_crt_free(&(tlsDataParams->clicert));
-	mbedtls_x509_crt_free(&(tlsDataParams->cacert));
-	mbedtls_pk_free(&(tlsDataParams->pkey));
 	mbedtls_ssl_free(&(tlsDataParams->ssl));
-	mbedtls_ssl_config_free(&(tlsDataParams->conf));
-	mbedtls_ctr_drbg_free(&(tlsDataParams->ctr_drbg));
-	mbedtls_entropy_free(&(tlsDataParams->entropy));
+
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_free(Network *pNetwork) {
+	if(NULL == pNetwork) {
+		return NULL_VALUE_ERROR;
+	}
+
+	_iot_tls_forget_session(&(pNetwork->tlsDataParams));
+	_iot_tls_free_config(&(pNetwork->tlsDataParams));
+
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_get_handshake_stats(Network *pNetwork, TLSHandshakeStats *pStats) {
+	TLSHandshakeStats *pValues;
+
+	if(NULL == pNetwork || NULL == pStats) {
+		return NULL_VALUE_ERROR;
+	}
+
+	pValues = &(pNetwork->tlsDataParams.handshakeStats);
+	pStats->handshakes = __atomic_load_n(&(pValues->handshakes), __ATOMIC_RELAXED);
+	pStats->resumptionsOffered = __atomic_load_n(&(pValues->resumptionsOffered), __ATOMIC_RELAXED);
+	pStats->resumed = __atomic_load_n(&(pValues->resumed), __ATOMIC_RELAXED);
+	pStats->lastHandshakeMs = __atomic_load_n(&(pValues->lastHandshakeMs), __ATOMIC_RELAXED);
+	pStats->lastFullHandshakeMs = __atomic_load_n(&(pValues->lastFullHandshakeMs), __ATOMIC_RELAXED);
+	pStats->lastResumedHandshakeMs = __atomic_load_n(&(pValues->lastResumedHandshakeMs), __ATOMIC_RELAXED);
 
 	return SUCCESS;
 }
@@ -13,6 +13,9 @@
  * permissions and limitations under the License.
  */
 
+#include <errno.h>
+#include <time.h>
+
 #include "sdk/threads_platform.h"
 #ifdef _ENABLE_THREAD_SUPPORT_
 
@@ -104,6 +107,109 @@ IoT_Error_t aws_iot_thread_mutex_destroy(IoT_Mutex_t *pMutex) {
 	return SUCCESS;
 }
 
+/**
+ * @brief Get an identifier of the calling thread
+ *
+ * @return uintptr_t - identifier of the calling thread
+ */
+uintptr_t aws_iot_thread_get_id(void) {
+	return (uintptr_t) pthread_self();
+}
+
+/**
+ * @brief Initialize the provided condition variable
+ *
+ * Call this function to initialize the condition variable. Timed waits use
+ * CLOCK_MONOTONIC so wall clock adjustments do not stretch or cut them short
+ *
+ * @param IoT_Cond_t - pointer to the condition variable to be initialized
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_cond_init(IoT_Cond_t *pCond) {
+	pthread_condattr_t attr;
+	int rc;
+
+	if(0 != pthread_condattr_init(&attr)) {
+		return COND_INIT_ERROR;
+	}
+
+	rc = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	if(0 == rc) {
+		rc = pthread_cond_init(&(pCond->cond), &attr);
+	}
+	pthread_condattr_destroy(&attr);
+
+	if(0 != rc) {
+		return COND_INIT_ERROR;
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * @brief Wait on the provided condition variable
+ *
+ * Releases the mutex while waiting and reacquires it before returning.
+ * Blocking, thread will block until signalled or until the timeout elapses
+ *
+ * @param IoT_Cond_t - pointer to the condition variable to wait on
+ * @param IoT_Mutex_t - pointer to the locked mutex protecting the condition
+ * @param timeout_ms - maximum time to wait in milliseconds
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_cond_wait(IoT_Cond_t *pCond, IoT_Mutex_t *pMutex, uint32_t timeout_ms) {
+	struct timespec deadline;
+	int rc;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+	if(deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	rc = pthread_cond_timedwait(&(pCond->cond), &(pMutex->lock), &deadline);
+	if(ETIMEDOUT == rc) {
+		return COND_WAIT_TIMEOUT_ERROR;
+	}
+	if(0 != rc) {
+		return COND_WAIT_ERROR;
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * @brief Wake every thread waiting on the provided condition variable
+ *
+ * @param IoT_Cond_t - pointer to the condition variable to be signalled
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_cond_broadcast(IoT_Cond_t *pCond) {
+	if(0 != pthread_cond_broadcast(&(pCond->cond))) {
+		return COND_SIGNAL_ERROR;
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * @brief Destroy the provided condition variable
+ *
+ * Call this function to destroy the condition variable
+ *
+ * @param IoT_Cond_t - pointer to the condition variable to be destroyed
+ * @return IoT_Error_t - error code indicating result of operation
+ */
+IoT_Error_t aws_iot_thread_cond_destroy(IoT_Cond_t *pCond) {
+	if(0 != pthread_cond_destroy(&(pCond->cond))) {
+		return COND_DESTROY_ERROR;
+	}
+
+	return SUCCESS;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -43,12 +43,15 @@ extern "C" {
 
 #include "sdk/aws_iot_log.h"
 #include "sdk/aws_iot_mqtt_client_interface.h"
+#include "sdk/aws_iot_mqtt_client_common_internal.h"
 #include "sdk/aws_iot_version.h"
 
 #if !DISABLE_METRICS
-#define SDK_METRICS_LEN 25
-#define SDK_METRICS_TEMPLATE "?SDK=C&Version=%d.%d.%d"
-static char pUsernameTemp[SDK_METRICS_LEN] = {0};
+#define SDK_METRICS_STRINGIFY(x) #x
+#define SDK_METRICS_VERSION(major, minor, patch) \
+	SDK_METRICS_STRINGIFY(major) "." SDK_METRICS_STRINGIFY(minor) "." SDK_METRICS_STRINGIFY(patch)
+/* Built at compile time, clients connecting on several threads share it read only */
+static const char pUsernameTemp[] = "?SDK=C&Version=" SDK_METRICS_VERSION(VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH);
 #endif
 
 #ifdef _ENABLE_THREAD_SUPPORT_
@@ -65,7 +68,7 @@ ClientState aws_iot_mqtt_get_client_state(AWS_IoT_Client *pClient) {
 		return CLIENT_STATE_INVALID;
 	}
 
-	FUNC_EXIT_RC(pClient->clientStatus.clientState);
+	FUNC_EXIT_RC(__atomic_load_n(&(pClient->clientStatus.clientState), __ATOMIC_SEQ_CST));
 }
 
 #ifdef _ENABLE_THREAD_SUPPORT_
@@ -98,38 +101,215 @@ IoT_Error_t aws_iot_mqtt_client_unlock_mutex(AWS_IoT_Client *pClient, IoT_Mutex_
 	IOT_UNUSED(pClient);
 	return aws_iot_thread_mutex_unlock(pMutex);
 }
+
+/**
+ * @brief Wake up the threads sleeping on the state change condition
+ *
+ * Called after the client state changed. The state change mutex is only taken when
+ * stateWaiterCount is not 0. Sleepers raise the count before they check the state for
+ * the last time, so either they see the new state or this sees their count.
+ * The caller must not hold the state change mutex.
+ *
+ * @param pClient Reference to the IoT Client
+ */
+static void _aws_iot_mqtt_wake_state_waiters(AWS_IoT_Client *pClient) {
+	if(0 == __atomic_load_n(&(pClient->clientData.stateWaiterCount), __ATOMIC_SEQ_CST)) {
+		return;
+	}
+
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.state_change_mutex));
+	(void)aws_iot_thread_cond_broadcast(&(pClient->clientData.state_change_cond));
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.state_change_mutex));
+}
 #endif
 
 IoT_Error_t aws_iot_mqtt_set_client_state(AWS_IoT_Client *pClient, ClientState expectedCurrentState,
 										  ClientState newState) {
+	FUNC_ENTRY;
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	/* Transitions are a compare and swap, readers of the state never block */
+	if(!__atomic_compare_exchange_n(&(pClient->clientStatus.clientState), &expectedCurrentState, newState, false,
+									__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+		FUNC_EXIT_RC(MQTT_UNEXPECTED_CLIENT_STATE_ERROR);
+	}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	/* Wake up operations waiting for the client to become available */
+	_aws_iot_mqtt_wake_state_waiters(pClient);
+#endif
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+/**
+ * @brief Set the client state whatever the current state is
+ *
+ * Used on the disconnect paths, where the state is taken back from any operation.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param newState State to move to
+ */
+void aws_iot_mqtt_internal_force_client_state(AWS_IoT_Client *pClient, ClientState newState) {
+	__atomic_store_n(&(pClient->clientStatus.clientState), newState, __ATOMIC_SEQ_CST);
+#ifdef _ENABLE_THREAD_SUPPORT_
+	_aws_iot_mqtt_wake_state_waiters(pClient);
+#endif
+}
+
+/**
+ * @brief Check if an operation can take over the client
+ *
+ * The client is available when it is CONNECTED_IDLE, or CONNECTED_WAIT_FOR_CB_RETURN
+ * if isCbReturnAllowed is set, which lets callbacks call back into the client.
+ * With thread support only the thread running the callback can do so, other threads
+ * wait for the callback to return.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param isCbReturnAllowed Accept CONNECTED_WAIT_FOR_CB_RETURN as available
+ *
+ * @return true if the client can be taken over
+ */
+bool aws_iot_mqtt_internal_is_client_available(AWS_IoT_Client *pClient, bool isCbReturnAllowed) {
+	ClientState clientState = aws_iot_mqtt_get_client_state(pClient);
+
+	if(CLIENT_STATE_CONNECTED_IDLE == clientState) {
+		return true;
+	}
+
+	if(!isCbReturnAllowed || CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN != clientState) {
+		return false;
+	}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	return aws_iot_thread_get_id() == pClient->clientData.callbackThreadId;
+#else
+	return true;
+#endif
+}
+
+/**
+ * @brief Move the client from an available state to the state of an operation
+ *
+ * Operations that read from the network (yield, subscribe, unsubscribe and the
+ * blocking publish) own the client state while they run, see
+ * aws_iot_mqtt_internal_is_client_available.
+ * An available client with no thread waiting for it is taken with a single compare
+ * and swap. With thread support and isBlockOnThreadLockEnabled set, a busy client is
+ * waited for on the state change condition until the running operation hands it back,
+ * for at most timeout_ms. Otherwise a busy client is reported immediately.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param newState State to move to
+ * @param isCbReturnAllowed Accept CONNECTED_WAIT_FOR_CB_RETURN as available
+ * @param timeout_ms Maximum time to wait for a busy client
+ * @param pPrevState Receives the state to restore once the operation is done
+ *
+ * @return SUCCESS, MQTT_CLIENT_NOT_IDLE_ERROR if the client stayed busy or
+ * NETWORK_DISCONNECTED_ERROR if the client is not connected
+ */
+IoT_Error_t aws_iot_mqtt_internal_acquire_client_state(AWS_IoT_Client *pClient, ClientState newState,
+													   bool isCbReturnAllowed, uint32_t timeout_ms,
+													   ClientState *pPrevState) {
+	ClientState clientState;
 	IoT_Error_t rc;
 #ifdef _ENABLE_THREAD_SUPPORT_
-	IoT_Error_t threadRc = FAILURE;
+	IoT_Error_t threadRc;
+	bool hasWaited = false;
+	bool isAvailable;
+	Timer timer;
 #endif
 
 	FUNC_ENTRY;
-	if(NULL == pClient) {
+	if(NULL == pClient || NULL == pPrevState) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
 #ifdef _ENABLE_THREAD_SUPPORT_
+	/* Fast path, nobody is waiting and the client is free */
+	clientState = aws_iot_mqtt_get_client_state(pClient);
+	if(0 == __atomic_load_n(&(pClient->clientData.stateWaiterCount), __ATOMIC_SEQ_CST) &&
+	   aws_iot_mqtt_internal_is_client_available(pClient, isCbReturnAllowed) &&
+	   __atomic_compare_exchange_n(&(pClient->clientStatus.clientState), &clientState, newState, false,
+								   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+		*pPrevState = clientState;
+		FUNC_EXIT_RC(SUCCESS);
+	}
+
+	init_timer(&timer);
+	countdown_ms(&timer, timeout_ms);
+
 	rc = aws_iot_mqtt_client_lock_mutex(pClient, &(pClient->clientData.state_change_mutex));
 	if(SUCCESS != rc) {
-		return rc;
+		FUNC_EXIT_RC(rc);
 	}
-#endif
-	if(expectedCurrentState == aws_iot_mqtt_get_client_state(pClient)) {
-		pClient->clientStatus.clientState = newState;
-		rc = SUCCESS;
-	} else {
-		rc = MQTT_UNEXPECTED_CLIENT_STATE_ERROR;
+
+	for(;;) {
+		clientState = aws_iot_mqtt_get_client_state(pClient);
+		if(CLIENT_STATE_CONNECTED_IDLE > clientState || CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN < clientState) {
+			rc = NETWORK_DISCONNECTED_ERROR;
+			break;
+		}
+
+		/* Threads already sleeping go first, a yield loop can not starve them */
+		isAvailable = aws_iot_mqtt_internal_is_client_available(pClient, isCbReturnAllowed);
+		if(isAvailable &&
+		   (hasWaited || 0 == __atomic_load_n(&(pClient->clientData.stateWaiterCount), __ATOMIC_SEQ_CST))) {
+			/* Fast path callers do not take the mutex, the state may have moved since it was read */
+			if(!__atomic_compare_exchange_n(&(pClient->clientStatus.clientState), &clientState, newState, false,
+											__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+				continue;
+			}
+			*pPrevState = clientState;
+			rc = SUCCESS;
+			break;
+		}
+
+		if(false == pClient->clientData.isBlockOnThreadLockEnabled || has_timer_expired(&timer)) {
+			rc = MQTT_CLIENT_NOT_IDLE_ERROR;
+			break;
+		}
+
+		if(!hasWaited) {
+			hasWaited = true;
+			__atomic_add_fetch(&(pClient->clientData.stateWaiterCount), 1, __ATOMIC_SEQ_CST);
+			if(!isAvailable) {
+				/* A release that read the count before it was raised did not wake this thread */
+				continue;
+			}
+		}
+		threadRc = aws_iot_thread_cond_wait(&(pClient->clientData.state_change_cond),
+											&(pClient->clientData.state_change_mutex), left_ms(&timer));
+		if(SUCCESS != threadRc && COND_WAIT_TIMEOUT_ERROR != threadRc) {
+			rc = threadRc;
+			break;
+		}
+	}
+
+	if(hasWaited) {
+		__atomic_sub_fetch(&(pClient->clientData.stateWaiterCount), 1, __ATOMIC_SEQ_CST);
+		/* Leaving may unblock a newcomer that deferred to this thread */
+		(void)aws_iot_thread_cond_broadcast(&(pClient->clientData.state_change_cond));
 	}
 
-#ifdef _ENABLE_THREAD_SUPPORT_
 	threadRc = aws_iot_mqtt_client_unlock_mutex(pClient, &(pClient->clientData.state_change_mutex));
 	if(SUCCESS == rc && SUCCESS != threadRc) {
 		rc = threadRc;
 	}
+#else
+	IOT_UNUSED(timeout_ms);
+
+	clientState = aws_iot_mqtt_get_client_state(pClient);
+	if(!aws_iot_mqtt_internal_is_client_available(pClient, isCbReturnAllowed)) {
+		FUNC_EXIT_RC(MQTT_CLIENT_NOT_IDLE_ERROR);
+	}
+
+	rc = aws_iot_mqtt_set_client_state(pClient, clientState, newState);
+	if(SUCCESS == rc) {
+		*pPrevState = clientState;
+	}
 #endif
 
 	FUNC_EXIT_RC(rc);
@@ -146,11 +326,8 @@ IoT_Error_t aws_iot_mqtt_set_connect_params(AWS_IoT_Client *pClient, IoT_Client_
 	pClient->clientData.options.pClientID = pNewConnectParams->pClientID;
 	pClient->clientData.options.clientIDLen = pNewConnectParams->clientIDLen;
 #if !DISABLE_METRICS
-	if (0 == strlen(pUsernameTemp)) {
-		snprintf(pUsernameTemp, SDK_METRICS_LEN, SDK_METRICS_TEMPLATE, VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH);
-	}
 	pClient->clientData.options.pUsername = (char*)&pUsernameTemp[0];
-	pClient->clientData.options.usernameLen = strlen(pUsernameTemp);
+	pClient->clientData.options.usernameLen = sizeof(pUsernameTemp) - 1;
 #else
 	pClient->clientData.options.pUsername = pNewConnectParams->pUsername;
 	pClient->clientData.options.usernameLen = pNewConnectParams->usernameLen;
@@ -177,12 +354,21 @@ IoT_Error_t aws_iot_mqtt_free(AWS_IoT_Client *pClient)
         rc = NULL_VALUE_ERROR;
     }else
 	{
+		rc = iot_tls_free(&(pClient->networkStack));
+
 	#ifdef _ENABLE_THREAD_SUPPORT_
 		if (rc == SUCCESS)
 		{
 			rc = aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
 		}
 
+		if (rc == SUCCESS)
+		{
+			rc = aws_iot_thread_cond_destroy(&(pClient->clientData.state_change_cond));
+		}else{
+			(void)aws_iot_thread_cond_destroy(&(pClient->clientData.state_change_cond));
+		}
+
 		if (rc == SUCCESS)
 		{
 			rc = aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_read_mutex));
@@ -215,17 +401,30 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, IoT_Client_Init_Params *p
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
-	for(i = 0; i < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++i) {
-		pClient->clientData.messageHandlers[i].topicName = NULL;
-		pClient->clientData.messageHandlers[i].pApplicationHandler = NULL;
-		pClient->clientData.messageHandlers[i].pApplicationHandlerData = NULL;
-		pClient->clientData.messageHandlers[i].qos = QOS0;
+	pClient->clientData.pMessageHandlers = pClient->clientData.messageHandlers;
+	pClient->clientData.messageHandlerCount = AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS;
+	pClient->clientData.pTopicTrieNodes = pClient->clientData.topicTrieNodes;
+	pClient->clientData.topicTrieNodeCount = AWS_IOT_MQTT_TOPIC_TRIE_NODES;
+	pClient->clientData.dispatchDepth = 0;
+	aws_iot_mqtt_internal_trie_init(pClient);
+
+	pClient->clientData.pDecompressBuf = NULL;
+	pClient->clientData.decompressBufLen = 0;
+
+	for(i = 0; i < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; ++i) {
+		pClient->clientData.inFlightPublishes[i].packetId = 0;
+		pClient->clientData.inFlightPublishes[i].pCompleteHandler = NULL;
+		pClient->clientData.inFlightPublishes[i].pCompleteHandlerData = NULL;
+		aws_iot_timer_wheel_init_entry(&(pClient->clientData.inFlightPublishes[i].retryEntry),
+									   &(pClient->clientData.inFlightPublishes[i]));
 	}
+	aws_iot_timer_wheel_init(&(pClient->clientData.inFlightRetryWheel));
 
 	pClient->clientData.packetTimeoutMs = pInitParams->mqttPacketTimeout_ms;
 	pClient->clientData.commandTimeoutMs = pInitParams->mqttCommandTimeout_ms;
 	pClient->clientData.writeBufSize = AWS_IOT_MQTT_TX_BUF_LEN;
 	pClient->clientData.readBufSize = AWS_IOT_MQTT_RX_BUF_LEN;
+	aws_iot_mqtt_internal_flushBuffers(pClient);
 	pClient->clientData.counterNetworkDisconnected = 0;
 	pClient->clientData.disconnectHandler = pInitParams->disconnectHandler;
 	pClient->clientData.disconnectHandlerData = pInitParams->disconnectHandlerData;
@@ -239,18 +438,30 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, IoT_Client_Init_Params *p
 
 #ifdef _ENABLE_THREAD_SUPPORT_
 	pClient->clientData.isBlockOnThreadLockEnabled = pInitParams->isBlockOnThreadLockEnabled;
+	pClient->clientData.callbackThreadId = 0;
+	pClient->clientData.stateWaiterCount = 0;
+	pClient->clientData.pPublishWaiters = NULL;
+	pClient->clientData.nextPublishWaiterId = 0;
+	aws_iot_mqtt_internal_outbound_queue_init(pClient);
 	rc = aws_iot_thread_mutex_init(&(pClient->clientData.state_change_mutex));
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
+	rc = aws_iot_thread_cond_init(&(pClient->clientData.state_change_cond));
+	if(SUCCESS != rc) {
+		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
+		FUNC_EXIT_RC(rc);
+	}
 	rc = aws_iot_thread_mutex_init(&(pClient->clientData.tls_read_mutex));
 	if(SUCCESS != rc) {
+		(void)aws_iot_thread_cond_destroy(&(pClient->clientData.state_change_cond));
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
 		FUNC_EXIT_RC(rc);
 	}
 	rc = aws_iot_thread_mutex_init(&(pClient->clientData.tls_write_mutex));
 	if(SUCCESS != rc) {
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_read_mutex));
+		(void)aws_iot_thread_cond_destroy(&(pClient->clientData.state_change_cond));
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
 		FUNC_EXIT_RC(rc);
 	}
@@ -258,6 +469,15 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, IoT_Client_Init_Params *p
 
 	pClient->clientStatus.isPingOutstanding = 0;
 	pClient->clientStatus.isAutoReconnectEnabled = pInitParams->enableAutoReconnect;
+	pClient->clientStatus.isSessionPresent = false;
+	memset(&(pClient->clientData.keepAliveStats), 0, sizeof(KeepAliveStats));
+
+	pClient->clientData.shaper.messageRate = AWS_IOT_MQTT_PUBLISH_RATE_LIMIT;
+	pClient->clientData.shaper.byteRate = AWS_IOT_MQTT_PUBLISH_BYTE_RATE_LIMIT;
+	pClient->clientData.shaper.pRules = NULL;
+	pClient->clientData.shaper.ruleCount = 0;
+	aws_iot_mqtt_internal_shaper_reset(pClient);
+	memset(&(pClient->clientData.shaperStats), 0, sizeof(PublishShaperStats));
 
 	rc = iot_tls_init(&(pClient->networkStack), pInitParams->pRootCALocation, pInitParams->pDeviceCertLocation,
 					  pInitParams->pDevicePrivateKeyLocation, pInitParams->pHostURL, pInitParams->port,
@@ -266,15 +486,28 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, IoT_Client_Init_Params *p
 	if(SUCCESS != rc) {
 		#ifdef _ENABLE_THREAD_SUPPORT_
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_read_mutex));
+		(void)aws_iot_thread_cond_destroy(&(pClient->clientData.state_change_cond));
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.state_change_mutex));
 		(void)aws_iot_thread_mutex_destroy(&(pClient->clientData.tls_write_mutex));
 		#endif
 		pClient->clientStatus.clientState = CLIENT_STATE_INVALID;
 		FUNC_EXIT_RC(rc);
 	}
+	pClient->networkStack.tlsConnectParams.cipherProfile = pInitParams->tlsCipherProfile;
+	pClient->networkStack.tlsConnectParams.curveProfile = pInitParams->tlsCurveProfile;
 
 	init_timer(&(pClient->pingTimer));
 	init_timer(&(pClient->reconnectDelayTimer));
+	init_timer(&(pClient->reconnectProbeTimer));
+	init_timer(&(pClient->connectTimer));
+	pClient->clientData.isConnectAsync = false;
+	pClient->clientData.isConnackPending = false;
+	pClient->clientData.connectCompleteHandler = NULL;
+	pClient->clientData.connectCompleteHandlerData = NULL;
+	pClient->clientData.reconnectJitterWaitInterval = 0;
+	pClient->clientData.reconnectWaitSpent = 0;
+	pClient->clientData.reconnectRandomState = 0;
+	pClient->clientData.isReconnectProbeFailed = false;
 
 	pClient->clientStatus.clientState = CLIENT_STATE_INITIALIZED;
 
@@ -282,8 +515,16 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, IoT_Client_Init_Params *p
 }
 
 uint16_t aws_iot_mqtt_get_next_packet_id(AWS_IoT_Client *pClient) {
-	return pClient->clientData.nextPacketId = (uint16_t) ((MAX_PACKET_ID == pClient->clientData.nextPacketId) ? 1 : (
-			pClient->clientData.nextPacketId + 1));
+	uint16_t packetId, nextPacketId;
+
+	/* Publishes no longer own the client state, ids can be taken by several threads at once */
+	packetId = __atomic_load_n(&(pClient->clientData.nextPacketId), __ATOMIC_RELAXED);
+	do {
+		nextPacketId = (uint16_t) ((MAX_PACKET_ID == packetId) ? 1 : (packetId + 1));
+	} while(!__atomic_compare_exchange_n(&(pClient->clientData.nextPacketId), &packetId, nextPacketId, true,
+										 __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	return nextPacketId;
 }
 
 bool aws_iot_mqtt_is_client_connected(AWS_IoT_Client *pClient) {
@@ -296,7 +537,7 @@ bool aws_iot_mqtt_is_client_connected(AWS_IoT_Client *pClient) {
 		FUNC_EXIT_RC(false);
 	}
 
-	switch(pClient->clientStatus.clientState) {
+	switch(aws_iot_mqtt_get_client_state(pClient)) {
 		case CLIENT_STATE_INVALID:
 		case CLIENT_STATE_INITIALIZED:
 		case CLIENT_STATE_CONNECTING:
@@ -323,6 +564,17 @@ bool aws_iot_mqtt_is_client_connected(AWS_IoT_Client *pClient) {
 	FUNC_EXIT_RC(isConnected);
 }
 
+bool aws_iot_mqtt_is_session_present(AWS_IoT_Client *pClient) {
+	FUNC_ENTRY;
+
+	if(NULL == pClient) {
+		IOT_WARN(" Client is null! ");
+		FUNC_EXIT_RC(false);
+	}
+
+	FUNC_EXIT_RC(pClient->clientStatus.isSessionPresent);
+}
+
 bool aws_iot_is_autoreconnect_enabled(AWS_IoT_Client *pClient) {
 	FUNC_ENTRY;
 	if(NULL == pClient) {
@@ -330,7 +582,7 @@ bool aws_iot_is_autoreconnect_enabled(AWS_IoT_Client *pClient) {
 		FUNC_EXIT_RC(false);
 	}
 
-	FUNC_EXIT_RC(pClient->clientStatus.isAutoReconnectEnabled);
+	FUNC_EXIT_RC(__atomic_load_n(&(pClient->clientStatus.isAutoReconnectEnabled), __ATOMIC_RELAXED));
 }
 
 IoT_Error_t aws_iot_mqtt_autoreconnect_set_status(AWS_IoT_Client *pClient, bool newStatus) {
@@ -338,7 +590,7 @@ IoT_Error_t aws_iot_mqtt_autoreconnect_set_status(AWS_IoT_Client *pClient, bool
 	if(NULL == pClient) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
-	pClient->clientStatus.isAutoReconnectEnabled = newStatus;
+	__atomic_store_n(&(pClient->clientStatus.isAutoReconnectEnabled), newStatus, __ATOMIC_RELAXED);
 	FUNC_EXIT_RC(SUCCESS);
 }
 
@@ -362,6 +614,289 @@ void aws_iot_mqtt_reset_network_disconnected_count(AWS_IoT_Client *pClient) {
 	pClient->clientData.counterNetworkDisconnected = 0;
 }
 
+IoT_Error_t aws_iot_mqtt_set_subscription_table(AWS_IoT_Client *pClient, MessageHandlers *pMessageHandlers,
+												uint32_t messageHandlerCount, TopicTrieNode *pTopicTrieNodes,
+												uint32_t topicTrieNodeCount) {
+	uint32_t i;
+
+	FUNC_ENTRY;
+	if(NULL == pClient || NULL == pMessageHandlers || NULL == pTopicTrieNodes) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	/* Indexes are stored as uint16_t, node 0 is always the root */
+	if(0 == messageHandlerCount || AWS_IOT_MQTT_TRIE_NONE <= messageHandlerCount ||
+	   2 > topicTrieNodeCount || AWS_IOT_MQTT_TRIE_NONE <= topicTrieNodeCount) {
+		FUNC_EXIT_RC(MAX_SIZE_ERROR);
+	}
+
+	for(i = 0; i < pClient->clientData.messageHandlerCount; ++i) {
+		if(NULL != pClient->clientData.pMessageHandlers[i].topicName ||
+		   AWS_IOT_MQTT_TRIE_NONE != pClient->clientData.pMessageHandlers[i].trieNode) {
+			FUNC_EXIT_RC(MQTT_CLIENT_NOT_IDLE_ERROR);
+		}
+	}
+
+	pClient->clientData.pMessageHandlers = pMessageHandlers;
+	pClient->clientData.messageHandlerCount = messageHandlerCount;
+	pClient->clientData.pTopicTrieNodes = pTopicTrieNodes;
+	pClient->clientData.topicTrieNodeCount = topicTrieNodeCount;
+	aws_iot_mqtt_internal_trie_init(pClient);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_set_decompression_buffer(AWS_IoT_Client *pClient, unsigned char *pBuf, size_t bufLen) {
+	FUNC_ENTRY;
+	if(NULL == pClient || (NULL != pBuf && 0 == bufLen)) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pClient->clientData.pDecompressBuf = pBuf;
+	pClient->clientData.decompressBufLen = (NULL != pBuf) ? bufLen : 0;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_set_subscription_decompression(AWS_IoT_Client *pClient, const char *pTopicFilter,
+														bool isEnabled) {
+	MessageHandlers *pHandler;
+	uint32_t i;
+
+	FUNC_ENTRY;
+	if(NULL == pClient || NULL == pTopicFilter) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	for(i = 0; i < pClient->clientData.messageHandlerCount; ++i) {
+		pHandler = &(pClient->clientData.pMessageHandlers[i]);
+		if(NULL != pHandler->topicName && 0 == strcmp(pHandler->topicName, pTopicFilter)) {
+			/* Read by the dispatch on the thread running yield */
+			__atomic_store_n(&(pHandler->isDecompressEnabled), isEnabled, __ATOMIC_RELAXED);
+			FUNC_EXIT_RC(SUCCESS);
+		}
+	}
+
+	FUNC_EXIT_RC(FAILURE);
+}
+
+uint32_t aws_iot_mqtt_get_inflight_publish_count(AWS_IoT_Client *pClient) {
+	uint32_t i, count = 0;
+
+	for(i = 0; i < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; ++i) {
+		if(0 != pClient->clientData.inFlightPublishes[i].packetId) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+IoT_Error_t aws_iot_mqtt_get_keepalive_stats(AWS_IoT_Client *pClient, KeepAliveStats *pStats) {
+	KeepAliveStats *pValues;
+
+	FUNC_ENTRY;
+	if(NULL == pClient || NULL == pStats) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pValues = &(pClient->clientData.keepAliveStats);
+	pStats->pingIntervalMs = __atomic_load_n(&(pValues->pingIntervalMs), __ATOMIC_RELAXED);
+	pStats->safeIntervalMs = __atomic_load_n(&(pValues->safeIntervalMs), __ATOMIC_RELAXED);
+	pStats->failedIntervalMs = __atomic_load_n(&(pValues->failedIntervalMs), __ATOMIC_RELAXED);
+	pStats->lastRttMs = __atomic_load_n(&(pValues->lastRttMs), __ATOMIC_RELAXED);
+	pStats->smoothedRttMs = __atomic_load_n(&(pValues->smoothedRttMs), __ATOMIC_RELAXED);
+	pStats->pingsSent = __atomic_load_n(&(pValues->pingsSent), __ATOMIC_RELAXED);
+	pStats->pingTimeouts = __atomic_load_n(&(pValues->pingTimeouts), __ATOMIC_RELAXED);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_set_keepalive_intervals(AWS_IoT_Client *pClient, uint32_t safeIntervalMs,
+												 uint32_t failedIntervalMs) {
+	FUNC_ENTRY;
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	/* A failed interval at or below the safe one contradicts it, keep only the safe one */
+	if(0 != failedIntervalMs && failedIntervalMs <= safeIntervalMs) {
+		failedIntervalMs = 0;
+	}
+
+	pClient->clientData.keepAliveStats.safeIntervalMs = safeIntervalMs;
+	pClient->clientData.keepAliveStats.failedIntervalMs = failedIntervalMs;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_set_publish_rate_limit(AWS_IoT_Client *pClient, uint32_t messagesPerSecond,
+												uint32_t bytesPerSecond) {
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	pClient->clientData.shaper.messageRate = messagesPerSecond;
+	pClient->clientData.shaper.byteRate = bytesPerSecond;
+	aws_iot_mqtt_internal_shaper_reset(pClient);
+
+	FUNC_EXIT_RC(aws_iot_mqtt_internal_unlock_write(pClient));
+}
+
+IoT_Error_t aws_iot_mqtt_set_publish_priority_rules(AWS_IoT_Client *pClient, const PublishPriorityRule *pRules,
+													uint32_t ruleCount) {
+	IoT_Error_t rc;
+	uint32_t i;
+
+	FUNC_ENTRY;
+	if(NULL == pClient || (NULL == pRules && 0 != ruleCount)) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	for(i = 0; i < ruleCount; ++i) {
+		if(NULL == pRules[i].pTopicPrefix || PUBLISH_PRIORITY_COUNT <= (uint32_t) pRules[i].priority) {
+			FUNC_EXIT_RC(NULL_VALUE_ERROR);
+		}
+	}
+
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	pClient->clientData.shaper.pRules = pRules;
+	pClient->clientData.shaper.ruleCount = (NULL != pRules) ? ruleCount : 0;
+
+	FUNC_EXIT_RC(aws_iot_mqtt_internal_unlock_write(pClient));
+}
+
+IoT_Error_t aws_iot_mqtt_get_publish_shaper_stats(AWS_IoT_Client *pClient, PublishShaperStats *pStats) {
+	PublishShaperStats *pValues;
+	uint32_t i;
+
+	FUNC_ENTRY;
+	if(NULL == pClient || NULL == pStats) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pValues = &(pClient->clientData.shaperStats);
+	pStats->messageTokens = __atomic_load_n(&(pValues->messageTokens), __ATOMIC_RELAXED);
+	pStats->byteTokens = __atomic_load_n(&(pValues->byteTokens), __ATOMIC_RELAXED);
+	for(i = 0; i < PUBLISH_PRIORITY_COUNT; ++i) {
+		pStats->passed[i] = __atomic_load_n(&(pValues->passed[i]), __ATOMIC_RELAXED);
+		pStats->deferred[i] = __atomic_load_n(&(pValues->deferred[i]), __ATOMIC_RELAXED);
+	}
+	pStats->retryAfterMs = __atomic_load_n(&(pValues->retryAfterMs), __ATOMIC_RELAXED);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_get_tls_handshake_stats(AWS_IoT_Client *pClient, TLSHandshakeStats *pStats) {
+	FUNC_ENTRY;
+	if(NULL == pClient || NULL == pStats || NULL == pClient->networkStack.getHandshakeStats) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	FUNC_EXIT_RC(pClient->networkStack.getHandshakeStats(&(pClient->networkStack), pStats));
+}
+
+int aws_iot_mqtt_get_network_fd(AWS_IoT_Client *pClient) {
+	FUNC_ENTRY;
+	if(NULL == pClient || NULL == pClient->networkStack.getSocketFd) {
+		FUNC_EXIT_RC(-1);
+	}
+
+	if(!aws_iot_mqtt_is_client_connected(pClient) && !pClient->clientData.isConnectAsync) {
+		FUNC_EXIT_RC(-1);
+	}
+
+	FUNC_EXIT_RC(pClient->networkStack.getSocketFd(&(pClient->networkStack)));
+}
+
+bool aws_iot_mqtt_has_pending_data(AWS_IoT_Client *pClient) {
+	FUNC_ENTRY;
+	if(NULL == pClient || NULL == pClient->networkStack.getBytesAvailable) {
+		FUNC_EXIT_RC(false);
+	}
+
+	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		FUNC_EXIT_RC(false);
+	}
+
+	if(aws_iot_mqtt_internal_has_buffered_packet(pClient)) {
+		FUNC_EXIT_RC(true);
+	}
+
+	FUNC_EXIT_RC(0 < pClient->networkStack.getBytesAvailable(&(pClient->networkStack)));
+}
+
+uint32_t aws_iot_mqtt_get_next_timeout_ms(AWS_IoT_Client *pClient) {
+	uint32_t timeout_ms, retry_ms, probe_ms, idle_ms, now_ms, keepalive_ms;
+
+	FUNC_ENTRY;
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(AWS_IOT_MQTT_NO_TIMEOUT_MS);
+	}
+
+	if(pClient->clientData.isConnectAsync) {
+		FUNC_EXIT_RC(left_ms(&(pClient->connectTimer)));
+	}
+
+	if(CLIENT_STATE_PENDING_RECONNECT == aws_iot_mqtt_get_client_state(pClient)) {
+		timeout_ms = left_ms(&(pClient->reconnectDelayTimer));
+		if(0 != AWS_IOT_MQTT_RECONNECT_PROBE_INTERVAL && NULL != pClient->networkStack.probeReachability) {
+			probe_ms = left_ms(&(pClient->reconnectProbeTimer));
+			if(probe_ms < timeout_ms) {
+				timeout_ms = probe_ms;
+			}
+		}
+		FUNC_EXIT_RC(timeout_ms);
+	}
+
+	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		FUNC_EXIT_RC(AWS_IOT_MQTT_NO_TIMEOUT_MS);
+	}
+
+	timeout_ms = AWS_IOT_MQTT_NO_TIMEOUT_MS;
+	if(0 != pClient->clientData.keepAliveInterval) {
+		if(pClient->clientStatus.isPingOutstanding) {
+			timeout_ms = left_ms(&(pClient->pingTimer));
+		} else {
+			/* The earlier of the probing PINGREQ and the one the broker's keep alive needs */
+			now_ms = get_time_ms();
+			keepalive_ms = (uint32_t) pClient->clientData.keepAliveInterval * 1000;
+			idle_ms = now_ms - __atomic_load_n(&(pClient->clientData.lastActivityMs), __ATOMIC_RELAXED);
+			timeout_ms = 0;
+			if(idle_ms < pClient->clientData.keepAliveStats.pingIntervalMs) {
+				timeout_ms = pClient->clientData.keepAliveStats.pingIntervalMs - idle_ms;
+			}
+			idle_ms = now_ms - __atomic_load_n(&(pClient->clientData.lastSentMs), __ATOMIC_RELAXED);
+			if(idle_ms >= keepalive_ms) {
+				timeout_ms = 0;
+			} else if(keepalive_ms - idle_ms < timeout_ms) {
+				timeout_ms = keepalive_ms - idle_ms;
+			}
+		}
+	}
+
+	/* Read without the write lock like the timers above. A publish racing with this call or
+	 * made after it is not seen here, its caller wakes the waiting thread to call again */
+	retry_ms = aws_iot_timer_wheel_next_timeout_ms(&(pClient->clientData.inFlightRetryWheel));
+	if(retry_ms < timeout_ms) {
+		timeout_ms = retry_ms;
+	}
+
+	FUNC_EXIT_RC(timeout_ms);
+}
+
 #ifdef __cplusplus
 }
 #endif
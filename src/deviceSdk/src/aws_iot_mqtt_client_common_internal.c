@@ -102,6 +102,126 @@ IoT_Error_t aws_iot_mqtt_internal_decode_remaining_length_from_buffer(unsigned c
 	FUNC_EXIT_RC(SUCCESS);
 }
 
+/**
+ * Reads the length of an MQTT 5 property list
+ * @param pptr pointer to the property length - incremented to the first property
+ * @param enddata pointer to the end of the data: do not read beyond
+ * @param pPropertiesEnd returned pointer to the first byte after the property list
+ * @return SUCCESS, FAILURE if the property list runs past enddata
+ */
+IoT_Error_t aws_iot_mqtt_internal_read_properties_length(unsigned char **pptr, unsigned char *enddata,
+														 unsigned char **pPropertiesEnd) {
+	uint32_t len, multiplier, count;
+	unsigned char encodedByte;
+
+	len = 0;
+	multiplier = 1;
+	count = 0;
+	do {
+		if(*pptr >= enddata || ++count > MAX_NO_OF_REMAINING_LENGTH_BYTES) {
+			return FAILURE;
+		}
+		encodedByte = aws_iot_mqtt_internal_read_char(pptr);
+		len += (encodedByte & 127) * multiplier;
+		multiplier *= 128;
+	} while(0 != (encodedByte & 128));
+
+	if(len > (uint32_t) (enddata - *pptr)) {
+		return FAILURE;
+	}
+
+	*pPropertiesEnd = *pptr + len;
+	return SUCCESS;
+}
+
+/**
+ * Reads one MQTT 5 property. Integer properties return their value,
+ * strings and binary data are skipped
+ * @param pptr pointer to the property - incremented past it
+ * @param enddata pointer to the end of the property list: do not read beyond
+ * @param pId returned property identifier
+ * @param pValue returned value of integer properties, 0 for the others
+ * @return SUCCESS, FAILURE if the property is unknown or runs past enddata
+ */
+IoT_Error_t aws_iot_mqtt_internal_read_property(unsigned char **pptr, unsigned char *enddata, uint8_t *pId,
+												uint32_t *pValue) {
+	unsigned char *ptr;
+	size_t len;
+	uint32_t itr;
+	bool isInteger = true;
+
+	if(*pptr >= enddata) {
+		return FAILURE;
+	}
+
+	ptr = *pptr;
+	*pId = aws_iot_mqtt_internal_read_char(&ptr);
+	*pValue = 0;
+
+	switch(*pId) {
+		case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+			/* byte */
+			len = 1;
+			break;
+		case 0x13: case 0x21: case 0x22: case 0x23:
+			/* two byte integer */
+			len = 2;
+			break;
+		case 0x02: case 0x11: case 0x18: case 0x27:
+			/* four byte integer */
+			len = 4;
+			break;
+		case 0x0B:
+			/* variable byte integer, at most four bytes */
+			for(itr = 0; ; itr++) {
+				if(ptr >= enddata || itr >= MAX_NO_OF_REMAINING_LENGTH_BYTES) {
+					return FAILURE;
+				}
+				*pValue |= (uint32_t) (*ptr & 127) << (7 * itr);
+				if(0 == (*ptr++ & 128)) {
+					break;
+				}
+			}
+			*pptr = ptr;
+			return SUCCESS;
+		case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+			/* UTF-8 string or binary data */
+			isInteger = false;
+			if(enddata - ptr < 2) {
+				return FAILURE;
+			}
+			len = 2 + (size_t) ((ptr[0] << 8) | ptr[1]);
+			break;
+		case 0x26:
+			/* user property, a pair of UTF-8 strings */
+			isInteger = false;
+			if(enddata - ptr < 2) {
+				return FAILURE;
+			}
+			len = 2 + (size_t) ((ptr[0] << 8) | ptr[1]);
+			if(enddata - ptr < (ptrdiff_t) (len + 2)) {
+				return FAILURE;
+			}
+			len += 2 + (size_t) ((ptr[len] << 8) | ptr[len + 1]);
+			break;
+		default:
+			return FAILURE;
+	}
+
+	if(enddata - ptr < (ptrdiff_t) len) {
+		return FAILURE;
+	}
+
+	if(isInteger) {
+		for(itr = 0; itr < len; itr++) {
+			*pValue = (*pValue << 8) | ptr[itr];
+		}
+	}
+
+	*pptr = ptr + len;
+	return SUCCESS;
+}
+
 uint32_t aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(uint32_t rem_len) {
 	rem_len += 1; /* header byte */
 	/* now remaining_length field (MQTT 3.1.1 - 2.2.3)*/
@@ -264,34 +384,19 @@ IoT_Error_t aws_iot_mqtt_internal_init_header(MQTTHeader *pHeader, MessageTypes
 	FUNC_EXIT_RC(SUCCESS);
 }
 
-IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t length, Timer *pTimer) {
-
+/* Writes len bytes of pBuf to the network, the caller holds the write lock */
+static IoT_Error_t _aws_iot_mqtt_internal_write_all(AWS_IoT_Client *pClient, unsigned char *pBuf, size_t length,
+													Timer *pTimer) {
 	size_t sentLen, sent;
 	IoT_Error_t rc;
 
-	FUNC_ENTRY;
-
-	if(NULL == pClient || NULL == pTimer) {
-		FUNC_EXIT_RC(NULL_VALUE_ERROR);
-	}
-
-	if(length >= pClient->clientData.writeBufSize) {
-		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
-	}
-
-#ifdef _ENABLE_THREAD_SUPPORT_
-	rc = aws_iot_mqtt_client_lock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
-	if(SUCCESS != rc) {
-		FUNC_EXIT_RC(rc);
-	}
-#endif
-
 	sentLen = 0;
 	sent = 0;
+	rc = NETWORK_SSL_WRITE_TIMEOUT_ERROR;
 
 	while(sent < length && !has_timer_expired(pTimer)) {
 		rc = pClient->networkStack.write(&(pClient->networkStack),
-						 &pClient->clientData.writeBuf[sent],
+						 &pBuf[sent],
 						 (length - sent),
 						 pTimer,
 						 &sentLen);
@@ -302,52 +407,210 @@ IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t le
 		sent += sentLen;
 	}
 
+	if(sent == length) {
+		return SUCCESS;
+	}
+
+	return rc;
+}
+
+/**
+ * Takes the write side of the connection. Packets are serialized into the write buffer
+ * and sent while the lock is held, so writers never interleave and never wait for a
+ * read in progress on another thread. The in-flight publish table is guarded by the same lock.
+ * @param pClient Reference to the IoT Client
+ * @return IoT_Error_t indicating function execution status
+ */
+IoT_Error_t aws_iot_mqtt_internal_lock_write(AWS_IoT_Client *pClient) {
 #ifdef _ENABLE_THREAD_SUPPORT_
-	rc = aws_iot_mqtt_client_unlock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
+	return aws_iot_mqtt_client_lock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
+#else
+	IOT_UNUSED(pClient);
+	return SUCCESS;
+#endif
+}
+
+IoT_Error_t aws_iot_mqtt_internal_unlock_write(AWS_IoT_Client *pClient) {
+#ifdef _ENABLE_THREAD_SUPPORT_
+	return aws_iot_mqtt_client_unlock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
+#else
+	IOT_UNUSED(pClient);
+	return SUCCESS;
+#endif
+}
+
+/**
+ * Records that a packet was received. This only delays the PINGREQ that keeps NAT
+ * bindings open, the broker's keep alive only counts what the client sends.
+ * @param pClient Reference to the IoT Client
+ */
+void aws_iot_mqtt_internal_note_activity(AWS_IoT_Client *pClient) {
+	__atomic_store_n(&(pClient->clientData.lastActivityMs), get_time_ms(), __ATOMIC_RELAXED);
+}
+
+/**
+ * Records that a packet was sent, which restarts both keep alive idle times.
+ * Called from any thread sending, the stores are atomic.
+ * @param pClient Reference to the IoT Client
+ */
+void aws_iot_mqtt_internal_note_sent(AWS_IoT_Client *pClient) {
+	uint32_t now = get_time_ms();
+
+	__atomic_store_n(&(pClient->clientData.lastSentMs), now, __ATOMIC_RELAXED);
+	__atomic_store_n(&(pClient->clientData.lastActivityMs), now, __ATOMIC_RELAXED);
+}
+
+/**
+ * Sends the first length bytes of the write buffer.
+ * The caller holds the write lock, see aws_iot_mqtt_internal_lock_write.
+ * @param pClient Reference to the IoT Client
+ * @param length number of bytes of the write buffer to send
+ * @param pTimer timer bounding the send
+ * @return IoT_Error_t indicating function execution status
+ */
+IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t length, Timer *pTimer) {
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTimer) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(length >= pClient->clientData.writeBufSize) {
+		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
+	}
+
+	FUNC_EXIT_RC(aws_iot_mqtt_internal_send_packet_with_payload(pClient, length, NULL, 0, pTimer));
+}
+
+/**
+ * Sends a packet made of two segments: the first length bytes of the write buffer,
+ * followed by a payload written straight from the caller's memory.
+ * The caller holds the write lock for both segments so packets are not interleaved.
+ * @param pClient Reference to the IoT Client
+ * @param length number of bytes of the write buffer to send first
+ * @param pPayload payload sent after the write buffer, may be NULL if payloadLen is 0
+ * @param payloadLen length of the payload
+ * @param pTimer timer bounding the whole send
+ * @return IoT_Error_t indicating function execution status
+ */
+IoT_Error_t aws_iot_mqtt_internal_send_packet_with_payload(AWS_IoT_Client *pClient, size_t length,
+														   const unsigned char *pPayload, size_t payloadLen,
+														   Timer *pTimer) {
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTimer || (NULL == pPayload && 0 < payloadLen)) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(length > pClient->clientData.writeBufSize) {
+		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
+	}
+
+	rc = _aws_iot_mqtt_internal_write_all(pClient, pClient->clientData.writeBuf, length, pTimer);
+	if(SUCCESS == rc && 0 < payloadLen) {
+		rc = _aws_iot_mqtt_internal_write_all(pClient, (unsigned char *) pPayload, payloadLen, pTimer);
+	}
+	if(SUCCESS == rc) {
+		aws_iot_mqtt_internal_note_sent(pClient);
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
+/**
+ * Acknowledges a QoS1 publish received from the server.
+ * Runs on the reading thread, takes the write lock for the short PUBACK only.
+ * @param pClient Reference to the IoT Client
+ * @param packetId packet identifier of the received publish
+ * @param pTimer timer bounding the send
+ * @return IoT_Error_t indicating function execution status
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_send_puback(AWS_IoT_Client *pClient, uint16_t packetId, Timer *pTimer) {
+	uint32_t serializedLen = 0;
+	IoT_Error_t rc, threadRc;
+
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
 	if(SUCCESS != rc) {
-		FUNC_EXIT_RC(rc);
+		return rc;
 	}
-#endif
 
-	if(sent == length) {
-		/* record the fact that we have successfully sent the packet */
-		//countdown_sec(&c->pingTimer, c->clientData.keepAliveInterval);
-		FUNC_EXIT_RC(SUCCESS);
+	rc = aws_iot_mqtt_internal_serialize_ack(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
+											 PUBACK, 0, packetId, &serializedLen);
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_internal_send_packet(pClient, serializedLen, pTimer);
+	}
+
+	threadRc = aws_iot_mqtt_internal_unlock_write(pClient);
+	if(SUCCESS == rc) {
+		rc = threadRc;
+	}
+
+	return rc;
+}
+
+/* Bytes already decrypted by the TLS layer that fit in the read buffer, they can be read without blocking */
+static size_t _aws_iot_mqtt_internal_get_greedy_len(AWS_IoT_Client *pClient) {
+	size_t available, space;
+
+	if(NULL == pClient->networkStack.getBytesAvailable) {
+		return 0;
 	}
 
-	FUNC_EXIT_RC(rc) 
+	available = pClient->networkStack.getBytesAvailable(&(pClient->networkStack));
+	space = pClient->clientData.readBufSize - pClient->clientData.readBufIndex;
+
+	return (available < space) ? available : space;
 }
 
-static IoT_Error_t _aws_iot_mqtt_internal_readWrapper( AWS_IoT_Client *pClient, size_t offset, size_t size, Timer *pTimer, size_t * read_len ) {
-    IoT_Error_t rc;
-    int byteToRead;
-    size_t byteRead = 0;
+/* Makes sure bytes [0, offset + size) of the current packet are in the read buffer.
+ * Whatever else the TLS record holds is read along, so the following packets are
+ * usually parsed from the buffer without touching the network again. */
+static IoT_Error_t _aws_iot_mqtt_internal_readWrapper(AWS_IoT_Client *pClient, size_t offset, size_t size,
+													  Timer *pTimer, size_t *read_len) {
+	IoT_Error_t rc;
+	int byteToRead;
+	size_t byteRead = 0;
+	size_t greedyLen;
 
-    byteToRead = ( offset + size ) - pClient->clientData.readBufIndex;
+	byteToRead = (offset + size) - pClient->clientData.readBufIndex;
 
-    if ( byteToRead > 0 )
-    {
-        rc = pClient->networkStack.read( &( pClient->networkStack ),
-            pClient->clientData.readBuf + pClient->clientData.readBufIndex,
-            (size_t)byteToRead,
-            pTimer,
-            &byteRead );
-        pClient->clientData.readBufIndex += byteRead;
+	if(byteToRead <= 0) {
+		*read_len = size;
+		return SUCCESS;
+	}
 
-        /* refresh byte to read */
-        byteToRead = ( offset + size ) - ((int)pClient->clientData.readBufIndex);
-        *read_len = size - (size_t)byteToRead;
-    }
-    else
-    {
-        *read_len = size;
-        rc = SUCCESS;
-    }
+	greedyLen = _aws_iot_mqtt_internal_get_greedy_len(pClient);
+	rc = pClient->networkStack.read(&(pClient->networkStack),
+									pClient->clientData.readBuf + pClient->clientData.readBufIndex,
+									(greedyLen > (size_t) byteToRead) ? greedyLen : (size_t) byteToRead,
+									pTimer, &byteRead);
+	pClient->clientData.readBufIndex += byteRead;
+
+	/* The first read of a record decrypts all of it, pick up the rest */
+	if(SUCCESS == rc) {
+		greedyLen = _aws_iot_mqtt_internal_get_greedy_len(pClient);
+		if(greedyLen > 0) {
+			/* The requested bytes are in, an error here is reported by the next read */
+			byteRead = 0;
+			(void) pClient->networkStack.read(&(pClient->networkStack),
+											  pClient->clientData.readBuf + pClient->clientData.readBufIndex,
+											  greedyLen, pTimer, &byteRead);
+			pClient->clientData.readBufIndex += byteRead;
+		}
+	}
 
- 
+	/* refresh byte to read */
+	byteToRead = (offset + size) - ((int) pClient->clientData.readBufIndex);
+	if(byteToRead < 0) {
+		byteToRead = 0;
+	}
+	*read_len = size - (size_t) byteToRead;
 
-    return rc;
+	return rc;
 }
+
 static IoT_Error_t _aws_iot_mqtt_internal_decode_packet_remaining_len(AWS_IoT_Client *pClient, size_t * offset,
 																	  size_t *rem_len, Timer *pTimer) {
 	size_t multiplier, len;
@@ -378,8 +641,274 @@ static IoT_Error_t _aws_iot_mqtt_internal_decode_packet_remaining_len(AWS_IoT_Cl
 	FUNC_EXIT_RC(rc);
 }
 
+static IoT_Error_t _aws_iot_mqtt_internal_deliver_message(AWS_IoT_Client *pClient, char *pTopicName,
+														  uint16_t topicNameLen,
+														  IoT_Publish_Message_Params *pMessageParams,
+														  size_t chunkOffset, size_t totalLen, bool isFinal,
+														  uint32_t *pHandlerCount);
+
+/**
+ * Reads and drops the rest of a packet that does not fit in the read buffer
+ * @param pClient Reference to the IoT Client
+ * @param rem_len number of bytes of the packet still on the network
+ * @param pTimer timer bounding the whole read
+ * @return MQTT_RX_BUFFER_TOO_SHORT_ERROR once the packet is consumed, the network error otherwise
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_discard_packet(AWS_IoT_Client *pClient, size_t rem_len, Timer *pTimer) {
+	size_t total_bytes_read, bytes_to_be_read, read_len;
+	IoT_Error_t rc;
+
+	total_bytes_read = 0;
+	read_len = 0;
+	rc = SUCCESS;
+
+	if(rem_len >= pClient->clientData.readBufSize) {
+		bytes_to_be_read = pClient->clientData.readBufSize;
+	} else {
+		bytes_to_be_read = rem_len;
+	}
+
+	while(total_bytes_read < rem_len && SUCCESS == rc) {
+		rc = pClient->networkStack.read(&(pClient->networkStack), pClient->clientData.readBuf, bytes_to_be_read,
+										pTimer, &read_len);
+		if(SUCCESS == rc) {
+			total_bytes_read += read_len;
+			if((rem_len - total_bytes_read) >= pClient->clientData.readBufSize) {
+				bytes_to_be_read = pClient->clientData.readBufSize;
+			} else {
+				bytes_to_be_read = rem_len - total_bytes_read;
+			}
+		}
+	}
+
+	/* Check buffer was correctly emptied, otherwise, return error message. */
+	if(total_bytes_read == rem_len) {
+		aws_iot_mqtt_internal_flushBuffers(pClient);
+		return MQTT_RX_BUFFER_TOO_SHORT_ERROR;
+	}
+
+	return rc;
+}
+
+/**
+ * Reads the property list of an MQTT 5 PUBLISH and resolves its topic alias.
+ * A publish carrying both a topic and an alias sets the alias, one with an empty
+ * topic is delivered on the topic its alias was last set to.
+ * @param pClient Reference to the IoT Client
+ * @param pProperties start of the property list, right after the packet identifier
+ * @param pEnd end of the packet data held in the read buffer
+ * @param pTopicName topic of the publish, replaced with the aliased topic for an empty topic
+ * @param pTopicNameLen length of the topic, replaced along with it
+ * @param pPayload returned start of the payload
+ * @return SUCCESS, FAILURE if the properties are malformed or the alias was never set
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_read_publish_properties(AWS_IoT_Client *pClient,
+																  unsigned char *pProperties, unsigned char *pEnd,
+																  char **pTopicName, uint16_t *pTopicNameLen,
+																  unsigned char **pPayload) {
+	unsigned char *curData, *endData;
+	uint32_t value;
+	uint16_t topicAlias;
+	uint8_t propertyId;
+	TopicAlias *pAlias;
+	IoT_Error_t rc;
+
+	curData = pProperties;
+	topicAlias = 0;
+	rc = aws_iot_mqtt_internal_read_properties_length(&curData, pEnd, &endData);
+	while(SUCCESS == rc && curData < endData) {
+		rc = aws_iot_mqtt_internal_read_property(&curData, endData, &propertyId, &value);
+		if(MQTT_PROPERTY_TOPIC_ALIAS == propertyId) {
+			topicAlias = (uint16_t) value;
+		}
+	}
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	*pPayload = endData;
+
+	if(0 == topicAlias) {
+		return (0 == *pTopicNameLen) ? FAILURE : SUCCESS;
+	}
+	if(AWS_IOT_MQTT_TOPIC_ALIAS_MAX < topicAlias) {
+		return FAILURE;
+	}
+
+	pAlias = &(pClient->clientData.inboundTopicAliases[topicAlias - 1]);
+	if(0 == *pTopicNameLen) {
+		if(0 == pAlias->topicNameLen) {
+			IOT_WARN("Publish on unknown topic alias %d dropped", topicAlias);
+			return FAILURE;
+		}
+		*pTopicName = pAlias->topicName;
+		*pTopicNameLen = pAlias->topicNameLen;
+	} else if(AWS_IOT_MQTT_TOPIC_ALIAS_LEN < *pTopicNameLen) {
+		IOT_WARN("Topic too long for alias %d, publishes using it are dropped", topicAlias);
+		pAlias->topicNameLen = 0;
+	} else {
+		memcpy(pAlias->topicName, *pTopicName, *pTopicNameLen);
+		pAlias->topicNameLen = *pTopicNameLen;
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * Streams the payload of a PUBLISH packet that does not fit in the read buffer.
+ * The variable header is kept at the start of the buffer and the payload is read
+ * into the space left behind it, one chunk at a time, each chunk being handed to
+ * the streaming handlers before the next one is read.
+ * @param pClient Reference to the IoT Client
+ * @param offset length of the fixed header already in the read buffer
+ * @param rem_len remaining length of the packet
+ * @param pTimer timer bounding the read of the variable header
+ * @param pPacketTimer timer bounding the read of the payload
+ * @return MQTT_NOTHING_TO_READ once the packet is consumed, MQTT_RX_BUFFER_TOO_SHORT_ERROR
+ *         if no handler took the message
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_stream_publish(AWS_IoT_Client *pClient, size_t offset, size_t rem_len,
+														 Timer *pTimer, Timer *pPacketTimer) {
+	unsigned char *curData, *pChunk;
+	unsigned char encodedByte;
+	char *pTopicName;
+	size_t varHeaderLen, payloadLen, chunkOffset, chunkCap, chunkLen, bufferedLen, read_len;
+	uint32_t handlerCount, propertiesLen, multiplier, lengthBytes;
+	uint16_t topicNameLen;
+	IoT_Publish_Message_Params msg;
+	MQTTHeader header = {0};
+	IoT_Error_t rc;
+
+	header.byte = pClient->clientData.readBuf[0];
+	msg.isDup = MQTT_HEADER_FIELD_DUP(header.byte);
+	msg.qos = (QoS) MQTT_HEADER_FIELD_QOS(header.byte);
+	msg.isRetained = MQTT_HEADER_FIELD_RETAIN(header.byte);
+	msg.id = 0;
+
+	/* Topic name length, the first field of the variable header */
+	rc = _aws_iot_mqtt_internal_readWrapper(pClient, offset, 2, pTimer, &read_len);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	curData = pClient->clientData.readBuf + offset;
+	topicNameLen = aws_iot_mqtt_internal_read_uint16_t(&curData);
+	varHeaderLen = 2 + topicNameLen + ((QOS0 != msg.qos) ? 2 : 0);
+	if(varHeaderLen >= rem_len || (offset + varHeaderLen) >= pClient->clientData.readBufSize) {
+		/* No room left for the payload, drop the packet as before */
+		return _aws_iot_mqtt_internal_discard_packet(pClient, offset + rem_len - pClient->clientData.readBufIndex,
+													 pPacketTimer);
+	}
+
+	rc = _aws_iot_mqtt_internal_readWrapper(pClient, offset + 2, varHeaderLen - 2, pTimer, &read_len);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	pTopicName = (char *) curData;
+	curData += topicNameLen;
+	if(QOS0 != msg.qos) {
+		msg.id = aws_iot_mqtt_internal_read_uint16_t(&curData);
+	}
+	pChunk = curData;
+
+	if(MQTT_5 == pClient->clientData.options.MQTTVersion) {
+		/* The property list ends the variable header, it has to fit in the buffer too */
+		propertiesLen = 0;
+		multiplier = 1;
+		lengthBytes = 0;
+		do {
+			if(varHeaderLen >= rem_len || (offset + varHeaderLen) >= pClient->clientData.readBufSize ||
+			   ++lengthBytes > 4) {
+				return _aws_iot_mqtt_internal_discard_packet(pClient,
+															 offset + rem_len - pClient->clientData.readBufIndex,
+															 pPacketTimer);
+			}
+			rc = _aws_iot_mqtt_internal_readWrapper(pClient, offset + varHeaderLen, 1, pTimer, &read_len);
+			if(SUCCESS != rc) {
+				return rc;
+			}
+			encodedByte = pClient->clientData.readBuf[offset + varHeaderLen];
+			varHeaderLen++;
+			propertiesLen += (encodedByte & 127) * multiplier;
+			multiplier *= 128;
+		} while(0 != (encodedByte & 128));
+
+		if((varHeaderLen + propertiesLen) >= rem_len ||
+		   (offset + varHeaderLen + propertiesLen) >= pClient->clientData.readBufSize) {
+			return _aws_iot_mqtt_internal_discard_packet(pClient, offset + rem_len - pClient->clientData.readBufIndex,
+														 pPacketTimer);
+		}
+		rc = _aws_iot_mqtt_internal_readWrapper(pClient, offset + varHeaderLen, propertiesLen, pTimer, &read_len);
+		if(SUCCESS != rc) {
+			return rc;
+		}
+		varHeaderLen += propertiesLen;
+
+		rc = _aws_iot_mqtt_internal_read_publish_properties(pClient, curData,
+															pClient->clientData.readBuf + offset + varHeaderLen,
+															&pTopicName, &topicNameLen, &pChunk);
+		if(SUCCESS != rc) {
+			return _aws_iot_mqtt_internal_discard_packet(pClient, offset + rem_len - pClient->clientData.readBufIndex,
+														 pPacketTimer);
+		}
+	}
+
+	chunkCap = pClient->clientData.readBufSize - (offset + varHeaderLen);
+	payloadLen = rem_len - varHeaderLen;
+	chunkOffset = 0;
+	handlerCount = 0;
+	/* Start of the payload read along with the header */
+	bufferedLen = pClient->clientData.readBufIndex - (offset + varHeaderLen);
+
+	do {
+		chunkLen = payloadLen - chunkOffset;
+		if(chunkLen > chunkCap) {
+			chunkLen = chunkCap;
+		}
+
+		rc = SUCCESS;
+		if(chunkLen > bufferedLen) {
+			rc = pClient->networkStack.read(&(pClient->networkStack), pChunk + bufferedLen, chunkLen - bufferedLen,
+											pPacketTimer, &read_len);
+		}
+		bufferedLen = 0;
+		if(SUCCESS != rc) {
+			/* The rest of the packet is still on the wire, the stream can not be resynchronized */
+			aws_iot_mqtt_internal_flushBuffers(pClient);
+			return NETWORK_SSL_READ_ERROR;
+		}
+
+		msg.payload = pChunk;
+		msg.payloadLen = chunkLen;
+		rc = _aws_iot_mqtt_internal_deliver_message(pClient, pTopicName, topicNameLen, &msg, chunkOffset, payloadLen,
+													(chunkOffset + chunkLen) == payloadLen, &handlerCount);
+		if(SUCCESS != rc) {
+			aws_iot_mqtt_internal_flushBuffers(pClient);
+			return rc;
+		}
+		chunkOffset += chunkLen;
+	} while(chunkOffset < payloadLen);
+
+	aws_iot_mqtt_internal_flushBuffers(pClient);
+
+	if(QOS0 != msg.qos) {
+		/* Message assumed to be QoS1 since we do not support QoS2 at this time */
+		countdown_ms(pPacketTimer, pClient->clientData.packetTimeoutMs);
+		rc = _aws_iot_mqtt_internal_send_puback(pClient, msg.id, pPacketTimer);
+		if(SUCCESS != rc) {
+			return rc;
+		}
+	}
+
+	if(0 == handlerCount) {
+		return MQTT_RX_BUFFER_TOO_SHORT_ERROR;
+	}
+
+	/* Packet fully handled here, nothing left for the caller */
+	return MQTT_NOTHING_TO_READ;
+}
+
 static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, Timer *pTimer, uint8_t *pPacketType) {
-	size_t rem_len, total_bytes_read, bytes_to_be_read, read_len;
+	size_t rem_len, read_len;
 	IoT_Error_t rc;
     size_t offset = 0;
 	MQTTHeader header = {0};
@@ -388,10 +917,16 @@ static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, T
 	countdown_ms(&packetTimer, pClient->clientData.packetTimeoutMs);
 
 	rem_len = 0;
-	total_bytes_read = 0;
-	bytes_to_be_read = 0;
 	read_len = 0;
 
+	/* Drop the packet handled by the previous call, the bytes read along with it move to the front */
+	if(0 < pClient->clientData.readBufPacketLen) {
+		pClient->clientData.readBufIndex -= pClient->clientData.readBufPacketLen;
+		memmove(pClient->clientData.readBuf, pClient->clientData.readBuf + pClient->clientData.readBufPacketLen,
+				pClient->clientData.readBufIndex);
+		pClient->clientData.readBufPacketLen = 0;
+	}
+
     rc = _aws_iot_mqtt_internal_readWrapper( pClient, offset, 1, pTimer, &read_len );
 	/* 1. read the header byte.  This has the packet type in it */
 	if(NETWORK_SSL_NOTHING_TO_READ == rc) {
@@ -400,99 +935,47 @@ static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, T
 		return rc;
 	}
 
-	/* 2. read the remaining length.  This is variable in itself */
-	rc = _aws_iot_mqtt_internal_decode_packet_remaining_len(pClient, &offset, &rem_len, pTimer);
+	/* 2. read the remaining length.  This is variable in itself. Once the header byte is in,
+	 * the rest of the packet is bounded by the packet timeout, not by the caller's timer that
+	 * may already have expired */
+	rc = _aws_iot_mqtt_internal_decode_packet_remaining_len(pClient, &offset, &rem_len, &packetTimer);
 	if(SUCCESS != rc) {
 		return rc;
 	} 
      
-	/* if the buffer is too short then the message will be dropped silently */
+	/* if the buffer is too short then publish payloads are streamed to the
+	 * streaming handlers, other packets are dropped */
 	if((rem_len + offset) >= pClient->clientData.readBufSize) {
-		bytes_to_be_read = pClient->clientData.readBufSize;
-		do {
-			rc = pClient->networkStack.read(&(pClient->networkStack), pClient->clientData.readBuf, bytes_to_be_read,
-											pTimer, &read_len);
-			if(SUCCESS == rc) {
-				total_bytes_read += read_len;
-				if((rem_len - total_bytes_read) >= pClient->clientData.readBufSize) {
-					bytes_to_be_read = pClient->clientData.readBufSize;
-				} else {
-					bytes_to_be_read = rem_len - total_bytes_read;
-				}
-			}
-		} while(total_bytes_read < rem_len && SUCCESS == rc);
-
-        /* Check buffer was correctly emptied, otherwise, return error message. */
-        if ( total_bytes_read == rem_len )
-        {
-            aws_iot_mqtt_internal_flushBuffers( pClient );
-            return MQTT_RX_BUFFER_TOO_SHORT_ERROR;
-        }
-        else
-        {
-            return rc;
-        }
+		header.byte = pClient->clientData.readBuf[0];
+		if(PUBLISH == MQTT_HEADER_FIELD_TYPE(header.byte)) {
+			return _aws_iot_mqtt_internal_stream_publish(pClient, offset, rem_len, pTimer, &packetTimer);
+		}
+		/* Everything buffered belongs to this packet since it is larger than the buffer */
+		return _aws_iot_mqtt_internal_discard_packet(pClient, offset + rem_len - pClient->clientData.readBufIndex,
+													 &packetTimer);
 	}
 
 	/* 3. read the rest of the buffer using a callback to supply the rest of the data */
 	if(rem_len > 0) {
-        rc = _aws_iot_mqtt_internal_readWrapper( pClient, offset, rem_len, pTimer, &read_len );
+        rc = _aws_iot_mqtt_internal_readWrapper( pClient, offset, rem_len, &packetTimer, &read_len );
 		if(SUCCESS != rc || read_len != rem_len) {
 			return FAILURE;
 		}
 	}
 
-    /* Pack has been received, we can flush the buffers for next call. */
-    aws_iot_mqtt_internal_flushBuffers( pClient );
+	/* Packet has been received, it stays at the start of the buffer until the next call */
+	pClient->clientData.readBufPacketLen = offset + rem_len;
 	header.byte = pClient->clientData.readBuf[0];
 	*pPacketType = MQTT_HEADER_FIELD_TYPE(header.byte);
 
 	FUNC_EXIT_RC(rc);
 }
 
-// assume topic filter and name is in correct format
-// # can only be at end
-// + and # can only be next to separator
-static bool _aws_iot_mqtt_internal_is_topic_matched(char *pTopicFilter, char *pTopicName, uint16_t topicNameLen) {
-
-	char *curf, *curn, *curn_end;
-
-	if(NULL == pTopicFilter || NULL == pTopicName) {
-		return false;
-	}
-
-	curf = pTopicFilter;
-	curn = pTopicName;
-	curn_end = curn + topicNameLen;
-
-	while(*curf && (curn < curn_end)) {
-		if(*curn == '/' && *curf != '/') {
-			break;
-		}
-		if(*curf != '+' && *curf != '#' && *curf != *curn) {
-			break;
-		}
-		if(*curf == '+') {
-			/* skip until we meet the next separator, or end of string */
-			char *nextpos = curn + 1;
-			while(nextpos < curn_end && *nextpos != '/')
-				nextpos = ++curn + 1;
-		} else if(*curf == '#') {
-			/* skip until end of string */
-			curn = curn_end - 1;
-		}
-
-		curf++;
-		curn++;
-	};
-
-	return (curn == curn_end) && (*curf == '\0');
-}
-
 static IoT_Error_t _aws_iot_mqtt_internal_deliver_message(AWS_IoT_Client *pClient, char *pTopicName,
 														  uint16_t topicNameLen,
-														  IoT_Publish_Message_Params *pMessageParams) {
-	uint32_t itr;
+														  IoT_Publish_Message_Params *pMessageParams,
+														  size_t chunkOffset, size_t totalLen, bool isFinal,
+														  uint32_t *pHandlerCount) {
 	IoT_Error_t rc;
 	ClientState clientState;
 
@@ -506,33 +989,24 @@ static IoT_Error_t _aws_iot_mqtt_internal_deliver_message(AWS_IoT_Client *pClien
 	 * But while callback return is in progress, Yield should not be called.
 	 * The state for CB_RETURN accomplishes that, as yield cannot be called while in that state */
 	clientState = aws_iot_mqtt_get_client_state(pClient);
+#ifdef _ENABLE_THREAD_SUPPORT_
+	pClient->clientData.callbackThreadId = aws_iot_thread_get_id();
+#endif
 	aws_iot_mqtt_set_client_state(pClient, clientState, CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN);
 
-	/* Find the right message handler - indexed by topic */
-	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++itr) {
-		if(NULL != pClient->clientData.messageHandlers[itr].topicName) {
-			if(((topicNameLen == pClient->clientData.messageHandlers[itr].topicNameLen)
-				&&
-				(strncmp(pTopicName, (char *) pClient->clientData.messageHandlers[itr].topicName, topicNameLen) == 0))
-			   || _aws_iot_mqtt_internal_is_topic_matched((char *) pClient->clientData.messageHandlers[itr].topicName,
-														  pTopicName, topicNameLen)) {
-				if(NULL != pClient->clientData.messageHandlers[itr].pApplicationHandler) {
-					pClient->clientData.messageHandlers[itr].pApplicationHandler(pClient, pTopicName, topicNameLen,
-																				 pMessageParams,
-																				 pClient->clientData.messageHandlers[itr].pApplicationHandlerData);
-				}
-			}
-		}
-	}
+	/* Find the right message handlers - indexed by topic level */
+	*pHandlerCount += aws_iot_mqtt_internal_trie_dispatch(pClient, pTopicName, topicNameLen, pMessageParams,
+														  chunkOffset, totalLen, isFinal);
 	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN, clientState);
 
 	FUNC_EXIT_RC(rc);
 }
 
 static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient, Timer *pTimer) {
+	unsigned char *pPayload, *pEnd;
 	char *topicName;
 	uint16_t topicNameLen;
-	uint32_t len;
+	uint32_t handlerCount;
 	IoT_Error_t rc;
 	IoT_Publish_Message_Params msg;
 
@@ -540,7 +1014,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient
 
 	topicName = NULL;
 	topicNameLen = 0;
-	len = 0;
+	handlerCount = 0;
 
 	rc = aws_iot_mqtt_internal_deserialize_publish(&msg.isDup, &msg.qos, &msg.isRetained,
 												   &msg.id, &topicName, &topicNameLen,
@@ -552,7 +1026,19 @@ static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient
 		FUNC_EXIT_RC(rc);
 	}
 
-	rc = _aws_iot_mqtt_internal_deliver_message(pClient, topicName, topicNameLen, &msg);
+	if(MQTT_5 == pClient->clientData.options.MQTTVersion) {
+		pEnd = (unsigned char *) msg.payload + msg.payloadLen;
+		rc = _aws_iot_mqtt_internal_read_publish_properties(pClient, (unsigned char *) msg.payload, pEnd,
+															&topicName, &topicNameLen, &pPayload);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+		msg.payload = pPayload;
+		msg.payloadLen = (size_t) (pEnd - pPayload);
+	}
+
+	rc = _aws_iot_mqtt_internal_deliver_message(pClient, topicName, topicNameLen, &msg, 0, msg.payloadLen, true,
+												&handlerCount);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
@@ -563,14 +1049,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient
 	}
 
 	/* Message assumed to be QoS1 since we do not support QoS2 at this time */
-	rc = aws_iot_mqtt_internal_serialize_ack(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
-											 PUBACK, 0, msg.id, &len);
-
-	if(SUCCESS != rc) {
-		FUNC_EXIT_RC(rc);
-	}
-
-	rc = aws_iot_mqtt_internal_send_packet(pClient, len, pTimer);
+	rc = _aws_iot_mqtt_internal_send_puback(pClient, msg.id, pTimer);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
@@ -613,9 +1092,22 @@ IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTi
 		return rc;
 	}
 
+	aws_iot_mqtt_internal_note_activity(pClient);
+
 	switch(*pPacketType) {
+		case PUBACK: {
+			/* Complete asynchronous publishes here, blocking publishes also get the PUBACK forwarded */
+			unsigned char type, dup;
+			uint16_t packetId = 0;
+			rc = aws_iot_mqtt_internal_deserialize_ack(&type, &dup, &packetId, pClient->clientData.readBuf,
+													   pClient->clientData.readBufSize);
+			if(SUCCESS == rc || MQTT_REASON_CODE_ERROR == rc) {
+				/* A refused message is completed with the error, the connection is fine */
+				rc = aws_iot_mqtt_internal_complete_inflight_publish(pClient, packetId, rc);
+			}
+			break;
+		}
 		case CONNACK:
-		case PUBACK:
 		case SUBACK:
 		case UNSUBACK:
 			/* SDK is blocking, these responses will be forwarded to calling function to process */
@@ -629,10 +1121,16 @@ IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTi
 			/* QoS2 not supported at this time */
 			break;
 		case PINGRESP: {
-			pClient->clientStatus.isPingOutstanding = 0;
-			countdown_sec(&pClient->pingTimer, pClient->clientData.keepAliveInterval);
+			aws_iot_mqtt_internal_handle_pingresp(pClient);
 			break;
 		}
+		case DISCONNECT:
+			/* MQTT 5 brokers say why they close the connection, the reason is only logged */
+			IOT_WARN("Disconnected by the broker, reason code 0x%02x",
+					 (0 < pClient->clientData.readBuf[1] && 128 > pClient->clientData.readBuf[1]) ?
+					 pClient->clientData.readBuf[2] : 0);
+			rc = NETWORK_DISCONNECTED_ERROR;
+			break;
 		default: {
 			/* Either unknown packet type or Failure occurred
              * Should not happen */
@@ -646,9 +1144,42 @@ IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTi
 
 IoT_Error_t aws_iot_mqtt_internal_flushBuffers( AWS_IoT_Client *pClient ) {
     pClient->clientData.readBufIndex = 0;
+    pClient->clientData.readBufPacketLen = 0;
     return SUCCESS;
 }
 
+/**
+ * Checks if a complete packet, other than the one last returned by cycle_read,
+ * is waiting in the read buffer. Such packets can be handled without waiting on the network.
+ * @param pClient Reference to the IoT Client
+ * @return true if the next cycle_read will not need to read the network
+ */
+bool aws_iot_mqtt_internal_has_buffered_packet(AWS_IoT_Client *pClient) {
+	unsigned char *pPacket;
+	size_t available, len;
+	uint32_t rem_len, multiplier;
+
+	if(pClient->clientData.readBufIndex <= pClient->clientData.readBufPacketLen) {
+		return false;
+	}
+
+	pPacket = pClient->clientData.readBuf + pClient->clientData.readBufPacketLen;
+	available = pClient->clientData.readBufIndex - pClient->clientData.readBufPacketLen;
+	rem_len = 0;
+	multiplier = 1;
+	len = 1;
+
+	do {
+		if(len >= available || len > MAX_NO_OF_REMAINING_LENGTH_BYTES) {
+			return false;
+		}
+		rem_len += (pPacket[len] & 127) * multiplier;
+		multiplier *= 128;
+	} while(0 != (pPacket[len++] & 128));
+
+	return (len + rem_len) <= available;
+}
+
 /* only used in single-threaded mode where one command at a time is in process */
 IoT_Error_t aws_iot_mqtt_internal_wait_for_read(AWS_IoT_Client *pClient, uint8_t packetType, Timer *pTimer) {
 	IoT_Error_t rc;
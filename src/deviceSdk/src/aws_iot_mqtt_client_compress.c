@@ -0,0 +1,361 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_client_compress.c
+ * @brief Payload compression for MQTT messages
+ *
+ * The codec writes the LZ4 block format: sequences of literals followed by a match
+ * copied from up to 64 KB back. The dictionary is placed before the payload, so the
+ * first occurrence of a common JSON key is already a match. Positions are counted
+ * from the start of the dictionary, which limits payloads to 64 KB minus the dictionary.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sdk/aws_iot_mqtt_client_common_internal.h"
+#include "sdk/aws_iot_mqtt_client_compress.h"
+
+/* JSON vocabulary of the shadow, jobs and door documents, most common strings last */
+static const char _aws_iot_mqtt_codec_dictionary[] =
+	"{\"execution\":{\"jobId\":\"jobDocument\":{\"operation\":\"queuedAt\":\"lastUpdatedAt\":\"startedAt\":"
+	"\"executionNumber\":\"expectedVersion\":\"includeJobExecutionState\":true,\"includeJobDocument\":false,"
+	"\"status\":\"QUEUED\",\"status\":\"IN_PROGRESS\",\"status\":\"FAILED\",\"status\":\"SUCCEEDED\","
+	"\"statusDetails\":{\"image\":\".jpg\",\"filename\":\"camera\":\"motion\":\"sensor\":\"battery\":"
+	"\"error\":null,\"code\":\"message\":\"timestamp\":\"version\":\"clientToken\":\"metadata\":{"
+	"\"desired\":{\"door\":\"open\",\"lock\":\"unlocked\"},\"delta\":{\"door\":\"opening\",\"closing\","
+	"{\"state\":{\"reported\":{\"door\":\"closed\",\"lock\":\"locked\",\"value\":false}},\"clientToken\":\"";
+
+#define CODEC_DICTIONARY_LEN (sizeof(_aws_iot_mqtt_codec_dictionary) - 1)
+
+/* LZ4 block format constants */
+#define CODEC_MIN_MATCH 4
+#define CODEC_LAST_LITERALS 5	/* the block always ends with this many literals */
+#define CODEC_MATCH_FIND_LIMIT 12	/* no match starts this close to the end */
+#define CODEC_MAX_OFFSET 65535
+#define CODEC_HASH_LOG 10
+#define CODEC_MAX_LENGTH_BYTES 4
+
+/* Positions are stored + 1 in a uint16_t, 0 marks an empty hash entry */
+#define CODEC_MAX_POSITION 65534
+
+/* Byte at pos in the dictionary followed by the payload */
+static unsigned char _aws_iot_mqtt_codec_byte(const unsigned char *pIn, uint32_t pos) {
+	if(pos < CODEC_DICTIONARY_LEN) {
+		return (unsigned char) _aws_iot_mqtt_codec_dictionary[pos];
+	}
+	return pIn[pos - CODEC_DICTIONARY_LEN];
+}
+
+static uint32_t _aws_iot_mqtt_codec_hash(const unsigned char *pIn, uint32_t pos) {
+	uint32_t value;
+
+	value = (uint32_t) _aws_iot_mqtt_codec_byte(pIn, pos) |
+			((uint32_t) _aws_iot_mqtt_codec_byte(pIn, pos + 1) << 8) |
+			((uint32_t) _aws_iot_mqtt_codec_byte(pIn, pos + 2) << 16) |
+			((uint32_t) _aws_iot_mqtt_codec_byte(pIn, pos + 3) << 24);
+
+	return (value * 2654435761U) >> (32 - CODEC_HASH_LOG);
+}
+
+/* Writes an LZ4 length continuation, 255 for every full step and the remainder */
+static bool _aws_iot_mqtt_codec_write_length(unsigned char **pptr, unsigned char *pEnd, size_t len) {
+	while(len >= 255) {
+		if(*pptr >= pEnd) {
+			return false;
+		}
+		*(*pptr)++ = 255;
+		len -= 255;
+	}
+	if(*pptr >= pEnd) {
+		return false;
+	}
+	*(*pptr)++ = (unsigned char) len;
+
+	return true;
+}
+
+/* Writes one sequence, matchLen 0 for the final literals-only sequence */
+static bool _aws_iot_mqtt_codec_write_sequence(unsigned char **pptr, unsigned char *pEnd,
+											   const unsigned char *pLiterals, size_t literalLen,
+											   uint32_t offset, size_t matchLen) {
+	unsigned char *pToken;
+	size_t matchCode;
+
+	if(*pptr >= pEnd) {
+		return false;
+	}
+	pToken = (*pptr)++;
+	*pToken = (unsigned char) (((literalLen < 15) ? literalLen : 15) << 4);
+	if(literalLen >= 15 && !_aws_iot_mqtt_codec_write_length(pptr, pEnd, literalLen - 15)) {
+		return false;
+	}
+
+	if((size_t) (pEnd - *pptr) < literalLen) {
+		return false;
+	}
+	memcpy(*pptr, pLiterals, literalLen);
+	*pptr += literalLen;
+
+	if(0 == matchLen) {
+		return true;
+	}
+
+	if(pEnd - *pptr < 2) {
+		return false;
+	}
+	*(*pptr)++ = (unsigned char) (offset & 0xFF);
+	*(*pptr)++ = (unsigned char) (offset >> 8);
+
+	matchCode = matchLen - CODEC_MIN_MATCH;
+	*pToken |= (unsigned char) ((matchCode < 15) ? matchCode : 15);
+	if(matchCode >= 15) {
+		return _aws_iot_mqtt_codec_write_length(pptr, pEnd, matchCode - 15);
+	}
+
+	return true;
+}
+
+IoT_Error_t aws_iot_mqtt_compress_payload(const unsigned char *pIn, size_t inLen, unsigned char *pOut,
+										  size_t outSize, size_t *pOutLen) {
+	uint16_t hashTable[1 << CODEC_HASH_LOG];
+	unsigned char *ptr, *pEnd;
+	uint32_t pos, anchor, end, matchFindLimit, matchLimit, ref, hash;
+	size_t matchLen;
+
+	FUNC_ENTRY;
+
+	if(NULL == pIn || NULL == pOut || NULL == pOutLen) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(inLen > (CODEC_MAX_POSITION - CODEC_DICTIONARY_LEN)) {
+		FUNC_EXIT_RC(MAX_SIZE_ERROR);
+	}
+
+	if(AWS_IOT_MQTT_CODEC_HEADER_MAX_LEN > outSize) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	ptr = pOut;
+	pEnd = pOut + outSize;
+	aws_iot_mqtt_internal_write_char(&ptr, AWS_IOT_MQTT_CODEC_LZ4_JSON);
+	ptr += aws_iot_mqtt_internal_write_len_to_buffer(ptr, (uint32_t) inLen);
+
+	memset(hashTable, 0, sizeof(hashTable));
+	for(pos = 0; pos + CODEC_MIN_MATCH <= CODEC_DICTIONARY_LEN; pos++) {
+		hashTable[_aws_iot_mqtt_codec_hash(pIn, pos)] = (uint16_t) (pos + 1);
+	}
+
+	anchor = CODEC_DICTIONARY_LEN;
+	pos = CODEC_DICTIONARY_LEN;
+	end = (uint32_t) (CODEC_DICTIONARY_LEN + inLen);
+	matchFindLimit = (inLen > CODEC_MATCH_FIND_LIMIT) ? end - CODEC_MATCH_FIND_LIMIT : 0;
+	matchLimit = end - CODEC_LAST_LITERALS;
+
+	while(pos < matchFindLimit) {
+		hash = _aws_iot_mqtt_codec_hash(pIn, pos);
+		ref = hashTable[hash];
+		hashTable[hash] = (uint16_t) (pos + 1);
+
+		if(0 == ref || CODEC_MAX_OFFSET < pos - (ref - 1)) {
+			pos++;
+			continue;
+		}
+		ref--;
+
+		for(matchLen = 0; pos + matchLen < matchLimit &&
+						  _aws_iot_mqtt_codec_byte(pIn, ref + matchLen) == _aws_iot_mqtt_codec_byte(pIn, pos + matchLen);
+			matchLen++) {
+		}
+		if(CODEC_MIN_MATCH > matchLen) {
+			pos++;
+			continue;
+		}
+
+		/* Take in the literals before the match that match as well */
+		while(pos > anchor && ref > 0 &&
+			  _aws_iot_mqtt_codec_byte(pIn, pos - 1) == _aws_iot_mqtt_codec_byte(pIn, ref - 1)) {
+			pos--;
+			ref--;
+			matchLen++;
+		}
+
+		if(!_aws_iot_mqtt_codec_write_sequence(&ptr, pEnd, pIn + (anchor - CODEC_DICTIONARY_LEN), pos - anchor,
+											   pos - ref, matchLen)) {
+			FUNC_EXIT_RC(FAILURE);
+		}
+
+		pos += (uint32_t) matchLen;
+		anchor = pos;
+	}
+
+	if(!_aws_iot_mqtt_codec_write_sequence(&ptr, pEnd, pIn + (anchor - CODEC_DICTIONARY_LEN), end - anchor, 0, 0)) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	*pOutLen = (size_t) (ptr - pOut);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+bool aws_iot_mqtt_is_payload_compressed(const unsigned char *pPayload, size_t payloadLen) {
+	return NULL != pPayload && 0 < payloadLen && AWS_IOT_MQTT_CODEC_LZ4_JSON == pPayload[0];
+}
+
+/* Reads an LZ4 length continuation, false if it runs past the end */
+static bool _aws_iot_mqtt_codec_read_length(const unsigned char **pptr, const unsigned char *pEnd, size_t *pLen) {
+	unsigned char byte;
+
+	do {
+		if(*pptr >= pEnd) {
+			return false;
+		}
+		byte = *(*pptr)++;
+		*pLen += byte;
+	} while(255 == byte);
+
+	return true;
+}
+
+IoT_Error_t aws_iot_mqtt_decompress_payload(const unsigned char *pIn, size_t inLen, unsigned char *pOut,
+											size_t outSize, size_t *pOutLen) {
+	const unsigned char *ptr, *pEnd;
+	unsigned char token, byte;
+	size_t origLen, outPos, literalLen, matchLen, offset, itr;
+	uint32_t multiplier, lengthBytes;
+
+	FUNC_ENTRY;
+
+	if(NULL == pIn || NULL == pOut || NULL == pOutLen) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(!aws_iot_mqtt_is_payload_compressed(pIn, inLen)) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	ptr = pIn + 1;
+	pEnd = pIn + inLen;
+	origLen = 0;
+	multiplier = 1;
+	lengthBytes = 0;
+	do {
+		if(ptr >= pEnd || ++lengthBytes > CODEC_MAX_LENGTH_BYTES) {
+			FUNC_EXIT_RC(FAILURE);
+		}
+		byte = *ptr++;
+		origLen += (byte & 127) * multiplier;
+		multiplier *= 128;
+	} while(0 != (byte & 128));
+
+	if(origLen > outSize) {
+		FUNC_EXIT_RC(MQTT_RX_BUFFER_TOO_SHORT_ERROR);
+	}
+
+	outPos = 0;
+	while(ptr < pEnd) {
+		token = *ptr++;
+
+		literalLen = token >> 4;
+		if(15 == literalLen && !_aws_iot_mqtt_codec_read_length(&ptr, pEnd, &literalLen)) {
+			FUNC_EXIT_RC(FAILURE);
+		}
+		if(literalLen > (size_t) (pEnd - ptr) || literalLen > origLen - outPos) {
+			FUNC_EXIT_RC(FAILURE);
+		}
+		memcpy(pOut + outPos, ptr, literalLen);
+		ptr += literalLen;
+		outPos += literalLen;
+
+		if(ptr == pEnd) {
+			/* The last sequence has no match */
+			break;
+		}
+
+		if(pEnd - ptr < 2) {
+			FUNC_EXIT_RC(FAILURE);
+		}
+		offset = (size_t) ptr[0] | ((size_t) ptr[1] << 8);
+		ptr += 2;
+		if(0 == offset || offset > outPos + CODEC_DICTIONARY_LEN) {
+			FUNC_EXIT_RC(FAILURE);
+		}
+
+		matchLen = token & 15;
+		if(15 == matchLen && !_aws_iot_mqtt_codec_read_length(&ptr, pEnd, &matchLen)) {
+			FUNC_EXIT_RC(FAILURE);
+		}
+		matchLen += CODEC_MIN_MATCH;
+		if(matchLen > origLen - outPos) {
+			FUNC_EXIT_RC(FAILURE);
+		}
+
+		/* Byte by byte, matches may overlap their own output or start in the dictionary */
+		for(itr = 0; itr < matchLen; itr++, outPos++) {
+			if(offset > outPos) {
+				pOut[outPos] = (unsigned char) _aws_iot_mqtt_codec_dictionary[CODEC_DICTIONARY_LEN + outPos - offset];
+			} else {
+				pOut[outPos] = pOut[outPos - offset];
+			}
+		}
+	}
+
+	if(outPos != origLen) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	*pOutLen = origLen;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_publish_compressed(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+											IoT_Publish_Message_Params *pParams, unsigned char *pWorkBuf,
+											size_t workBufLen) {
+	IoT_Publish_Message_Params compressedParams;
+	size_t compressedLen;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTopicName || 0 == topicNameLen || NULL == pParams || NULL == pWorkBuf) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	/* Payloads that do not shrink go out as they are */
+	if(workBufLen > pParams->payloadLen) {
+		workBufLen = pParams->payloadLen;
+	}
+	rc = aws_iot_mqtt_compress_payload((const unsigned char *) pParams->payload, pParams->payloadLen, pWorkBuf,
+									   workBufLen, &compressedLen);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(aws_iot_mqtt_publish(pClient, pTopicName, topicNameLen, pParams));
+	}
+
+	compressedParams = *pParams;
+	compressedParams.payload = pWorkBuf;
+	compressedParams.payloadLen = compressedLen;
+	rc = aws_iot_mqtt_publish(pClient, pTopicName, topicNameLen, &compressedParams);
+	pParams->id = compressedParams.id;
+
+	FUNC_EXIT_RC(rc);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -126,8 +126,19 @@ static uint32_t _aws_iot_get_connect_packet_length(IoT_Client_Connect_Params *pC
 	len = 10; // Len = 10 for MQTT_3_1_1
 	len = len + pConnectParams->clientIDLen + 2;
 
+	if(MQTT_5 == pConnectParams->MQTTVersion) {
+		/* Property length and topic alias maximum, session expiry for persistent sessions */
+		len = len + 1 + 3;
+		if(!pConnectParams->isCleanSession) {
+			len = len + 5;
+		}
+	}
+
 	if(pConnectParams->isWillMsgPresent) {
 		len = len + pConnectParams->will.topicNameLen + 2 + pConnectParams->will.msgLen + 2;
+		if(MQTT_5 == pConnectParams->MQTTVersion) {
+			len = len + 1; /* empty will property list */
+		}
 	}
 
 	if(NULL != pConnectParams->pUsername) {
@@ -169,6 +180,7 @@ static IoT_Error_t _aws_iot_mqtt_serialize_connect(unsigned char *pTxBuf, size_t
 	/* Check needed here before we start writing to the Tx buffer */
 	switch(pConnectParams->MQTTVersion) {
 		case MQTT_3_1_1:
+		case MQTT_5:
 			break;
 		default:
 			return MQTT_CONNACK_UNACCEPTABLE_PROTOCOL_VERSION_ERROR;
@@ -219,6 +231,18 @@ static IoT_Error_t _aws_iot_mqtt_serialize_connect(unsigned char *pTxBuf, size_t
 	aws_iot_mqtt_internal_write_char(&ptr, flags.all);
 	aws_iot_mqtt_internal_write_uint_16(&ptr, pConnectParams->keepAliveIntervalInSec);
 
+	if(MQTT_5 == pConnectParams->MQTTVersion) {
+		/* The session of a clean start ends with the connection, as in 3.1.1 */
+		aws_iot_mqtt_internal_write_char(&ptr, pConnectParams->isCleanSession ? 3 : 8);
+		aws_iot_mqtt_internal_write_char(&ptr, MQTT_PROPERTY_TOPIC_ALIAS_MAXIMUM);
+		aws_iot_mqtt_internal_write_uint_16(&ptr, AWS_IOT_MQTT_TOPIC_ALIAS_MAX);
+		if(!pConnectParams->isCleanSession) {
+			aws_iot_mqtt_internal_write_char(&ptr, MQTT_PROPERTY_SESSION_EXPIRY_INTERVAL);
+			aws_iot_mqtt_internal_write_uint_16(&ptr, (uint16_t) (AWS_IOT_MQTT_SESSION_EXPIRY_INTERVAL >> 16));
+			aws_iot_mqtt_internal_write_uint_16(&ptr, (uint16_t) (AWS_IOT_MQTT_SESSION_EXPIRY_INTERVAL & 0xFFFF));
+		}
+	}
+
 	/* If the code have passed the check for incorrect values above, no client id was passed as argument */
 	if(NULL == pConnectParams->pClientID) {
 		aws_iot_mqtt_internal_write_uint_16(&ptr, 0);
@@ -227,6 +251,9 @@ static IoT_Error_t _aws_iot_mqtt_serialize_connect(unsigned char *pTxBuf, size_t
 	}
 
 	if(pConnectParams->isWillMsgPresent) {
+		if(MQTT_5 == pConnectParams->MQTTVersion) {
+			aws_iot_mqtt_internal_write_char(&ptr, 0);
+		}
 		aws_iot_mqtt_internal_write_utf8_string(&ptr, pConnectParams->will.pTopicName,
 												pConnectParams->will.topicNameLen);
 		aws_iot_mqtt_internal_write_utf8_string(&ptr, pConnectParams->will.pMessage, pConnectParams->will.msgLen);
@@ -247,24 +274,30 @@ static IoT_Error_t _aws_iot_mqtt_serialize_connect(unsigned char *pTxBuf, size_t
 
 /**
   * Deserializes the supplied (wire) buffer into connack data - return code
+  * MQTT 5 reason codes are mapped to the matching MQTT 3.1.1 return code errors
   * @param sessionPresent the session present flag returned (only for MQTT 3.1.1)
   * @param connack_rc returned integer value of the connack return code
+  * @param pTopicAliasMax returned topic alias maximum of the broker, 0 if it does not accept aliases
+  * @param pServerKeepAlive returned keep alive imposed by the broker in seconds, unchanged if none
   * @param buf the raw buffer data, of the correct length determined by the remaining length field
   * @param buflen the length in bytes of the data in the supplied buffer
   * @return IoT_Error_t indicating function execution status
   */
 static IoT_Error_t _aws_iot_mqtt_deserialize_connack(unsigned char *pSessionPresent, IoT_Error_t *pConnackRc,
+													 uint16_t *pTopicAliasMax, uint16_t *pServerKeepAlive,
 													 unsigned char *pRxBuf, size_t rxBufLen) {
 	unsigned char *curdata, *enddata;
 	unsigned char connack_rc_char;
-	uint32_t decodedLen, readBytesLen;
+	uint32_t decodedLen, readBytesLen, value;
+	uint8_t propertyId;
 	IoT_Error_t rc;
 	MQTT_Connack_Header_Flags flags = {0};
 	MQTTHeader header = {0};
 
 	FUNC_ENTRY;
 
-	if(NULL == pSessionPresent || NULL == pConnackRc || NULL == pRxBuf) {
+	if(NULL == pSessionPresent || NULL == pConnackRc || NULL == pTopicAliasMax || NULL == pServerKeepAlive ||
+	   NULL == pRxBuf) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
@@ -279,6 +312,7 @@ static IoT_Error_t _aws_iot_mqtt_deserialize_connack(unsigned char *pSessionPres
 	enddata = NULL;
 	decodedLen = 0;
 	readBytesLen = 0;
+	*pTopicAliasMax = 0;
 
 	header.byte = aws_iot_mqtt_internal_read_char(&curdata);
 	if(CONNACK != MQTT_HEADER_FIELD_TYPE(header.byte)) {
@@ -291,33 +325,65 @@ static IoT_Error_t _aws_iot_mqtt_deserialize_connack(unsigned char *pSessionPres
 		FUNC_EXIT_RC(rc);
 	}
 
-	/* CONNACK remaining length should always be 2 as per MQTT 3.1.1 spec */
+	/* CONNACK remaining length is always 2 as per MQTT 3.1.1 spec. MQTT 5 adds properties,
+	 * a broker refusing MQTT 5 may still answer in the 3.1.1 format */
 	curdata += (readBytesLen);
 	enddata = curdata + decodedLen;
-	if(2 != (enddata - curdata)) {
+	if(2 > (enddata - curdata) || rxBufLen < (size_t) (enddata - pRxBuf)) {
 		FUNC_EXIT_RC(MQTT_DECODE_REMAINING_LENGTH_ERROR);
 	}
 
 	flags.all = aws_iot_mqtt_internal_read_char(&curdata);
 	*pSessionPresent = flags.bits.sessionpresent;
 	connack_rc_char = aws_iot_mqtt_internal_read_char(&curdata);
+
+	if(curdata == enddata) {
+		switch(connack_rc_char) {
+			case CONNACK_CONNECTION_ACCEPTED:
+				*pConnackRc = MQTT_CONNACK_CONNECTION_ACCEPTED;
+				break;
+			case CONNACK_UNACCEPTABLE_PROTOCOL_VERSION_ERROR:
+				*pConnackRc = MQTT_CONNACK_UNACCEPTABLE_PROTOCOL_VERSION_ERROR;
+				break;
+			case CONNACK_IDENTIFIER_REJECTED_ERROR:
+				*pConnackRc = MQTT_CONNACK_IDENTIFIER_REJECTED_ERROR;
+				break;
+			case CONNACK_SERVER_UNAVAILABLE_ERROR:
+				*pConnackRc = MQTT_CONNACK_SERVER_UNAVAILABLE_ERROR;
+				break;
+			case CONNACK_BAD_USERDATA_ERROR:
+				*pConnackRc = MQTT_CONNACK_BAD_USERDATA_ERROR;
+				break;
+			case CONNACK_NOT_AUTHORIZED_ERROR:
+				*pConnackRc = MQTT_CONNACK_NOT_AUTHORIZED_ERROR;
+				break;
+			default:
+				*pConnackRc = MQTT_CONNACK_UNKNOWN_ERROR;
+				break;
+		}
+		FUNC_EXIT_RC(SUCCESS);
+	}
+
 	switch(connack_rc_char) {
-		case CONNACK_CONNECTION_ACCEPTED:
+		case 0x00:
 			*pConnackRc = MQTT_CONNACK_CONNECTION_ACCEPTED;
 			break;
-		case CONNACK_UNACCEPTABLE_PROTOCOL_VERSION_ERROR:
+		case 0x84: /* Unsupported Protocol Version */
 			*pConnackRc = MQTT_CONNACK_UNACCEPTABLE_PROTOCOL_VERSION_ERROR;
 			break;
-		case CONNACK_IDENTIFIER_REJECTED_ERROR:
+		case 0x85: /* Client Identifier not valid */
 			*pConnackRc = MQTT_CONNACK_IDENTIFIER_REJECTED_ERROR;
 			break;
-		case CONNACK_SERVER_UNAVAILABLE_ERROR:
+		case 0x88: /* Server unavailable */
+		case 0x89: /* Server busy */
+		case 0x9F: /* Connection rate exceeded */
 			*pConnackRc = MQTT_CONNACK_SERVER_UNAVAILABLE_ERROR;
 			break;
-		case CONNACK_BAD_USERDATA_ERROR:
+		case 0x86: /* Bad User Name or Password */
 			*pConnackRc = MQTT_CONNACK_BAD_USERDATA_ERROR;
 			break;
-		case CONNACK_NOT_AUTHORIZED_ERROR:
+		case 0x87: /* Not authorized */
+		case 0x8A: /* Banned */
 			*pConnackRc = MQTT_CONNACK_NOT_AUTHORIZED_ERROR;
 			break;
 		default:
@@ -325,7 +391,17 @@ static IoT_Error_t _aws_iot_mqtt_deserialize_connack(unsigned char *pSessionPres
 			break;
 	}
 
-	FUNC_EXIT_RC(SUCCESS);
+	rc = aws_iot_mqtt_internal_read_properties_length(&curdata, enddata, &enddata);
+	while(SUCCESS == rc && curdata < enddata) {
+		rc = aws_iot_mqtt_internal_read_property(&curdata, enddata, &propertyId, &value);
+		if(MQTT_PROPERTY_TOPIC_ALIAS_MAXIMUM == propertyId) {
+			*pTopicAliasMax = (uint16_t) value;
+		} else if(MQTT_PROPERTY_SERVER_KEEP_ALIVE == propertyId) {
+			*pServerKeepAlive = (uint16_t) value;
+		}
+	}
+
+	FUNC_EXIT_RC(rc);
 }
 
 /**
@@ -369,6 +445,88 @@ static bool _aws_iot_mqtt_is_client_state_valid_for_connect(ClientState clientSt
 	return isValid;
 }
 
+/**
+ * @brief Send the CONNECT packet
+ *
+ * Called once the network connection is up. Resets the state that does not outlive a connection.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTimer Timer bounding the write
+ *
+ * @return An IoT Error Type defining successful/failed send
+ */
+static IoT_Error_t _aws_iot_mqtt_send_connect(AWS_IoT_Client *pClient, Timer *pTimer) {
+	size_t len = 0;
+	IoT_Error_t rc = FAILURE;
+	IoT_Error_t threadRc;
+
+	FUNC_ENTRY;
+
+	pClient->clientData.keepAliveInterval = pClient->clientData.options.keepAliveIntervalInSec;
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	/* Topic aliases do not outlive the connection */
+	pClient->clientData.topicAliasMax = 0;
+	pClient->clientData.nextTopicAlias = 0;
+	memset(pClient->clientData.outboundTopicAliases, 0, sizeof(pClient->clientData.outboundTopicAliases));
+	memset(pClient->clientData.inboundTopicAliases, 0, sizeof(pClient->clientData.inboundTopicAliases));
+
+	rc = _aws_iot_mqtt_serialize_connect(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
+										 &(pClient->clientData.options), &len);
+	if(SUCCESS == rc && 0 < len) {
+		/* send the connect packet */
+		rc = aws_iot_mqtt_internal_send_packet(pClient, len, pTimer);
+	}
+
+	threadRc = aws_iot_mqtt_internal_unlock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	FUNC_EXIT_RC(threadRc);
+}
+
+/**
+ * @brief Handle the CONNACK held in the read buffer
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return SUCCESS if the broker accepted the connection, the refusal or decoding error otherwise
+ */
+static IoT_Error_t _aws_iot_mqtt_handle_connack(AWS_IoT_Client *pClient) {
+	IoT_Error_t connack_rc = FAILURE;
+	char sessionPresent = 0;
+	uint16_t topicAliasMax = 0;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	/* Received CONNACK, check the return code */
+	rc = _aws_iot_mqtt_deserialize_connack((unsigned char *) &sessionPresent, &connack_rc, &topicAliasMax,
+										   &(pClient->clientData.keepAliveInterval), pClient->clientData.readBuf,
+										   pClient->clientData.readBufSize);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	if(MQTT_CONNACK_CONNECTION_ACCEPTED != connack_rc) {
+		FUNC_EXIT_RC(connack_rc);
+	}
+
+	/* Nothing is published before the client state leaves CONNECTING */
+	pClient->clientData.topicAliasMax = (topicAliasMax < AWS_IOT_MQTT_TOPIC_ALIAS_MAX) ? topicAliasMax :
+										AWS_IOT_MQTT_TOPIC_ALIAS_MAX;
+
+	/* A clean session is never resumed, whatever the broker reports */
+	pClient->clientStatus.isSessionPresent = (0 != sessionPresent && !pClient->clientData.options.isCleanSession);
+	aws_iot_mqtt_internal_start_keepalive(pClient);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
 /**
  * @brief MQTT Connection Function
  *
@@ -383,9 +541,6 @@ static bool _aws_iot_mqtt_is_client_state_valid_for_connect(ClientState clientSt
  */
 static IoT_Error_t _aws_iot_mqtt_internal_connect(AWS_IoT_Client *pClient, IoT_Client_Connect_Params *pConnectParams) {
 	Timer connect_timer;
-	IoT_Error_t connack_rc = FAILURE;
-	char sessionPresent = 0;
-	size_t len = 0;
 	IoT_Error_t rc = FAILURE;
 
 	FUNC_ENTRY;
@@ -407,15 +562,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_connect(AWS_IoT_Client *pClient, IoT_C
 	init_timer(&connect_timer);
 	countdown_ms(&connect_timer, pClient->clientData.commandTimeoutMs);
 
-	pClient->clientData.keepAliveInterval = pClient->clientData.options.keepAliveIntervalInSec;
-	rc = _aws_iot_mqtt_serialize_connect(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
-										 &(pClient->clientData.options), &len);
-	if(SUCCESS != rc || 0 >= len) {
-		FUNC_EXIT_RC(rc);
-	}
-
-	/* send the connect packet */
-	rc = aws_iot_mqtt_internal_send_packet(pClient, len, &connect_timer);
+	rc = _aws_iot_mqtt_send_connect(pClient, &connect_timer);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
@@ -426,21 +573,34 @@ static IoT_Error_t _aws_iot_mqtt_internal_connect(AWS_IoT_Client *pClient, IoT_C
 		FUNC_EXIT_RC(rc);
 	}
 
-	/* Received CONNACK, check the return code */
-	rc = _aws_iot_mqtt_deserialize_connack((unsigned char *) &sessionPresent, &connack_rc, pClient->clientData.readBuf,
-										   pClient->clientData.readBufSize);
-	if(SUCCESS != rc) {
-		FUNC_EXIT_RC(rc);
-	}
+	FUNC_EXIT_RC(_aws_iot_mqtt_handle_connack(pClient));
+}
 
-	if(MQTT_CONNACK_CONNECTION_ACCEPTED != connack_rc) {
-		FUNC_EXIT_RC(connack_rc);
-	}
+/**
+ * @brief Leave the CONNECTING state
+ *
+ * Called with the result of a connect, closes the network connection of a failed one
+ *
+ * @param pClient Reference to the IoT Client
+ * @param rc Result of the connect
+ *
+ * @return rc, or NETWORK_DISCONNECTED_ERROR if the network stack could not be cleaned
+ */
+static IoT_Error_t _aws_iot_mqtt_finish_connect(AWS_IoT_Client *pClient, IoT_Error_t rc) {
+	IoT_Error_t disconRc;
 
-	pClient->clientStatus.isPingOutstanding = false;
-	countdown_sec(&pClient->pingTimer, pClient->clientData.keepAliveInterval);
+	if(SUCCESS != rc) {
+		pClient->networkStack.disconnect(&(pClient->networkStack));
+		disconRc = pClient->networkStack.destroy(&(pClient->networkStack));
+		if (SUCCESS != disconRc) {
+			return NETWORK_DISCONNECTED_ERROR;
+		}
+		aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTING, CLIENT_STATE_DISCONNECTED_ERROR);
+	} else {
+		aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTING, CLIENT_STATE_CONNECTED_IDLE);
+	}
 
-	FUNC_EXIT_RC(SUCCESS);
+	return rc;
 }
 
 /**
@@ -456,7 +616,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_connect(AWS_IoT_Client *pClient, IoT_C
  * @return An IoT Error Type defining successful/failed connection
  */
 IoT_Error_t aws_iot_mqtt_connect(AWS_IoT_Client *pClient, IoT_Client_Connect_Params *pConnectParams) {
-	IoT_Error_t rc, disconRc;
+	IoT_Error_t rc;
 	ClientState clientState;
 	FUNC_ENTRY;
 
@@ -476,20 +636,131 @@ IoT_Error_t aws_iot_mqtt_connect(AWS_IoT_Client *pClient, IoT_Client_Connect_Par
 
 	rc = _aws_iot_mqtt_internal_connect(pClient, pConnectParams);
 
+	FUNC_EXIT_RC(_aws_iot_mqtt_finish_connect(pClient, rc));
+}
+
+/* Ends an asynchronous connect and passes its result to the completion handler */
+static IoT_Error_t _aws_iot_mqtt_complete_connect_async(AWS_IoT_Client *pClient, IoT_Error_t rc) {
+	pConnectCompleteHandler_t pCompleteHandler = pClient->clientData.connectCompleteHandler;
+	void *pCompleteHandlerData = pClient->clientData.connectCompleteHandlerData;
+
+	pClient->clientData.isConnectAsync = false;
+	pClient->clientData.isConnackPending = false;
+	pClient->clientData.connectCompleteHandler = NULL;
+	pClient->clientData.connectCompleteHandlerData = NULL;
+
+	rc = _aws_iot_mqtt_finish_connect(pClient, rc);
+	if(NULL != pCompleteHandler) {
+		pCompleteHandler(pClient, rc, pCompleteHandlerData);
+	}
+
+	return rc;
+}
+
+IoT_Error_t aws_iot_mqtt_connect_async(AWS_IoT_Client *pClient, IoT_Client_Connect_Params *pConnectParams,
+									   pConnectCompleteHandler_t pCompleteHandler, void *pCompleteHandlerData) {
+	IoT_Error_t rc;
+	ClientState clientState;
+	FUNC_ENTRY;
+
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(NULL == pClient->networkStack.connectStart || NULL == pClient->networkStack.connectContinue) {
+		rc = aws_iot_mqtt_connect(pClient, pConnectParams);
+		if(NULL != pCompleteHandler) {
+			pCompleteHandler(pClient, rc, pCompleteHandlerData);
+		}
+		FUNC_EXIT_RC(rc);
+	}
+
+	aws_iot_mqtt_internal_flushBuffers(pClient);
+	clientState = aws_iot_mqtt_get_client_state(pClient);
+
+	if(false == _aws_iot_mqtt_is_client_state_valid_for_connect(clientState)) {
+		FUNC_EXIT_RC(NETWORK_ALREADY_CONNECTED_ERROR);
+	}
+
+	rc = aws_iot_mqtt_set_client_state(pClient, clientState, CLIENT_STATE_CONNECTING);
 	if(SUCCESS != rc) {
-		pClient->networkStack.disconnect(&(pClient->networkStack));
-		disconRc = pClient->networkStack.destroy(&(pClient->networkStack));
-		if (SUCCESS != disconRc) {
-			FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
+		FUNC_EXIT_RC(rc);
+	}
+
+	pClient->clientData.isConnectAsync = true;
+	pClient->clientData.isConnackPending = false;
+	pClient->clientData.connectCompleteHandler = pCompleteHandler;
+	pClient->clientData.connectCompleteHandlerData = pCompleteHandlerData;
+
+	if(NULL != pConnectParams) {
+		/* override default options if new options were supplied */
+		rc = aws_iot_mqtt_set_connect_params(pClient, pConnectParams);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(_aws_iot_mqtt_complete_connect_async(pClient, MQTT_CONNECTION_ERROR));
 		}
-		aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTING, CLIENT_STATE_DISCONNECTED_ERROR);
-	} else {
-		aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTING, CLIENT_STATE_CONNECTED_IDLE);
+	}
+
+	/* The network layer times the handshake out too, this timer only wakes the caller up for it */
+	init_timer(&(pClient->connectTimer));
+	countdown_ms(&(pClient->connectTimer), pClient->networkStack.tlsConnectParams.timeout_ms);
+
+	rc = pClient->networkStack.connectStart(&(pClient->networkStack), NULL);
+	if(NETWORK_CONNECT_WANT_WRITE != rc && NETWORK_CONNECT_WANT_READ != rc) {
+		rc = _aws_iot_mqtt_complete_connect_async(pClient, rc);
 	}
 
 	FUNC_EXIT_RC(rc);
 }
 
+IoT_Error_t aws_iot_mqtt_connect_continue(AWS_IoT_Client *pClient) {
+	Timer readTimer;
+	uint8_t packetType = 0;
+	IoT_Error_t rc;
+	FUNC_ENTRY;
+
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(!pClient->clientData.isConnectAsync) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	if(!pClient->clientData.isConnackPending) {
+		rc = pClient->networkStack.connectContinue(&(pClient->networkStack));
+		if(NETWORK_CONNECT_WANT_WRITE == rc || NETWORK_CONNECT_WANT_READ == rc) {
+			FUNC_EXIT_RC(rc);
+		} else if(SUCCESS != rc) {
+			FUNC_EXIT_RC(_aws_iot_mqtt_complete_connect_async(pClient, rc));
+		}
+
+		/* The socket blocks again, the CONNECT fits in its send buffer */
+		countdown_ms(&(pClient->connectTimer), pClient->clientData.commandTimeoutMs);
+		rc = _aws_iot_mqtt_send_connect(pClient, &(pClient->connectTimer));
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(_aws_iot_mqtt_complete_connect_async(pClient, rc));
+		}
+		pClient->clientData.isConnackPending = true;
+	}
+
+	/* An expired timer returns at once when the CONNACK has not arrived yet */
+	init_timer(&readTimer);
+	countdown_ms(&readTimer, 0);
+	rc = aws_iot_mqtt_internal_cycle_read(pClient, &readTimer, &packetType);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(_aws_iot_mqtt_complete_connect_async(pClient, rc));
+	}
+
+	if(CONNACK != packetType) {
+		if(has_timer_expired(&(pClient->connectTimer))) {
+			FUNC_EXIT_RC(_aws_iot_mqtt_complete_connect_async(pClient, MQTT_REQUEST_TIMEOUT_ERROR));
+		}
+		FUNC_EXIT_RC(NETWORK_CONNECT_WANT_READ);
+	}
+
+	FUNC_EXIT_RC(_aws_iot_mqtt_complete_connect_async(pClient, _aws_iot_mqtt_handle_connack(pClient)));
+}
+
 /**
  * @brief Disconnect an MQTT Connection
  *
@@ -509,10 +780,17 @@ IoT_Error_t _aws_iot_mqtt_internal_disconnect(AWS_IoT_Client *pClient) {
 
 	FUNC_ENTRY;
 
+	/* Held until the network stack is gone so no publish writes to a closed connection */
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
 	rc = aws_iot_mqtt_internal_serialize_zero(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
 											  DISCONNECT,
 											  &serialized_len);
 	if(SUCCESS != rc) {
+		(void)aws_iot_mqtt_internal_unlock_write(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
@@ -527,6 +805,7 @@ IoT_Error_t _aws_iot_mqtt_internal_disconnect(AWS_IoT_Client *pClient) {
 	/* Clean network stack */
 	pClient->networkStack.disconnect(&(pClient->networkStack));
 	rc = pClient->networkStack.destroy(&(pClient->networkStack));
+	(void)aws_iot_mqtt_internal_unlock_write(pClient);
 	if(0 != rc) {
 		/* TLS Destroy failed, return error */
 		FUNC_EXIT_RC(FAILURE);
@@ -570,10 +849,10 @@ IoT_Error_t aws_iot_mqtt_disconnect(AWS_IoT_Client *pClient) {
 	rc = _aws_iot_mqtt_internal_disconnect(pClient);
 
 	if(SUCCESS != rc) {
-		pClient->clientStatus.clientState = clientState;
+		aws_iot_mqtt_internal_force_client_state(pClient, clientState);
 	} else {
 		/* If called from Keepalive, this gets set to CLIENT_STATE_DISCONNECTED_ERROR */
-		pClient->clientStatus.clientState = CLIENT_STATE_DISCONNECTED_MANUALLY;
+		aws_iot_mqtt_internal_force_client_state(pClient, CLIENT_STATE_DISCONNECTED_MANUALLY);
 	}
 
 	FUNC_EXIT_RC(rc);
@@ -614,7 +893,15 @@ IoT_Error_t aws_iot_mqtt_attempt_reconnect(AWS_IoT_Client *pClient) {
 		FUNC_EXIT_RC(NETWORK_ATTEMPTING_RECONNECT);
 	}
 
-	rc = aws_iot_mqtt_resubscribe(pClient);
+	/* A resumed session still holds the subscriptions, skip the SUBSCRIBE round trips */
+	if(!pClient->clientStatus.isSessionPresent) {
+		rc = aws_iot_mqtt_resubscribe(pClient);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+	}
+
+	rc = aws_iot_mqtt_internal_restart_inflight_publishes(pClient);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
@@ -42,6 +42,10 @@ extern "C" {
 
 #include "sdk/aws_iot_mqtt_client_common_internal.h"
 
+#ifdef _ENABLE_THREAD_SUPPORT_
+#include "threads_interface.h"
+#endif
+
 /**
  * @param stringVar pointer to the String into which the data is to be read
  * @param stringLen pointer to variable which has the length of the string
@@ -68,47 +72,66 @@ static IoT_Error_t _aws_iot_mqtt_read_string_with_len(char **stringVar, uint16_t
 	FUNC_EXIT_RC(rc);
 }
 
+/* Largest remaining length the MQTT variable length encoding can carry */
+#define MQTT_MAX_REMAINING_LENGTH 268435455
+
 /**
-  * Serializes the supplied publish data into the supplied buffer, ready for sending
-  * @param pTxBuf the buffer into which the packet will be serialized
+  * Serializes the fixed header, topic and packet identifier of a publish into the supplied buffer.
+  * The payload is not copied, it is sent as a second segment after the header.
+  * MQTT 5 headers also carry the property list, holding the topic alias if there is one.
+  * @param pTxBuf the buffer into which the header will be serialized
   * @param txBufLen the length in bytes of the supplied buffer
+  * @param version MQTT_Ver_t - the MQTT version of the connection
   * @param dup uint8_t - the MQTT dup flag
   * @param qos QoS - the MQTT QoS value
   * @param retained uint8_t - the MQTT retained flag
   * @param packetId uint16_t - the MQTT packet identifier
   * @param pTopicName char * - the MQTT topic in the publish
-  * @param topicNameLen uint16_t - the length of the Topic Name
-  * @param pPayload byte buffer - the MQTT publish payload
+  * @param topicNameLen uint16_t - the length of the Topic Name, 0 to send the topic as its alias only
+  * @param topicAlias uint16_t - the MQTT 5 topic alias, 0 for none
   * @param payloadLen size_t - the length of the MQTT payload
-  * @param pSerializedLen uint32_t - pointer to the variable that stores serialized len
+  * @param pSerializedLen uint32_t - pointer to the variable that stores serialized header len
   *
   * @return An IoT Error Type defining successful/failed call
   */
-static IoT_Error_t _aws_iot_mqtt_internal_serialize_publish(unsigned char *pTxBuf, size_t txBufLen, uint8_t dup,
-															QoS qos, uint8_t retained, uint16_t packetId,
-															const char *pTopicName, uint16_t topicNameLen,
-															const unsigned char *pPayload, size_t payloadLen,
-															uint32_t *pSerializedLen) {
+IoT_Error_t aws_iot_mqtt_internal_serialize_publish_header(unsigned char *pTxBuf, size_t txBufLen,
+														   MQTT_Ver_t version, uint8_t dup, QoS qos,
+														   uint8_t retained, uint16_t packetId,
+														   const char *pTopicName, uint16_t topicNameLen,
+														   uint16_t topicAlias, size_t payloadLen,
+														   uint32_t *pSerializedLen) {
 	unsigned char *ptr;
-	uint32_t rem_len;
+	uint32_t rem_len, header_len, properties_len;
 	IoT_Error_t rc;
 	MQTTHeader header = {0};
 
 	FUNC_ENTRY;
-	if(NULL == pTxBuf || NULL == pPayload || NULL == pSerializedLen) {
+	if(NULL == pTxBuf || NULL == pSerializedLen) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
 	ptr = pTxBuf;
-	rem_len = 0;
-
-	rem_len += (uint32_t) (topicNameLen + payloadLen + 2);
+	rem_len = (uint32_t) (topicNameLen + 2);
 	if(qos > 0) {
 		rem_len += 2; /* packetId */
 	}
-	if(aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(rem_len) > txBufLen) {
+
+	properties_len = (0 != topicAlias) ? 3 : 0; /* identifier + two byte alias */
+	if(MQTT_5 == version) {
+		rem_len += 1 + properties_len; /* property length fits in one byte */
+	}
+
+	if(payloadLen > (MQTT_MAX_REMAINING_LENGTH - rem_len)) {
+		FUNC_EXIT_RC(MAX_SIZE_ERROR);
+	}
+
+	/* Fixed header and variable header must fit, the payload stays in the caller's buffer */
+	header_len = aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(rem_len + (uint32_t) payloadLen)
+				 - (uint32_t) payloadLen;
+	if(header_len > txBufLen) {
 		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
 	}
+	rem_len += (uint32_t) payloadLen;
 
 	rc = aws_iot_mqtt_internal_init_header(&header, PUBLISH, qos, dup, retained);
 	if(SUCCESS != rc) {
@@ -124,14 +147,110 @@ static IoT_Error_t _aws_iot_mqtt_internal_serialize_publish(unsigned char *pTxBu
 		aws_iot_mqtt_internal_write_uint_16(&ptr, packetId);
 	}
 
-	memcpy(ptr, pPayload, payloadLen);
-	ptr += payloadLen;
+	if(MQTT_5 == version) {
+		ptr += aws_iot_mqtt_internal_write_len_to_buffer(ptr, properties_len);
+		if(0 != topicAlias) {
+			aws_iot_mqtt_internal_write_char(&ptr, MQTT_PROPERTY_TOPIC_ALIAS);
+			aws_iot_mqtt_internal_write_uint_16(&ptr, topicAlias);
+		}
+	}
 
 	*pSerializedLen = (uint32_t) (ptr - pTxBuf);
 
 	FUNC_EXIT_RC(SUCCESS);
 }
 
+/**
+ * @brief Pick the MQTT 5 topic alias of an outbound publish
+ *
+ * Topics already holding an alias are sent as the alias alone. Other topics take
+ * the next entry of the outbound table, they are sent in full along with the alias
+ * so the broker learns it. Once all entries are used they are reassigned in turn.
+ * The caller holds the write lock.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic Name to publish to
+ * @param topicNameLen Length of the topic name
+ * @param pIsNewAlias Set when the alias was assigned by this call
+ *
+ * @return Topic alias, 0 when the topic has to be sent without one
+ */
+static uint16_t _aws_iot_mqtt_internal_get_topic_alias(AWS_IoT_Client *pClient, const char *pTopicName,
+													   uint16_t topicNameLen, bool *pIsNewAlias) {
+	TopicAlias *pAlias;
+	uint16_t itr;
+
+	*pIsNewAlias = false;
+	if(MQTT_5 != pClient->clientData.options.MQTTVersion || 0 == pClient->clientData.topicAliasMax ||
+	   AWS_IOT_MQTT_TOPIC_ALIAS_LEN < topicNameLen) {
+		return 0;
+	}
+
+	for(itr = 0; itr < pClient->clientData.topicAliasMax; itr++) {
+		pAlias = &(pClient->clientData.outboundTopicAliases[itr]);
+		if(topicNameLen == pAlias->topicNameLen && 0 == memcmp(pAlias->topicName, pTopicName, topicNameLen)) {
+			return (uint16_t) (itr + 1);
+		}
+	}
+
+	itr = pClient->clientData.nextTopicAlias;
+	pClient->clientData.nextTopicAlias = (uint16_t) ((itr + 1) % pClient->clientData.topicAliasMax);
+	pAlias = &(pClient->clientData.outboundTopicAliases[itr]);
+	memcpy(pAlias->topicName, pTopicName, topicNameLen);
+	pAlias->topicNameLen = topicNameLen;
+	*pIsNewAlias = true;
+
+	return (uint16_t) (itr + 1);
+}
+
+/**
+ * @brief Serialize and send a publish packet
+ *
+ * Payloads that fit in the write buffer behind the header are copied there and sent
+ * in one write. Larger payloads are written from the caller's buffer after the header,
+ * so their size is only limited by the MQTT remaining length.
+ * The caller holds the write lock.
+ *
+ * @return An IoT Error Type defining successful/failed send
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_send_publish(AWS_IoT_Client *pClient, uint8_t dup, QoS qos,
+													   uint8_t retained, uint16_t packetId, const char *pTopicName,
+													   uint16_t topicNameLen, const unsigned char *pPayload,
+													   size_t payloadLen, Timer *pTimer) {
+	uint32_t len = 0;
+	uint16_t topicAlias;
+	bool isNewAlias;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+	if(NULL == pPayload) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	topicAlias = _aws_iot_mqtt_internal_get_topic_alias(pClient, pTopicName, topicNameLen, &isNewAlias);
+	rc = aws_iot_mqtt_internal_serialize_publish_header(pClient->clientData.writeBuf,
+														pClient->clientData.writeBufSize,
+														pClient->clientData.options.MQTTVersion, dup, qos,
+														retained, packetId, pTopicName,
+														(0 == topicAlias || isNewAlias) ? topicNameLen : 0,
+														topicAlias, payloadLen, &len);
+	if(SUCCESS == rc) {
+		if(payloadLen < (pClient->clientData.writeBufSize - len)) {
+			memcpy(pClient->clientData.writeBuf + len, pPayload, payloadLen);
+			rc = aws_iot_mqtt_internal_send_packet(pClient, len + payloadLen, pTimer);
+		} else {
+			rc = aws_iot_mqtt_internal_send_packet_with_payload(pClient, len, pPayload, payloadLen, pTimer);
+		}
+	}
+
+	if(SUCCESS != rc && isNewAlias) {
+		/* The broker may not have seen the topic, it can not be sent as the alias alone */
+		pClient->clientData.outboundTopicAliases[topicAlias - 1].topicNameLen = 0;
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
 /**
   * Serializes the ack packet into the supplied buffer.
   * @param pTxBuf the buffer into which the packet will be serialized
@@ -177,6 +296,160 @@ IoT_Error_t aws_iot_mqtt_internal_serialize_ack(unsigned char *pTxBuf, size_t tx
 	FUNC_EXIT_RC(SUCCESS);
 }
 
+/* Shaper tokens are thousandths of a message or a byte, a bucket refills by its rate every millisecond */
+#define SHAPER_TOKEN_SCALE 1000
+
+/**
+ * @brief Fill both buckets of the publish shaper and restart the refill clock
+ *
+ * Called when the limits change. The caller holds the write lock or the client is not connected.
+ *
+ * @param pClient Reference to the IoT Client
+ */
+void aws_iot_mqtt_internal_shaper_reset(AWS_IoT_Client *pClient) {
+	PublishShaper *pShaper = &(pClient->clientData.shaper);
+
+	pShaper->messageTokens = (uint64_t) pShaper->messageRate * AWS_IOT_MQTT_PUBLISH_BURST_MS;
+	pShaper->byteTokens = (uint64_t) pShaper->byteRate * AWS_IOT_MQTT_PUBLISH_BURST_MS;
+	pShaper->lastRefillMs = get_time_ms();
+}
+
+PublishPriority aws_iot_mqtt_internal_get_publish_priority(AWS_IoT_Client *pClient, const char *pTopicName,
+														   uint16_t topicNameLen) {
+	const PublishPriorityRule *pRule;
+	uint32_t itr;
+
+	for(itr = 0; itr < pClient->clientData.shaper.ruleCount; itr++) {
+		pRule = &(pClient->clientData.shaper.pRules[itr]);
+		if(pRule->topicPrefixLen <= topicNameLen &&
+		   0 == strncmp(pTopicName, pRule->pTopicPrefix, pRule->topicPrefixLen)) {
+			return pRule->priority;
+		}
+	}
+
+	return PUBLISH_PRIORITY_NORMAL;
+}
+
+/* Checks that the bucket keeps the reserve of the class once the cost is taken out */
+static bool _aws_iot_mqtt_shaper_has_tokens(uint64_t tokens, uint32_t rate, PublishPriority priority,
+											uint64_t *pCost) {
+	uint64_t capacity, reserve;
+
+	if(0 == rate) {
+		return true;
+	}
+
+	capacity = (uint64_t) rate * AWS_IOT_MQTT_PUBLISH_BURST_MS;
+	reserve = capacity / 4 * (uint64_t) priority;
+
+	/* Publishes larger than the bucket pass once it holds all the class can use */
+	if(*pCost > capacity - reserve) {
+		*pCost = capacity - reserve;
+	}
+
+	return tokens >= reserve + *pCost;
+}
+
+/* Time until the bucket holds the tokens checked by _aws_iot_mqtt_shaper_has_tokens */
+static uint32_t _aws_iot_mqtt_shaper_wait_ms(uint64_t tokens, uint32_t rate, PublishPriority priority, uint64_t cost) {
+	uint64_t capacity, reserve;
+
+	if(0 == rate) {
+		return 0;
+	}
+
+	capacity = (uint64_t) rate * AWS_IOT_MQTT_PUBLISH_BURST_MS;
+	reserve = capacity / 4 * (uint64_t) priority;
+	if(cost > capacity - reserve) {
+		cost = capacity - reserve;
+	}
+	if(tokens >= reserve + cost) {
+		return 0;
+	}
+
+	return (uint32_t) ((reserve + cost - tokens + rate - 1) / rate);
+}
+
+/**
+ * @brief Take the tokens of a publish from the shaper
+ *
+ * Both buckets are refilled for the time elapsed since the last call, then the publish
+ * takes one message token and one byte token per byte of the packet if that leaves the
+ * reserve of its class in both buckets. The caller holds the write lock.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param priority Class of the publish
+ * @param packetLen Length of the serialized PUBLISH packet
+ *
+ * @return SUCCESS if the publish can be sent, MQTT_PUBLISH_THROTTLED_ERROR otherwise
+ */
+IoT_Error_t aws_iot_mqtt_internal_shape_publish(AWS_IoT_Client *pClient, PublishPriority priority,
+												uint32_t packetLen) {
+	PublishShaper *pShaper = &(pClient->clientData.shaper);
+	PublishShaperStats *pCounters = &(pClient->clientData.shaperStats);
+	uint64_t messageCost, byteCost;
+	uint32_t now, elapsed, messageWaitMs, byteWaitMs;
+	IoT_Error_t rc;
+
+	if(0 == pShaper->messageRate && 0 == pShaper->byteRate) {
+		__atomic_store_n(&(pCounters->passed[priority]), pCounters->passed[priority] + 1, __ATOMIC_RELAXED);
+		return SUCCESS;
+	}
+
+	now = get_time_ms();
+	elapsed = now - pShaper->lastRefillMs;
+	if(AWS_IOT_MQTT_PUBLISH_BURST_MS < elapsed) {
+		elapsed = AWS_IOT_MQTT_PUBLISH_BURST_MS;
+	}
+	pShaper->lastRefillMs = now;
+
+	pShaper->messageTokens += (uint64_t) elapsed * pShaper->messageRate;
+	if(pShaper->messageTokens > (uint64_t) pShaper->messageRate * AWS_IOT_MQTT_PUBLISH_BURST_MS) {
+		pShaper->messageTokens = (uint64_t) pShaper->messageRate * AWS_IOT_MQTT_PUBLISH_BURST_MS;
+	}
+	pShaper->byteTokens += (uint64_t) elapsed * pShaper->byteRate;
+	if(pShaper->byteTokens > (uint64_t) pShaper->byteRate * AWS_IOT_MQTT_PUBLISH_BURST_MS) {
+		pShaper->byteTokens = (uint64_t) pShaper->byteRate * AWS_IOT_MQTT_PUBLISH_BURST_MS;
+	}
+
+	messageCost = SHAPER_TOKEN_SCALE;
+	byteCost = (uint64_t) packetLen * SHAPER_TOKEN_SCALE;
+	if(_aws_iot_mqtt_shaper_has_tokens(pShaper->messageTokens, pShaper->messageRate, priority, &messageCost) &&
+	   _aws_iot_mqtt_shaper_has_tokens(pShaper->byteTokens, pShaper->byteRate, priority, &byteCost)) {
+		if(0 != pShaper->messageRate) {
+			pShaper->messageTokens -= messageCost;
+		}
+		if(0 != pShaper->byteRate) {
+			pShaper->byteTokens -= byteCost;
+		}
+		__atomic_store_n(&(pCounters->passed[priority]), pCounters->passed[priority] + 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&(pCounters->retryAfterMs), 0, __ATOMIC_RELAXED);
+		rc = SUCCESS;
+	} else {
+		__atomic_store_n(&(pCounters->deferred[priority]), pCounters->deferred[priority] + 1, __ATOMIC_RELAXED);
+		messageWaitMs = _aws_iot_mqtt_shaper_wait_ms(pShaper->messageTokens, pShaper->messageRate, priority,
+													 SHAPER_TOKEN_SCALE);
+		byteWaitMs = _aws_iot_mqtt_shaper_wait_ms(pShaper->byteTokens, pShaper->byteRate, priority,
+												  (uint64_t) packetLen * SHAPER_TOKEN_SCALE);
+		__atomic_store_n(&(pCounters->retryAfterMs), (messageWaitMs > byteWaitMs) ? messageWaitMs : byteWaitMs,
+						 __ATOMIC_RELAXED);
+		rc = MQTT_PUBLISH_THROTTLED_ERROR;
+	}
+
+	__atomic_store_n(&(pCounters->messageTokens), (uint32_t) (pShaper->messageTokens / SHAPER_TOKEN_SCALE),
+					 __ATOMIC_RELAXED);
+	__atomic_store_n(&(pCounters->byteTokens), (uint32_t) (pShaper->byteTokens / SHAPER_TOKEN_SCALE),
+					 __ATOMIC_RELAXED);
+
+	return rc;
+}
+
+/* Length of the PUBLISH packet charged to the shaper, topic aliases are not taken into account */
+static uint32_t _aws_iot_mqtt_shaped_publish_len(const IoT_Publish_Message_Params *pParams, uint16_t topicNameLen) {
+	return aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(
+			(uint32_t) (2 + topicNameLen + ((QOS1 == pParams->qos) ? 2 : 0) + pParams->payloadLen));
+}
+
 /**
  * @brief Publish an MQTT message on a topic
  *
@@ -184,6 +457,7 @@ IoT_Error_t aws_iot_mqtt_internal_serialize_ack(unsigned char *pTxBuf, size_t tx
  * @note Call is blocking.  In the case of a QoS 0 message the function returns
  * after the message was successfully passed to the TLS layer.  In the case of QoS 1
  * the function returns after the receipt of the PUBACK control packet.
+ * A publish held back by the shaper waits for it within the command timeout.
  * This is the internal function which is called by the publish API to perform the operation.
  * Not meant to be called directly as it doesn't do validations or client state changes
  *
@@ -197,10 +471,11 @@ IoT_Error_t aws_iot_mqtt_internal_serialize_ack(unsigned char *pTxBuf, size_t tx
 static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const char *pTopicName,
 												  uint16_t topicNameLen, IoT_Publish_Message_Params *pParams) {
 	Timer timer;
-	uint32_t len = 0;
 	uint16_t packet_id;
 	unsigned char dup, type;
-	IoT_Error_t rc;
+	PublishPriority priority;
+	uint32_t retryAfterMs;
+	IoT_Error_t rc, threadRc;
 
 	FUNC_ENTRY;
 
@@ -211,37 +486,572 @@ static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const
 		pParams->id = aws_iot_mqtt_get_next_packet_id(pClient);
 	}
 
-	rc = _aws_iot_mqtt_internal_serialize_publish(pClient->clientData.writeBuf, pClient->clientData.writeBufSize, 0,
-												  pParams->qos, pParams->isRetained, pParams->id, pTopicName,
-												  topicNameLen, (unsigned char *) pParams->payload,
-												  pParams->payloadLen, &len);
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	/* Wait for the shaper to refill as long as the command timeout allows, with the write lock released */
+	priority = aws_iot_mqtt_internal_get_publish_priority(pClient, pTopicName, topicNameLen);
+	for(;;) {
+		rc = aws_iot_mqtt_internal_shape_publish(pClient, priority,
+												 _aws_iot_mqtt_shaped_publish_len(pParams, topicNameLen));
+		if(MQTT_PUBLISH_THROTTLED_ERROR != rc) {
+			break;
+		}
+		retryAfterMs = __atomic_load_n(&(pClient->clientData.shaperStats.retryAfterMs), __ATOMIC_RELAXED);
+		if(retryAfterMs >= left_ms(&timer)) {
+			break;
+		}
+		rc = aws_iot_mqtt_internal_unlock_write(pClient);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+		sleep_ms((0 < retryAfterMs) ? retryAfterMs : 1);
+		rc = aws_iot_mqtt_internal_lock_write(pClient);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+	}
 	if(SUCCESS != rc) {
+		(void)aws_iot_mqtt_internal_unlock_write(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
 	/* send the publish packet */
-	rc = aws_iot_mqtt_internal_send_packet(pClient, len, &timer);
+	rc = _aws_iot_mqtt_internal_send_publish(pClient, 0, pParams->qos, pParams->isRetained, pParams->id, pTopicName,
+											 topicNameLen, (const unsigned char *) pParams->payload,
+											 pParams->payloadLen, &timer);
+	threadRc = aws_iot_mqtt_internal_unlock_write(pClient);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
+	if(SUCCESS != threadRc) {
+		FUNC_EXIT_RC(threadRc);
+	}
 
-	/* Wait for ack if QoS1 */
+	/* Wait for ack if QoS1. PUBACKs of asynchronous publishes are completed by the read path and skipped here */
 	if(QOS1 == pParams->qos) {
-		rc = aws_iot_mqtt_internal_wait_for_read(pClient, PUBACK, &timer);
+		do {
+			rc = aws_iot_mqtt_internal_wait_for_read(pClient, PUBACK, &timer);
+			if(SUCCESS != rc) {
+				FUNC_EXIT_RC(rc);
+			}
+
+			/* A PUBACK refusing the message still carries its packet id */
+			rc = aws_iot_mqtt_internal_deserialize_ack(&type, &dup, &packet_id, pClient->clientData.readBuf,
+													   pClient->clientData.readBufSize);
+			if(SUCCESS != rc && MQTT_REASON_CODE_ERROR != rc) {
+				FUNC_EXIT_RC(rc);
+			}
+		} while(packet_id != pParams->id);
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
+/* The in-flight table is guarded by the write lock, the caller holds it */
+static InFlightPublish *_aws_iot_mqtt_find_inflight_publish(AWS_IoT_Client *pClient, uint16_t packetId) {
+	uint32_t itr;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; itr++) {
+		if(packetId == pClient->clientData.inFlightPublishes[itr].packetId) {
+			return &(pClient->clientData.inFlightPublishes[itr]);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Serialize and send an in-flight QoS1 publish
+ *
+ * Used for the first transmission and for retransmissions, which set the DUP flag.
+ * Reschedules the retransmission of the entry. The caller holds the write lock.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pInFlight In-flight entry to send
+ * @param dup MQTT dup flag
+ *
+ * @return An IoT Error Type defining successful/failed send
+ */
+static IoT_Error_t _aws_iot_mqtt_send_inflight_publish(AWS_IoT_Client *pClient, InFlightPublish *pInFlight,
+													   uint8_t dup) {
+	Timer timer;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	init_timer(&timer);
+	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
+
+	rc = _aws_iot_mqtt_internal_send_publish(pClient, dup, QOS1, pInFlight->isRetained, pInFlight->packetId,
+											 pInFlight->pTopicName, pInFlight->topicNameLen,
+											 (const unsigned char *) pInFlight->pPayload, pInFlight->payloadLen,
+											 &timer);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	aws_iot_timer_wheel_schedule(&(pClient->clientData.inFlightRetryWheel), &(pInFlight->retryEntry),
+								 AWS_IOT_MQTT_INFLIGHT_RETRY_INTERVAL);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+/* Frees an in-flight entry and hands back its completion handler. The caller holds the write lock */
+static void _aws_iot_mqtt_release_inflight_publish(AWS_IoT_Client *pClient, InFlightPublish *pInFlight,
+												   pPublishCompleteHandler_t *pCompleteHandler,
+												   void **pCompleteHandlerData) {
+	aws_iot_timer_wheel_cancel(&(pClient->clientData.inFlightRetryWheel), &(pInFlight->retryEntry));
+
+	*pCompleteHandler = pInFlight->pCompleteHandler;
+	*pCompleteHandlerData = pInFlight->pCompleteHandlerData;
+
+	pInFlight->packetId = 0;
+	pInFlight->pCompleteHandler = NULL;
+	pInFlight->pCompleteHandlerData = NULL;
+}
+
+/**
+ * @brief Report the result of a released in-flight entry to the application
+ *
+ * Runs without the write lock so the handler can publish again.
+ * Like message callbacks, the handler runs in the WAIT_FOR_CB_RETURN state.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param packetId Packet id of the released entry
+ * @param pCompleteHandler Completion handler of the released entry, may be NULL
+ * @param pCompleteHandlerData Data passed to the completion handler
+ * @param result Result passed to the completion handler
+ *
+ * @return An IoT Error Type defining successful/failed state change
+ */
+static IoT_Error_t _aws_iot_mqtt_notify_inflight_publish(AWS_IoT_Client *pClient, uint16_t packetId,
+														 pPublishCompleteHandler_t pCompleteHandler,
+														 void *pCompleteHandlerData, IoT_Error_t result) {
+	ClientState clientState;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pCompleteHandler) {
+		FUNC_EXIT_RC(SUCCESS);
+	}
+
+	clientState = aws_iot_mqtt_get_client_state(pClient);
+#ifdef _ENABLE_THREAD_SUPPORT_
+	pClient->clientData.callbackThreadId = aws_iot_thread_get_id();
+#endif
+	aws_iot_mqtt_set_client_state(pClient, clientState, CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN);
+	pCompleteHandler(pClient, packetId, result, pCompleteHandlerData);
+	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN, clientState);
+
+	FUNC_EXIT_RC(rc);
+}
+
+/**
+ * @brief Complete the in-flight publish acknowledged by a PUBACK
+ *
+ * Called from the read path for every PUBACK. PUBACKs that do not belong to an
+ * asynchronous publish are ignored, they are consumed by the blocking publish.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param packetId Packet id carried by the PUBACK
+ * @param result Result passed to the completion handler, MQTT_REASON_CODE_ERROR if the broker refused the message
+ *
+ * @return An IoT Error Type defining successful/failed call
+ */
+IoT_Error_t aws_iot_mqtt_internal_complete_inflight_publish(AWS_IoT_Client *pClient, uint16_t packetId,
+															IoT_Error_t result) {
+	InFlightPublish *pInFlight;
+	pPublishCompleteHandler_t pCompleteHandler = NULL;
+	void *pCompleteHandlerData = NULL;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(0 == packetId) {
+		FUNC_EXIT_RC(SUCCESS);
+	}
+
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	pInFlight = _aws_iot_mqtt_find_inflight_publish(pClient, packetId);
+	if(NULL != pInFlight) {
+		_aws_iot_mqtt_release_inflight_publish(pClient, pInFlight, &pCompleteHandler, &pCompleteHandlerData);
+	}
+
+	rc = aws_iot_mqtt_internal_unlock_write(pClient);
+	if(NULL == pInFlight || SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	FUNC_EXIT_RC(_aws_iot_mqtt_notify_inflight_publish(pClient, packetId, pCompleteHandler, pCompleteHandlerData,
+														result));
+}
+
+/**
+ * @brief Retransmit in-flight publishes whose PUBACK did not arrive in time
+ *
+ * Called from yield. Entries are sent again with the DUP flag until
+ * AWS_IOT_MQTT_INFLIGHT_MAX_RETRIES is reached, after which they are completed
+ * with MQTT_REQUEST_TIMEOUT_ERROR. Only the entries handed out by the retry wheel
+ * are visited, a yield without expired retransmissions does not walk the table.
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return An IoT Error Type defining successful/failed retransmission
+ */
+IoT_Error_t aws_iot_mqtt_internal_resend_inflight_publishes(AWS_IoT_Client *pClient) {
+	uint16_t packetId;
+	TimerWheelEntry *pEntry;
+	InFlightPublish *pInFlight;
+	pPublishCompleteHandler_t pCompleteHandler;
+	void *pCompleteHandlerData;
+	IoT_Error_t rc, threadRc;
+
+	FUNC_ENTRY;
+
+	for(;;) {
+		rc = aws_iot_mqtt_internal_lock_write(pClient);
 		if(SUCCESS != rc) {
 			FUNC_EXIT_RC(rc);
 		}
 
-		rc = aws_iot_mqtt_internal_deserialize_ack(&type, &dup, &packet_id, pClient->clientData.readBuf,
-												   pClient->clientData.readBufSize);
+		pEntry = aws_iot_timer_wheel_expire(&(pClient->clientData.inFlightRetryWheel));
+		if(NULL == pEntry) {
+			FUNC_EXIT_RC(aws_iot_mqtt_internal_unlock_write(pClient));
+		}
+
+		pInFlight = (InFlightPublish *) pEntry->pData;
+		packetId = pInFlight->packetId;
+		pCompleteHandler = NULL;
+		pCompleteHandlerData = NULL;
+
+		if(AWS_IOT_MQTT_INFLIGHT_MAX_RETRIES <= pInFlight->retryCount) {
+			IOT_WARN("Publish %d not acknowledged, dropping it", packetId);
+			_aws_iot_mqtt_release_inflight_publish(pClient, pInFlight, &pCompleteHandler, &pCompleteHandlerData);
+			rc = SUCCESS;
+		} else {
+			pInFlight->retryCount++;
+			rc = _aws_iot_mqtt_send_inflight_publish(pClient, pInFlight, 1);
+			if(SUCCESS != rc) {
+				/* Keep the entry due, it goes out again with the next yield or reconnect */
+				aws_iot_timer_wheel_schedule(&(pClient->clientData.inFlightRetryWheel), &(pInFlight->retryEntry), 0);
+			}
+		}
+
+		threadRc = aws_iot_mqtt_internal_unlock_write(pClient);
+		if(SUCCESS == rc) {
+			rc = threadRc;
+		}
+
+		if(SUCCESS == rc && NULL != pCompleteHandler) {
+			rc = _aws_iot_mqtt_notify_inflight_publish(pClient, packetId, pCompleteHandler, pCompleteHandlerData,
+														MQTT_REQUEST_TIMEOUT_ERROR);
+		}
+
 		if(SUCCESS != rc) {
 			FUNC_EXIT_RC(rc);
 		}
 	}
+}
 
-	FUNC_EXIT_RC(SUCCESS);
+/**
+ * @brief Retransmit every in-flight publish after a reconnect
+ *
+ * Called once the CONNACK of a reconnect was received. Unacknowledged publishes are sent
+ * again with the DUP flag without waiting for their retransmission deadline. Earlier
+ * attempts went to the lost connection, so the retry count of every entry starts over.
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return An IoT Error Type defining successful/failed retransmission
+ */
+IoT_Error_t aws_iot_mqtt_internal_restart_inflight_publishes(AWS_IoT_Client *pClient) {
+	uint32_t itr;
+	InFlightPublish *pInFlight;
+	IoT_Error_t rc, threadRc;
+
+	FUNC_ENTRY;
+
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	for(itr = 0; itr < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH && SUCCESS == rc; itr++) {
+		pInFlight = &(pClient->clientData.inFlightPublishes[itr]);
+		if(0 != pInFlight->packetId) {
+			pInFlight->retryCount = 0;
+			rc = _aws_iot_mqtt_send_inflight_publish(pClient, pInFlight, 1);
+		}
+	}
+
+	threadRc = aws_iot_mqtt_internal_unlock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	FUNC_EXIT_RC(threadRc);
+}
+
+/**
+ * @brief Publish an MQTT message on a topic without waiting for the PUBACK
+ *
+ * Called to publish a QoS1 message and return once it was passed to the TLS layer.
+ * The PUBACK is processed by yield which then calls the completion handler.
+ * This is the internal function which is called by the publish API to perform the operation.
+ * Not meant to be called directly as it doesn't do validations or client state changes
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic Name to publish to
+ * @param topicNameLen Length of the topic name
+ * @param pParams Pointer to Publish Message parameters
+ * @param pCompleteHandler Handler called once the message is acknowledged or dropped
+ * @param pCompleteHandlerData Pointer to data passed to the completion handler
+ *
+ * @return An IoT Error Type defining successful/failed publish
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_publish_async(AWS_IoT_Client *pClient, const char *pTopicName,
+														uint16_t topicNameLen, IoT_Publish_Message_Params *pParams,
+														pPublishCompleteHandler_t pCompleteHandler,
+														void *pCompleteHandlerData) {
+	InFlightPublish *pInFlight;
+	uint16_t packetId;
+	uint32_t itr;
+	IoT_Error_t rc, threadRc;
+
+	FUNC_ENTRY;
+
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	pInFlight = _aws_iot_mqtt_find_inflight_publish(pClient, 0);
+	if(NULL == pInFlight) {
+		(void)aws_iot_mqtt_internal_unlock_write(pClient);
+		FUNC_EXIT_RC(MQTT_INFLIGHT_WINDOW_FULL_ERROR);
+	}
+
+	/* Only the first transmission is shaped, retries are bounded by the in-flight table */
+	rc = aws_iot_mqtt_internal_shape_publish(pClient,
+											 aws_iot_mqtt_internal_get_publish_priority(pClient, pTopicName,
+																						topicNameLen),
+											 _aws_iot_mqtt_shaped_publish_len(pParams, topicNameLen));
+	if(SUCCESS != rc) {
+		(void)aws_iot_mqtt_internal_unlock_write(pClient);
+		FUNC_EXIT_RC(rc);
+	}
+
+	/* Skip ids still waiting for their PUBACK after a wrap around */
+	for(itr = 0; itr <= AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; itr++) {
+		packetId = aws_iot_mqtt_get_next_packet_id(pClient);
+		if(NULL == _aws_iot_mqtt_find_inflight_publish(pClient, packetId)) {
+			break;
+		}
+	}
+
+	pInFlight->packetId = packetId;
+	pInFlight->isRetained = pParams->isRetained;
+	pInFlight->retryCount = 0;
+	pInFlight->pTopicName = pTopicName;
+	pInFlight->topicNameLen = topicNameLen;
+	pInFlight->pPayload = pParams->payload;
+	pInFlight->payloadLen = pParams->payloadLen;
+	pInFlight->pCompleteHandler = pCompleteHandler;
+	pInFlight->pCompleteHandlerData = pCompleteHandlerData;
+
+	/* The PUBACK can be read by another thread as soon as the packet is out,
+	 * the id is stored before the entry becomes visible to the read path */
+	pParams->id = packetId;
+
+	rc = _aws_iot_mqtt_send_inflight_publish(pClient, pInFlight, 0);
+	if(SUCCESS != rc) {
+		/* Never made it to the wire, the caller gets the error instead of the handler */
+		pInFlight->packetId = 0;
+		pInFlight->pCompleteHandler = NULL;
+		pInFlight->pCompleteHandlerData = NULL;
+	}
+
+	threadRc = aws_iot_mqtt_internal_unlock_write(pClient);
+	if(SUCCESS == rc) {
+		rc = threadRc;
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+/* pClientData is the id of the waiter, a waiter that already gave up is no longer linked */
+static void _aws_iot_mqtt_publish_waiter_handler(AWS_IoT_Client *pClient, uint16_t packetId, IoT_Error_t rc,
+												 void *pClientData) {
+	PublishWaiter *pWaiter;
+
+	IOT_UNUSED(packetId);
+
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.state_change_mutex));
+	for(pWaiter = pClient->clientData.pPublishWaiters; NULL != pWaiter; pWaiter = pWaiter->pNext) {
+		if((uintptr_t) pWaiter->id == (uintptr_t) pClientData) {
+			pWaiter->rc = rc;
+			pWaiter->isDone = true;
+			(void)aws_iot_thread_cond_broadcast(&(pClient->clientData.state_change_cond));
+			break;
+		}
+	}
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.state_change_mutex));
+}
+
+/* Unlinks a waiter from the client. The caller holds the state change mutex */
+static void _aws_iot_mqtt_unlink_publish_waiter(AWS_IoT_Client *pClient, PublishWaiter *pWaiter) {
+	PublishWaiter **ppLink;
+
+	for(ppLink = &(pClient->clientData.pPublishWaiters); NULL != *ppLink; ppLink = &((*ppLink)->pNext)) {
+		if(pWaiter == *ppLink) {
+			*ppLink = pWaiter->pNext;
+			break;
+		}
+	}
 }
 
+/**
+ * @brief Publish a QoS1 message and wait for its PUBACK without owning the client
+ *
+ * The message goes through the in-flight table so the PUBACK is matched by whichever
+ * operation reads from the network. While another thread reads (usually the yield
+ * thread) the caller sleeps on the state change condition. When nobody reads the
+ * caller takes the read side itself for one packet at a time, like the single
+ * threaded publish. The wait is bounded by the command timeout even when no thread
+ * reads any more, e.g. after the yield thread has exited.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic Name to publish to
+ * @param topicNameLen Length of the topic name
+ * @param pParams Pointer to Publish Message parameters
+ *
+ * @return An IoT Error Type defining successful/failed publish
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_publish_and_wait(AWS_IoT_Client *pClient, const char *pTopicName,
+														   uint16_t topicNameLen,
+														   IoT_Publish_Message_Params *pParams) {
+	PublishWaiter waiter;
+	void *pWaiterId;
+	InFlightPublish *pInFlight;
+	ClientState clientState;
+	uint8_t packetType;
+	Timer timer;
+	IoT_Error_t rc, threadRc;
+
+	FUNC_ENTRY;
+
+	init_timer(&timer);
+	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
+
+	waiter.isDone = false;
+	waiter.rc = SUCCESS;
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.state_change_mutex));
+	waiter.id = ++(pClient->clientData.nextPublishWaiterId);
+	waiter.pNext = pClient->clientData.pPublishWaiters;
+	pClient->clientData.pPublishWaiters = &waiter;
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.state_change_mutex));
+	pWaiterId = (void *) (uintptr_t) waiter.id;
+
+	rc = _aws_iot_mqtt_internal_publish_async(pClient, pTopicName, topicNameLen, pParams,
+											  _aws_iot_mqtt_publish_waiter_handler, pWaiterId);
+	if(SUCCESS != rc) {
+		(void)aws_iot_thread_mutex_lock(&(pClient->clientData.state_change_mutex));
+		_aws_iot_mqtt_unlink_publish_waiter(pClient, &waiter);
+		(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.state_change_mutex));
+		FUNC_EXIT_RC(rc);
+	}
+
+	rc = MQTT_REQUEST_TIMEOUT_ERROR;
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.state_change_mutex));
+	/* Counted before the state is checked, the operation owning the client wakes this thread */
+	__atomic_add_fetch(&(pClient->clientData.stateWaiterCount), 1, __ATOMIC_SEQ_CST);
+	while(!waiter.isDone && !has_timer_expired(&timer)) {
+		clientState = aws_iot_mqtt_get_client_state(pClient);
+		if(!aws_iot_mqtt_internal_is_client_available(pClient, true)) {
+			if(!aws_iot_mqtt_is_client_connected(pClient)) {
+				rc = NETWORK_DISCONNECTED_ERROR;
+				break;
+			}
+			/* The PUBACK is read by the operation owning the client */
+			(void)aws_iot_thread_cond_wait(&(pClient->clientData.state_change_cond),
+										   &(pClient->clientData.state_change_mutex), left_ms(&timer));
+			continue;
+		}
+
+		/* Nobody is reading, read the next packet here. The state is set with a compare and
+		 * swap, an operation may have taken the client without the mutex since the check */
+		if(!__atomic_compare_exchange_n(&(pClient->clientStatus.clientState), &clientState,
+										CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS, false, __ATOMIC_SEQ_CST,
+										__ATOMIC_SEQ_CST)) {
+			continue;
+		}
+		(void)aws_iot_thread_cond_broadcast(&(pClient->clientData.state_change_cond));
+		(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.state_change_mutex));
+
+		rc = aws_iot_mqtt_internal_cycle_read(pClient, &timer, &packetType);
+		threadRc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS, clientState);
+
+		(void)aws_iot_thread_mutex_lock(&(pClient->clientData.state_change_mutex));
+		if(SUCCESS == rc) {
+			rc = threadRc;
+		}
+		if(SUCCESS != rc) {
+			break;
+		}
+		rc = MQTT_REQUEST_TIMEOUT_ERROR;
+	}
+	__atomic_sub_fetch(&(pClient->clientData.stateWaiterCount), 1, __ATOMIC_SEQ_CST);
+	/* Leaving may unblock a newcomer that deferred to this thread */
+	(void)aws_iot_thread_cond_broadcast(&(pClient->clientData.state_change_cond));
+
+	if(waiter.isDone) {
+		_aws_iot_mqtt_unlink_publish_waiter(pClient, &waiter);
+		(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.state_change_mutex));
+		FUNC_EXIT_RC(waiter.rc);
+	}
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.state_change_mutex));
+
+	/* Withdraw the entry unless a PUBACK claimed it in the meantime */
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.tls_write_mutex));
+	pInFlight = _aws_iot_mqtt_find_inflight_publish(pClient, pParams->id);
+	if(NULL != pInFlight && _aws_iot_mqtt_publish_waiter_handler == pInFlight->pCompleteHandler &&
+	   pWaiterId == pInFlight->pCompleteHandlerData) {
+		aws_iot_timer_wheel_cancel(&(pClient->clientData.inFlightRetryWheel), &(pInFlight->retryEntry));
+		pInFlight->packetId = 0;
+		pInFlight->pCompleteHandler = NULL;
+		pInFlight->pCompleteHandlerData = NULL;
+	} else {
+		pInFlight = NULL;
+	}
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.tls_write_mutex));
+
+	(void)aws_iot_thread_mutex_lock(&(pClient->clientData.state_change_mutex));
+	if(NULL == pInFlight) {
+		/* The handler is about to run on the reading thread, give it one more command timeout */
+		countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
+		while(!waiter.isDone && !has_timer_expired(&timer)) {
+			(void)aws_iot_thread_cond_wait(&(pClient->clientData.state_change_cond),
+										   &(pClient->clientData.state_change_mutex), left_ms(&timer));
+		}
+		rc = waiter.isDone ? waiter.rc : MQTT_REQUEST_TIMEOUT_ERROR;
+	}
+	/* Once unlinked the handler no longer touches the waiter */
+	_aws_iot_mqtt_unlink_publish_waiter(pClient, &waiter);
+	(void)aws_iot_thread_mutex_unlock(&(pClient->clientData.state_change_mutex));
+
+	FUNC_EXIT_RC(rc);
+}
+#endif
+
 /**
  * @brief Publish an MQTT message on a topic
  *
@@ -251,6 +1061,8 @@ static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const
  * the function returns after the receipt of the PUBACK control packet.
  * This is the outer function which does the validations and calls the internal publish above
  * to perform the actual operation. It is also responsible for client state changes
+ * With thread support publishes only take the write lock, they run alongside a yield
+ * blocked in read on another thread.
  *
  * @param pClient Reference to the IoT Client
  * @param pTopicName Topic Name to publish to
@@ -261,8 +1073,10 @@ static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const
  */
 IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
 								 IoT_Publish_Message_Params *pParams) {
+#ifndef _ENABLE_THREAD_SUPPORT_
 	IoT_Error_t rc, pubRc;
 	ClientState clientState;
+#endif
 
 	FUNC_ENTRY;
 
@@ -274,6 +1088,13 @@ IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName
 		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
 	}
 
+#ifdef _ENABLE_THREAD_SUPPORT_
+	if(QOS0 == pParams->qos) {
+		FUNC_EXIT_RC(_aws_iot_mqtt_internal_publish(pClient, pTopicName, topicNameLen, pParams));
+	}
+
+	FUNC_EXIT_RC(_aws_iot_mqtt_internal_publish_and_wait(pClient, pTopicName, topicNameLen, pParams));
+#else
 	clientState = aws_iot_mqtt_get_client_state(pClient);
 	if(CLIENT_STATE_CONNECTED_IDLE != clientState && CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN != clientState) {
 		FUNC_EXIT_RC(MQTT_CLIENT_NOT_IDLE_ERROR);
@@ -292,6 +1113,55 @@ IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName
 	}
 
 	FUNC_EXIT_RC(pubRc);
+#endif
+}
+
+IoT_Error_t aws_iot_mqtt_publish_async(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+									   IoT_Publish_Message_Params *pParams,
+									   pPublishCompleteHandler_t pCompleteHandler, void *pCompleteHandlerData) {
+#ifndef _ENABLE_THREAD_SUPPORT_
+	IoT_Error_t rc, pubRc;
+	ClientState clientState;
+#endif
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTopicName || 0 == topicNameLen || NULL == pParams) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(QOS1 != pParams->qos) {
+		FUNC_EXIT_RC(aws_iot_mqtt_publish(pClient, pTopicName, topicNameLen, pParams));
+	}
+
+	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
+	}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	FUNC_EXIT_RC(_aws_iot_mqtt_internal_publish_async(pClient, pTopicName, topicNameLen, pParams, pCompleteHandler,
+													  pCompleteHandlerData));
+#else
+	clientState = aws_iot_mqtt_get_client_state(pClient);
+	if(CLIENT_STATE_CONNECTED_IDLE != clientState && CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN != clientState) {
+		FUNC_EXIT_RC(MQTT_CLIENT_NOT_IDLE_ERROR);
+	}
+
+	rc = aws_iot_mqtt_set_client_state(pClient, clientState, CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	pubRc = _aws_iot_mqtt_internal_publish_async(pClient, pTopicName, topicNameLen, pParams, pCompleteHandler,
+												 pCompleteHandlerData);
+
+	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS, clientState);
+	if(SUCCESS == pubRc && SUCCESS != rc) {
+		pubRc = rc;
+	}
+
+	FUNC_EXIT_RC(pubRc);
+#endif
 }
 
 /**
@@ -372,13 +1242,14 @@ IoT_Error_t aws_iot_mqtt_internal_deserialize_publish(uint8_t *dup, QoS *qos,
 
 /**
   * Deserializes the supplied (wire) buffer into an ack
+  * MQTT 5 reason codes are checked, the packet id is returned even when they report a failure
   * @param pPacketType returned integer - the MQTT packet type
   * @param dup returned integer - the MQTT dup flag
   * @param pPacketId returned integer - the MQTT packet identifier
   * @param pRxBuf the raw buffer data, of the correct length determined by the remaining length field
   * @param rxBuflen the length in bytes of the data in the supplied buffer
   *
-  * @return An IoT Error Type defining successful/failed call
+  * @return An IoT Error Type defining successful/failed call, MQTT_REASON_CODE_ERROR if the broker refused the request
   */
 IoT_Error_t aws_iot_mqtt_internal_deserialize_ack(unsigned char *pPacketType, unsigned char *dup,
 												  uint16_t *pPacketId, unsigned char *pRxBuf,
@@ -420,7 +1291,23 @@ IoT_Error_t aws_iot_mqtt_internal_deserialize_ack(unsigned char *pPacketType, un
 
 	*pPacketId = aws_iot_mqtt_internal_read_uint16_t(&curdata);
 
-	FUNC_EXIT_RC(SUCCESS);
+	/* MQTT 3.1.1 acks end here. MQTT 5 UNSUBACK has properties and a reason code per topic filter,
+	 * the other acks a reason code and optional properties */
+	if(UNSUBACK == *pPacketType && curdata < enddata) {
+		rc = aws_iot_mqtt_internal_read_properties_length(&curdata, enddata, &curdata);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+		while(curdata < enddata) {
+			if(MQTT_REASON_CODE_FAILURE <= aws_iot_mqtt_internal_read_char(&curdata)) {
+				rc = MQTT_REASON_CODE_ERROR;
+			}
+		}
+	} else if(curdata < enddata && MQTT_REASON_CODE_FAILURE <= aws_iot_mqtt_internal_read_char(&curdata)) {
+		rc = MQTT_REASON_CODE_ERROR;
+	}
+
+	FUNC_EXIT_RC(rc);
 }
 
 #ifdef __cplusplus
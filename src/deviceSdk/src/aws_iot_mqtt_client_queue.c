@@ -0,0 +1,273 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_client_queue.c
+ * @brief MQTT client outbound queue written by a dedicated writer thread
+ *
+ * The queue is a bounded multi-producer single-consumer ring of serialized packets.
+ * Every slot carries a sequence number: a producer claims the slot whose sequence
+ * equals the enqueue position with a compare and swap, fills it and publishes it by
+ * storing position + 1. The writer consumes slots whose sequence is position + 1 and
+ * hands them back to producers by storing position + AWS_IOT_MQTT_OUTBOUND_QUEUE_SLOTS.
+ * Producers never take a lock, only the writer touches the network.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sdk/aws_iot_mqtt_client.h"
+#include "sdk/aws_iot_mqtt_client_common_internal.h"
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+
+#if (AWS_IOT_MQTT_OUTBOUND_QUEUE_SLOTS & (AWS_IOT_MQTT_OUTBOUND_QUEUE_SLOTS - 1)) != 0
+#error "AWS_IOT_MQTT_OUTBOUND_QUEUE_SLOTS must be a power of two"
+#endif
+
+#if AWS_IOT_MQTT_OUTBOUND_SLOT_LEN > AWS_IOT_MQTT_TX_BUF_LEN
+#error "AWS_IOT_MQTT_OUTBOUND_SLOT_LEN must not exceed AWS_IOT_MQTT_TX_BUF_LEN"
+#endif
+
+#define OUTBOUND_QUEUE_MASK (AWS_IOT_MQTT_OUTBOUND_QUEUE_SLOTS - 1)
+
+/* Raises *pMax to value, producers may race on it */
+static void _aws_iot_mqtt_outbound_update_max(uint32_t *pMax, uint32_t value) {
+	uint32_t current = __atomic_load_n(pMax, __ATOMIC_RELAXED);
+
+	while(value > current &&
+		  !__atomic_compare_exchange_n(pMax, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+void aws_iot_mqtt_internal_outbound_queue_init(AWS_IoT_Client *pClient) {
+	uint32_t i;
+
+	for(i = 0; i < AWS_IOT_MQTT_OUTBOUND_QUEUE_SLOTS; ++i) {
+		pClient->clientData.outboundQueue[i].sequence = i;
+		pClient->clientData.outboundQueue[i].packetLen = 0;
+	}
+	pClient->clientData.outboundEnqueuePos = 0;
+	pClient->clientData.outboundDequeuePos = 0;
+	memset(&(pClient->clientData.outboundStats), 0, sizeof(OutboundQueueStats));
+}
+
+IoT_Error_t aws_iot_mqtt_publish_enqueue(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+										 IoT_Publish_Message_Params *pParams) {
+	OutboundQueueSlot *pSlot;
+	uint32_t pos, sequence, packetLen, headerLen;
+	size_t payloadLen;
+	int32_t diff;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+	if(NULL == pClient || NULL == pTopicName || 0 == topicNameLen || NULL == pParams ||
+	   (NULL == pParams->payload && 0 != pParams->payloadLen)) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	/* QoS1 needs a packet id and an in-flight entry, use aws_iot_mqtt_publish_async for it */
+	if(QOS0 != pParams->qos) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	if(CLIENT_STATE_INVALID == aws_iot_mqtt_get_client_state(pClient) ||
+	   CLIENT_STATE_INITIALIZED == aws_iot_mqtt_get_client_state(pClient) ||
+	   CLIENT_STATE_DISCONNECTED_MANUALLY == aws_iot_mqtt_get_client_state(pClient)) {
+		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
+	}
+
+	/* Topic length field and topic, no packet id for QoS0. Queued packets may be written after a
+	 * reconnect so they never use topic aliases, MQTT 5 only adds an empty property list */
+	packetLen = aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(
+			(uint32_t) (2 + topicNameLen + pParams->payloadLen +
+						((MQTT_5 == pClient->clientData.options.MQTTVersion) ? 1 : 0)));
+	if(AWS_IOT_MQTT_OUTBOUND_SLOT_LEN < pParams->payloadLen || AWS_IOT_MQTT_OUTBOUND_SLOT_LEN < packetLen) {
+		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
+	}
+
+	pos = __atomic_load_n(&(pClient->clientData.outboundEnqueuePos), __ATOMIC_RELAXED);
+	for(;;) {
+		pSlot = &(pClient->clientData.outboundQueue[pos & OUTBOUND_QUEUE_MASK]);
+		sequence = __atomic_load_n(&(pSlot->sequence), __ATOMIC_ACQUIRE);
+		diff = (int32_t) (sequence - pos);
+		if(0 == diff) {
+			/* Slot is free, claim it. On failure pos is reloaded with the current position */
+			if(__atomic_compare_exchange_n(&(pClient->clientData.outboundEnqueuePos), &pos, pos + 1, true,
+										   __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if(0 > diff) {
+			/* The writer has not released this slot yet, the ring is full */
+			__atomic_add_fetch(&(pClient->clientData.outboundStats.dropped), 1, __ATOMIC_RELAXED);
+			FUNC_EXIT_RC(MQTT_OUTBOUND_QUEUE_FULL_ERROR);
+		} else {
+			pos = __atomic_load_n(&(pClient->clientData.outboundEnqueuePos), __ATOMIC_RELAXED);
+		}
+	}
+
+	rc = aws_iot_mqtt_internal_serialize_publish_header(pSlot->packet, AWS_IOT_MQTT_OUTBOUND_SLOT_LEN,
+														pClient->clientData.options.MQTTVersion, 0, QOS0,
+														pParams->isRetained, 0, pTopicName, topicNameLen, 0,
+														pParams->payloadLen, &headerLen);
+	payloadLen = pParams->payloadLen;
+	if(SUCCESS != rc) {
+		/* Sizes were checked above. The slot is claimed, publish it empty so the writer skips it */
+		headerLen = 0;
+		payloadLen = 0;
+	}
+	if(0 < payloadLen) {
+		memcpy(pSlot->packet + headerLen, pParams->payload, payloadLen);
+	}
+	pSlot->packetLen = (uint16_t) (headerLen + payloadLen);
+	pSlot->priority = (uint8_t) aws_iot_mqtt_internal_get_publish_priority(pClient, pTopicName, topicNameLen);
+	pSlot->enqueueTimeMs = get_time_ms();
+	__atomic_store_n(&(pSlot->sequence), pos + 1, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&(pClient->clientData.outboundStats.enqueued), 1, __ATOMIC_RELAXED);
+	_aws_iot_mqtt_outbound_update_max(&(pClient->clientData.outboundStats.maxDepth),
+									  pos + 1 - __atomic_load_n(&(pClient->clientData.outboundDequeuePos),
+																__ATOMIC_RELAXED));
+
+	FUNC_EXIT_RC(rc);
+}
+
+/* Returns the slot at pos if a producer has finished filling it */
+static OutboundQueueSlot *_aws_iot_mqtt_outbound_ready_slot(AWS_IoT_Client *pClient, uint32_t pos) {
+	OutboundQueueSlot *pSlot = &(pClient->clientData.outboundQueue[pos & OUTBOUND_QUEUE_MASK]);
+
+	if(__atomic_load_n(&(pSlot->sequence), __ATOMIC_ACQUIRE) != pos + 1) {
+		return NULL;
+	}
+
+	return pSlot;
+}
+
+IoT_Error_t aws_iot_mqtt_drain_outbound_queue(AWS_IoT_Client *pClient) {
+	OutboundQueueSlot *pSlot;
+	OutboundQueueStats *pCounters;
+	Timer timer;
+	size_t len;
+	uint32_t pos, endPos, now, latency;
+	IoT_Error_t rc, threadRc, shapeRc;
+
+	FUNC_ENTRY;
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pos = pClient->clientData.outboundDequeuePos;
+	while(NULL != _aws_iot_mqtt_outbound_ready_slot(pClient, pos)) {
+		rc = aws_iot_mqtt_internal_lock_write(pClient);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+
+		/* Checked under the write lock, disconnect holds it while the network is torn down */
+		if(!aws_iot_mqtt_is_client_connected(pClient)) {
+			(void) aws_iot_mqtt_internal_unlock_write(pClient);
+			FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
+		}
+
+		/* Coalesce every ready packet that fits behind the previous ones into one write.
+		 * The queue is written in order, a throttled packet holds back the ones behind it */
+		len = 0;
+		endPos = pos;
+		shapeRc = SUCCESS;
+		while(NULL != (pSlot = _aws_iot_mqtt_outbound_ready_slot(pClient, endPos)) &&
+			  len + pSlot->packetLen <= pClient->clientData.writeBufSize) {
+			if(0 < pSlot->packetLen) {
+				shapeRc = aws_iot_mqtt_internal_shape_publish(pClient, (PublishPriority) pSlot->priority,
+															  pSlot->packetLen);
+				if(SUCCESS != shapeRc) {
+					break;
+				}
+			}
+			memcpy(pClient->clientData.writeBuf + len, pSlot->packet, pSlot->packetLen);
+			len += pSlot->packetLen;
+			endPos++;
+		}
+
+		if(pos == endPos && SUCCESS != shapeRc) {
+			(void) aws_iot_mqtt_internal_unlock_write(pClient);
+			FUNC_EXIT_RC(shapeRc);
+		}
+
+		rc = SUCCESS;
+		if(0 < len) {
+			init_timer(&timer);
+			countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
+			rc = aws_iot_mqtt_internal_send_packet(pClient, len, &timer);
+		}
+		threadRc = aws_iot_mqtt_internal_unlock_write(pClient);
+		if(SUCCESS != rc) {
+			/* Slots are only released once written, they are sent again on the next call */
+			FUNC_EXIT_RC(rc);
+		}
+
+		/* Only the writer updates these, stores are atomic for aws_iot_mqtt_get_outbound_queue_stats */
+		pCounters = &(pClient->clientData.outboundStats);
+		if(0 < len) {
+			__atomic_store_n(&(pCounters->writes), pCounters->writes + 1, __ATOMIC_RELAXED);
+		}
+		now = get_time_ms();
+		for(; pos != endPos; pos++) {
+			pSlot = &(pClient->clientData.outboundQueue[pos & OUTBOUND_QUEUE_MASK]);
+			latency = now - pSlot->enqueueTimeMs;
+			__atomic_store_n(&(pCounters->written), pCounters->written + 1, __ATOMIC_RELAXED);
+			__atomic_store_n(&(pCounters->lastDrainLatencyMs), latency, __ATOMIC_RELAXED);
+			if(latency > pCounters->maxDrainLatencyMs) {
+				__atomic_store_n(&(pCounters->maxDrainLatencyMs), latency, __ATOMIC_RELAXED);
+			}
+			__atomic_store_n(&(pSlot->sequence), pos + AWS_IOT_MQTT_OUTBOUND_QUEUE_SLOTS, __ATOMIC_RELEASE);
+		}
+		__atomic_store_n(&(pClient->clientData.outboundDequeuePos), pos, __ATOMIC_RELAXED);
+
+		if(SUCCESS != threadRc) {
+			FUNC_EXIT_RC(threadRc);
+		}
+	}
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_get_outbound_queue_stats(AWS_IoT_Client *pClient, OutboundQueueStats *pStats) {
+	OutboundQueueStats *pCounters;
+
+	FUNC_ENTRY;
+	if(NULL == pClient || NULL == pStats) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pCounters = &(pClient->clientData.outboundStats);
+	pStats->depth = __atomic_load_n(&(pClient->clientData.outboundEnqueuePos), __ATOMIC_RELAXED)
+					- __atomic_load_n(&(pClient->clientData.outboundDequeuePos), __ATOMIC_RELAXED);
+	pStats->maxDepth = __atomic_load_n(&(pCounters->maxDepth), __ATOMIC_RELAXED);
+	pStats->enqueued = __atomic_load_n(&(pCounters->enqueued), __ATOMIC_RELAXED);
+	pStats->dropped = __atomic_load_n(&(pCounters->dropped), __ATOMIC_RELAXED);
+	pStats->written = __atomic_load_n(&(pCounters->written), __ATOMIC_RELAXED);
+	pStats->writes = __atomic_load_n(&(pCounters->writes), __ATOMIC_RELAXED);
+	pStats->lastDrainLatencyMs = __atomic_load_n(&(pCounters->lastDrainLatencyMs), __ATOMIC_RELAXED);
+	pStats->maxDrainLatencyMs = __atomic_load_n(&(pCounters->maxDrainLatencyMs), __ATOMIC_RELAXED);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+#endif /* _ENABLE_THREAD_SUPPORT_ */
+
+#ifdef __cplusplus
+}
+#endif
@@ -41,10 +41,21 @@ extern "C" {
 
 #include "sdk/aws_iot_mqtt_client_common_internal.h"
 
+/**
+  * Remaining length of a SUBSCRIBE packet before its first filter
+  * @param version MQTT_Ver_t - the MQTT version of the connection
+  *
+  * @return the packet id, and for MQTT 5 the empty property list
+  */
+static uint32_t _aws_iot_mqtt_subscribe_header_len(MQTT_Ver_t version) {
+	return 2 + ((MQTT_5 == version) ? 1 : 0);
+}
+
 /**
   * Serializes the supplied subscribe data into the supplied buffer, ready for sending
   * @param pTxBuf the buffer into which the packet will be serialized
   * @param txBufLen the length in bytes of the supplied buffer
+  * @param version MQTT_Ver_t - the MQTT version of the connection
   * @param dup unsigned char - the MQTT dup flag
   * @param packetId uint16_t - the MQTT packet identifier
   * @param topicCount - number of members in the topicFilters and reqQos arrays
@@ -56,7 +67,7 @@ extern "C" {
   * @return An IoT Error Type defining successful/failed operation
   */
 static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size_t txBufLen,
-													 unsigned char dup, uint16_t packetId, uint32_t topicCount,
+													 MQTT_Ver_t version, unsigned char dup, uint16_t packetId, uint32_t topicCount,
 													 const char **pTopicNameList, uint16_t *pTopicNameLenList,
 													 QoS *pRequestedQoSs, uint32_t *pSerializedLen) {
 	unsigned char *ptr;
@@ -70,13 +81,14 @@ static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size
 	}
 
 	ptr = pTxBuf;
-	rem_len = 2; /* packetId */
+	rem_len = _aws_iot_mqtt_subscribe_header_len(version);
 
 	for(itr = 0; itr < topicCount; ++itr) {
 		rem_len += (uint32_t) (pTopicNameLenList[itr] + 2 + 1); /* topic + length + req_qos */
 	}
 
-	if(aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(rem_len) > txBufLen) {
+	/* aws_iot_mqtt_internal_send_packet refuses a packet filling the whole buffer */
+	if(aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(rem_len) >= txBufLen) {
 		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
 	}
 
@@ -91,7 +103,11 @@ static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size
 	ptr += aws_iot_mqtt_internal_write_len_to_buffer(ptr, rem_len);
 
 	aws_iot_mqtt_internal_write_uint_16(&ptr, packetId);
+	if(MQTT_5 == version) {
+		aws_iot_mqtt_internal_write_char(&ptr, 0);
+	}
 
+	/* The MQTT 5 subscription options keep the requested QoS in their low bits */
 	for(itr = 0; itr < topicCount; ++itr) {
 		aws_iot_mqtt_internal_write_utf8_string(&ptr, pTopicNameList[itr], pTopicNameLenList[itr]);
 		aws_iot_mqtt_internal_write_char(&ptr, (unsigned char) pRequestedQoSs[itr]);
@@ -104,6 +120,8 @@ static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size
 
 /**
   * Deserializes the supplied (wire) buffer into suback data
+  * MQTT 5 failure reason codes are all returned as AWS_IOT_MQTT_SUBACK_FAILURE
+  * @param version MQTT_Ver_t - the MQTT version of the connection
   * @param pPacketId returned integer - the MQTT packet identifier
   * @param maxExpectedQoSCount - the maximum number of members allowed in the grantedQoSs array
   * @param pGrantedQoSCount returned uint32_t - number of members in the grantedQoSs array
@@ -113,10 +131,12 @@ static IoT_Error_t _aws_iot_mqtt_serialize_subscribe(unsigned char *pTxBuf, size
   *
   * @return An IoT Error Type defining successful/failed operation
   */
-static IoT_Error_t _aws_iot_mqtt_deserialize_suback(uint16_t *pPacketId, uint32_t maxExpectedQoSCount,
+static IoT_Error_t _aws_iot_mqtt_deserialize_suback(MQTT_Ver_t version, uint16_t *pPacketId,
+													uint32_t maxExpectedQoSCount,
 													uint32_t *pGrantedQoSCount, QoS *pGrantedQoSs,
 													unsigned char *pRxBuf, size_t rxBufLen) {
 	unsigned char *curData, *endData;
+	unsigned char returnCode;
 	uint32_t decodedLen, readBytesLen;
 	IoT_Error_t decodeRc;
 	MQTTHeader header = {0};
@@ -158,25 +178,38 @@ static IoT_Error_t _aws_iot_mqtt_deserialize_suback(uint16_t *pPacketId, uint32_
 
 	*pPacketId = aws_iot_mqtt_internal_read_uint16_t(&curData);
 
+	if(MQTT_5 == version) {
+		decodeRc = aws_iot_mqtt_internal_read_properties_length(&curData, endData, &curData);
+		if(SUCCESS != decodeRc) {
+			FUNC_EXIT_RC(decodeRc);
+		}
+	}
+
 	*pGrantedQoSCount = 0;
 	while(curData < endData) {
-		if(*pGrantedQoSCount > maxExpectedQoSCount) {
+		if(*pGrantedQoSCount >= maxExpectedQoSCount) {
 			FUNC_EXIT_RC(FAILURE);
 		}
-		pGrantedQoSs[(*pGrantedQoSCount)++] = (QoS) aws_iot_mqtt_internal_read_char(&curData);
+		returnCode = aws_iot_mqtt_internal_read_char(&curData);
+		if(MQTT_REASON_CODE_FAILURE <= returnCode) {
+			returnCode = AWS_IOT_MQTT_SUBACK_FAILURE;
+		}
+		pGrantedQoSs[(*pGrantedQoSCount)++] = (QoS) returnCode;
 	}
 
 	FUNC_EXIT_RC(SUCCESS);
 }
 
-/* Returns MAX_MESSAGE_HANDLERS value if no free index is available */
+/* Returns messageHandlerCount value if no free index is available.
+ * Handlers removed during a dispatch stay linked in the trie until it returns */
 static uint32_t _aws_iot_mqtt_get_free_message_handler_index(AWS_IoT_Client *pClient) {
 	uint32_t itr;
 
 	FUNC_ENTRY;
 
-	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; itr++) {
-		if(pClient->clientData.messageHandlers[itr].topicName == NULL) {
+	for(itr = 0; itr < pClient->clientData.messageHandlerCount; itr++) {
+		if(pClient->clientData.pMessageHandlers[itr].topicName == NULL &&
+		   pClient->clientData.pMessageHandlers[itr].trieNode == AWS_IOT_MQTT_TRIE_NONE) {
 			break;
 		}
 	}
@@ -184,6 +217,34 @@ static uint32_t _aws_iot_mqtt_get_free_message_handler_index(AWS_IoT_Client *pCl
 	FUNC_EXIT_RC(itr);
 }
 
+/* Serializes and sends a SUBSCRIBE for count topics while holding the write lock */
+static IoT_Error_t _aws_iot_mqtt_send_subscribe(AWS_IoT_Client *pClient, uint16_t packetId, uint32_t count,
+												const char **pTopicNames, uint16_t *pTopicNameLens, QoS *pQoSs,
+												Timer *pTimer) {
+	uint32_t serializedLen = 0;
+	IoT_Error_t rc, threadRc;
+
+	FUNC_ENTRY;
+
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	rc = _aws_iot_mqtt_serialize_subscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
+										   pClient->clientData.options.MQTTVersion, 0, packetId, count, pTopicNames, pTopicNameLens, pQoSs, &serializedLen);
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_internal_send_packet(pClient, serializedLen, pTimer);
+	}
+
+	threadRc = aws_iot_mqtt_internal_unlock_write(pClient);
+	if(SUCCESS == rc) {
+		rc = threadRc;
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
 /**
  * @brief Subscribe to an MQTT topic.
  *
@@ -199,6 +260,7 @@ static uint32_t _aws_iot_mqtt_get_free_message_handler_index(AWS_IoT_Client *pCl
  *     no malloc are performed by the SDK
  * @param topicNameLen Length of the topic name
  * @param pApplicationHandler_t Reference to the handler function for this subscription
+ * @param pStreamApplicationHandler Reference to the streaming handler function, NULL for a regular subscription
  * @param pApplicationHandlerData Point to data passed to the callback. 
  *    pApplicationHandlerData also needs to be static in memory  since no malloc are performed by the SDK
  *
@@ -207,49 +269,63 @@ static uint32_t _aws_iot_mqtt_get_free_message_handler_index(AWS_IoT_Client *pCl
 static IoT_Error_t _aws_iot_mqtt_internal_subscribe(AWS_IoT_Client *pClient, const char *pTopicName,
 													uint16_t topicNameLen, QoS qos,
 													pApplicationHandler_t pApplicationHandler,
+													pStreamApplicationHandler_t pStreamApplicationHandler,
 													void *pApplicationHandlerData) {
 	uint16_t txPacketId, rxPacketId;
-	uint32_t serializedLen, indexOfFreeMessageHandler, count;
+	uint32_t indexOfFreeMessageHandler, count;
 	IoT_Error_t rc;
 	Timer timer;
+	MessageHandlers *pHandler;
 	QoS grantedQoS[3] = {QOS0, QOS0, QOS0};
 
 	FUNC_ENTRY;
 	init_timer(&timer);
 	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
 
-	serializedLen = 0;
 	count = 0;
 	txPacketId = aws_iot_mqtt_get_next_packet_id(pClient);
 	rxPacketId = 0;
 
-	rc = _aws_iot_mqtt_serialize_subscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize, 0,
-										   txPacketId, 1, &pTopicName, &topicNameLen, &qos, &serializedLen);
-	if(SUCCESS != rc) {
-		FUNC_EXIT_RC(rc);
-	}
-
 	indexOfFreeMessageHandler = _aws_iot_mqtt_get_free_message_handler_index(pClient);
-	if(AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS <= indexOfFreeMessageHandler) {
+	if(pClient->clientData.messageHandlerCount <= indexOfFreeMessageHandler) {
 		FUNC_EXIT_RC(MQTT_MAX_SUBSCRIPTIONS_REACHED_ERROR);
 	}
 
+	/* Link the handler before sending so messages following the SUBACK are delivered */
+	pHandler = &(pClient->clientData.pMessageHandlers[indexOfFreeMessageHandler]);
+	pHandler->topicName = pTopicName;
+	pHandler->topicNameLen = topicNameLen;
+	pHandler->pApplicationHandler = pApplicationHandler;
+	pHandler->pStreamApplicationHandler = pStreamApplicationHandler;
+	pHandler->pApplicationHandlerData = pApplicationHandlerData;
+	pHandler->isDecompressEnabled = false;
+	pHandler->qos = qos;
+
+	rc = aws_iot_mqtt_internal_trie_insert(pClient, indexOfFreeMessageHandler);
+	if(SUCCESS != rc) {
+		pHandler->topicName = NULL;
+		FUNC_EXIT_RC(rc);
+	}
+
 	/* send the subscribe packet */
-	rc = aws_iot_mqtt_internal_send_packet(pClient, serializedLen, &timer);
+	rc = _aws_iot_mqtt_send_subscribe(pClient, txPacketId, 1, &pTopicName, &topicNameLen, &qos, &timer);
 	if(SUCCESS != rc) {
+		aws_iot_mqtt_internal_trie_remove(pClient, indexOfFreeMessageHandler);
 		FUNC_EXIT_RC(rc);
 	}
 
 	/* wait for suback */
 	rc = aws_iot_mqtt_internal_wait_for_read(pClient, SUBACK, &timer);
 	if(SUCCESS != rc) {
+		aws_iot_mqtt_internal_trie_remove(pClient, indexOfFreeMessageHandler);
 		FUNC_EXIT_RC(rc);
 	}
 
 	/* Granted QoS can be 0, 1 or 2 */
-	rc = _aws_iot_mqtt_deserialize_suback(&rxPacketId, 1, &count, grantedQoS, pClient->clientData.readBuf,
+	rc = _aws_iot_mqtt_deserialize_suback(pClient->clientData.options.MQTTVersion, &rxPacketId, 1, &count, grantedQoS, pClient->clientData.readBuf,
 										  pClient->clientData.readBufSize);
 	if(SUCCESS != rc) {
+		aws_iot_mqtt_internal_trie_remove(pClient, indexOfFreeMessageHandler);
 		FUNC_EXIT_RC(rc);
 	}
 
@@ -260,16 +336,6 @@ static IoT_Error_t _aws_iot_mqtt_internal_subscribe(AWS_IoT_Client *pClient, con
 	//	return RX_MESSAGE_INVALID_ERROR;
 	//}
 
-	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].topicName =
-			pTopicName;
-	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].topicNameLen =
-			topicNameLen;
-	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].pApplicationHandler =
-			pApplicationHandler;
-	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].pApplicationHandlerData =
-			pApplicationHandlerData;
-	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].qos = qos;
-
 	FUNC_EXIT_RC(SUCCESS);
 }
 
@@ -308,18 +374,219 @@ IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicNa
 		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
 	}
 
-	clientState = aws_iot_mqtt_get_client_state(pClient);
-	if(CLIENT_STATE_CONNECTED_IDLE != clientState && CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN != clientState) {
-		FUNC_EXIT_RC(MQTT_CLIENT_NOT_IDLE_ERROR);
+	/* Waits for a running yield to hand over the read side when threads may block */
+	rc = aws_iot_mqtt_internal_acquire_client_state(pClient, CLIENT_STATE_CONNECTED_SUBSCRIBE_IN_PROGRESS, true,
+													pClient->clientData.commandTimeoutMs, &clientState);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	subRc = _aws_iot_mqtt_internal_subscribe(pClient, pTopicName, topicNameLen, qos,
+											 pApplicationHandler, NULL, pApplicationHandlerData);
+
+	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_SUBSCRIBE_IN_PROGRESS, clientState);
+	if(SUCCESS == subRc && SUCCESS != rc) {
+		subRc = rc;
 	}
 
-	rc = aws_iot_mqtt_set_client_state(pClient, clientState, CLIENT_STATE_CONNECTED_SUBSCRIBE_IN_PROGRESS);
+	FUNC_EXIT_RC(subRc);
+}
+
+/**
+ * @brief Subscribe to an MQTT topic with a streaming handler.
+ *
+ * Called to send a subscribe message to the broker requesting a subscription
+ * to an MQTT topic. Payloads larger than the RX buffer are delivered to the
+ * handler in chunks instead of being dropped.
+ * It is also responsible for client state changes
+ * @note Call is blocking.  The call returns after the receipt of the SUBACK control packet.
+ * @warning pTopicName and pApplicationHandlerData need to be static in memory.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic Name to subscribe to. pTopicName needs to be static in memory since
+ *     no malloc are performed by the SDK
+ * @param topicNameLen Length of the topic name
+ * @param pStreamApplicationHandler Reference to the streaming handler function for this subscription
+ * @param pApplicationHandlerData Point to data passed to the callback.
+ *    pApplicationHandlerData also needs to be static in memory  since no malloc are performed by the SDK
+ *
+ * @return An IoT Error Type defining successful/failed subscription
+ */
+IoT_Error_t aws_iot_mqtt_subscribe_stream(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+										  QoS qos, pStreamApplicationHandler_t pStreamApplicationHandler,
+										  void *pApplicationHandlerData) {
+	ClientState clientState;
+	IoT_Error_t rc, subRc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTopicName || NULL == pStreamApplicationHandler) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
+	}
+
+	/* Waits for a running yield to hand over the read side when threads may block */
+	rc = aws_iot_mqtt_internal_acquire_client_state(pClient, CLIENT_STATE_CONNECTED_SUBSCRIBE_IN_PROGRESS, true,
+													pClient->clientData.commandTimeoutMs, &clientState);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
 
 	subRc = _aws_iot_mqtt_internal_subscribe(pClient, pTopicName, topicNameLen, qos,
-											 pApplicationHandler, pApplicationHandlerData);
+											 NULL, pStreamApplicationHandler, pApplicationHandlerData);
+
+	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_SUBSCRIBE_IN_PROGRESS, clientState);
+	if(SUCCESS == subRc && SUCCESS != rc) {
+		subRc = rc;
+	}
+
+	FUNC_EXIT_RC(subRc);
+}
+
+/**
+ * @brief Subscribe to several MQTT topics with one SUBSCRIBE packet.
+ *
+ * Internal function called by the subscribe batch API, doesn't do validations or client state changes
+ * @note Call is blocking.  The call returns after the receipt of the SUBACK control packet.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pParams Array of topic filters, returnCode is set from the SUBACK
+ * @param count Number of entries in pParams
+ *
+ * @return An IoT Error Type defining successful/failed subscription
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_subscribe_batch(AWS_IoT_Client *pClient, IoT_Subscribe_Params *pParams,
+														  uint32_t count) {
+	uint16_t rxPacketId;
+	uint32_t itr, grantedCount;
+	uint32_t handlerIndexes[AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET];
+	const char *pTopicNames[AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET];
+	uint16_t topicNameLens[AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET];
+	QoS requestedQoS[AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET];
+	QoS grantedQoS[AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET];
+	IoT_Error_t rc = SUCCESS;
+	Timer timer;
+	MessageHandlers *pHandler;
+
+	FUNC_ENTRY;
+	init_timer(&timer);
+	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
+
+	/* Link the handlers before sending so messages following the SUBACK are delivered */
+	for(itr = 0; itr < count; itr++) {
+		handlerIndexes[itr] = _aws_iot_mqtt_get_free_message_handler_index(pClient);
+		if(pClient->clientData.messageHandlerCount <= handlerIndexes[itr]) {
+			rc = MQTT_MAX_SUBSCRIPTIONS_REACHED_ERROR;
+			break;
+		}
+
+		pHandler = &(pClient->clientData.pMessageHandlers[handlerIndexes[itr]]);
+		pHandler->topicName = pParams[itr].pTopicName;
+		pHandler->topicNameLen = pParams[itr].topicNameLen;
+		pHandler->pApplicationHandler = pParams[itr].pApplicationHandler;
+		pHandler->pStreamApplicationHandler = NULL;
+		pHandler->pApplicationHandlerData = pParams[itr].pApplicationHandlerData;
+		pHandler->isDecompressEnabled = false;
+		pHandler->qos = pParams[itr].qos;
+
+		rc = aws_iot_mqtt_internal_trie_insert(pClient, handlerIndexes[itr]);
+		if(SUCCESS != rc) {
+			pHandler->topicName = NULL;
+			break;
+		}
+
+		pTopicNames[itr] = pParams[itr].pTopicName;
+		topicNameLens[itr] = pParams[itr].topicNameLen;
+		requestedQoS[itr] = pParams[itr].qos;
+	}
+
+	if(SUCCESS == rc) {
+		rc = _aws_iot_mqtt_send_subscribe(pClient, aws_iot_mqtt_get_next_packet_id(pClient), count, pTopicNames,
+										  topicNameLens, requestedQoS, &timer);
+	}
+
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_internal_wait_for_read(pClient, SUBACK, &timer);
+	}
+
+	if(SUCCESS == rc) {
+		rc = _aws_iot_mqtt_deserialize_suback(pClient->clientData.options.MQTTVersion, &rxPacketId, count,
+											  &grantedCount, grantedQoS, pClient->clientData.readBuf,
+											  pClient->clientData.readBufSize);
+		if(SUCCESS == rc && grantedCount != count) {
+			rc = FAILURE;
+		}
+	}
+
+	if(SUCCESS != rc) {
+		/* itr is the number of handlers linked above */
+		while(0 < itr) {
+			itr--;
+			aws_iot_mqtt_internal_trie_remove(pClient, handlerIndexes[itr]);
+		}
+		FUNC_EXIT_RC(rc);
+	}
+
+	for(itr = 0; itr < count; itr++) {
+		pParams[itr].returnCode = (uint8_t) grantedQoS[itr];
+		if(AWS_IOT_MQTT_SUBACK_FAILURE == pParams[itr].returnCode) {
+			aws_iot_mqtt_internal_trie_remove(pClient, handlerIndexes[itr]);
+			rc = FAILURE;
+		}
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
+/**
+ * @brief Subscribe to several MQTT topics at once.
+ *
+ * Outer function of the subscribe batch API, does the validations and the client state changes
+ * @note Call is blocking.  The call returns after the receipt of the SUBACK control packet.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pParams Array of topic filters, returnCode is set from the SUBACK
+ * @param count Number of entries in pParams
+ *
+ * @return An IoT Error Type defining successful/failed subscription
+ */
+IoT_Error_t aws_iot_mqtt_subscribe_batch(AWS_IoT_Client *pClient, IoT_Subscribe_Params *pParams, uint32_t count) {
+	ClientState clientState;
+	IoT_Error_t rc, subRc;
+	uint32_t itr;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pParams) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(0 == count || AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET < count) {
+		FUNC_EXIT_RC(LIMIT_EXCEEDED_ERROR);
+	}
+
+	for(itr = 0; itr < count; itr++) {
+		if(NULL == pParams[itr].pTopicName || NULL == pParams[itr].pApplicationHandler) {
+			FUNC_EXIT_RC(NULL_VALUE_ERROR);
+		}
+		pParams[itr].returnCode = AWS_IOT_MQTT_SUBACK_FAILURE;
+	}
+
+	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
+	}
+
+	/* Waits for a running yield to hand over the read side when threads may block */
+	rc = aws_iot_mqtt_internal_acquire_client_state(pClient, CLIENT_STATE_CONNECTED_SUBSCRIBE_IN_PROGRESS, true,
+													pClient->clientData.commandTimeoutMs, &clientState);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	subRc = _aws_iot_mqtt_internal_subscribe_batch(pClient, pParams, count);
 
 	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_SUBSCRIBE_IN_PROGRESS, clientState);
 	if(SUCCESS == subRc && SUCCESS != rc) {
@@ -336,7 +603,9 @@ IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicNa
  * to an MQTT topic.
  * This is the internal function which is called by the resubscribe API to perform the operation.
  * Not meant to be called directly as it doesn't do validations or client state changes
- * @note Call is blocking.  The call returns after the receipt of the SUBACK control packet.
+ * The filters are packed into as few SUBSCRIBE packets as possible and all the packets are sent
+ * before the first SUBACK is read, so the whole table costs one round trip.
+ * @note Call is blocking.  The call returns after the receipt of the last SUBACK control packet.
  *
  * @param pClient Reference to the IoT Client
  *
@@ -344,41 +613,63 @@ IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicNa
  */
 static IoT_Error_t _aws_iot_mqtt_internal_resubscribe(AWS_IoT_Client *pClient) {
 	uint16_t packetId;
-	uint32_t len, count, existingSubCount, itr;
+	uint32_t count, itr, filterCount, packetCount, remLen;
 	IoT_Error_t rc;
 	Timer timer;
-	QoS grantedQoS[3] = {QOS0, QOS0, QOS0};
+	const char *pTopicNames[AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET];
+	uint16_t topicNameLens[AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET];
+	QoS requestedQoS[AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET];
+	QoS grantedQoS[AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET];
+	MessageHandlers *pHandler;
 
 	FUNC_ENTRY;
 
 	packetId = 0;
-	len = 0;
 	count = 0;
-	existingSubCount = _aws_iot_mqtt_get_free_message_handler_index(pClient);
+	packetCount = 0;
 
-	for(itr = 0; itr < existingSubCount; itr++) {
-		if(pClient->clientData.messageHandlers[itr].topicName == NULL) {
-			continue;
-		}
+	init_timer(&timer);
+	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
 
-		init_timer(&timer);
-		countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
+	/* Slots freed by unsubscribe leave holes, walk the whole table */
+	itr = 0;
+	while(itr < pClient->clientData.messageHandlerCount) {
+		filterCount = 0;
+		remLen = _aws_iot_mqtt_subscribe_header_len(pClient->clientData.options.MQTTVersion);
+		for(; itr < pClient->clientData.messageHandlerCount && filterCount < AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET;
+			itr++) {
+			pHandler = &(pClient->clientData.pMessageHandlers[itr]);
+			if(pHandler->topicName == NULL) {
+				continue;
+			}
+
+			/* Start a new packet when the filter does not fit behind the previous ones */
+			if(0 < filterCount && aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(
+					remLen + pHandler->topicNameLen + 3) >= pClient->clientData.writeBufSize) {
+				break;
+			}
+
+			pTopicNames[filterCount] = pHandler->topicName;
+			topicNameLens[filterCount] = pHandler->topicNameLen;
+			requestedQoS[filterCount] = pHandler->qos;
+			remLen += (uint32_t) (pHandler->topicNameLen + 2 + 1); /* topic + length + req_qos */
+			filterCount++;
+		}
 
-		rc = _aws_iot_mqtt_serialize_subscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize, 0,
-											   aws_iot_mqtt_get_next_packet_id(pClient), 1,
-											   &(pClient->clientData.messageHandlers[itr].topicName),
-											   &(pClient->clientData.messageHandlers[itr].topicNameLen),
-											   &(pClient->clientData.messageHandlers[itr].qos), &len);
-		if(SUCCESS != rc) {
-			FUNC_EXIT_RC(rc);
+		if(0 == filterCount) {
+			break;
 		}
 
 		/* send the subscribe packet */
-		rc = aws_iot_mqtt_internal_send_packet(pClient, len, &timer);
+		rc = _aws_iot_mqtt_send_subscribe(pClient, aws_iot_mqtt_get_next_packet_id(pClient), filterCount,
+										  pTopicNames, topicNameLens, requestedQoS, &timer);
 		if(SUCCESS != rc) {
 			FUNC_EXIT_RC(rc);
 		}
+		packetCount++;
+	}
 
+	for(itr = 0; itr < packetCount; itr++) {
 		/* wait for suback */
 		rc = aws_iot_mqtt_internal_wait_for_read(pClient, SUBACK, &timer);
 		if(SUCCESS != rc) {
@@ -386,8 +677,9 @@ static IoT_Error_t _aws_iot_mqtt_internal_resubscribe(AWS_IoT_Client *pClient) {
 		}
 
 		/* Granted QoS can be 0, 1 or 2 */
-		rc = _aws_iot_mqtt_deserialize_suback(&packetId, 1, &count, grantedQoS, pClient->clientData.readBuf,
-											  pClient->clientData.readBufSize);
+		rc = _aws_iot_mqtt_deserialize_suback(pClient->clientData.options.MQTTVersion, &packetId,
+											  AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET, &count, grantedQoS,
+											  pClient->clientData.readBuf, pClient->clientData.readBufSize);
 		if(SUCCESS != rc) {
 			FUNC_EXIT_RC(rc);
 		}
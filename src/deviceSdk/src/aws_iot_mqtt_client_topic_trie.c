@@ -0,0 +1,473 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_client_topic_trie.c
+ * @brief MQTT client topic filter trie used to dispatch incoming messages
+ *
+ * Every subscribed topic filter is stored as a path of nodes, one node per topic level.
+ * Incoming topic names walk the trie level by level so dispatch cost depends on the
+ * depth of the topic and not on the number of subscriptions.
+ * Nodes and handlers are kept in the arrays of the client, no malloc is performed.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sdk/aws_iot_mqtt_client.h"
+#include "sdk/aws_iot_mqtt_client_common_internal.h"
+#include "sdk/aws_iot_mqtt_client_compress.h"
+
+#define TRIE_ROOT_NODE 0
+
+/* 32 bit FNV-1a of a single topic level */
+static uint32_t _aws_iot_mqtt_trie_hash_level(const char *pLevel, uint16_t levelLen) {
+	uint32_t hash = 2166136261u;
+	uint16_t i;
+
+	for(i = 0; i < levelLen; i++) {
+		hash ^= (unsigned char) pLevel[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* Returns the length of the topic level starting at pLevel */
+static uint16_t _aws_iot_mqtt_trie_level_len(const char *pLevel, const char *pEnd) {
+	const char *cur = pLevel;
+
+	while(cur < pEnd && '/' != *cur) {
+		cur++;
+	}
+
+	return (uint16_t) (cur - pLevel);
+}
+
+/**
+ * @brief Check a topic name against a topic filter
+ *
+ * Exact level-wise match used to confirm trie matches, literal levels in the trie
+ * are only compared by hash and length.
+ * '#' matches the parent level and any number of levels below it, '+' matches one level.
+ * Topic names starting with '$' are not matched by a wildcard in the first level.
+ */
+static bool _aws_iot_mqtt_trie_is_topic_matched(const char *pTopicFilter, uint16_t topicFilterLen,
+												const char *pTopicName, uint16_t topicNameLen) {
+	const char *curf, *curf_end, *curn, *curn_end;
+	uint16_t filterLevelLen, nameLevelLen;
+	bool nameDone = false;
+
+	curf = pTopicFilter;
+	curf_end = pTopicFilter + topicFilterLen;
+	curn = pTopicName;
+	curn_end = pTopicName + topicNameLen;
+
+	if(0 < topicNameLen && '$' == *curn && 0 < topicFilterLen && ('+' == *curf || '#' == *curf)) {
+		return false;
+	}
+
+	for(;;) {
+		filterLevelLen = _aws_iot_mqtt_trie_level_len(curf, curf_end);
+		if(1 == filterLevelLen && '#' == *curf) {
+			return true;
+		}
+		if(nameDone) {
+			return false;
+		}
+
+		nameLevelLen = _aws_iot_mqtt_trie_level_len(curn, curn_end);
+		if(!(1 == filterLevelLen && '+' == *curf)) {
+			if(filterLevelLen != nameLevelLen || 0 != strncmp(curf, curn, filterLevelLen)) {
+				return false;
+			}
+		}
+
+		if(curn + nameLevelLen == curn_end) {
+			nameDone = true;
+		} else {
+			curn += nameLevelLen + 1;
+		}
+
+		if(curf + filterLevelLen == curf_end) {
+			return nameDone;
+		}
+		curf += filterLevelLen + 1;
+	}
+}
+
+static uint16_t _aws_iot_mqtt_trie_find_child(TopicTrieNode *pNodes, uint16_t parent, uint8_t levelType,
+											  uint32_t levelHash, uint16_t levelLen) {
+	uint16_t child = pNodes[parent].firstChild;
+
+	while(AWS_IOT_MQTT_TRIE_NONE != child) {
+		if(pNodes[child].levelType == levelType &&
+		   (TOPIC_TRIE_LEVEL_LITERAL != levelType ||
+			(pNodes[child].levelLen == levelLen && pNodes[child].levelHash == levelHash))) {
+			break;
+		}
+		child = pNodes[child].nextSibling;
+	}
+
+	return child;
+}
+
+/* Returns AWS_IOT_MQTT_TRIE_NONE if the node pool is exhausted */
+static uint16_t _aws_iot_mqtt_trie_add_child(AWS_IoT_Client *pClient, uint16_t parent, uint8_t levelType,
+											 uint32_t levelHash, uint16_t levelLen) {
+	TopicTrieNode *pNodes = pClient->clientData.pTopicTrieNodes;
+	uint32_t itr;
+
+	for(itr = TRIE_ROOT_NODE + 1; itr < pClient->clientData.topicTrieNodeCount; itr++) {
+		if(TOPIC_TRIE_LEVEL_FREE == pNodes[itr].levelType) {
+			pNodes[itr].levelType = levelType;
+			pNodes[itr].levelHash = levelHash;
+			pNodes[itr].levelLen = levelLen;
+			pNodes[itr].parent = parent;
+			pNodes[itr].firstChild = AWS_IOT_MQTT_TRIE_NONE;
+			pNodes[itr].firstHandler = AWS_IOT_MQTT_TRIE_NONE;
+			pNodes[itr].nextSibling = pNodes[parent].firstChild;
+			pNodes[parent].firstChild = (uint16_t) itr;
+			return (uint16_t) itr;
+		}
+	}
+
+	return AWS_IOT_MQTT_TRIE_NONE;
+}
+
+/* Releases nodes left without handlers or children, walking up from node */
+static void _aws_iot_mqtt_trie_prune(TopicTrieNode *pNodes, uint16_t node) {
+	uint16_t parent, *pLink;
+
+	while(TRIE_ROOT_NODE != node && AWS_IOT_MQTT_TRIE_NONE == pNodes[node].firstHandler &&
+		  AWS_IOT_MQTT_TRIE_NONE == pNodes[node].firstChild) {
+		parent = pNodes[node].parent;
+		pLink = &(pNodes[parent].firstChild);
+		while(*pLink != node) {
+			pLink = &(pNodes[*pLink].nextSibling);
+		}
+		*pLink = pNodes[node].nextSibling;
+		pNodes[node].levelType = TOPIC_TRIE_LEVEL_FREE;
+		node = parent;
+	}
+}
+
+static void _aws_iot_mqtt_trie_unlink_handler(AWS_IoT_Client *pClient, uint32_t handlerIndex) {
+	TopicTrieNode *pNodes = pClient->clientData.pTopicTrieNodes;
+	MessageHandlers *pHandlers = pClient->clientData.pMessageHandlers;
+	uint16_t node, *pLink;
+
+	node = pHandlers[handlerIndex].trieNode;
+	pLink = &(pNodes[node].firstHandler);
+	while(*pLink != handlerIndex) {
+		pLink = &(pHandlers[*pLink].nextHandler);
+	}
+	*pLink = pHandlers[handlerIndex].nextHandler;
+
+	pHandlers[handlerIndex].topicName = NULL;
+	pHandlers[handlerIndex].trieNode = AWS_IOT_MQTT_TRIE_NONE;
+	pHandlers[handlerIndex].nextHandler = AWS_IOT_MQTT_TRIE_NONE;
+
+	_aws_iot_mqtt_trie_prune(pNodes, node);
+}
+
+void aws_iot_mqtt_internal_trie_init(AWS_IoT_Client *pClient) {
+	TopicTrieNode *pNodes = pClient->clientData.pTopicTrieNodes;
+	MessageHandlers *pHandlers = pClient->clientData.pMessageHandlers;
+	uint32_t itr;
+
+	for(itr = 0; itr < pClient->clientData.messageHandlerCount; itr++) {
+		pHandlers[itr].topicName = NULL;
+		pHandlers[itr].topicNameLen = 0;
+		pHandlers[itr].pApplicationHandler = NULL;
+		pHandlers[itr].pStreamApplicationHandler = NULL;
+		pHandlers[itr].pApplicationHandlerData = NULL;
+		pHandlers[itr].isDecompressEnabled = false;
+		pHandlers[itr].qos = QOS0;
+		pHandlers[itr].trieNode = AWS_IOT_MQTT_TRIE_NONE;
+		pHandlers[itr].nextHandler = AWS_IOT_MQTT_TRIE_NONE;
+	}
+
+	for(itr = 0; itr < pClient->clientData.topicTrieNodeCount; itr++) {
+		pNodes[itr].levelType = TOPIC_TRIE_LEVEL_FREE;
+		pNodes[itr].levelHash = 0;
+		pNodes[itr].levelLen = 0;
+		pNodes[itr].parent = AWS_IOT_MQTT_TRIE_NONE;
+		pNodes[itr].firstChild = AWS_IOT_MQTT_TRIE_NONE;
+		pNodes[itr].nextSibling = AWS_IOT_MQTT_TRIE_NONE;
+		pNodes[itr].firstHandler = AWS_IOT_MQTT_TRIE_NONE;
+	}
+	pNodes[TRIE_ROOT_NODE].levelType = TOPIC_TRIE_LEVEL_ROOT;
+}
+
+/**
+ * @brief Link a message handler into the trie
+ *
+ * The handler at handlerIndex must already hold its topic filter.
+ * On failure the nodes created for this filter are released again.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param handlerIndex Index of the handler in the subscription table
+ *
+ * @return MQTT_MAX_SUBSCRIPTIONS_REACHED_ERROR if the node pool is exhausted
+ */
+IoT_Error_t aws_iot_mqtt_internal_trie_insert(AWS_IoT_Client *pClient, uint32_t handlerIndex) {
+	TopicTrieNode *pNodes = pClient->clientData.pTopicTrieNodes;
+	MessageHandlers *pHandler = &(pClient->clientData.pMessageHandlers[handlerIndex]);
+	const char *curf, *curf_end;
+	uint16_t node, child, levelLen;
+	uint32_t levelHash;
+	uint8_t levelType;
+
+	FUNC_ENTRY;
+
+	curf = pHandler->topicName;
+	curf_end = curf + pHandler->topicNameLen;
+	node = TRIE_ROOT_NODE;
+
+	for(;;) {
+		levelLen = _aws_iot_mqtt_trie_level_len(curf, curf_end);
+		levelHash = 0;
+		if(1 == levelLen && '+' == *curf) {
+			levelType = TOPIC_TRIE_LEVEL_SINGLE;
+		} else if(1 == levelLen && '#' == *curf) {
+			levelType = TOPIC_TRIE_LEVEL_MULTI;
+		} else {
+			levelType = TOPIC_TRIE_LEVEL_LITERAL;
+			levelHash = _aws_iot_mqtt_trie_hash_level(curf, levelLen);
+		}
+
+		child = _aws_iot_mqtt_trie_find_child(pNodes, node, levelType, levelHash, levelLen);
+		if(AWS_IOT_MQTT_TRIE_NONE == child) {
+			child = _aws_iot_mqtt_trie_add_child(pClient, node, levelType, levelHash, levelLen);
+			if(AWS_IOT_MQTT_TRIE_NONE == child) {
+				_aws_iot_mqtt_trie_prune(pNodes, node);
+				FUNC_EXIT_RC(MQTT_MAX_SUBSCRIPTIONS_REACHED_ERROR);
+			}
+		}
+		node = child;
+
+		if(curf + levelLen == curf_end) {
+			break;
+		}
+		curf += levelLen + 1;
+	}
+
+	pHandler->trieNode = node;
+	pHandler->nextHandler = pNodes[node].firstHandler;
+	pNodes[node].firstHandler = (uint16_t) handlerIndex;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+/**
+ * @brief Remove a message handler from the trie and free its slot
+ *
+ * While a message is being dispatched the handler is only disabled, it is unlinked
+ * once the outermost dispatch returns so the lists being walked stay intact.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param handlerIndex Index of the handler in the subscription table
+ */
+void aws_iot_mqtt_internal_trie_remove(AWS_IoT_Client *pClient, uint32_t handlerIndex) {
+	MessageHandlers *pHandler = &(pClient->clientData.pMessageHandlers[handlerIndex]);
+
+	pHandler->topicName = NULL;
+	if(AWS_IOT_MQTT_TRIE_NONE == pHandler->trieNode || 0 < pClient->clientData.dispatchDepth) {
+		return;
+	}
+
+	_aws_iot_mqtt_trie_unlink_handler(pClient, handlerIndex);
+}
+
+/* Describes the message or message chunk being dispatched */
+typedef struct {
+	char *pTopicName;
+	uint16_t topicNameLen;
+	IoT_Publish_Message_Params *pMessageParams;
+	size_t chunkOffset;
+	size_t totalLen;
+	bool isFinal;
+	uint32_t handlerCount;
+	IoT_Publish_Message_Params *pDecompressedParams;	///< Set once the payload was decompressed, NULL if it is delivered as received
+	bool isDecompressTried;
+	IoT_Publish_Message_Params decompressedParams;
+} TrieDispatch;
+
+/* Message handed to a handler, decompressed on the first handler asking for it */
+static IoT_Publish_Message_Params *_aws_iot_mqtt_trie_get_message(AWS_IoT_Client *pClient, MessageHandlers *pHandler,
+																   TrieDispatch *pDispatch, bool isWholeMessage) {
+	IoT_Publish_Message_Params *pParams = pDispatch->pMessageParams;
+	IoT_Error_t rc;
+
+	if(!isWholeMessage || !__atomic_load_n(&(pHandler->isDecompressEnabled), __ATOMIC_RELAXED)) {
+		return pParams;
+	}
+
+	if(!pDispatch->isDecompressTried) {
+		pDispatch->isDecompressTried = true;
+		if(NULL != pClient->clientData.pDecompressBuf &&
+		   aws_iot_mqtt_is_payload_compressed((unsigned char *) pParams->payload, pParams->payloadLen)) {
+			pDispatch->decompressedParams = *pParams;
+			rc = aws_iot_mqtt_decompress_payload((unsigned char *) pParams->payload, pParams->payloadLen,
+												 pClient->clientData.pDecompressBuf,
+												 pClient->clientData.decompressBufLen,
+												 &(pDispatch->decompressedParams.payloadLen));
+			if(SUCCESS == rc) {
+				pDispatch->decompressedParams.payload = pClient->clientData.pDecompressBuf;
+				pDispatch->pDecompressedParams = &(pDispatch->decompressedParams);
+			} else {
+				/* The payload may be binary data starting with a codec byte, it is delivered as received */
+				IOT_WARN("Delivering a payload that failed to decompress on %.*s as received, rc %d",
+						 pDispatch->topicNameLen, pDispatch->pTopicName, rc);
+			}
+		}
+	}
+
+	return (NULL != pDispatch->pDecompressedParams) ? pDispatch->pDecompressedParams : pParams;
+}
+
+static void _aws_iot_mqtt_trie_call_handlers(AWS_IoT_Client *pClient, uint16_t node, TrieDispatch *pDispatch) {
+	MessageHandlers *pHandlers = pClient->clientData.pMessageHandlers;
+	uint16_t itr = pClient->clientData.pTopicTrieNodes[node].firstHandler;
+	bool isWholeMessage = (0 == pDispatch->chunkOffset && pDispatch->isFinal);
+
+	while(AWS_IOT_MQTT_TRIE_NONE != itr) {
+		if(NULL != pHandlers[itr].topicName &&
+		   _aws_iot_mqtt_trie_is_topic_matched(pHandlers[itr].topicName, pHandlers[itr].topicNameLen,
+											   pDispatch->pTopicName, pDispatch->topicNameLen)) {
+			if(NULL != pHandlers[itr].pStreamApplicationHandler) {
+				pHandlers[itr].pStreamApplicationHandler(pClient, pDispatch->pTopicName, pDispatch->topicNameLen,
+														 _aws_iot_mqtt_trie_get_message(pClient, &(pHandlers[itr]),
+																						pDispatch, isWholeMessage),
+														 pDispatch->chunkOffset,
+														 pDispatch->totalLen, pDispatch->isFinal,
+														 pHandlers[itr].pApplicationHandlerData);
+				pDispatch->handlerCount++;
+			} else if(NULL != pHandlers[itr].pApplicationHandler && isWholeMessage) {
+				/* Handlers without streaming only see messages that fit in the RX buffer */
+				pHandlers[itr].pApplicationHandler(pClient, pDispatch->pTopicName, pDispatch->topicNameLen,
+												   _aws_iot_mqtt_trie_get_message(pClient, &(pHandlers[itr]),
+																				  pDispatch, isWholeMessage),
+												   pHandlers[itr].pApplicationHandlerData);
+				pDispatch->handlerCount++;
+			}
+		}
+		itr = pHandlers[itr].nextHandler;
+	}
+}
+
+/* Matches the topic level at pLevel against the children of node */
+static void _aws_iot_mqtt_trie_match(AWS_IoT_Client *pClient, uint16_t node, char *pLevel,
+									 TrieDispatch *pDispatch) {
+	TopicTrieNode *pNodes = pClient->clientData.pTopicTrieNodes;
+	char *pEnd = pDispatch->pTopicName + pDispatch->topicNameLen;
+	uint16_t child, grandChild, levelLen;
+	uint32_t levelHash;
+	bool isLastLevel, allowWildcard;
+
+	levelLen = _aws_iot_mqtt_trie_level_len(pLevel, pEnd);
+	levelHash = _aws_iot_mqtt_trie_hash_level(pLevel, levelLen);
+	isLastLevel = (pLevel + levelLen == pEnd);
+	/* Wildcards in the first level do not match topics starting with '$' */
+	allowWildcard = !(pLevel == pDispatch->pTopicName && 0 < levelLen && '$' == *pLevel);
+
+	for(child = pNodes[node].firstChild; AWS_IOT_MQTT_TRIE_NONE != child; child = pNodes[child].nextSibling) {
+		if(TOPIC_TRIE_LEVEL_MULTI == pNodes[child].levelType) {
+			if(allowWildcard) {
+				_aws_iot_mqtt_trie_call_handlers(pClient, child, pDispatch);
+			}
+			continue;
+		}
+
+		if(TOPIC_TRIE_LEVEL_SINGLE == pNodes[child].levelType) {
+			if(!allowWildcard) {
+				continue;
+			}
+		} else if(pNodes[child].levelLen != levelLen || pNodes[child].levelHash != levelHash) {
+			continue;
+		}
+
+		if(!isLastLevel) {
+			_aws_iot_mqtt_trie_match(pClient, child, pLevel + levelLen + 1, pDispatch);
+			continue;
+		}
+
+		_aws_iot_mqtt_trie_call_handlers(pClient, child, pDispatch);
+		/* "a/#" also matches "a" */
+		grandChild = _aws_iot_mqtt_trie_find_child(pNodes, child, TOPIC_TRIE_LEVEL_MULTI, 0, 0);
+		if(AWS_IOT_MQTT_TRIE_NONE != grandChild) {
+			_aws_iot_mqtt_trie_call_handlers(pClient, grandChild, pDispatch);
+		}
+	}
+}
+
+/**
+ * @brief Call the handlers of all topic filters matching a topic name
+ *
+ * Streaming handlers get every chunk, other handlers only get messages delivered
+ * in one piece. Handlers may subscribe or unsubscribe from inside the callback,
+ * removals are applied once the outermost dispatch completes.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic name of the incoming message
+ * @param topicNameLen Length of the topic name
+ * @param pMessageParams Incoming message passed to the handlers, payload holds the current chunk
+ * @param chunkOffset Offset of the chunk in the message payload
+ * @param totalLen Length of the whole message payload
+ * @param isFinal true if this chunk ends the message
+ *
+ * @return Number of handlers called
+ */
+uint32_t aws_iot_mqtt_internal_trie_dispatch(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+											 IoT_Publish_Message_Params *pMessageParams, size_t chunkOffset,
+											 size_t totalLen, bool isFinal) {
+	MessageHandlers *pHandlers;
+	TrieDispatch dispatch;
+	uint32_t itr;
+
+	dispatch.pTopicName = pTopicName;
+	dispatch.topicNameLen = topicNameLen;
+	dispatch.pMessageParams = pMessageParams;
+	dispatch.chunkOffset = chunkOffset;
+	dispatch.totalLen = totalLen;
+	dispatch.isFinal = isFinal;
+	dispatch.handlerCount = 0;
+	dispatch.pDecompressedParams = NULL;
+	dispatch.isDecompressTried = false;
+
+	pClient->clientData.dispatchDepth++;
+	_aws_iot_mqtt_trie_match(pClient, TRIE_ROOT_NODE, pTopicName, &dispatch);
+	pClient->clientData.dispatchDepth--;
+
+	if(0 < pClient->clientData.dispatchDepth) {
+		return dispatch.handlerCount;
+	}
+
+	/* Unlink handlers removed while dispatching */
+	pHandlers = pClient->clientData.pMessageHandlers;
+	for(itr = 0; itr < pClient->clientData.messageHandlerCount; itr++) {
+		if(NULL == pHandlers[itr].topicName && AWS_IOT_MQTT_TRIE_NONE != pHandlers[itr].trieNode) {
+			_aws_iot_mqtt_trie_unlink_handler(pClient, itr);
+		}
+	}
+
+	return dispatch.handlerCount;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -45,6 +45,7 @@ extern "C" {
   * Serializes the supplied unsubscribe data into the supplied buffer, ready for sending
   * @param pTxBuf the raw buffer data, of the correct length determined by the remaining length field
   * @param txBufLen the length in bytes of the data in the supplied buffer
+  * @param version MQTT_Ver_t - the MQTT version of the connection
   * @param dup integer - the MQTT dup flag
   * @param packetId integer - the MQTT packet identifier
   * @param count - number of members in the topicFilters array
@@ -54,7 +55,7 @@ extern "C" {
   * @return IoT_Error_t indicating function execution status
   */
 static IoT_Error_t _aws_iot_mqtt_serialize_unsubscribe(unsigned char *pTxBuf, size_t txBufLen,
-													   uint8_t dup, uint16_t packetId,
+													   MQTT_Ver_t version, uint8_t dup, uint16_t packetId,
 													   uint32_t count, const char **pTopicNameList,
 													   uint16_t *pTopicNameLenList, uint32_t *pSerializedLen) {
 	unsigned char *ptr = pTxBuf;
@@ -65,11 +66,16 @@ static IoT_Error_t _aws_iot_mqtt_serialize_unsubscribe(unsigned char *pTxBuf, si
 
 	FUNC_ENTRY;
 
+	if(MQTT_5 == version) {
+		rem_len += 1; /* empty property list */
+	}
+
 	for(i = 0; i < count; ++i) {
 		rem_len += (uint32_t) (pTopicNameLenList[i] + 2); /* topic + length */
 	}
 
-	if(aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(rem_len) > txBufLen) {
+	/* aws_iot_mqtt_internal_send_packet refuses a packet filling the whole buffer */
+	if(aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(rem_len) >= txBufLen) {
 		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
 	}
 
@@ -82,6 +88,9 @@ static IoT_Error_t _aws_iot_mqtt_serialize_unsubscribe(unsigned char *pTxBuf, si
 	ptr += aws_iot_mqtt_internal_write_len_to_buffer(ptr, rem_len); /* write remaining length */
 
 	aws_iot_mqtt_internal_write_uint_16(&ptr, packetId);
+	if(MQTT_5 == version) {
+		aws_iot_mqtt_internal_write_char(&ptr, 0);
+	}
 
 	for(i = 0; i < count; ++i) {
 		aws_iot_mqtt_internal_write_utf8_string(&ptr, pTopicNameList[i], pTopicNameLenList[i]);
@@ -115,23 +124,38 @@ static IoT_Error_t _aws_iot_mqtt_deserialize_unsuback(uint16_t *pPacketId, unsig
 	FUNC_EXIT_RC(rc);
 }
 
+/* Returns true if a handler is registered for the topic filter */
+static bool _aws_iot_mqtt_is_subscribed(AWS_IoT_Client *pClient, const char *pTopicFilter) {
+	uint32_t i;
+
+	for(i = 0; i < pClient->clientData.messageHandlerCount; ++i) {
+		if(pClient->clientData.pMessageHandlers[i].topicName != NULL &&
+		   (strcmp(pClient->clientData.pMessageHandlers[i].topicName, pTopicFilter) == 0)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /**
- * @brief Unsubscribe to an MQTT topic.
+ * @brief Unsubscribe to MQTT topics.
  *
- * Called to send an unsubscribe message to the broker requesting removal of a subscription
- * to an MQTT topic.
+ * Called to send an unsubscribe message to the broker requesting removal of the subscriptions
+ * to count MQTT topics, all packed into one UNSUBSCRIBE packet.
  * @note Call is blocking.  The call returns after the receipt of the UNSUBACK control packet.
- * This is the internal function which is called by the unsubscribe API to perform the operation.
+ * This is the internal function which is called by the unsubscribe APIs to perform the operation.
  * Not meant to be called directly as it doesn't do validations or client state changes
  *
  * @param pClient Reference to the IoT Client
- * @param pTopicName Topic Name to publish to
- * @param topicNameLen Length of the topic name
+ * @param pTopicFilters Array of topic filters
+ * @param pTopicFilterLens Array of the lengths of the topic filters
+ * @param count Number of topic filters
  *
  * @return An IoT Error Type defining successful/failed unsubscribe call
  */
-static IoT_Error_t _aws_iot_mqtt_internal_unsubscribe(AWS_IoT_Client *pClient, const char *pTopicFilter,
-													  uint16_t topicFilterLen) {
+static IoT_Error_t _aws_iot_mqtt_internal_unsubscribe(AWS_IoT_Client *pClient, const char **pTopicFilters,
+													  uint16_t *pTopicFilterLens, uint32_t count) {
 	/* No NULL checks because this is a static internal function */
 
 	Timer timer;
@@ -139,39 +163,41 @@ static IoT_Error_t _aws_iot_mqtt_internal_unsubscribe(AWS_IoT_Client *pClient, c
 	uint16_t packet_id;
 	uint32_t serializedLen = 0;
 	uint32_t i = 0;
-	IoT_Error_t rc;
-	bool subscriptionExists = false;
+	uint32_t filter;
+	IoT_Error_t rc, threadRc;
 
 	FUNC_ENTRY;
 
-	/* Remove from message handler array */
-	for(i = 0; i < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++i) {
-		if(pClient->clientData.messageHandlers[i].topicName != NULL &&
-		   (strcmp(pClient->clientData.messageHandlers[i].topicName, pTopicFilter) == 0)) {
-			subscriptionExists = true;
-            break;
+	for(filter = 0; filter < count; filter++) {
+		if(!_aws_iot_mqtt_is_subscribed(pClient, pTopicFilters[filter])) {
+			FUNC_EXIT_RC(FAILURE);
 		}
 	}
 
-	if(false == subscriptionExists) {
-		FUNC_EXIT_RC(FAILURE);
-	}
-
 	init_timer(&timer);
 	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
 
-	rc = _aws_iot_mqtt_serialize_unsubscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize, 0,
-											 aws_iot_mqtt_get_next_packet_id(pClient), 1, &pTopicFilter,
-											 &topicFilterLen, &serializedLen);
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
 
-	/* send the unsubscribe packet */
-	rc = aws_iot_mqtt_internal_send_packet(pClient, serializedLen, &timer);
+	rc = _aws_iot_mqtt_serialize_unsubscribe(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
+											 pClient->clientData.options.MQTTVersion, 0,
+											 aws_iot_mqtt_get_next_packet_id(pClient), count, pTopicFilters,
+											 pTopicFilterLens, &serializedLen);
+	if(SUCCESS == rc) {
+		/* send the unsubscribe packet */
+		rc = aws_iot_mqtt_internal_send_packet(pClient, serializedLen, &timer);
+	}
+
+	threadRc = aws_iot_mqtt_internal_unlock_write(pClient);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
+	if(SUCCESS != threadRc) {
+		FUNC_EXIT_RC(threadRc);
+	}
 
 	rc = aws_iot_mqtt_internal_wait_for_read(pClient, UNSUBACK, &timer);
 	if(SUCCESS != rc) {
@@ -184,12 +210,14 @@ static IoT_Error_t _aws_iot_mqtt_internal_unsubscribe(AWS_IoT_Client *pClient, c
 	}
 
 	/* Remove from message handler array */
-	for(i = 0; i < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++i) {
-		if(pClient->clientData.messageHandlers[i].topicName != NULL &&
-		   (strcmp(pClient->clientData.messageHandlers[i].topicName, pTopicFilter) == 0)) {
-			pClient->clientData.messageHandlers[i].topicName = NULL;
-			/* We don't want to break here, in case the same topic is registered
-             * with 2 callbacks. Unlikely scenario */
+	for(filter = 0; filter < count; filter++) {
+		for(i = 0; i < pClient->clientData.messageHandlerCount; ++i) {
+			if(pClient->clientData.pMessageHandlers[i].topicName != NULL &&
+			   (strcmp(pClient->clientData.pMessageHandlers[i].topicName, pTopicFilters[filter]) == 0)) {
+				aws_iot_mqtt_internal_trie_remove(pClient, i);
+				/* We don't want to break here, in case the same topic is registered
+				 * with 2 callbacks. Unlikely scenario */
+			}
 		}
 	}
 
@@ -223,18 +251,67 @@ IoT_Error_t aws_iot_mqtt_unsubscribe(AWS_IoT_Client *pClient, const char *pTopic
 		return NETWORK_DISCONNECTED_ERROR;
 	}
 
-	clientState = aws_iot_mqtt_get_client_state(pClient);
-	if(CLIENT_STATE_CONNECTED_IDLE != clientState && CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN != clientState) {
-		return MQTT_CLIENT_NOT_IDLE_ERROR;
+	rc = aws_iot_mqtt_internal_acquire_client_state(pClient, CLIENT_STATE_CONNECTED_UNSUBSCRIBE_IN_PROGRESS, true,
+													pClient->clientData.commandTimeoutMs, &clientState);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	unsubRc = _aws_iot_mqtt_internal_unsubscribe(pClient, &pTopicFilter, &topicFilterLen, 1);
+
+	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_UNSUBSCRIBE_IN_PROGRESS, clientState);
+	if(SUCCESS == unsubRc && SUCCESS != rc) {
+		unsubRc = rc;
+	}
+
+	return unsubRc;
+}
+
+/**
+ * @brief Unsubscribe from several MQTT topics at once.
+ *
+ * Called to send one unsubscribe message to the broker requesting removal of the
+ * subscriptions to all the topic filters.
+ * @note Call is blocking.  The call returns after the receipt of the UNSUBACK control packet.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicFilters Array of topic filters
+ * @param pTopicFilterLens Array of the lengths of the topic filters
+ * @param count Number of topic filters
+ *
+ * @return An IoT Error Type defining successful/failed unsubscribe call
+ */
+IoT_Error_t aws_iot_mqtt_unsubscribe_batch(AWS_IoT_Client *pClient, const char **pTopicFilters,
+										   uint16_t *pTopicFilterLens, uint32_t count) {
+	IoT_Error_t rc, unsubRc;
+	ClientState clientState;
+	uint32_t i;
+
+	if(NULL == pClient || NULL == pTopicFilters || NULL == pTopicFilterLens) {
+		return NULL_VALUE_ERROR;
+	}
+
+	if(0 == count || AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET < count) {
+		return LIMIT_EXCEEDED_ERROR;
+	}
+
+	for(i = 0; i < count; i++) {
+		if(NULL == pTopicFilters[i]) {
+			return NULL_VALUE_ERROR;
+		}
+	}
+
+	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		return NETWORK_DISCONNECTED_ERROR;
 	}
 
-	rc = aws_iot_mqtt_set_client_state(pClient, clientState, CLIENT_STATE_CONNECTED_UNSUBSCRIBE_IN_PROGRESS);
+	rc = aws_iot_mqtt_internal_acquire_client_state(pClient, CLIENT_STATE_CONNECTED_UNSUBSCRIBE_IN_PROGRESS, true,
+													pClient->clientData.commandTimeoutMs, &clientState);
 	if(SUCCESS != rc) {
-		rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_UNSUBSCRIBE_IN_PROGRESS, clientState);
 		return rc;
 	}
 
-	unsubRc = _aws_iot_mqtt_internal_unsubscribe(pClient, pTopicFilter, topicFilterLen);
+	unsubRc = _aws_iot_mqtt_internal_unsubscribe(pClient, pTopicFilters, pTopicFilterLens, count);
 
 	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_UNSUBSCRIBE_IN_PROGRESS, clientState);
 	if(SUCCESS == unsubRc && SUCCESS != rc) {
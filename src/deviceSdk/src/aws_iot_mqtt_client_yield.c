@@ -41,11 +41,14 @@ extern "C" {
 
 #include "sdk/aws_iot_mqtt_client_common_internal.h"
 
+/* Interval in ms for checking whether a started reachability probe has completed */
+#define MQTT_RECONNECT_PROBE_POLL_INTERVAL 100
+
 /**
   * This is for the case when the aws_iot_mqtt_internal_send_packet Fails.
   */
 static void _aws_iot_mqtt_force_client_disconnect(AWS_IoT_Client *pClient) {
-	pClient->clientStatus.clientState = CLIENT_STATE_DISCONNECTED_ERROR;
+	aws_iot_mqtt_internal_force_client_state(pClient, CLIENT_STATE_DISCONNECTED_ERROR);
 	pClient->networkStack.disconnect(&(pClient->networkStack));
 	pClient->networkStack.destroy(&(pClient->networkStack));
 }
@@ -66,17 +69,104 @@ static IoT_Error_t _aws_iot_mqtt_handle_disconnect(AWS_IoT_Client *pClient) {
 	}
 
 	/* Reset to 0 since this was not a manual disconnect */
-	pClient->clientStatus.clientState = CLIENT_STATE_DISCONNECTED_ERROR;
+	aws_iot_mqtt_internal_force_client_state(pClient, CLIENT_STATE_DISCONNECTED_ERROR);
 	FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
 }
 
 
+static uint32_t _aws_iot_mqtt_next_random(AWS_IoT_Client *pClient) {
+	uint32_t x = pClient->clientData.reconnectRandomState;
+	const char *pId;
+	uint16_t i;
+
+	if(0 == x) {
+		/* Seed with the client id so devices rebooted by the same power cut do not share a sequence */
+		x = 2166136261u;
+		pId = pClient->clientData.options.pClientID;
+		for(i = 0; NULL != pId && i < pClient->clientData.options.clientIDLen; i++) {
+			x = (x ^ (uint8_t) pId[i]) * 16777619u;
+		}
+		x ^= get_time_ms();
+		if(0 == x) {
+			x = 1;
+		}
+	}
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	pClient->clientData.reconnectRandomState = x;
+	return x;
+}
+
+/**
+ * Arms the reconnect timer with a decorrelated jitter wait, a random value between half the
+ * minimum wait and three times the previous wait, capped by the exponential back-off ceiling.
+ */
+static void _aws_iot_mqtt_schedule_reconnect(AWS_IoT_Client *pClient) {
+	uint32_t lower = AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL / 2;
+	uint32_t upper = 3 * pClient->clientData.reconnectJitterWaitInterval;
+	uint32_t wait;
+
+	if(upper > pClient->clientData.currentReconnectWaitInterval) {
+		upper = pClient->clientData.currentReconnectWaitInterval;
+	}
+	if(upper < lower) {
+		upper = lower;
+	}
+
+	wait = lower + _aws_iot_mqtt_next_random(pClient) % (upper - lower + 1);
+	pClient->clientData.reconnectJitterWaitInterval = wait;
+	countdown_ms(&(pClient->reconnectDelayTimer), wait);
+}
+
+/**
+ * Probes the endpoint while waiting to reconnect. When it becomes reachable after a failed probe
+ * the wait is cut down to a short random delay, so devices that lost the same broker do not
+ * all reconnect in the same instant once it is back.
+ */
+static void _aws_iot_mqtt_probe_endpoint(AWS_IoT_Client *pClient) {
+	IoT_Error_t rc;
+	uint32_t wait;
+
+	if(0 == AWS_IOT_MQTT_RECONNECT_PROBE_INTERVAL || NULL == pClient->networkStack.probeReachability
+	   || !has_timer_expired(&(pClient->reconnectProbeTimer))) {
+		return;
+	}
+
+	rc = pClient->networkStack.probeReachability(&(pClient->networkStack));
+	if(NETWORK_PROBE_IN_PROGRESS == rc) {
+		countdown_ms(&(pClient->reconnectProbeTimer), MQTT_RECONNECT_PROBE_POLL_INTERVAL);
+		return;
+	}
+	countdown_ms(&(pClient->reconnectProbeTimer), AWS_IOT_MQTT_RECONNECT_PROBE_INTERVAL);
+
+	if(NETWORK_PHYSICAL_LAYER_CONNECTED != rc) {
+		pClient->clientData.isReconnectProbeFailed = true;
+		return;
+	}
+
+	/* Only a change from unreachable to reachable shortens the wait. An endpoint that accepts
+	 * TCP but keeps refusing MQTT connections stays on the normal back-off */
+	if(!pClient->clientData.isReconnectProbeFailed) {
+		return;
+	}
+	pClient->clientData.isReconnectProbeFailed = false;
+
+	wait = _aws_iot_mqtt_next_random(pClient) % (AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL + 1);
+	if(wait < left_ms(&(pClient->reconnectDelayTimer))) {
+		IOT_DEBUG("Endpoint reachable again, reconnecting in %u ms", (unsigned int) wait);
+		countdown_ms(&(pClient->reconnectDelayTimer), wait);
+	}
+}
+
 static IoT_Error_t _aws_iot_mqtt_handle_reconnect(AWS_IoT_Client *pClient) {
 	IoT_Error_t rc;
 
 	FUNC_ENTRY;
 
 	if(!has_timer_expired(&(pClient->reconnectDelayTimer))) {
+		_aws_iot_mqtt_probe_endpoint(pClient);
 		/* Timer has not expired. Not time to attempt reconnect yet.
 		 * Return attempting reconnect */
 		FUNC_EXIT_RC(NETWORK_ATTEMPTING_RECONNECT);
@@ -99,19 +189,109 @@ static IoT_Error_t _aws_iot_mqtt_handle_reconnect(AWS_IoT_Client *pClient) {
 		}
 	}
 
-	pClient->clientData.currentReconnectWaitInterval *= 2;
+	/* Jittered waits are shorter than the ceiling, double it once they add up to it so the
+	 * overall time before giving up stays that of the plain exponential back-off */
+	pClient->clientData.reconnectWaitSpent += pClient->clientData.reconnectJitterWaitInterval;
+	if(pClient->clientData.reconnectWaitSpent >= pClient->clientData.currentReconnectWaitInterval) {
+		pClient->clientData.reconnectWaitSpent = 0;
+		pClient->clientData.currentReconnectWaitInterval *= 2;
+	}
 
 	if(AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL < pClient->clientData.currentReconnectWaitInterval) {
 		FUNC_EXIT_RC(NETWORK_RECONNECT_TIMED_OUT_ERROR);
 	}
-	countdown_ms(&(pClient->reconnectDelayTimer), pClient->clientData.currentReconnectWaitInterval);
+	_aws_iot_mqtt_schedule_reconnect(pClient);
 	FUNC_EXIT_RC(rc);
 }
 
+/**
+ * Picks the idle time before the next PINGREQ. Without a failure the interval doubles from the
+ * longest one that worked, after a failure it bisects between the two until they are closer
+ * than AWS_IOT_MQTT_KEEPALIVE_PROBE_RESOLUTION. Never longer than the negotiated keep alive.
+ */
+static uint32_t _aws_iot_mqtt_next_ping_interval(AWS_IoT_Client *pClient) {
+	KeepAliveStats *pStats = &(pClient->clientData.keepAliveStats);
+	uint32_t ceiling = (uint32_t) pClient->clientData.keepAliveInterval * 1000;
+	uint32_t interval;
+
+	if(0 == pStats->safeIntervalMs) {
+		interval = AWS_IOT_MQTT_KEEPALIVE_MIN_INTERVAL;
+	} else if(0 == pStats->failedIntervalMs) {
+		interval = 2 * pStats->safeIntervalMs;
+	} else if(AWS_IOT_MQTT_KEEPALIVE_PROBE_RESOLUTION > pStats->failedIntervalMs - pStats->safeIntervalMs) {
+		interval = pStats->safeIntervalMs;
+	} else {
+		interval = pStats->safeIntervalMs + (pStats->failedIntervalMs - pStats->safeIntervalMs) / 2;
+	}
+
+	if(interval > ceiling) {
+		interval = ceiling;
+	}
+	return interval;
+}
+
+/* Keep alive values are written by the thread owning the read side, stores are atomic for
+ * aws_iot_mqtt_get_keepalive_stats */
+static void _aws_iot_mqtt_store_keepalive_value(uint32_t *pValue, uint32_t value) {
+	__atomic_store_n(pValue, value, __ATOMIC_RELAXED);
+}
+
+void aws_iot_mqtt_internal_start_keepalive(AWS_IoT_Client *pClient) {
+	pClient->clientStatus.isPingOutstanding = false;
+	aws_iot_mqtt_internal_note_sent(pClient);
+	_aws_iot_mqtt_store_keepalive_value(&(pClient->clientData.keepAliveStats.pingIntervalMs),
+										_aws_iot_mqtt_next_ping_interval(pClient));
+}
+
+void aws_iot_mqtt_internal_handle_pingresp(AWS_IoT_Client *pClient) {
+	KeepAliveStats *pStats = &(pClient->clientData.keepAliveStats);
+	uint32_t rtt;
+
+	if(!pClient->clientStatus.isPingOutstanding) {
+		return;
+	}
+	pClient->clientStatus.isPingOutstanding = false;
+
+	rtt = get_time_ms() - pClient->clientData.pingSentMs;
+	_aws_iot_mqtt_store_keepalive_value(&(pStats->lastRttMs), rtt);
+	_aws_iot_mqtt_store_keepalive_value(&(pStats->smoothedRttMs),
+										0 == pStats->smoothedRttMs ? rtt : (7 * pStats->smoothedRttMs + rtt) / 8);
+
+	if(pClient->clientData.pingIdleMs > pStats->safeIntervalMs) {
+		_aws_iot_mqtt_store_keepalive_value(&(pStats->safeIntervalMs), pClient->clientData.pingIdleMs);
+		if(0 != pStats->failedIntervalMs && pStats->failedIntervalMs <= pClient->clientData.pingIdleMs) {
+			/* The earlier loss was not caused by the idle time */
+			_aws_iot_mqtt_store_keepalive_value(&(pStats->failedIntervalMs), 0);
+		}
+	}
+	_aws_iot_mqtt_store_keepalive_value(&(pStats->pingIntervalMs), _aws_iot_mqtt_next_ping_interval(pClient));
+}
+
+static void _aws_iot_mqtt_handle_ping_timeout(AWS_IoT_Client *pClient) {
+	KeepAliveStats *pStats = &(pClient->clientData.keepAliveStats);
+	uint32_t idle = pClient->clientData.pingIdleMs;
+
+	_aws_iot_mqtt_store_keepalive_value(&(pStats->pingTimeouts), pStats->pingTimeouts + 1);
+
+	if(idle > pStats->safeIntervalMs) {
+		/* Probing above the known safe interval, the idle time is the likely cause */
+		if(0 == pStats->failedIntervalMs || idle < pStats->failedIntervalMs) {
+			_aws_iot_mqtt_store_keepalive_value(&(pStats->failedIntervalMs), idle);
+		}
+	} else {
+		/* An interval that used to work failed, the network may have changed. Search again */
+		_aws_iot_mqtt_store_keepalive_value(&(pStats->safeIntervalMs), 0);
+		_aws_iot_mqtt_store_keepalive_value(&(pStats->failedIntervalMs), 0);
+	}
+	IOT_WARN("PINGRESP timeout after %u ms idle, safe %u ms, failed %u ms", (unsigned int) idle,
+			 (unsigned int) pStats->safeIntervalMs, (unsigned int) pStats->failedIntervalMs);
+}
+
 static IoT_Error_t _aws_iot_mqtt_keep_alive(AWS_IoT_Client *pClient) {
 	IoT_Error_t rc = SUCCESS;
 	Timer timer;
 	size_t serialized_len;
+	uint32_t now, idle, sentIdle;
 
 	FUNC_ENTRY;
 
@@ -123,37 +303,63 @@ static IoT_Error_t _aws_iot_mqtt_keep_alive(AWS_IoT_Client *pClient) {
 		FUNC_EXIT_RC(SUCCESS);
 	}
 
-	if(!has_timer_expired(&pClient->pingTimer)) {
-		FUNC_EXIT_RC(SUCCESS);
-	}
-
 	if(pClient->clientStatus.isPingOutstanding) {
+		if(!has_timer_expired(&pClient->pingTimer)) {
+			FUNC_EXIT_RC(SUCCESS);
+		}
+		_aws_iot_mqtt_handle_ping_timeout(pClient);
 		rc = _aws_iot_mqtt_handle_disconnect(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
+	/* Traffic either way keeps the NAT binding open and delays the probing PINGREQ. The broker
+	 * only counts what it receives, so a client that only receives still pings in time */
+	now = get_time_ms();
+	idle = now - __atomic_load_n(&(pClient->clientData.lastActivityMs), __ATOMIC_RELAXED);
+	sentIdle = now - __atomic_load_n(&(pClient->clientData.lastSentMs), __ATOMIC_RELAXED);
+	if(idle < pClient->clientData.keepAliveStats.pingIntervalMs &&
+	   sentIdle < (uint32_t) pClient->clientData.keepAliveInterval * 1000) {
+		FUNC_EXIT_RC(SUCCESS);
+	}
+
 	/* there is no ping outstanding - send one */
 	init_timer(&timer);
 
 	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
 	serialized_len = 0;
+	rc = aws_iot_mqtt_internal_lock_write(pClient);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
 	rc = aws_iot_mqtt_internal_serialize_zero(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
 											  PINGREQ, &serialized_len);
 	if(SUCCESS != rc) {
+		(void)aws_iot_mqtt_internal_unlock_write(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
 	/* send the ping packet */
 	rc = aws_iot_mqtt_internal_send_packet(pClient, serialized_len, &timer);
+	(void)aws_iot_mqtt_internal_unlock_write(pClient);
 	if(SUCCESS != rc) {
 		//If sending a PING fails we can no longer determine if we are connected.  In this case we decide we are disconnected and begin reconnection attempts
 		rc = _aws_iot_mqtt_handle_disconnect(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
+	pClient->clientData.pingSentMs = get_time_ms();
+	/* Credit the interval rather than the measured idle time, which overshoots by the polling delay.
+	 * A PINGREQ sent for the broker's keep alive only tested the shorter idle time */
+	if(idle > pClient->clientData.keepAliveStats.pingIntervalMs) {
+		idle = pClient->clientData.keepAliveStats.pingIntervalMs;
+	}
+	pClient->clientData.pingIdleMs = idle;
+	_aws_iot_mqtt_store_keepalive_value(&(pClient->clientData.keepAliveStats.pingsSent),
+										pClient->clientData.keepAliveStats.pingsSent + 1);
 	pClient->clientStatus.isPingOutstanding = true;
 	/* start a timer to wait for PINGRESP from server */
-	countdown_sec(&pClient->pingTimer, pClient->clientData.keepAliveInterval);
+	countdown_ms(&pClient->pingTimer, AWS_IOT_MQTT_PINGRESP_TIMEOUT);
 
 	FUNC_EXIT_RC(SUCCESS);
 }
@@ -206,6 +412,12 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 		yieldRc = aws_iot_mqtt_internal_cycle_read(pClient, &timer, &packet_type);
 		if(SUCCESS == yieldRc) {
 			yieldRc = _aws_iot_mqtt_keep_alive(pClient);
+			if(SUCCESS == yieldRc) {
+				yieldRc = aws_iot_mqtt_internal_resend_inflight_publishes(pClient);
+				if(NETWORK_SSL_WRITE_ERROR == yieldRc || NETWORK_SSL_WRITE_TIMEOUT_ERROR == yieldRc) {
+					yieldRc = _aws_iot_mqtt_handle_disconnect(pClient);
+				}
+			}
 		} else {
 			// SSL read and write errors are terminal, connection must be closed and retried
 			if(NETWORK_SSL_READ_ERROR == yieldRc || NETWORK_SSL_WRITE_ERROR == yieldRc || NETWORK_SSL_WRITE_TIMEOUT_ERROR == yieldRc) {
@@ -215,7 +427,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 
 		if(NETWORK_DISCONNECTED_ERROR == yieldRc) {
 			pClient->clientData.counterNetworkDisconnected++;
-			if(1 == pClient->clientStatus.isAutoReconnectEnabled) {
+			if(aws_iot_is_autoreconnect_enabled(pClient)) {
 				yieldRc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_DISCONNECTED_ERROR,
 														CLIENT_STATE_PENDING_RECONNECT);
 				if(SUCCESS != yieldRc) {
@@ -223,7 +435,11 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 				}
 
 				pClient->clientData.currentReconnectWaitInterval = AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL;
-				countdown_ms(&(pClient->reconnectDelayTimer), pClient->clientData.currentReconnectWaitInterval);
+				pClient->clientData.reconnectJitterWaitInterval = AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL;
+				pClient->clientData.reconnectWaitSpent = 0;
+				pClient->clientData.isReconnectProbeFailed = false;
+				countdown_ms(&(pClient->reconnectProbeTimer), 0);
+				_aws_iot_mqtt_schedule_reconnect(pClient);
 				/* Depending on timer values, it is possible that yield timer has expired
 				 * Set to rc to attempting reconnect to inform client that autoreconnect
 				 * attempt has started */
@@ -234,7 +450,8 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 		} else if(SUCCESS != yieldRc) {
 			break;
 		}
-	} while(!has_timer_expired(&timer));
+		/* Packets already in the read buffer are handled even if the timer expired */
+	} while(!has_timer_expired(&timer) || aws_iot_mqtt_internal_has_buffered_packet(pClient));
 
 	FUNC_EXIT_RC(yieldRc);
 }
@@ -280,13 +497,10 @@ IoT_Error_t aws_iot_mqtt_yield(AWS_IoT_Client *pClient, uint32_t timeout_ms) {
 			FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
 		}
 
-		/* Check if client is idle, if not another operation is in progress and we should return */
-		if(CLIENT_STATE_CONNECTED_IDLE != clientState) {
-			FUNC_EXIT_RC(MQTT_CLIENT_NOT_IDLE_ERROR);
-		}
-
-		rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_IDLE,
-										   CLIENT_STATE_CONNECTED_YIELD_IN_PROGRESS);
+		/* Another operation owns the read side. With blocking thread locks enabled sleep
+		 * until it hands the client back, it is bounded by the command timeout */
+		rc = aws_iot_mqtt_internal_acquire_client_state(pClient, CLIENT_STATE_CONNECTED_YIELD_IN_PROGRESS, false,
+														pClient->clientData.commandTimeoutMs, &clientState);
 		if(SUCCESS != rc) {
 			FUNC_EXIT_RC(rc);
 		}
@@ -31,29 +31,51 @@ extern "C" {
 #include "sdk/aws_iot_shadow_json.h"
 #include "sdk/aws_iot_shadow_key.h"
 #include "sdk/aws_iot_shadow_records.h"
+#include "sdk/aws_iot_shadow_context.h"
 
 const ShadowInitParameters_t ShadowInitParametersDefault = {(char *) AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, NULL, NULL,
-															NULL, false, NULL};
+															NULL, false, NULL, NULL};
 
 const ShadowConnectParameters_t ShadowConnectParametersDefault = {(char *) AWS_IOT_MY_THING_NAME,
 								  (char *) AWS_IOT_MQTT_CLIENT_ID, 0, NULL};
 
-static char deleteAcceptedTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+// instance of the clients initialized without a context of their own
+static ShadowContext_t defaultShadowContext;
 
-void aws_iot_shadow_reset_last_received_version(void) {
-	shadowJsonVersionNum = 0;
+static ShadowContext_t *getShadowContext(AWS_IoT_Client *pClient) {
+	if(NULL == pClient) {
+		return NULL;
+	}
+	return (ShadowContext_t *) pClient->pShadowContext;
+}
+
+void aws_iot_shadow_reset_last_received_version(AWS_IoT_Client *pClient) {
+	ShadowContext_t *pShadow = getShadowContext(pClient);
+	if(NULL != pShadow) {
+		pShadow->shadowJsonVersionNum = 0;
+	}
 }
 
-uint32_t aws_iot_shadow_get_last_received_version(void) {
-	return shadowJsonVersionNum;
+uint32_t aws_iot_shadow_get_last_received_version(AWS_IoT_Client *pClient) {
+	ShadowContext_t *pShadow = getShadowContext(pClient);
+	if(NULL == pShadow) {
+		return 0;
+	}
+	return pShadow->shadowJsonVersionNum;
 }
 
-void aws_iot_shadow_enable_discard_old_delta_msgs(void) {
-	shadowDiscardOldDeltaFlag = true;
+void aws_iot_shadow_enable_discard_old_delta_msgs(AWS_IoT_Client *pClient) {
+	ShadowContext_t *pShadow = getShadowContext(pClient);
+	if(NULL != pShadow) {
+		pShadow->shadowDiscardOldDeltaFlag = true;
+	}
 }
 
-void aws_iot_shadow_disable_discard_old_delta_msgs(void) {
-	shadowDiscardOldDeltaFlag = false;
+void aws_iot_shadow_disable_discard_old_delta_msgs(AWS_IoT_Client *pClient) {
+	ShadowContext_t *pShadow = getShadowContext(pClient);
+	if(NULL != pShadow) {
+		pShadow->shadowDiscardOldDeltaFlag = false;
+	}
 }
 
 IoT_Error_t aws_iot_shadow_free(AWS_IoT_Client *pClient)
@@ -71,6 +93,7 @@ IoT_Error_t aws_iot_shadow_free(AWS_IoT_Client *pClient)
 
 IoT_Error_t aws_iot_shadow_init(AWS_IoT_Client *pClient, ShadowInitParameters_t *pParams) {
 	IoT_Client_Init_Params mqttInitParams = IoT_Client_Init_Params_initializer;
+	ShadowContext_t *pShadow;
 	IoT_Error_t rc;
 
 	FUNC_ENTRY;
@@ -96,9 +119,13 @@ IoT_Error_t aws_iot_shadow_init(AWS_IoT_Client *pClient, ShadowInitParameters_t
 		FUNC_EXIT_RC(rc);
 	}
 
-	resetClientTokenSequenceNum();
-	aws_iot_shadow_reset_last_received_version();
-	initDeltaTokens();
+	pShadow = (NULL != pParams->pContext) ? pParams->pContext : &defaultShadowContext;
+	pClient->pShadowContext = pShadow;
+
+	initializeRecords(pShadow, pClient);
+	aws_iot_shadow_reset_last_received_version(pClient);
+	aws_iot_shadow_enable_discard_old_delta_msgs(pClient);
+	initDeltaTokens(pShadow);
 
 	FUNC_EXIT_RC(SUCCESS);
 }
@@ -107,15 +134,17 @@ IoT_Error_t aws_iot_shadow_connect(AWS_IoT_Client *pClient, ShadowConnectParamet
 	IoT_Error_t rc = SUCCESS;
 	uint16_t deleteAcceptedTopicLen;
 	IoT_Client_Connect_Params ConnectParams = iotClientConnectParamsDefault;
+	ShadowContext_t *pShadow = getShadowContext(pClient);
 
 	FUNC_ENTRY;
 
-	if(NULL == pClient || NULL == pParams || NULL == pParams->pMqttClientId) {
+	if(NULL == pShadow || NULL == pParams || NULL == pParams->pMqttClientId) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
-	snprintf(myThingName, MAX_SIZE_OF_THING_NAME, "%s", pParams->pMyThingName);
-	snprintf(mqttClientID, MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES, "%s", pParams->pMqttClientId);
+	snprintf(pShadow->myThingName, MAX_SIZE_OF_THING_NAME, "%s", pParams->pMyThingName);
+	snprintf(pShadow->mqttClientID, MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES, "%s", pParams->pMqttClientId);
+	setClientTokenPrefix(pShadow->mqttClientID);
 
 	ConnectParams.keepAliveIntervalInSec = 600; // NOTE: Temporary fix
 	ConnectParams.MQTTVersion = MQTT_3_1_1;
@@ -132,21 +161,23 @@ IoT_Error_t aws_iot_shadow_connect(AWS_IoT_Client *pClient, ShadowConnectParamet
 		FUNC_EXIT_RC(rc);
 	}
 
-	initializeRecords(pClient);
+	initializeRecords(pShadow, pClient);
 
 	if(NULL != pParams->deleteActionHandler) {
-		snprintf(deleteAcceptedTopic, MAX_SHADOW_TOPIC_LENGTH_BYTES,
-				 "$aws/things/%s/shadow/delete/accepted", myThingName);
-		deleteAcceptedTopicLen = (uint16_t) strlen(deleteAcceptedTopic);
-		rc = aws_iot_mqtt_subscribe(pClient, deleteAcceptedTopic, deleteAcceptedTopicLen, QOS1,
-									pParams->deleteActionHandler, (void *) myThingName);
+		snprintf(pShadow->deleteAcceptedTopic, MAX_SHADOW_TOPIC_LENGTH_BYTES,
+				 "$aws/things/%s/shadow/delete/accepted", pShadow->myThingName);
+		deleteAcceptedTopicLen = (uint16_t) strlen(pShadow->deleteAcceptedTopic);
+		rc = aws_iot_mqtt_subscribe(pClient, pShadow->deleteAcceptedTopic, deleteAcceptedTopicLen, QOS1,
+									pParams->deleteActionHandler, (void *) pShadow->myThingName);
 	}
 
 	FUNC_EXIT_RC(rc);
 }
 
 IoT_Error_t aws_iot_shadow_register_delta(AWS_IoT_Client *pMqttClient, jsonStruct_t *pStruct) {
-	if(NULL == pMqttClient || NULL == pStruct) {
+	ShadowContext_t *pShadow = getShadowContext(pMqttClient);
+
+	if(NULL == pShadow || NULL == pStruct) {
 		return NULL_VALUE_ERROR;
 	}
 
@@ -154,15 +185,17 @@ IoT_Error_t aws_iot_shadow_register_delta(AWS_IoT_Client *pMqttClient, jsonStruc
 		return MQTT_CONNECTION_ERROR;
 	}
 
-	return registerJsonTokenOnDelta(pStruct);
+	return registerJsonTokenOnDelta(pShadow, pStruct);
 }
 
 IoT_Error_t aws_iot_shadow_yield(AWS_IoT_Client *pClient, uint32_t timeout) {
-	if(NULL == pClient) {
+	ShadowContext_t *pShadow = getShadowContext(pClient);
+
+	if(NULL == pShadow) {
 		return NULL_VALUE_ERROR;
 	}
 
-	HandleExpiredResponseCallbacks();
+	HandleExpiredResponseCallbacks(pShadow);
 	return aws_iot_mqtt_yield(pClient, timeout);
 }
 
@@ -173,9 +206,10 @@ IoT_Error_t aws_iot_shadow_disconnect(AWS_IoT_Client *pClient) {
 IoT_Error_t aws_iot_shadow_update(AWS_IoT_Client *pClient, const char *pThingName, char *pJsonString,
 								  fpActionCallback_t callback, void *pContextData, uint8_t timeout_seconds,
 								  bool isPersistentSubscribe) {
+	ShadowContext_t *pShadow = getShadowContext(pClient);
 	IoT_Error_t rc;
 
-	if(NULL == pClient) {
+	if(NULL == pShadow) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
@@ -183,7 +217,7 @@ IoT_Error_t aws_iot_shadow_update(AWS_IoT_Client *pClient, const char *pThingNam
 		FUNC_EXIT_RC(MQTT_CONNECTION_ERROR);
 	}
 
-	rc = aws_iot_shadow_internal_action(pThingName, SHADOW_UPDATE, pJsonString, strlen(pJsonString), callback, pContextData,
+	rc = aws_iot_shadow_internal_action(pShadow, pThingName, SHADOW_UPDATE, pJsonString, strlen(pJsonString), callback, pContextData,
 										timeout_seconds, isPersistentSubscribe);
 
 	FUNC_EXIT_RC(rc);
@@ -192,11 +226,12 @@ IoT_Error_t aws_iot_shadow_update(AWS_IoT_Client *pClient, const char *pThingNam
 IoT_Error_t aws_iot_shadow_delete(AWS_IoT_Client *pClient, const char *pThingName, fpActionCallback_t callback,
 								  void *pContextData, uint8_t timeout_seconds, bool isPersistentSubscribe) {
 	char deleteRequestJsonBuf[MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE];
+	ShadowContext_t *pShadow = getShadowContext(pClient);
 	IoT_Error_t rc;
 
 	FUNC_ENTRY;
 
-	if(NULL == pClient) {
+	if(NULL == pShadow) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
@@ -204,12 +239,12 @@ IoT_Error_t aws_iot_shadow_delete(AWS_IoT_Client *pClient, const char *pThingNam
 		FUNC_EXIT_RC(MQTT_CONNECTION_ERROR);
 	}
 
-	rc = aws_iot_shadow_internal_delete_request_json(deleteRequestJsonBuf, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE );
+	rc = aws_iot_shadow_internal_delete_request_json(pShadow->mqttClientID, deleteRequestJsonBuf, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE );
     if ( SUCCESS != rc ) {
         FUNC_EXIT_RC( rc );
     }
 
-	rc = aws_iot_shadow_internal_action(pThingName, SHADOW_DELETE, deleteRequestJsonBuf, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE, callback, pContextData,
+	rc = aws_iot_shadow_internal_action(pShadow, pThingName, SHADOW_DELETE, deleteRequestJsonBuf, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE, callback, pContextData,
 										timeout_seconds, isPersistentSubscribe);
 
 	FUNC_EXIT_RC(rc);
@@ -218,11 +253,12 @@ IoT_Error_t aws_iot_shadow_delete(AWS_IoT_Client *pClient, const char *pThingNam
 IoT_Error_t aws_iot_shadow_get(AWS_IoT_Client *pClient, const char *pThingName, fpActionCallback_t callback,
 							   void *pContextData, uint8_t timeout_seconds, bool isPersistentSubscribe) {
 	char getRequestJsonBuf[MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE];
+	ShadowContext_t *pShadow = getShadowContext(pClient);
 	IoT_Error_t rc;
 
 	FUNC_ENTRY;
 
-	if(NULL == pClient) {
+	if(NULL == pShadow) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
@@ -230,12 +266,12 @@ IoT_Error_t aws_iot_shadow_get(AWS_IoT_Client *pClient, const char *pThingName,
 		FUNC_EXIT_RC(MQTT_CONNECTION_ERROR);
 	}
 
-    rc = aws_iot_shadow_internal_get_request_json(getRequestJsonBuf, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE );
+    rc = aws_iot_shadow_internal_get_request_json(pShadow->mqttClientID, getRequestJsonBuf, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE );
     if (SUCCESS != rc) {
         FUNC_EXIT_RC(rc);
     }
 
-	rc = aws_iot_shadow_internal_action(pThingName, SHADOW_GET, getRequestJsonBuf, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE, callback, pContextData,
+	rc = aws_iot_shadow_internal_action(pShadow, pThingName, SHADOW_GET, getRequestJsonBuf, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE, callback, pContextData,
 										timeout_seconds, isPersistentSubscribe);
 	FUNC_EXIT_RC(rc);
 }
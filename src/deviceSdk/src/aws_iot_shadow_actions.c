@@ -29,7 +29,7 @@ extern "C" {
 #include "sdk/aws_iot_shadow_records.h"
 #include "aws_iot_config.h"
 
-IoT_Error_t aws_iot_shadow_internal_action(const char *pThingName, ShadowActions_t action,
+IoT_Error_t aws_iot_shadow_internal_action(ShadowContext_t *pShadow, const char *pThingName, ShadowActions_t action,
 										   const char *pJsonDocumentToBeSent, size_t jsonSize, fpActionCallback_t callback,
 										   void *pCallbackContext, uint32_t timeout_seconds, bool isSticky) {
 	IoT_Error_t ret_val = SUCCESS;
@@ -44,18 +44,19 @@ IoT_Error_t aws_iot_shadow_internal_action(const char *pThingName, ShadowActions
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
-	isClientTokenPresent = extractClientToken(pJsonDocumentToBeSent, jsonSize, extractedClientToken, MAX_SIZE_CLIENT_ID_WITH_SEQUENCE );
+	isClientTokenPresent = extractClientToken(pJsonDocumentToBeSent, jsonSize, &(pShadow->jsonParser), extractedClientToken,
+											  MAX_SIZE_CLIENT_ID_WITH_SEQUENCE );
 
 	if(isClientTokenPresent && (NULL != callback)) {
-		if(getNextFreeIndexOfAckWaitList(&indexAckWaitList)) {
+		if(getNextFreeIndexOfAckWaitList(pShadow, &indexAckWaitList)) {
 			isAckWaitListFree = true;
 		}
 
 		if(isAckWaitListFree) {
-			if(!isSubscriptionPresent(pThingName, action)) {
-				ret_val = subscribeToShadowActionAcks(pThingName, action, isSticky);
+			if(!isSubscriptionPresent(pShadow, pThingName, action)) {
+				ret_val = subscribeToShadowActionAcks(pShadow, pThingName, action, isSticky);
 			} else {
-				incrementSubscriptionCnt(pThingName, action, isSticky);
+				incrementSubscriptionCnt(pShadow, pThingName, action, isSticky);
 			}
 		}
 		else {
@@ -64,12 +65,12 @@ IoT_Error_t aws_iot_shadow_internal_action(const char *pThingName, ShadowActions
 	}
 
 	if(SUCCESS == ret_val) {
-		ret_val = publishToShadowAction(pThingName, action, pJsonDocumentToBeSent);
+		ret_val = publishToShadowAction(pShadow, pThingName, action, pJsonDocumentToBeSent);
 	}
 
 	if(isClientTokenPresent && (NULL != callback) && (SUCCESS == ret_val) && isAckWaitListFree) {
-		addToAckWaitList(indexAckWaitList, pThingName, action, extractedClientToken, callback, pCallbackContext,
-						 timeout_seconds);
+		addToAckWaitList(pShadow, indexAckWaitList, pThingName, action, extractedClientToken, callback,
+						 pCallbackContext, timeout_seconds);
 	}
 
 	FUNC_EXIT_RC(ret_val);
@@ -0,0 +1,492 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_shadow_cbor.c
+ * @brief CBOR encoding and decoding of jsonStruct_t name value pairs
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sdk/aws_iot_shadow_cbor.h"
+
+#include <string.h>
+
+#include "sdk/aws_iot_log.h"
+
+#define CBOR_MAJOR_UNSIGNED 0
+#define CBOR_MAJOR_NEGATIVE 1
+#define CBOR_MAJOR_BYTES 2
+#define CBOR_MAJOR_TEXT 3
+#define CBOR_MAJOR_ARRAY 4
+#define CBOR_MAJOR_MAP 5
+#define CBOR_MAJOR_TAG 6
+#define CBOR_MAJOR_SIMPLE 7
+
+#define CBOR_INFO_UINT8 24
+#define CBOR_INFO_UINT16 25
+#define CBOR_INFO_UINT32 26
+#define CBOR_INFO_UINT64 27
+
+#define CBOR_SIMPLE_FALSE 20
+#define CBOR_SIMPLE_TRUE 21
+
+/* Nested arrays and maps skipped in a document, deeper documents are rejected */
+#define CBOR_MAX_NESTING 16
+
+static bool writeArgument(unsigned char **pptr, unsigned char *pEnd, uint8_t major, uint8_t info, uint64_t value,
+						  size_t argLen) {
+	size_t i;
+
+	if((size_t) (pEnd - *pptr) < 1 + argLen) {
+		return false;
+	}
+
+	*(*pptr)++ = (unsigned char) ((major << 5) | info);
+	for(i = argLen; i > 0; i--) {
+		*(*pptr)++ = (unsigned char) (value >> (8 * (i - 1)));
+	}
+
+	return true;
+}
+
+/* Writes the initial byte and argument of an item in its shortest encoding */
+static bool writeHead(unsigned char **pptr, unsigned char *pEnd, uint8_t major, uint64_t value) {
+	if(value < CBOR_INFO_UINT8) {
+		return writeArgument(pptr, pEnd, major, (uint8_t) value, 0, 0);
+	} else if(value <= UINT8_MAX) {
+		return writeArgument(pptr, pEnd, major, CBOR_INFO_UINT8, value, 1);
+	} else if(value <= UINT16_MAX) {
+		return writeArgument(pptr, pEnd, major, CBOR_INFO_UINT16, value, 2);
+	} else if(value <= UINT32_MAX) {
+		return writeArgument(pptr, pEnd, major, CBOR_INFO_UINT32, value, 4);
+	}
+	return writeArgument(pptr, pEnd, major, CBOR_INFO_UINT64, value, 8);
+}
+
+static bool writeFloat(unsigned char **pptr, unsigned char *pEnd, float value) {
+	uint32_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	return writeArgument(pptr, pEnd, CBOR_MAJOR_SIMPLE, CBOR_INFO_UINT32, bits, 4);
+}
+
+static bool writeDouble(unsigned char **pptr, unsigned char *pEnd, double value) {
+	uint64_t bits;
+
+	/* Single precision is enough for most readings, it saves four bytes */
+	if((double) (float) value == value) {
+		return writeFloat(pptr, pEnd, (float) value);
+	}
+
+	memcpy(&bits, &value, sizeof(bits));
+	return writeArgument(pptr, pEnd, CBOR_MAJOR_SIMPLE, CBOR_INFO_UINT64, bits, 8);
+}
+
+static bool writeInteger(unsigned char **pptr, unsigned char *pEnd, int64_t value) {
+	if(value < 0) {
+		return writeHead(pptr, pEnd, CBOR_MAJOR_NEGATIVE, (uint64_t) (-1 - value));
+	}
+	return writeHead(pptr, pEnd, CBOR_MAJOR_UNSIGNED, (uint64_t) value);
+}
+
+static bool writeValue(unsigned char **pptr, unsigned char *pEnd, jsonStruct_t *pDataStruct) {
+	size_t length;
+
+	switch(pDataStruct->type) {
+		case SHADOW_JSON_INT32:
+			return writeInteger(pptr, pEnd, *(int32_t *) (pDataStruct->pData));
+		case SHADOW_JSON_INT16:
+			return writeInteger(pptr, pEnd, *(int16_t *) (pDataStruct->pData));
+		case SHADOW_JSON_INT8:
+			return writeInteger(pptr, pEnd, *(int8_t *) (pDataStruct->pData));
+		case SHADOW_JSON_UINT32:
+			return writeHead(pptr, pEnd, CBOR_MAJOR_UNSIGNED, *(uint32_t *) (pDataStruct->pData));
+		case SHADOW_JSON_UINT16:
+			return writeHead(pptr, pEnd, CBOR_MAJOR_UNSIGNED, *(uint16_t *) (pDataStruct->pData));
+		case SHADOW_JSON_UINT8:
+			return writeHead(pptr, pEnd, CBOR_MAJOR_UNSIGNED, *(uint8_t *) (pDataStruct->pData));
+		case SHADOW_JSON_FLOAT:
+			return writeFloat(pptr, pEnd, *(float *) (pDataStruct->pData));
+		case SHADOW_JSON_DOUBLE:
+			return writeDouble(pptr, pEnd, *(double *) (pDataStruct->pData));
+		case SHADOW_JSON_BOOL:
+			return writeHead(pptr, pEnd, CBOR_MAJOR_SIMPLE,
+							 *(bool *) (pDataStruct->pData) ? CBOR_SIMPLE_TRUE : CBOR_SIMPLE_FALSE);
+		case SHADOW_JSON_STRING:
+			length = strlen((const char *) pDataStruct->pData);
+			if(!writeHead(pptr, pEnd, CBOR_MAJOR_TEXT, length) || (size_t) (pEnd - *pptr) < length) {
+				return false;
+			}
+			memcpy(*pptr, pDataStruct->pData, length);
+			*pptr += length;
+			return true;
+		case SHADOW_JSON_OBJECT:
+			if((size_t) (pEnd - *pptr) < pDataStruct->dataLength) {
+				return false;
+			}
+			memcpy(*pptr, pDataStruct->pData, pDataStruct->dataLength);
+			*pptr += pDataStruct->dataLength;
+			return true;
+		default:
+			return false;
+	}
+}
+
+IoT_Error_t aws_iot_cbor_encode_document(unsigned char *pBuffer, size_t bufferSize, size_t *pEncodedLength,
+										 uint8_t count, ...) {
+	unsigned char *ptr, *pEnd;
+	jsonStruct_t *pTemporary;
+	size_t keyLength;
+	uint8_t i;
+	va_list pArgs;
+
+	if(pBuffer == NULL || pEncodedLength == NULL) {
+		return NULL_VALUE_ERROR;
+	}
+
+	ptr = pBuffer;
+	pEnd = pBuffer + bufferSize;
+	if(!writeHead(&ptr, pEnd, CBOR_MAJOR_MAP, count)) {
+		return SHADOW_JSON_BUFFER_TRUNCATED;
+	}
+
+	va_start(pArgs, count);
+	for(i = 0; i < count; i++) {
+		pTemporary = va_arg (pArgs, jsonStruct_t *);
+		if(pTemporary == NULL || pTemporary->pKey == NULL || pTemporary->pData == NULL) {
+			va_end(pArgs);
+			return NULL_VALUE_ERROR;
+		}
+
+		keyLength = strlen(pTemporary->pKey);
+		if(!writeHead(&ptr, pEnd, CBOR_MAJOR_TEXT, keyLength) || (size_t) (pEnd - ptr) < keyLength) {
+			va_end(pArgs);
+			return SHADOW_JSON_BUFFER_TRUNCATED;
+		}
+		memcpy(ptr, pTemporary->pKey, keyLength);
+		ptr += keyLength;
+
+		if(!writeValue(&ptr, pEnd, pTemporary)) {
+			va_end(pArgs);
+			return SHADOW_JSON_BUFFER_TRUNCATED;
+		}
+	}
+	va_end(pArgs);
+
+	*pEncodedLength = (size_t) (ptr - pBuffer);
+
+	return SUCCESS;
+}
+
+static bool readHead(const unsigned char **pptr, const unsigned char *pEnd, uint8_t *pMajor, uint8_t *pInfo,
+					 uint64_t *pValue) {
+	size_t argLen, i;
+
+	if(*pptr >= pEnd) {
+		return false;
+	}
+
+	*pMajor = (uint8_t) (**pptr >> 5);
+	*pInfo = (uint8_t) (**pptr & 0x1F);
+	(*pptr)++;
+
+	if(*pInfo < CBOR_INFO_UINT8) {
+		*pValue = *pInfo;
+		return true;
+	} else if(*pInfo > CBOR_INFO_UINT64) {
+		/* Indefinite lengths and reserved values are not supported */
+		return false;
+	}
+
+	argLen = (size_t) 1 << (*pInfo - CBOR_INFO_UINT8);
+	if((size_t) (pEnd - *pptr) < argLen) {
+		return false;
+	}
+
+	*pValue = 0;
+	for(i = 0; i < argLen; i++) {
+		*pValue = (*pValue << 8) | *(*pptr)++;
+	}
+
+	return true;
+}
+
+/* Moves *pptr past one complete item, false if it is malformed or runs past pEnd */
+static bool skipItem(const unsigned char **pptr, const unsigned char *pEnd, uint8_t depth) {
+	uint8_t major, info;
+	uint64_t value, i;
+
+	if(depth > CBOR_MAX_NESTING || !readHead(pptr, pEnd, &major, &info, &value)) {
+		return false;
+	}
+
+	switch(major) {
+		case CBOR_MAJOR_BYTES:
+		case CBOR_MAJOR_TEXT:
+			if((uint64_t) (pEnd - *pptr) < value) {
+				return false;
+			}
+			*pptr += value;
+			return true;
+		case CBOR_MAJOR_MAP:
+			if(value > (uint64_t) (pEnd - *pptr)) {
+				return false;
+			}
+			value *= 2;
+			/* fall through */
+		case CBOR_MAJOR_ARRAY:
+			/* Every item takes at least one byte */
+			if(value > (uint64_t) (pEnd - *pptr)) {
+				return false;
+			}
+			for(i = 0; i < value; i++) {
+				if(!skipItem(pptr, pEnd, (uint8_t) (depth + 1))) {
+					return false;
+				}
+			}
+			return true;
+		case CBOR_MAJOR_TAG:
+			return skipItem(pptr, pEnd, (uint8_t) (depth + 1));
+		default:
+			return true;
+	}
+}
+
+static float halfToFloat(uint16_t half) {
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	uint32_t bits;
+	float value;
+
+	if(exponent == 0) {
+		value = (float) mantissa / 16777216.0f;
+		return (half & 0x8000) ? -value : value;
+	}
+
+	if(exponent == 0x1F) {
+		bits = 0x7F800000U | (mantissa << 13);
+	} else {
+		bits = ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+	bits |= (uint32_t) (half & 0x8000) << 16;
+	memcpy(&value, &bits, sizeof(value));
+
+	return value;
+}
+
+static bool readNumber(const unsigned char *pItem, const unsigned char *pEnd, double *pValue) {
+	uint8_t major, info;
+	uint64_t value;
+	uint32_t floatBits;
+	float floatValue;
+
+	if(!readHead(&pItem, pEnd, &major, &info, &value)) {
+		return false;
+	}
+
+	if(major == CBOR_MAJOR_UNSIGNED) {
+		*pValue = (double) value;
+	} else if(major == CBOR_MAJOR_NEGATIVE) {
+		*pValue = -1.0 - (double) value;
+	} else if(major == CBOR_MAJOR_SIMPLE && info == CBOR_INFO_UINT16) {
+		*pValue = halfToFloat((uint16_t) value);
+	} else if(major == CBOR_MAJOR_SIMPLE && info == CBOR_INFO_UINT32) {
+		floatBits = (uint32_t) value;
+		memcpy(&floatValue, &floatBits, sizeof(floatValue));
+		*pValue = floatValue;
+	} else if(major == CBOR_MAJOR_SIMPLE && info == CBOR_INFO_UINT64) {
+		memcpy(pValue, &value, sizeof(*pValue));
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool readInteger(const unsigned char *pItem, const unsigned char *pEnd, bool isSigned, uint64_t max,
+						int64_t *pValue) {
+	uint8_t major, info;
+	uint64_t value;
+
+	if(!readHead(&pItem, pEnd, &major, &info, &value) || value > max) {
+		return false;
+	}
+
+	/* A negative integer n is encoded as -1 - n, so it is in range when -1 - n <= max */
+	if(major == CBOR_MAJOR_UNSIGNED) {
+		*pValue = (int64_t) value;
+	} else if(major == CBOR_MAJOR_NEGATIVE && isSigned) {
+		*pValue = -1 - (int64_t) value;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool updateValue(const unsigned char *pItem, const unsigned char *pEnd, jsonStruct_t *pDataStruct) {
+	uint8_t major, info;
+	uint64_t value;
+	int64_t integer;
+	double number;
+
+	switch(pDataStruct->type) {
+		case SHADOW_JSON_INT32:
+			if(pDataStruct->dataLength < sizeof(int32_t) || !readInteger(pItem, pEnd, true, INT32_MAX, &integer)) {
+				return false;
+			}
+			*(int32_t *) (pDataStruct->pData) = (int32_t) integer;
+			return true;
+		case SHADOW_JSON_INT16:
+			if(pDataStruct->dataLength < sizeof(int16_t) || !readInteger(pItem, pEnd, true, INT16_MAX, &integer)) {
+				return false;
+			}
+			*(int16_t *) (pDataStruct->pData) = (int16_t) integer;
+			return true;
+		case SHADOW_JSON_INT8:
+			if(pDataStruct->dataLength < sizeof(int8_t) || !readInteger(pItem, pEnd, true, INT8_MAX, &integer)) {
+				return false;
+			}
+			*(int8_t *) (pDataStruct->pData) = (int8_t) integer;
+			return true;
+		case SHADOW_JSON_UINT32:
+			if(pDataStruct->dataLength < sizeof(uint32_t) ||
+			   !readInteger(pItem, pEnd, false, UINT32_MAX, &integer)) {
+				return false;
+			}
+			*(uint32_t *) (pDataStruct->pData) = (uint32_t) integer;
+			return true;
+		case SHADOW_JSON_UINT16:
+			if(pDataStruct->dataLength < sizeof(uint16_t) ||
+			   !readInteger(pItem, pEnd, false, UINT16_MAX, &integer)) {
+				return false;
+			}
+			*(uint16_t *) (pDataStruct->pData) = (uint16_t) integer;
+			return true;
+		case SHADOW_JSON_UINT8:
+			if(pDataStruct->dataLength < sizeof(uint8_t) || !readInteger(pItem, pEnd, false, UINT8_MAX, &integer)) {
+				return false;
+			}
+			*(uint8_t *) (pDataStruct->pData) = (uint8_t) integer;
+			return true;
+		case SHADOW_JSON_FLOAT:
+			if(pDataStruct->dataLength < sizeof(float) || !readNumber(pItem, pEnd, &number)) {
+				return false;
+			}
+			*(float *) (pDataStruct->pData) = (float) number;
+			return true;
+		case SHADOW_JSON_DOUBLE:
+			if(pDataStruct->dataLength < sizeof(double) || !readNumber(pItem, pEnd, &number)) {
+				return false;
+			}
+			*(double *) (pDataStruct->pData) = number;
+			return true;
+		case SHADOW_JSON_BOOL:
+			if(pDataStruct->dataLength < sizeof(bool) || !readHead(&pItem, pEnd, &major, &info, &value) ||
+			   major != CBOR_MAJOR_SIMPLE || (info != CBOR_SIMPLE_FALSE && info != CBOR_SIMPLE_TRUE)) {
+				return false;
+			}
+			*(bool *) (pDataStruct->pData) = (info == CBOR_SIMPLE_TRUE);
+			return true;
+		case SHADOW_JSON_STRING:
+			/* The item was validated, the text is in the buffer */
+			if(!readHead(&pItem, pEnd, &major, &info, &value) || major != CBOR_MAJOR_TEXT ||
+			   value >= pDataStruct->dataLength) {
+				return false;
+			}
+			memcpy(pDataStruct->pData, pItem, (size_t) value);
+			((char *) pDataStruct->pData)[value] = '\0';
+			return true;
+		case SHADOW_JSON_OBJECT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+IoT_Error_t aws_iot_cbor_decode_document(const unsigned char *pBuffer, size_t bufferLength, uint8_t count, ...) {
+	const unsigned char *ptr, *pEnd, *pItems, *pItem, *pKey;
+	jsonStruct_t *pTemporary;
+	uint64_t pairCount, j, keyLength;
+	uint8_t major, info, i;
+	va_list pArgs;
+
+	if(pBuffer == NULL) {
+		return NULL_VALUE_ERROR;
+	}
+
+	/* Validate the whole document once, the lookups below can then trust every length */
+	ptr = pBuffer;
+	pEnd = pBuffer + bufferLength;
+	if(!skipItem(&ptr, pEnd, 0) || ptr != pEnd) {
+		IOT_WARN("Failed to parse CBOR document\n");
+		return JSON_PARSE_ERROR;
+	}
+
+	ptr = pBuffer;
+	if(!readHead(&ptr, pEnd, &major, &info, &pairCount) || major != CBOR_MAJOR_MAP) {
+		IOT_WARN("Top Level is not a map\n");
+		return JSON_PARSE_ERROR;
+	}
+	pItems = ptr;
+
+	va_start(pArgs, count);
+	for(i = 0; i < count; i++) {
+		pTemporary = va_arg (pArgs, jsonStruct_t *);
+		if(pTemporary == NULL || pTemporary->pKey == NULL || pTemporary->pData == NULL) {
+			va_end(pArgs);
+			return NULL_VALUE_ERROR;
+		}
+	}
+	va_end(pArgs);
+
+	/* One pass over the document, every pair is looked up in the arguments */
+	ptr = pItems;
+	for(j = 0; j < pairCount; j++) {
+		pKey = ptr;
+		(void) skipItem(&ptr, pEnd, 0);
+		pItem = ptr;
+		(void) skipItem(&ptr, pEnd, 0);
+		if(!readHead(&pKey, pEnd, &major, &info, &keyLength) || major != CBOR_MAJOR_TEXT) {
+			continue;
+		}
+
+		va_start(pArgs, count);
+		for(i = 0; i < count; i++) {
+			pTemporary = va_arg (pArgs, jsonStruct_t *);
+			/* The first character rules out most keys before strlen */
+			if((keyLength > 0 && pTemporary->pKey[0] != (char) pKey[0]) || keyLength != strlen(pTemporary->pKey) ||
+			   memcmp(pKey, pTemporary->pKey, (size_t) keyLength) != 0) {
+				continue;
+			}
+
+			if(!updateValue(pItem, ptr, pTemporary)) {
+				IOT_WARN("Value of %s does not fit its type\n", pTemporary->pKey);
+			} else if(pTemporary->cb != NULL) {
+				pTemporary->cb((const char *) pItem, (uint32_t) (ptr - pItem), pTemporary);
+			}
+		}
+		va_end(pArgs);
+	}
+
+	return SUCCESS;
+}
+
+#ifdef __cplusplus
+}
+#endif
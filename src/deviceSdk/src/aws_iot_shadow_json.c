@@ -32,19 +32,46 @@ extern "C" {
 #include "sdk/aws_iot_shadow_key.h"
 #include "aws_iot_config.h"
 
-extern char mqttClientID[MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES];
 #define AWS_IOT_SHADOW_CLIENT_TOKEN_KEY "{\"clientToken\":\""
+
+#define CLIENT_TOKEN_PREFIX_UNSET 0
+#define CLIENT_TOKEN_PREFIX_WRITING 1
+#define CLIENT_TOKEN_PREFIX_SET 2
+
+// shared by all shadow instances, tokens stay unique within the process
 static uint32_t clientTokenNum = 0;
 
+// client id used by the document helpers that are not given a client
+static char clientTokenPrefix[MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES];
+static uint8_t clientTokenPrefixState = CLIENT_TOKEN_PREFIX_UNSET;
+
 //helper functions
 static IoT_Error_t convertDataToString(char *pStringBuffer, size_t maxSizoStringBuffer, JsonPrimitiveType type,
 									   void *pData);
 
-void resetClientTokenSequenceNum(void) {
-	clientTokenNum = 0;
+static uint32_t nextClientTokenNum(void) {
+	return __atomic_fetch_add(&clientTokenNum, 1, __ATOMIC_RELAXED);
 }
 
-static IoT_Error_t emptyJsonWithClientToken(char *pBuffer, size_t bufferSize) {
+void setClientTokenPrefix(const char *pClientID) {
+	uint8_t expected = CLIENT_TOKEN_PREFIX_UNSET;
+
+	// the first instance to connect names the tokens, later ones must not rewrite it under a reader
+	if(__atomic_compare_exchange_n(&clientTokenPrefixState, &expected, CLIENT_TOKEN_PREFIX_WRITING, false,
+								   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		snprintf(clientTokenPrefix, MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES, "%s", pClientID);
+		__atomic_store_n(&clientTokenPrefixState, CLIENT_TOKEN_PREFIX_SET, __ATOMIC_RELEASE);
+	}
+}
+
+static const char *getClientTokenPrefix(void) {
+	if(CLIENT_TOKEN_PREFIX_SET == __atomic_load_n(&clientTokenPrefixState, __ATOMIC_ACQUIRE)) {
+		return clientTokenPrefix;
+	}
+	return "";
+}
+
+static IoT_Error_t emptyJsonWithClientToken(const char *pClientID, char *pBuffer, size_t bufferSize) {
 
     IoT_Error_t rc = SUCCESS;
     size_t dataLenInBuffer = 0;
@@ -62,7 +89,7 @@ static IoT_Error_t emptyJsonWithClientToken(char *pBuffer, size_t bufferSize) {
 	{
 	    if ( dataLenInBuffer < bufferSize )
 	    {
-	        dataLenInBuffer += (size_t)snprintf(pBuffer + dataLenInBuffer, bufferSize - dataLenInBuffer, "%s-%d", mqttClientID, ( int )clientTokenNum++);
+	        dataLenInBuffer += (size_t)snprintf(pBuffer + dataLenInBuffer, bufferSize - dataLenInBuffer, "%s-%d", pClientID, ( int )nextClientTokenNum());
 	    }
 	    else
 	    {
@@ -92,12 +119,12 @@ static IoT_Error_t emptyJsonWithClientToken(char *pBuffer, size_t bufferSize) {
     FUNC_EXIT_RC(rc);
 }
 
-IoT_Error_t aws_iot_shadow_internal_get_request_json(char *pBuffer, size_t bufferSize) {
-	return emptyJsonWithClientToken( pBuffer, bufferSize);
+IoT_Error_t aws_iot_shadow_internal_get_request_json(const char *pClientID, char *pBuffer, size_t bufferSize) {
+	return emptyJsonWithClientToken( pClientID, pBuffer, bufferSize);
 }
 
-IoT_Error_t aws_iot_shadow_internal_delete_request_json(char *pBuffer, size_t bufferSize ) {
-	return emptyJsonWithClientToken( pBuffer, bufferSize);
+IoT_Error_t aws_iot_shadow_internal_delete_request_json(const char *pClientID, char *pBuffer, size_t bufferSize ) {
+	return emptyJsonWithClientToken( pClientID, pBuffer, bufferSize);
 }
 
 static inline IoT_Error_t checkReturnValueOfSnPrintf(int32_t snPrintfReturn, size_t maxSizeOfJsonDocument) {
@@ -269,8 +296,8 @@ IoT_Error_t aws_iot_shadow_add_reported(char *pJsonDocument, size_t maxSizeOfJso
 
 int32_t FillWithClientTokenSize(char *pBufferToBeUpdatedWithClientToken, size_t maxSizeOfJsonDocument) {
 	int32_t snPrintfReturn;
-	snPrintfReturn = snprintf(pBufferToBeUpdatedWithClientToken, maxSizeOfJsonDocument, "%s-%d", mqttClientID,
-				  (int) clientTokenNum++);
+	snPrintfReturn = snprintf(pBufferToBeUpdatedWithClientToken, maxSizeOfJsonDocument, "%s-%d", getClientTokenPrefix(),
+				  (int) nextClientTokenNum());
 
 	return snPrintfReturn;
 }
@@ -373,18 +400,14 @@ static IoT_Error_t convertDataToString(char *pStringBuffer, size_t maxSizoString
 	return ret_val;
 }
 
-static jsmn_parser shadowJsonParser;
-static jsmntok_t jsonTokenStruct[MAX_JSON_TOKEN_EXPECTED];
-
 bool isJsonValidAndParse(const char *pJsonDocument, size_t jsonSize, void *pJsonHandler, int32_t *pTokenCount) {
 	int32_t tokenCount;
+	ShadowJsonParser_t *pParser = (ShadowJsonParser_t *) pJsonHandler;
+	jsmntok_t *jsonTokenStruct = pParser->tokens;
 
-	IOT_UNUSED(pJsonHandler);
-
-	jsmn_init(&shadowJsonParser);
+	jsmn_init(&(pParser->parser));
 
-	tokenCount = jsmn_parse(&shadowJsonParser, pJsonDocument, jsonSize, jsonTokenStruct,
-							sizeof(jsonTokenStruct) / sizeof(jsonTokenStruct[0]));
+	tokenCount = jsmn_parse(&(pParser->parser), pJsonDocument, jsonSize, jsonTokenStruct, MAX_JSON_TOKEN_EXPECTED);
 
 	if(tokenCount < 0) {
 		IOT_WARN("Failed to parse JSON: %d\n", tokenCount);
@@ -434,8 +457,7 @@ bool isJsonKeyMatchingAndUpdateValue(const char *pJsonDocument, void *pJsonHandl
 	int32_t i;
 	uint32_t dataLength;
 	jsmntok_t dataToken;
-
-	IOT_UNUSED(pJsonHandler);
+	jsmntok_t *jsonTokenStruct = ((ShadowJsonParser_t *) pJsonHandler)->tokens;
 
 	for(i = 1; i < tokenCount; i++) {
 		if(jsoneq(pJsonDocument, &(jsonTokenStruct[i]), pDataStruct->pKey) == 0) {
@@ -452,13 +474,14 @@ bool isJsonKeyMatchingAndUpdateValue(const char *pJsonDocument, void *pJsonHandl
 	return false;
 }
 
-bool isReceivedJsonValid(const char *pJsonDocument, size_t jsonSize ) {
+bool isReceivedJsonValid(const char *pJsonDocument, size_t jsonSize, void *pJsonHandler) {
 	int32_t tokenCount;
+	ShadowJsonParser_t *pParser = (ShadowJsonParser_t *) pJsonHandler;
+	jsmntok_t *jsonTokenStruct = pParser->tokens;
 
-	jsmn_init(&shadowJsonParser);
+	jsmn_init(&(pParser->parser));
 
-	tokenCount = jsmn_parse(&shadowJsonParser, pJsonDocument, jsonSize, jsonTokenStruct,
-							sizeof(jsonTokenStruct) / sizeof(jsonTokenStruct[0]));
+	tokenCount = jsmn_parse(&(pParser->parser), pJsonDocument, jsonSize, jsonTokenStruct, MAX_JSON_TOKEN_EXPECTED);
 
 	if(tokenCount < 0) {
 		IOT_WARN("Failed to parse JSON: %d\n", tokenCount);
@@ -473,14 +496,17 @@ bool isReceivedJsonValid(const char *pJsonDocument, size_t jsonSize ) {
 	return true;
 }
 
-bool extractClientToken(const char *pJsonDocument, size_t jsonSize, char *pExtractedClientToken, size_t clientTokenSize) {
+bool extractClientToken(const char *pJsonDocument, size_t jsonSize, void *pJsonHandler, char *pExtractedClientToken,
+						size_t clientTokenSize) {
 	int32_t tokenCount, i;
 	size_t length;
 	jsmntok_t ClientJsonToken;
-	jsmn_init(&shadowJsonParser);
+	ShadowJsonParser_t *pParser = (ShadowJsonParser_t *) pJsonHandler;
+	jsmntok_t *jsonTokenStruct = pParser->tokens;
+
+	jsmn_init(&(pParser->parser));
 
-	tokenCount = jsmn_parse(&shadowJsonParser, pJsonDocument, jsonSize, jsonTokenStruct,
-							sizeof(jsonTokenStruct) / sizeof(jsonTokenStruct[0]));
+	tokenCount = jsmn_parse(&(pParser->parser), pJsonDocument, jsonSize, jsonTokenStruct, MAX_JSON_TOKEN_EXPECTED);
 
 	if(tokenCount < 0) {
 		IOT_WARN("Failed to parse JSON: %d\n", tokenCount);
@@ -514,8 +540,7 @@ bool extractClientToken(const char *pJsonDocument, size_t jsonSize, char *pExtra
 bool extractVersionNumber(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount, uint32_t *pVersionNumber) {
 	int32_t i;
 	IoT_Error_t ret_val = SUCCESS;
-
-	IOT_UNUSED(pJsonHandler);
+	jsmntok_t *jsonTokenStruct = ((ShadowJsonParser_t *) pJsonHandler)->tokens;
 
 	for(i = 1; i < tokenCount; i++) {
 		if(jsoneq(pJsonDocument, &(jsonTokenStruct[i]), SHADOW_VERSION_STRING) == 0) {
@@ -28,59 +28,17 @@ extern "C" {
 #include <stdio.h>
 
 #include "sdk/timer_interface.h"
+#include "sdk/aws_iot_timer_wheel.h"
 #include "sdk/aws_iot_json_utils.h"
 #include "sdk/aws_iot_log.h"
 #include "sdk/aws_iot_shadow_json.h"
 #include "aws_iot_config.h"
 
-typedef struct {
-	char clientTokenID[MAX_SIZE_CLIENT_ID_WITH_SEQUENCE];
-	char thingName[MAX_SIZE_OF_THING_NAME];
-	ShadowActions_t action;
-	fpActionCallback_t callback;
-	void *pCallbackContext;
-	bool isFree;
-	Timer timer;
-} ToBeReceivedAckRecord_t;
-
-typedef struct {
-	const char *pKey;
-	void *pStruct;
-	jsonStructCallback_t callback;
-	bool isFree;
-} JsonTokenTable_t;
-
-typedef struct {
-	char Topic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
-	uint8_t count;
-	bool isFree;
-	bool isSticky;
-} SubscriptionRecord_t;
-
 typedef enum {
 	SHADOW_ACCEPTED, SHADOW_REJECTED, SHADOW_ACTION
 } ShadowAckTopicTypes_t;
 
-ToBeReceivedAckRecord_t AckWaitList[MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME];
-
-AWS_IoT_Client *pMqttClient;
-
-char myThingName[MAX_SIZE_OF_THING_NAME];
-char mqttClientID[MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES];
-
-char shadowDeltaTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
-
-#define MAX_TOPICS_AT_ANY_GIVEN_TIME 2*MAX_THINGNAME_HANDLED_AT_ANY_GIVEN_TIME
-SubscriptionRecord_t SubscriptionList[MAX_TOPICS_AT_ANY_GIVEN_TIME];
-
 #define SUBSCRIBE_SETTLING_TIME 2
-char shadowRxBuf[SHADOW_MAX_SIZE_OF_RX_BUFFER];
-
-static JsonTokenTable_t tokenTable[MAX_JSON_TOKEN_EXPECTED];
-static uint32_t tokenTableIndex = 0;
-static bool deltaTopicSubscribedFlag = false;
-uint32_t shadowJsonVersionNum = 0;
-bool shadowDiscardOldDeltaFlag = true;
 
 // local helper functions
 static void AckStatusCallback(AWS_IoT_Client *pClient, char *topicName,
@@ -92,48 +50,49 @@ static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 static void topicNameFromThingAndAction(char *pTopic, const char *pThingName, ShadowActions_t action,
 										ShadowAckTopicTypes_t ackType);
 
-static int16_t getNextFreeIndexOfSubscriptionList(void);
+static int16_t getNextFreeIndexOfSubscriptionList(ShadowContext_t *pShadow);
 
-static void unsubscribeFromAcceptedAndRejected(uint8_t index);
+static void unsubscribeFromAcceptedAndRejected(ShadowContext_t *pShadow, uint8_t index);
 
-void initDeltaTokens(void) {
+void initDeltaTokens(ShadowContext_t *pShadow) {
 	uint32_t i;
 	for(i = 0; i < MAX_JSON_TOKEN_EXPECTED; i++) {
-		tokenTable[i].isFree = true;
+		pShadow->tokenTable[i].isFree = true;
 	}
-	tokenTableIndex = 0;
-	deltaTopicSubscribedFlag = false;
+	pShadow->tokenTableIndex = 0;
+	pShadow->deltaTopicSubscribedFlag = false;
 }
 
-IoT_Error_t registerJsonTokenOnDelta(jsonStruct_t *pStruct) {
+IoT_Error_t registerJsonTokenOnDelta(ShadowContext_t *pShadow, jsonStruct_t *pStruct) {
 
 	IoT_Error_t rc = SUCCESS;
 
-	if(!deltaTopicSubscribedFlag) {
-		snprintf(shadowDeltaTopic, MAX_SHADOW_TOPIC_LENGTH_BYTES, "$aws/things/%s/shadow/update/delta", myThingName);
-		rc = aws_iot_mqtt_subscribe(pMqttClient, shadowDeltaTopic, (uint16_t) strlen(shadowDeltaTopic), QOS0,
-									shadow_delta_callback, NULL);
-		deltaTopicSubscribedFlag = true;
+	if(!pShadow->deltaTopicSubscribedFlag) {
+		snprintf(pShadow->shadowDeltaTopic, MAX_SHADOW_TOPIC_LENGTH_BYTES, "$aws/things/%s/shadow/update/delta",
+				 pShadow->myThingName);
+		rc = aws_iot_mqtt_subscribe(pShadow->pMqttClient, pShadow->shadowDeltaTopic,
+									(uint16_t) strlen(pShadow->shadowDeltaTopic), QOS0, shadow_delta_callback, pShadow);
+		pShadow->deltaTopicSubscribedFlag = true;
 	}
 
-	if(tokenTableIndex >= MAX_JSON_TOKEN_EXPECTED) {
+	if(pShadow->tokenTableIndex >= MAX_JSON_TOKEN_EXPECTED) {
 		return FAILURE;
 	}
 
-	tokenTable[tokenTableIndex].pKey = pStruct->pKey;
-	tokenTable[tokenTableIndex].callback = pStruct->cb;
-	tokenTable[tokenTableIndex].pStruct = pStruct;
-	tokenTable[tokenTableIndex].isFree = false;
-	tokenTableIndex++;
+	pShadow->tokenTable[pShadow->tokenTableIndex].pKey = pStruct->pKey;
+	pShadow->tokenTable[pShadow->tokenTableIndex].callback = pStruct->cb;
+	pShadow->tokenTable[pShadow->tokenTableIndex].pStruct = pStruct;
+	pShadow->tokenTable[pShadow->tokenTableIndex].isFree = false;
+	pShadow->tokenTableIndex++;
 
 	return rc;
 }
 
-static int16_t getNextFreeIndexOfSubscriptionList(void) {
+static int16_t getNextFreeIndexOfSubscriptionList(ShadowContext_t *pShadow) {
 	uint8_t i;
 	for(i = 0; i < MAX_TOPICS_AT_ANY_GIVEN_TIME; i++) {
-		if(SubscriptionList[i].isFree) {
-			SubscriptionList[i].isFree = false;
+		if(pShadow->SubscriptionList[i].isFree) {
+			pShadow->SubscriptionList[i].isFree = false;
 			return i;
 		}
 	}
@@ -168,8 +127,8 @@ static void topicNameFromThingAndAction(char *pTopic, const char *pThingName, Sh
 	}
 }
 
-static bool isValidShadowVersionUpdate(const char *pTopicName) {
-	if(strstr(pTopicName, myThingName) != NULL &&
+static bool isValidShadowVersionUpdate(ShadowContext_t *pShadow, const char *pTopicName) {
+	if(strstr(pTopicName, pShadow->myThingName) != NULL &&
 	   ((strstr(pTopicName, "get/accepted") != NULL) ||
 		(strstr(pTopicName, "delta") != NULL))) {
 		return true;
@@ -181,39 +140,41 @@ static void AckStatusCallback(AWS_IoT_Client *pClient, char *topicName, uint16_t
 							  IoT_Publish_Message_Params *params, void *pData) {
 	int32_t tokenCount;
 	uint8_t i;
-	void *pJsonHandler = NULL;
+	void *pJsonHandler;
 	char temporaryClientToken[MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE];
+	ShadowContext_t *pShadow = (ShadowContext_t *) pData;
 
 	IOT_UNUSED(pClient);
 	IOT_UNUSED(topicNameLen);
-	IOT_UNUSED(pData);
 
 	if(params->payloadLen >= SHADOW_MAX_SIZE_OF_RX_BUFFER) {
 		IOT_WARN("Payload larger than RX Buffer");
 		return;
 	}
 
-	memcpy(shadowRxBuf, params->payload, params->payloadLen);
-	shadowRxBuf[params->payloadLen] = '\0';    // jsmn_parse relies on a string
+	memcpy(pShadow->shadowRxBuf, params->payload, params->payloadLen);
+	pShadow->shadowRxBuf[params->payloadLen] = '\0';    // jsmn_parse relies on a string
+	pJsonHandler = &(pShadow->jsonParser);
 
-	if(!isJsonValidAndParse(shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, pJsonHandler, &tokenCount)) {
+	if(!isJsonValidAndParse(pShadow->shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, pJsonHandler, &tokenCount)) {
 		IOT_WARN("Received JSON is not valid");
 		return;
 	}
 
-	if(isValidShadowVersionUpdate(topicName)) {
+	if(isValidShadowVersionUpdate(pShadow, topicName)) {
 		uint32_t tempVersionNumber = 0;
-		if(extractVersionNumber(shadowRxBuf, pJsonHandler, tokenCount, &tempVersionNumber)) {
-			if(tempVersionNumber > shadowJsonVersionNum) {
-				shadowJsonVersionNum = tempVersionNumber;
+		if(extractVersionNumber(pShadow->shadowRxBuf, pJsonHandler, tokenCount, &tempVersionNumber)) {
+			if(tempVersionNumber > pShadow->shadowJsonVersionNum) {
+				pShadow->shadowJsonVersionNum = tempVersionNumber;
 			}
 		}
 	}
 
-	if(extractClientToken(shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, temporaryClientToken, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE)) {
+	if(extractClientToken(pShadow->shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, pJsonHandler, temporaryClientToken,
+						  MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE)) {
 		for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
-			if(!AckWaitList[i].isFree) {
-				if(strcmp(AckWaitList[i].clientTokenID, temporaryClientToken) == 0) {
+			if(!pShadow->AckWaitList[i].isFree) {
+				if(strcmp(pShadow->AckWaitList[i].clientTokenID, temporaryClientToken) == 0) {
 					Shadow_Ack_Status_t status = SHADOW_ACK_REJECTED;
 					if(strstr(topicName, "accepted") != NULL) {
 						status = SHADOW_ACK_ACCEPTED;
@@ -221,12 +182,14 @@ static void AckStatusCallback(AWS_IoT_Client *pClient, char *topicName, uint16_t
 						status = SHADOW_ACK_REJECTED;
 					}
 					if(status == SHADOW_ACK_ACCEPTED || status == SHADOW_ACK_REJECTED) {
-						if(AckWaitList[i].callback != NULL) {
-							AckWaitList[i].callback(AckWaitList[i].thingName, AckWaitList[i].action, status,
-													shadowRxBuf, AckWaitList[i].pCallbackContext);
+						if(pShadow->AckWaitList[i].callback != NULL) {
+							pShadow->AckWaitList[i].callback(pShadow->AckWaitList[i].thingName,
+															 pShadow->AckWaitList[i].action, status, pShadow->shadowRxBuf,
+															 pShadow->AckWaitList[i].pCallbackContext);
 						}
-						unsubscribeFromAcceptedAndRejected(i);
-						AckWaitList[i].isFree = true;
+						aws_iot_timer_wheel_cancel(&(pShadow->AckTimeoutWheel), &(pShadow->AckWaitList[i].timeoutEntry));
+						unsubscribeFromAcceptedAndRejected(pShadow, i);
+						pShadow->AckWaitList[i].isFree = true;
 						return;
 					}
 				}
@@ -235,11 +198,11 @@ static void AckStatusCallback(AWS_IoT_Client *pClient, char *topicName, uint16_t
 	}
 }
 
-static int16_t findIndexOfSubscriptionList(const char *pTopic) {
+static int16_t findIndexOfSubscriptionList(ShadowContext_t *pShadow, const char *pTopic) {
 	uint8_t i;
 	for(i = 0; i < MAX_TOPICS_AT_ANY_GIVEN_TIME; i++) {
-		if(!SubscriptionList[i].isFree) {
-			if((strcmp(pTopic, SubscriptionList[i].Topic) == 0)) {
+		if(!pShadow->SubscriptionList[i].isFree) {
+			if((strcmp(pTopic, pShadow->SubscriptionList[i].Topic) == 0)) {
 				return i;
 			}
 		}
@@ -247,61 +210,71 @@ static int16_t findIndexOfSubscriptionList(const char *pTopic) {
 	return -1;
 }
 
-static void unsubscribeFromAcceptedAndRejected(uint8_t index) {
+static void unsubscribeFromAcceptedAndRejected(ShadowContext_t *pShadow, uint8_t index) {
 
 	char TemporaryTopicNameAccepted[MAX_SHADOW_TOPIC_LENGTH_BYTES];
 	char TemporaryTopicNameRejected[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	const char *pTopicNames[2];
+	uint16_t topicNameLens[2];
+	int16_t indexesToFree[2];
+	uint32_t unsubscribeCount = 0;
 	IoT_Error_t ret_val = SUCCESS;
 
 	int16_t indexSubList;
+	uint8_t i;
 
-	topicNameFromThingAndAction(TemporaryTopicNameAccepted, AckWaitList[index].thingName, AckWaitList[index].action,
-								SHADOW_ACCEPTED);
-	topicNameFromThingAndAction(TemporaryTopicNameRejected, AckWaitList[index].thingName, AckWaitList[index].action,
-								SHADOW_REJECTED);
-
-	indexSubList = findIndexOfSubscriptionList(TemporaryTopicNameAccepted);
-	if((indexSubList >= 0)) {
-		if(!SubscriptionList[indexSubList].isSticky && (SubscriptionList[indexSubList].count == 1)) {
-			ret_val = aws_iot_mqtt_unsubscribe(pMqttClient, TemporaryTopicNameAccepted,
-											   (uint16_t) strlen(TemporaryTopicNameAccepted));
-			if(ret_val == SUCCESS) {
-				SubscriptionList[indexSubList].isFree = true;
+	topicNameFromThingAndAction(TemporaryTopicNameAccepted, pShadow->AckWaitList[index].thingName,
+								pShadow->AckWaitList[index].action, SHADOW_ACCEPTED);
+	topicNameFromThingAndAction(TemporaryTopicNameRejected, pShadow->AckWaitList[index].thingName,
+								pShadow->AckWaitList[index].action, SHADOW_REJECTED);
+	pTopicNames[0] = TemporaryTopicNameAccepted;
+	pTopicNames[1] = TemporaryTopicNameRejected;
+
+	for(i = 0; i < 2; i++) {
+		indexSubList = findIndexOfSubscriptionList(pShadow, pTopicNames[i]);
+		if((indexSubList >= 0)) {
+			if(!pShadow->SubscriptionList[indexSubList].isSticky &&
+			   (pShadow->SubscriptionList[indexSubList].count == 1)) {
+				pTopicNames[unsubscribeCount] = pTopicNames[i];
+				topicNameLens[unsubscribeCount] = (uint16_t) strlen(pTopicNames[i]);
+				indexesToFree[unsubscribeCount] = indexSubList;
+				unsubscribeCount++;
+			} else if(pShadow->SubscriptionList[indexSubList].count > 1) {
+				pShadow->SubscriptionList[indexSubList].count--;
 			}
-		} else if(SubscriptionList[indexSubList].count > 1) {
-			SubscriptionList[indexSubList].count--;
 		}
 	}
 
-	indexSubList = findIndexOfSubscriptionList(TemporaryTopicNameRejected);
-	if((indexSubList >= 0)) {
-		if(!SubscriptionList[indexSubList].isSticky && (SubscriptionList[indexSubList].count == 1)) {
-			ret_val = aws_iot_mqtt_unsubscribe(pMqttClient, TemporaryTopicNameRejected,
-											   (uint16_t) strlen(TemporaryTopicNameRejected));
-			if(ret_val == SUCCESS) {
-				SubscriptionList[indexSubList].isFree = true;
-			}
-		} else if(SubscriptionList[indexSubList].count > 1) {
-			SubscriptionList[indexSubList].count--;
+	if(0 == unsubscribeCount) {
+		return;
+	}
+
+	// accepted and rejected go in one UNSUBSCRIBE packet
+	ret_val = aws_iot_mqtt_unsubscribe_batch(pShadow->pMqttClient, pTopicNames, topicNameLens, unsubscribeCount);
+	if(ret_val == SUCCESS) {
+		for(i = 0; i < unsubscribeCount; i++) {
+			pShadow->SubscriptionList[indexesToFree[i]].isFree = true;
 		}
 	}
 }
 
-void initializeRecords(AWS_IoT_Client *pClient) {
+void initializeRecords(ShadowContext_t *pShadow, AWS_IoT_Client *pClient) {
 	uint8_t i;
+	aws_iot_timer_wheel_init(&(pShadow->AckTimeoutWheel));
 	for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
-		AckWaitList[i].isFree = true;
+		pShadow->AckWaitList[i].isFree = true;
+		aws_iot_timer_wheel_init_entry(&(pShadow->AckWaitList[i].timeoutEntry), &(pShadow->AckWaitList[i]));
 	}
 	for(i = 0; i < MAX_TOPICS_AT_ANY_GIVEN_TIME; i++) {
-		SubscriptionList[i].isFree = true;
-		SubscriptionList[i].count = 0;
-		SubscriptionList[i].isSticky = false;
+		pShadow->SubscriptionList[i].isFree = true;
+		pShadow->SubscriptionList[i].count = 0;
+		pShadow->SubscriptionList[i].isSticky = false;
 	}
 
-	pMqttClient = pClient;
+	pShadow->pMqttClient = pClient;
 }
 
-bool isSubscriptionPresent(const char *pThingName, ShadowActions_t action) {
+bool isSubscriptionPresent(ShadowContext_t *pShadow, const char *pThingName, ShadowActions_t action) {
 
 	uint8_t i = 0;
 	bool isAcceptedPresent = false;
@@ -313,10 +286,10 @@ bool isSubscriptionPresent(const char *pThingName, ShadowActions_t action) {
 	topicNameFromThingAndAction(TemporaryTopicNameRejected, pThingName, action, SHADOW_REJECTED);
 
 	for(i = 0; i < MAX_TOPICS_AT_ANY_GIVEN_TIME; i++) {
-		if(!SubscriptionList[i].isFree) {
-			if((strcmp(TemporaryTopicNameAccepted, SubscriptionList[i].Topic) == 0)) {
+		if(!pShadow->SubscriptionList[i].isFree) {
+			if((strcmp(TemporaryTopicNameAccepted, pShadow->SubscriptionList[i].Topic) == 0)) {
 				isAcceptedPresent = true;
-			} else if((strcmp(TemporaryTopicNameRejected, SubscriptionList[i].Topic) == 0)) {
+			} else if((strcmp(TemporaryTopicNameRejected, pShadow->SubscriptionList[i].Topic) == 0)) {
 				isRejectedPresent = true;
 			}
 		}
@@ -329,54 +302,68 @@ bool isSubscriptionPresent(const char *pThingName, ShadowActions_t action) {
 	return false;
 }
 
-IoT_Error_t subscribeToShadowActionAcks(const char *pThingName, ShadowActions_t action, bool isSticky) {
+IoT_Error_t subscribeToShadowActionAcks(ShadowContext_t *pShadow, const char *pThingName, ShadowActions_t action,
+										bool isSticky) {
 	IoT_Error_t ret_val = SUCCESS;
 
 	bool clearBothEntriesFromList = true;
 	int16_t indexAcceptedSubList = 0;
 	int16_t indexRejectedSubList = 0;
+	IoT_Subscribe_Params subscribeParams[2];
 	Timer subSettlingtimer;
-	indexAcceptedSubList = getNextFreeIndexOfSubscriptionList();
-	indexRejectedSubList = getNextFreeIndexOfSubscriptionList();
+	indexAcceptedSubList = getNextFreeIndexOfSubscriptionList(pShadow);
+	indexRejectedSubList = getNextFreeIndexOfSubscriptionList(pShadow);
+
+	subscribeParams[0].returnCode = AWS_IOT_MQTT_SUBACK_FAILURE;
+	subscribeParams[1].returnCode = AWS_IOT_MQTT_SUBACK_FAILURE;
 
 	if(indexAcceptedSubList >= 0 && indexRejectedSubList >= 0) {
-		topicNameFromThingAndAction(SubscriptionList[indexAcceptedSubList].Topic, pThingName, action, SHADOW_ACCEPTED);
-		ret_val = aws_iot_mqtt_subscribe(pMqttClient, SubscriptionList[indexAcceptedSubList].Topic,
-										 (uint16_t) strlen(SubscriptionList[indexAcceptedSubList].Topic), QOS0,
-										 AckStatusCallback, NULL);
+		topicNameFromThingAndAction(pShadow->SubscriptionList[indexAcceptedSubList].Topic, pThingName, action,
+									SHADOW_ACCEPTED);
+		topicNameFromThingAndAction(pShadow->SubscriptionList[indexRejectedSubList].Topic, pThingName, action,
+									SHADOW_REJECTED);
+
+		subscribeParams[0].pTopicName = pShadow->SubscriptionList[indexAcceptedSubList].Topic;
+		subscribeParams[1].pTopicName = pShadow->SubscriptionList[indexRejectedSubList].Topic;
+		subscribeParams[0].topicNameLen = (uint16_t) strlen(pShadow->SubscriptionList[indexAcceptedSubList].Topic);
+		subscribeParams[1].topicNameLen = (uint16_t) strlen(pShadow->SubscriptionList[indexRejectedSubList].Topic);
+		subscribeParams[0].qos = subscribeParams[1].qos = QOS0;
+		subscribeParams[0].pApplicationHandler = subscribeParams[1].pApplicationHandler = AckStatusCallback;
+		subscribeParams[0].pApplicationHandlerData = subscribeParams[1].pApplicationHandlerData = pShadow;
+
+		// accepted and rejected go in one SUBSCRIBE packet, a single round trip
+		ret_val = aws_iot_mqtt_subscribe_batch(pShadow->pMqttClient, subscribeParams, 2);
 		if(ret_val == SUCCESS) {
-			SubscriptionList[indexAcceptedSubList].count = 1;
-			SubscriptionList[indexAcceptedSubList].isSticky = isSticky;
-			topicNameFromThingAndAction(SubscriptionList[indexRejectedSubList].Topic, pThingName, action,
-										SHADOW_REJECTED);
-			ret_val = aws_iot_mqtt_subscribe(pMqttClient, SubscriptionList[indexRejectedSubList].Topic,
-											 (uint16_t) strlen(SubscriptionList[indexRejectedSubList].Topic), QOS0,
-											 AckStatusCallback, NULL);
-			if(ret_val == SUCCESS) {
-				SubscriptionList[indexRejectedSubList].count = 1;
-				SubscriptionList[indexRejectedSubList].isSticky = isSticky;
-				clearBothEntriesFromList = false;
-
-				// wait for SUBSCRIBE_SETTLING_TIME seconds to let the subscription take effect
-				init_timer(&subSettlingtimer);
-				countdown_sec(&subSettlingtimer, SUBSCRIBE_SETTLING_TIME);
-				while(!has_timer_expired(&subSettlingtimer));
-
-			}
+			pShadow->SubscriptionList[indexAcceptedSubList].count = 1;
+			pShadow->SubscriptionList[indexAcceptedSubList].isSticky = isSticky;
+			pShadow->SubscriptionList[indexRejectedSubList].count = 1;
+			pShadow->SubscriptionList[indexRejectedSubList].isSticky = isSticky;
+			clearBothEntriesFromList = false;
+
+			// wait for SUBSCRIBE_SETTLING_TIME seconds to let the subscription take effect
+			init_timer(&subSettlingtimer);
+			countdown_sec(&subSettlingtimer, SUBSCRIBE_SETTLING_TIME);
+			while(!has_timer_expired(&subSettlingtimer));
 		}
 	}
 
 	if(clearBothEntriesFromList) {
 		if(indexAcceptedSubList >= 0) {
-			SubscriptionList[indexAcceptedSubList].isFree = true;
-			
-			if(SubscriptionList[indexAcceptedSubList].count == 1) {
-			    aws_iot_mqtt_unsubscribe(pMqttClient, SubscriptionList[indexAcceptedSubList].Topic,
-				(uint16_t) strlen(SubscriptionList[indexAcceptedSubList].Topic));
-		    }
+			pShadow->SubscriptionList[indexAcceptedSubList].isFree = true;
+
+			// the broker may have granted one of the two
+			if(subscribeParams[0].returnCode != AWS_IOT_MQTT_SUBACK_FAILURE) {
+				aws_iot_mqtt_unsubscribe(pShadow->pMqttClient, subscribeParams[0].pTopicName,
+										 subscribeParams[0].topicNameLen);
+			}
 		}
 		if(indexRejectedSubList >= 0) {
-			SubscriptionList[indexRejectedSubList].isFree = true;
+			pShadow->SubscriptionList[indexRejectedSubList].isFree = true;
+
+			if(subscribeParams[1].returnCode != AWS_IOT_MQTT_SUBACK_FAILURE) {
+				aws_iot_mqtt_unsubscribe(pShadow->pMqttClient, subscribeParams[1].pTopicName,
+										 subscribeParams[1].topicNameLen);
+			}
 		}
 
 	}
@@ -384,7 +371,7 @@ IoT_Error_t subscribeToShadowActionAcks(const char *pThingName, ShadowActions_t
 	return ret_val;
 }
 
-void incrementSubscriptionCnt(const char *pThingName, ShadowActions_t action, bool isSticky) {
+void incrementSubscriptionCnt(ShadowContext_t *pShadow, const char *pThingName, ShadowActions_t action, bool isSticky) {
 	char TemporaryTopicNameAccepted[MAX_SHADOW_TOPIC_LENGTH_BYTES];
 	char TemporaryTopicNameRejected[MAX_SHADOW_TOPIC_LENGTH_BYTES];
 	uint8_t i;
@@ -392,17 +379,18 @@ void incrementSubscriptionCnt(const char *pThingName, ShadowActions_t action, bo
 	topicNameFromThingAndAction(TemporaryTopicNameRejected, pThingName, action, SHADOW_REJECTED);
 
 	for(i = 0; i < MAX_TOPICS_AT_ANY_GIVEN_TIME; i++) {
-		if(!SubscriptionList[i].isFree) {
-			if((strcmp(TemporaryTopicNameAccepted, SubscriptionList[i].Topic) == 0)
-			   || (strcmp(TemporaryTopicNameRejected, SubscriptionList[i].Topic) == 0)) {
-				SubscriptionList[i].count++;
-				SubscriptionList[i].isSticky = isSticky;
+		if(!pShadow->SubscriptionList[i].isFree) {
+			if((strcmp(TemporaryTopicNameAccepted, pShadow->SubscriptionList[i].Topic) == 0)
+			   || (strcmp(TemporaryTopicNameRejected, pShadow->SubscriptionList[i].Topic) == 0)) {
+				pShadow->SubscriptionList[i].count++;
+				pShadow->SubscriptionList[i].isSticky = isSticky;
 			}
 		}
 	}
 }
 
-IoT_Error_t publishToShadowAction(const char *pThingName, ShadowActions_t action, const char *pJsonDocumentToBeSent) {
+IoT_Error_t publishToShadowAction(ShadowContext_t *pShadow, const char *pThingName, ShadowActions_t action,
+								  const char *pJsonDocumentToBeSent) {
 	IoT_Error_t ret_val = SUCCESS;
 	char TemporaryTopicName[MAX_SHADOW_TOPIC_LENGTH_BYTES];
 	IoT_Publish_Message_Params msgParams;
@@ -417,12 +405,13 @@ IoT_Error_t publishToShadowAction(const char *pThingName, ShadowActions_t action
 	msgParams.isRetained = 0;
 	msgParams.payloadLen = strlen(pJsonDocumentToBeSent);
 	msgParams.payload = (char *) pJsonDocumentToBeSent;
-	ret_val = aws_iot_mqtt_publish(pMqttClient, TemporaryTopicName, (uint16_t) strlen(TemporaryTopicName), &msgParams);
+	ret_val = aws_iot_mqtt_publish(pShadow->pMqttClient, TemporaryTopicName, (uint16_t) strlen(TemporaryTopicName),
+								   &msgParams);
 
 	return ret_val;
 }
 
-bool getNextFreeIndexOfAckWaitList(uint8_t *pIndex) {
+bool getNextFreeIndexOfAckWaitList(ShadowContext_t *pShadow, uint8_t *pIndex) {
 	uint8_t i;
 	bool rc = false;
 
@@ -431,7 +420,7 @@ bool getNextFreeIndexOfAckWaitList(uint8_t *pIndex) {
 	}
 
 	for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
-		if(AckWaitList[i].isFree) {
+		if(pShadow->AckWaitList[i].isFree) {
 			*pIndex = i;
 			rc = true;
 			break;
@@ -441,32 +430,33 @@ bool getNextFreeIndexOfAckWaitList(uint8_t *pIndex) {
 	return rc;
 }
 
-void addToAckWaitList(uint8_t indexAckWaitList, const char *pThingName, ShadowActions_t action,
-					  const char *pExtractedClientToken, fpActionCallback_t callback, void *pCallbackContext,
-					  uint32_t timeout_seconds) {
-	AckWaitList[indexAckWaitList].callback = callback;
-	memcpy(AckWaitList[indexAckWaitList].clientTokenID, pExtractedClientToken, MAX_SIZE_CLIENT_ID_WITH_SEQUENCE);
-	memcpy(AckWaitList[indexAckWaitList].thingName, pThingName, MAX_SIZE_OF_THING_NAME);
-	AckWaitList[indexAckWaitList].pCallbackContext = pCallbackContext;
-	AckWaitList[indexAckWaitList].action = action;
-	init_timer(&(AckWaitList[indexAckWaitList].timer));
-	countdown_sec(&(AckWaitList[indexAckWaitList].timer), timeout_seconds);
-	AckWaitList[indexAckWaitList].isFree = false;
+void addToAckWaitList(ShadowContext_t *pShadow, uint8_t indexAckWaitList, const char *pThingName,
+					  ShadowActions_t action, const char *pExtractedClientToken, fpActionCallback_t callback,
+					  void *pCallbackContext, uint32_t timeout_seconds) {
+	pShadow->AckWaitList[indexAckWaitList].callback = callback;
+	memcpy(pShadow->AckWaitList[indexAckWaitList].clientTokenID, pExtractedClientToken,
+		   MAX_SIZE_CLIENT_ID_WITH_SEQUENCE);
+	memcpy(pShadow->AckWaitList[indexAckWaitList].thingName, pThingName, MAX_SIZE_OF_THING_NAME);
+	pShadow->AckWaitList[indexAckWaitList].pCallbackContext = pCallbackContext;
+	pShadow->AckWaitList[indexAckWaitList].action = action;
+	aws_iot_timer_wheel_schedule(&(pShadow->AckTimeoutWheel), &(pShadow->AckWaitList[indexAckWaitList].timeoutEntry),
+								 timeout_seconds * 1000);
+	pShadow->AckWaitList[indexAckWaitList].isFree = false;
 }
 
-void HandleExpiredResponseCallbacks(void) {
+void HandleExpiredResponseCallbacks(ShadowContext_t *pShadow) {
+	TimerWheelEntry *pEntry;
 	uint8_t i;
-	for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
-		if(!AckWaitList[i].isFree) {
-			if(has_timer_expired(&(AckWaitList[i].timer))) {
-				if(AckWaitList[i].callback != NULL) {
-					AckWaitList[i].callback(AckWaitList[i].thingName, AckWaitList[i].action, SHADOW_ACK_TIMEOUT,
-											shadowRxBuf, AckWaitList[i].pCallbackContext);
-				}
-				AckWaitList[i].isFree = true;
-				unsubscribeFromAcceptedAndRejected(i);
-			}
+	// only the records whose timeout passed are visited, callbacks may add new ones
+	while((pEntry = aws_iot_timer_wheel_expire(&(pShadow->AckTimeoutWheel))) != NULL) {
+		i = (uint8_t) ((ToBeReceivedAckRecord_t *) pEntry->pData - pShadow->AckWaitList);
+		if(pShadow->AckWaitList[i].callback != NULL) {
+			pShadow->AckWaitList[i].callback(pShadow->AckWaitList[i].thingName, pShadow->AckWaitList[i].action,
+											 SHADOW_ACK_TIMEOUT, pShadow->shadowRxBuf,
+											 pShadow->AckWaitList[i].pCallbackContext);
 		}
+		pShadow->AckWaitList[i].isFree = true;
+		unsubscribeFromAcceptedAndRejected(pShadow, i);
 	}
 }
 
@@ -474,50 +464,53 @@ static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 								  uint16_t topicNameLen, IoT_Publish_Message_Params *params, void *pData) {
 	int32_t tokenCount;
 	uint32_t i = 0;
-	void *pJsonHandler = NULL;
+	void *pJsonHandler;
 	int32_t DataPosition;
 	uint32_t dataLength;
 	uint32_t tempVersionNumber = 0;
 
+	ShadowContext_t *pShadow = (ShadowContext_t *) pData;
+
 	FUNC_ENTRY;
 
 	IOT_UNUSED(pClient);
 	IOT_UNUSED(topicName);
 	IOT_UNUSED(topicNameLen);
-	IOT_UNUSED(pData);
 
 	if(params->payloadLen >= SHADOW_MAX_SIZE_OF_RX_BUFFER) {
 		IOT_WARN("Payload larger than RX Buffer");
 		return;
 	}
 
-	memcpy(shadowRxBuf, params->payload, params->payloadLen);
-	shadowRxBuf[params->payloadLen] = '\0';    // jsmn_parse relies on a string
+	memcpy(pShadow->shadowRxBuf, params->payload, params->payloadLen);
+	pShadow->shadowRxBuf[params->payloadLen] = '\0';    // jsmn_parse relies on a string
+	pJsonHandler = &(pShadow->jsonParser);
 
-	if(!isJsonValidAndParse(shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, pJsonHandler, &tokenCount)) {
+	if(!isJsonValidAndParse(pShadow->shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, pJsonHandler, &tokenCount)) {
 		IOT_WARN("Received JSON is not valid");
 		return;
 	}
 
-	if(shadowDiscardOldDeltaFlag) {
-		if(extractVersionNumber(shadowRxBuf, pJsonHandler, tokenCount, &tempVersionNumber)) {
-			if(tempVersionNumber > shadowJsonVersionNum) {
-				shadowJsonVersionNum = tempVersionNumber;
+	if(pShadow->shadowDiscardOldDeltaFlag) {
+		if(extractVersionNumber(pShadow->shadowRxBuf, pJsonHandler, tokenCount, &tempVersionNumber)) {
+			if(tempVersionNumber > pShadow->shadowJsonVersionNum) {
+				pShadow->shadowJsonVersionNum = tempVersionNumber;
 			} else {
 				IOT_WARN("Old Delta Message received - Ignoring rx: %d local: %d", tempVersionNumber,
-						 shadowJsonVersionNum);
+						 pShadow->shadowJsonVersionNum);
 				return;
 			}
 		}
 	}
 
-	for(i = 0; i < tokenTableIndex; i++) {
-		if(!tokenTable[i].isFree) {
-			if(isJsonKeyMatchingAndUpdateValue(shadowRxBuf, pJsonHandler, tokenCount,
-											   (jsonStruct_t *) tokenTable[i].pStruct, &dataLength, &DataPosition)) {
-				if(tokenTable[i].callback != NULL) {
-					tokenTable[i].callback(shadowRxBuf + DataPosition, dataLength,
-										   (jsonStruct_t *) tokenTable[i].pStruct);
+	for(i = 0; i < pShadow->tokenTableIndex; i++) {
+		if(!pShadow->tokenTable[i].isFree) {
+			if(isJsonKeyMatchingAndUpdateValue(pShadow->shadowRxBuf, pJsonHandler, tokenCount,
+											   (jsonStruct_t *) pShadow->tokenTable[i].pStruct, &dataLength,
+											   &DataPosition)) {
+				if(pShadow->tokenTable[i].callback != NULL) {
+					pShadow->tokenTable[i].callback(pShadow->shadowRxBuf + DataPosition, dataLength,
+													(jsonStruct_t *) pShadow->tokenTable[i].pStruct);
 				}
 			}
 		}
@@ -0,0 +1,278 @@
+/*
+ * Copyright 2010-2015 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_timer_wheel.c
+ * @brief Hierarchical timing wheel
+ *
+ * Level L holds the entries expiring between 64^L and 64^(L+1) ticks from the current
+ * tick, in the slot selected by bits 6L to 6L+5 of their expiry tick. When the lower
+ * bits of the current tick wrap to zero the current slot of the level above is moved
+ * down, so an entry reaches level 0 before it is due.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "sdk/aws_iot_timer_wheel.h"
+#include "sdk/timer_interface.h"
+#include "aws_iot_config.h"
+
+#define TIMER_WHEEL_SLOT_MASK (AWS_IOT_TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_MAX_TICKS ((1u << (AWS_IOT_TIMER_WHEEL_LEVEL_BITS * AWS_IOT_TIMER_WHEEL_LEVELS)) - 1)
+#define TIMER_WHEEL_EXPIRED_SLOT 0xFFFF
+
+static void _aws_iot_timer_wheel_link(TimerWheelEntry **ppHead, TimerWheelEntry *pEntry) {
+	pEntry->pNext = *ppHead;
+	if(NULL != pEntry->pNext) {
+		pEntry->pNext->ppPrev = &(pEntry->pNext);
+	}
+	*ppHead = pEntry;
+	pEntry->ppPrev = ppHead;
+}
+
+static void _aws_iot_timer_wheel_unlink(TimerWheelEntry *pEntry) {
+	*(pEntry->ppPrev) = pEntry->pNext;
+	if(NULL != pEntry->pNext) {
+		pEntry->pNext->ppPrev = pEntry->ppPrev;
+	}
+	pEntry->pNext = NULL;
+	pEntry->ppPrev = NULL;
+}
+
+/* Slot n of the rotated bitmap is slot (n + count) of the level */
+static uint64_t _aws_iot_timer_wheel_rotate(uint64_t bitmap, uint32_t count) {
+	count &= TIMER_WHEEL_SLOT_MASK;
+	if(0 == count) {
+		return bitmap;
+	}
+	return (bitmap >> count) | (bitmap << (AWS_IOT_TIMER_WHEEL_SLOTS - count));
+}
+
+static void _aws_iot_timer_wheel_add(TimerWheel *pWheel, TimerWheelEntry *pEntry) {
+	uint32_t delta, level, slot;
+
+	delta = pEntry->expiryTick - pWheel->currentTick;
+	if(0 > (int32_t) delta) {
+		/* Overdue entries moved down late go to the slot processed next */
+		level = 0;
+		slot = pWheel->currentTick & TIMER_WHEEL_SLOT_MASK;
+	} else {
+		for(level = 0; level < AWS_IOT_TIMER_WHEEL_LEVELS - 1; level++) {
+			if(delta < (1u << (AWS_IOT_TIMER_WHEEL_LEVEL_BITS * (level + 1)))) {
+				break;
+			}
+		}
+		slot = (pEntry->expiryTick >> (AWS_IOT_TIMER_WHEEL_LEVEL_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+	}
+
+	_aws_iot_timer_wheel_link(&(pWheel->pSlots[level][slot]), pEntry);
+	pEntry->slotIndex = (uint16_t) (level * AWS_IOT_TIMER_WHEEL_SLOTS + slot);
+	pWheel->occupied[level] |= (uint64_t) 1 << slot;
+	pWheel->entryCount++;
+}
+
+/* Moves the entries of a slot above level 0 to the levels matching their remaining time */
+static void _aws_iot_timer_wheel_cascade(TimerWheel *pWheel, uint32_t level, uint32_t slot) {
+	TimerWheelEntry *pEntry, *pNext;
+
+	pEntry = pWheel->pSlots[level][slot];
+	pWheel->pSlots[level][slot] = NULL;
+	pWheel->occupied[level] &= ~((uint64_t) 1 << slot);
+
+	while(NULL != pEntry) {
+		pNext = pEntry->pNext;
+		pWheel->entryCount--;
+		_aws_iot_timer_wheel_add(pWheel, pEntry);
+		pEntry = pNext;
+	}
+}
+
+static void _aws_iot_timer_wheel_run_tick(TimerWheel *pWheel) {
+	TimerWheelEntry *pEntry;
+	uint32_t tick, level, slot;
+
+	tick = pWheel->currentTick;
+	for(level = 1; level < AWS_IOT_TIMER_WHEEL_LEVELS; level++) {
+		if(0 != (tick & ((1u << (AWS_IOT_TIMER_WHEEL_LEVEL_BITS * level)) - 1))) {
+			break;
+		}
+		slot = (tick >> (AWS_IOT_TIMER_WHEEL_LEVEL_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+		if(0 != (pWheel->occupied[level] & ((uint64_t) 1 << slot))) {
+			_aws_iot_timer_wheel_cascade(pWheel, level, slot);
+		}
+	}
+
+	slot = tick & TIMER_WHEEL_SLOT_MASK;
+	while(NULL != (pEntry = pWheel->pSlots[0][slot])) {
+		_aws_iot_timer_wheel_unlink(pEntry);
+		pWheel->entryCount--;
+		pEntry->slotIndex = TIMER_WHEEL_EXPIRED_SLOT;
+		_aws_iot_timer_wheel_link(&(pWheel->pExpired), pEntry);
+	}
+	pWheel->occupied[0] &= ~((uint64_t) 1 << slot);
+
+	pWheel->currentTick++;
+	pWheel->lastTickMs += AWS_IOT_TIMER_WHEEL_TICK_MS;
+}
+
+/* Processes every tick that ended on the coarse clock */
+static void _aws_iot_timer_wheel_advance(TimerWheel *pWheel) {
+	uint32_t now, ticks;
+
+	now = get_coarse_time_ms();
+	while(AWS_IOT_TIMER_WHEEL_TICK_MS <= (int32_t) (now - pWheel->lastTickMs)) {
+		if(0 == pWheel->entryCount) {
+			/* Nothing left to move, skip the idle ticks at once */
+			ticks = (now - pWheel->lastTickMs) / AWS_IOT_TIMER_WHEEL_TICK_MS;
+			pWheel->currentTick += ticks;
+			pWheel->lastTickMs += ticks * AWS_IOT_TIMER_WHEEL_TICK_MS;
+			break;
+		}
+		_aws_iot_timer_wheel_run_tick(pWheel);
+	}
+}
+
+void aws_iot_timer_wheel_init(TimerWheel *pWheel) {
+	memset(pWheel, 0, sizeof(TimerWheel));
+	pWheel->lastTickMs = get_coarse_time_ms();
+}
+
+void aws_iot_timer_wheel_init_entry(TimerWheelEntry *pEntry, void *pData) {
+	pEntry->pNext = NULL;
+	pEntry->ppPrev = NULL;
+	pEntry->expiryTick = 0;
+	pEntry->slotIndex = TIMER_WHEEL_EXPIRED_SLOT;
+	pEntry->pData = pData;
+}
+
+void aws_iot_timer_wheel_schedule(TimerWheel *pWheel, TimerWheelEntry *pEntry, uint32_t timeoutMs) {
+	uint64_t ticks;
+
+	aws_iot_timer_wheel_cancel(pWheel, pEntry);
+	_aws_iot_timer_wheel_advance(pWheel);
+
+	/* Tick currentTick + n is processed once the coarse clock reaches lastTickMs + (n + 1) ticks.
+	 * The deadline is taken from the precise clock, which is never behind the coarse one */
+	ticks = ((uint64_t) (get_time_ms() - pWheel->lastTickMs) + timeoutMs + AWS_IOT_TIMER_WHEEL_TICK_MS - 1)
+			/ AWS_IOT_TIMER_WHEEL_TICK_MS;
+	if(0 < ticks) {
+		ticks--;
+	}
+	if(TIMER_WHEEL_MAX_TICKS < ticks) {
+		ticks = TIMER_WHEEL_MAX_TICKS;
+	}
+
+	pEntry->expiryTick = pWheel->currentTick + (uint32_t) ticks;
+	_aws_iot_timer_wheel_add(pWheel, pEntry);
+}
+
+void aws_iot_timer_wheel_cancel(TimerWheel *pWheel, TimerWheelEntry *pEntry) {
+	uint32_t level, slot;
+
+	if(NULL == pEntry->ppPrev) {
+		return;
+	}
+
+	_aws_iot_timer_wheel_unlink(pEntry);
+	if(TIMER_WHEEL_EXPIRED_SLOT == pEntry->slotIndex) {
+		return;
+	}
+
+	level = pEntry->slotIndex / AWS_IOT_TIMER_WHEEL_SLOTS;
+	slot = pEntry->slotIndex & TIMER_WHEEL_SLOT_MASK;
+	if(NULL == pWheel->pSlots[level][slot]) {
+		pWheel->occupied[level] &= ~((uint64_t) 1 << slot);
+	}
+	pWheel->entryCount--;
+	pEntry->slotIndex = TIMER_WHEEL_EXPIRED_SLOT;
+}
+
+bool aws_iot_timer_wheel_is_scheduled(const TimerWheelEntry *pEntry) {
+	return NULL != pEntry->ppPrev;
+}
+
+TimerWheelEntry *aws_iot_timer_wheel_expire(TimerWheel *pWheel) {
+	TimerWheelEntry *pEntry;
+
+	if(NULL == pWheel->pExpired) {
+		_aws_iot_timer_wheel_advance(pWheel);
+	}
+
+	pEntry = pWheel->pExpired;
+	if(NULL != pEntry) {
+		_aws_iot_timer_wheel_unlink(pEntry);
+	}
+
+	return pEntry;
+}
+
+uint32_t aws_iot_timer_wheel_next_timeout_ms(const TimerWheel *pWheel) {
+	uint32_t level, shift, pos, ticks, candidate, elapsedMs;
+	uint64_t bitmap, waitMs;
+
+	if(NULL != pWheel->pExpired) {
+		return 0;
+	}
+	if(0 == pWheel->entryCount) {
+		return AWS_IOT_TIMER_WHEEL_NO_TIMEOUT;
+	}
+
+	ticks = AWS_IOT_TIMER_WHEEL_NO_TIMEOUT;
+	for(level = 0; level < AWS_IOT_TIMER_WHEEL_LEVELS; level++) {
+		bitmap = pWheel->occupied[level];
+		if(0 == bitmap) {
+			continue;
+		}
+
+		shift = AWS_IOT_TIMER_WHEEL_LEVEL_BITS * level;
+		pos = (pWheel->currentTick >> shift) & TIMER_WHEEL_SLOT_MASK;
+		if(0 == level) {
+			candidate = (uint32_t) __builtin_ctzll(_aws_iot_timer_wheel_rotate(bitmap, pos));
+		} else if(0 == (pWheel->currentTick & ((1u << shift) - 1)) && 0 != (bitmap & ((uint64_t) 1 << pos))) {
+			/* The current slot is moved down by the tick processed next */
+			candidate = 0;
+		} else {
+			/* Other slots are moved down when the lower levels wrap to them, the
+			 * current slot only holds entries for the next turn of the level */
+			candidate = (uint32_t) __builtin_ctzll(_aws_iot_timer_wheel_rotate(bitmap, pos + 1)) + 1;
+			candidate = (((pWheel->currentTick >> shift) + candidate) << shift) - pWheel->currentTick;
+		}
+
+		if(candidate < ticks) {
+			ticks = candidate;
+		}
+	}
+
+	waitMs = ((uint64_t) ticks + 1) * AWS_IOT_TIMER_WHEEL_TICK_MS;
+	elapsedMs = get_coarse_time_ms() - pWheel->lastTickMs;
+	if(waitMs <= elapsedMs) {
+		return 0;
+	}
+
+	waitMs -= elapsedMs;
+	if(AWS_IOT_TIMER_WHEEL_NO_TIMEOUT <= waitMs) {
+		waitMs = AWS_IOT_TIMER_WHEEL_NO_TIMEOUT - 1;
+	}
+
+	return (uint32_t) waitMs;
+}
+
+#ifdef __cplusplus
+}
+#endif
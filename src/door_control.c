@@ -17,17 +17,14 @@
 #include <service_app.h>
 #include "log.h"
 #include <peripheral_io.h>
-#include <unistd.h>
 
-extern bool terminate_yield_thread;
+extern void terminate_mqtt(void);
 
 extern int resource_switch_close(void);
 extern int resource_switch_open(void);
 extern void resource_camera_close(void);
 extern int init_mqtt(void);
 
-#define MAX_RETRY_COUNT	100
-
 bool service_app_create(void *data)
 {
 	int ret = 0;
@@ -40,18 +37,10 @@ bool service_app_create(void *data)
 		return false;
 	}
 
-	int count = 0;
-	while (count < MAX_RETRY_COUNT) {
-		ret = init_mqtt();
-		if (ret == 0) {
-			INFO("mqtt init count [%d] success", count);
-			return true;
-		} else {
-			count++;
-			ERR("mqtt init count [%d] failed", count);
-			sleep(2);
-		}
-	}
+	/* Returns at once, the connection comes up in the background */
+	ret = init_mqtt();
+	if (ret != 0)
+		ERR("mqtt init failed [%d]", ret);
 
     return true;
 }
@@ -61,7 +50,7 @@ void service_app_terminate(void *data)
 	INFO("service_app_terminate\n");
 	int ret = 0;
 
-	terminate_yield_thread = true;
+	terminate_mqtt();
 
 	ret = resource_switch_close();
 	if (ret != 0 ) {
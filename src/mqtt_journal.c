@@ -0,0 +1,486 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "mqtt_journal.h"
+
+#define JOURNAL_MAGIC 0x4a51544d	// "MTQJ"
+#define JOURNAL_VERSION 1
+
+#define RECORD_FLAG_DONE 0x0001	// acknowledged or expired, skipped by replay
+
+#define JOURNAL_ALIGN(len) (((len) + 3) & ~3u)
+
+/* the device boots at the epoch, the wall clock is not trusted before 2018-01-01 */
+#define JOURNAL_CLOCK_VALID_SEC 1514764800u
+
+/*
+ * The file starts with a header followed by records packed back to back.
+ * position holds the offset of the oldest record in its low half and that
+ * record's sequence number in its high half, it is stored in one write so a
+ * crash never leaves the two out of step. The end of the journal is found
+ * again on open by following records while sequence numbers are consecutive
+ * and CRCs match, so data left over from before a compaction is ignored.
+ */
+struct __journal_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t reserved;
+	uint64_t position;
+};
+
+struct __journal_record {
+	uint32_t crc;		// CRC-32 from topic_len to the end of the payload
+	uint16_t flags;		// not covered by crc, updated in place
+	uint16_t topic_len;
+	uint32_t seq;
+	uint32_t timestamp;	// 0 when written before the clock was synced
+	uint32_t payload_len;
+};
+
+#define JOURNAL_CRC_OFFSET (offsetof(struct __journal_record, topic_len))
+#define JOURNAL_START ((uint32_t) sizeof(struct __journal_header))
+
+struct __journal_data {
+	int fd;
+	unsigned char *base;
+	uint32_t size;
+	unsigned int max_age_sec;
+
+	uint32_t head;		// oldest record not yet completed
+	uint32_t head_seq;
+	uint32_t tail;		// where the next record is appended
+	uint32_t next_seq;
+	uint32_t sent;		// next record to replay
+	uint32_t inflight;	// records handed to the client and not completed
+
+	pthread_mutex_t lock;
+};
+
+static struct __journal_data *journal_data = NULL;
+static uint32_t crc_table[256];
+
+static void __crc32_init(void)
+{
+	uint32_t c;
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		c = (uint32_t) i;
+		for (k = 0; k < 8; k++)
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		crc_table[i] = c;
+	}
+}
+
+static uint32_t __crc32(const unsigned char *buf, size_t len)
+{
+	uint32_t c = 0xffffffff;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		c = crc_table[(c ^ buf[i]) & 0xff] ^ (c >> 8);
+
+	return c ^ 0xffffffff;
+}
+
+static inline struct __journal_header *__header(void)
+{
+	return (struct __journal_header *) journal_data->base;
+}
+
+static inline struct __journal_record *__record(uint32_t offset)
+{
+	return (struct __journal_record *) (journal_data->base + offset);
+}
+
+static inline uint32_t __record_len(uint16_t topic_len, size_t payload_len)
+{
+	return JOURNAL_ALIGN((uint32_t) (sizeof(struct __journal_record) + topic_len + payload_len));
+}
+
+static uint32_t __record_crc(struct __journal_record *record)
+{
+	return __crc32((unsigned char *) record + JOURNAL_CRC_OFFSET,
+			sizeof(struct __journal_record) - JOURNAL_CRC_OFFSET + record->topic_len + record->payload_len);
+}
+
+static bool __is_valid_record(uint32_t offset, uint32_t seq)
+{
+	struct __journal_record *record;
+
+	if (offset + sizeof(struct __journal_record) > journal_data->size)
+		return false;
+
+	record = __record(offset);
+	if (record->seq != seq || record->payload_len > journal_data->size
+			|| offset + __record_len(record->topic_len, record->payload_len) > journal_data->size)
+		return false;
+
+	return record->crc == __record_crc(record);
+}
+
+static void __store_position(void)
+{
+	uint64_t position = ((uint64_t) journal_data->head_seq << 32) | journal_data->head;
+
+	__atomic_store_n(&__header()->position, position, __ATOMIC_RELEASE);
+}
+
+/* Drops completed records from the front, rewinds the file once it is empty */
+static void __advance_head(void)
+{
+	struct __journal_record *record;
+
+	while (journal_data->head < journal_data->tail) {
+		record = __record(journal_data->head);
+		if (!(record->flags & RECORD_FLAG_DONE))
+			break;
+		journal_data->head += __record_len(record->topic_len, record->payload_len);
+		journal_data->head_seq++;
+	}
+
+	if (journal_data->sent < journal_data->head)
+		journal_data->sent = journal_data->head;
+
+	/* records handed to the client point into the file, they must not move */
+	if (journal_data->head == journal_data->tail && journal_data->inflight == 0) {
+		journal_data->head = JOURNAL_START;
+		journal_data->tail = JOURNAL_START;
+		journal_data->sent = JOURNAL_START;
+	}
+
+	__store_position();
+}
+
+/* Makes room for len bytes at the tail, dropping the oldest records if needed */
+static int __make_room(uint32_t len)
+{
+	struct __journal_record *record;
+	uint32_t live;
+
+	if (journal_data->tail + len <= journal_data->size)
+		return 0;
+
+	if (journal_data->inflight != 0)
+		return -ENOSPC;
+
+	while (journal_data->head < journal_data->tail
+			&& JOURNAL_START + (journal_data->tail - journal_data->head) + len > journal_data->size) {
+		record = __record(journal_data->head);
+		WARN("journal full, dropping record %u", record->seq);
+		journal_data->head += __record_len(record->topic_len, record->payload_len);
+		journal_data->head_seq++;
+	}
+
+	live = journal_data->tail - journal_data->head;
+	memmove(journal_data->base + JOURNAL_START, journal_data->base + journal_data->head, live);
+	journal_data->head = JOURNAL_START;
+	journal_data->tail = JOURNAL_START + live;
+	journal_data->sent = JOURNAL_START;
+	__store_position();
+
+	return 0;
+}
+
+static void __recover(void)
+{
+	struct __journal_header *header = __header();
+	uint32_t offset, seq, len;
+
+	if (header->magic != JOURNAL_MAGIC || header->version != JOURNAL_VERSION || header->size != journal_data->size) {
+		header->magic = JOURNAL_MAGIC;
+		header->version = JOURNAL_VERSION;
+		header->size = journal_data->size;
+		header->reserved = 0;
+		header->position = JOURNAL_START;
+		/* records left in the file would otherwise be found again from sequence 0 */
+		len = journal_data->size - JOURNAL_START;
+		if (len > sizeof(struct __journal_record))
+			len = sizeof(struct __journal_record);
+		memset(journal_data->base + JOURNAL_START, 0, len);
+	}
+
+	offset = (uint32_t) (header->position & 0xffffffff);
+	seq = (uint32_t) (header->position >> 32);
+	if (offset < JOURNAL_START || offset > journal_data->size)
+		offset = JOURNAL_START;
+
+	journal_data->head = offset;
+	journal_data->head_seq = seq;
+	while (__is_valid_record(offset, seq)) {
+		offset += __record_len(__record(offset)->topic_len, __record(offset)->payload_len);
+		seq++;
+	}
+	journal_data->tail = offset;
+	journal_data->next_seq = seq;
+	journal_data->sent = journal_data->head;
+	journal_data->inflight = 0;
+
+	__advance_head();
+}
+
+static uint32_t __clock_now(void)
+{
+	time_t now = time(NULL);
+
+	if (now < (time_t) JOURNAL_CLOCK_VALID_SEC)
+		return 0;
+
+	return (uint32_t) now;
+}
+
+/*
+ * A record only ages while both its timestamp and the current time come from
+ * a synced clock, one stamped in the future (clock set back) is kept.
+ */
+static bool __is_expired(const struct __journal_record *entry, uint32_t now)
+{
+	if (!journal_data->max_age_sec || !now || !entry->timestamp)
+		return false;
+
+	if (entry->timestamp > now)
+		return false;
+
+	return now - entry->timestamp > journal_data->max_age_sec;
+}
+
+int mqtt_journal_open(const char *path, size_t size, unsigned int max_age_sec)
+{
+	struct stat st;
+
+	if (journal_data) {
+		ERR("journal already open");
+		return -EALREADY;
+	}
+
+	if (!path || size <= JOURNAL_START || size > UINT32_MAX)
+		return -EINVAL;
+
+	journal_data = calloc(1, sizeof(struct __journal_data));
+	if (!journal_data) {
+		ERR("failed to allocate journal data");
+		return -ENOMEM;
+	}
+
+	__crc32_init();
+
+	journal_data->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (journal_data->fd < 0) {
+		ERR("failed to open journal %s [%d]", path, errno);
+		goto ERROR;
+	}
+
+	if (fstat(journal_data->fd, &st) != 0 || (size_t) st.st_size != size) {
+		if (ftruncate(journal_data->fd, (off_t) size) != 0) {
+			ERR("failed to size journal %s [%d]", path, errno);
+			goto ERROR;
+		}
+	}
+
+	journal_data->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, journal_data->fd, 0);
+	if (journal_data->base == MAP_FAILED) {
+		ERR("failed to map journal %s [%d]", path, errno);
+		journal_data->base = NULL;
+		goto ERROR;
+	}
+
+	journal_data->size = (uint32_t) size;
+	journal_data->max_age_sec = max_age_sec;
+	pthread_mutex_init(&journal_data->lock, NULL);
+
+	__recover();
+	INFO("journal %s holds %u records", path, journal_data->next_seq - journal_data->head_seq);
+
+	return 0;
+
+ERROR:
+	if (journal_data->fd >= 0)
+		close(journal_data->fd);
+	free(journal_data);
+	journal_data = NULL;
+	return -EIO;
+}
+
+void mqtt_journal_flush(void)
+{
+	if (!journal_data)
+		return;
+
+	/* the only place the journal is forced to storage, appends rely on the page cache */
+	pthread_mutex_lock(&journal_data->lock);
+	if (msync(journal_data->base, journal_data->size, MS_SYNC) != 0)
+		ERR("failed to sync journal [%d]", errno);
+	pthread_mutex_unlock(&journal_data->lock);
+}
+
+int mqtt_journal_append(const char *topic, uint16_t topic_len, const void *payload, size_t payload_len)
+{
+	struct __journal_record *record;
+	uint32_t len;
+	int ret;
+
+	if (!journal_data)
+		return -ENODEV;
+
+	if (!topic || (!payload && payload_len))
+		return -EINVAL;
+
+	if (payload_len > journal_data->size
+			|| JOURNAL_START + __record_len(topic_len, payload_len) > journal_data->size)
+		return -EMSGSIZE;
+
+	len = __record_len(topic_len, payload_len);
+
+	pthread_mutex_lock(&journal_data->lock);
+
+	ret = __make_room(len);
+	if (ret != 0) {
+		pthread_mutex_unlock(&journal_data->lock);
+		return ret;
+	}
+
+	record = __record(journal_data->tail);
+	record->flags = 0;
+	record->topic_len = topic_len;
+	record->seq = journal_data->next_seq;
+	record->timestamp = __clock_now();
+	record->payload_len = (uint32_t) payload_len;
+	memcpy((unsigned char *) record + sizeof(struct __journal_record), topic, topic_len);
+	if (payload_len)
+		memcpy((unsigned char *) record + sizeof(struct __journal_record) + topic_len, payload, payload_len);
+	/* written last, a record cut short by a crash fails the check on open */
+	record->crc = __record_crc(record);
+
+	journal_data->tail += len;
+	journal_data->next_seq++;
+
+	pthread_mutex_unlock(&journal_data->lock);
+
+	return 0;
+}
+
+bool mqtt_journal_is_empty(void)
+{
+	bool is_empty;
+
+	if (!journal_data)
+		return true;
+
+	pthread_mutex_lock(&journal_data->lock);
+	is_empty = (journal_data->head == journal_data->tail);
+	pthread_mutex_unlock(&journal_data->lock);
+
+	return is_empty;
+}
+
+int mqtt_journal_peek(mqtt_journal_record_s *record)
+{
+	struct __journal_record *entry;
+	uint32_t now;
+
+	if (!journal_data)
+		return -ENODEV;
+
+	if (!record)
+		return -EINVAL;
+
+	pthread_mutex_lock(&journal_data->lock);
+
+	now = __clock_now();
+
+	/* records that failed to send are retried once everything sent after them is completed */
+	if (journal_data->sent == journal_data->tail && journal_data->inflight == 0)
+		journal_data->sent = journal_data->head;
+
+	while (journal_data->sent < journal_data->tail) {
+		entry = __record(journal_data->sent);
+		if (!(entry->flags & RECORD_FLAG_DONE) && __is_expired(entry, now)) {
+			WARN("journal record %u expired", entry->seq);
+			entry->flags |= RECORD_FLAG_DONE;
+			__advance_head();
+			continue;
+		}
+
+		if (entry->flags & RECORD_FLAG_DONE) {
+			journal_data->sent += __record_len(entry->topic_len, entry->payload_len);
+			continue;
+		}
+
+		record->id = journal_data->sent;
+		record->topic = (const char *) entry + sizeof(struct __journal_record);
+		record->topic_len = entry->topic_len;
+		record->payload = (const unsigned char *) entry + sizeof(struct __journal_record) + entry->topic_len;
+		record->payload_len = entry->payload_len;
+
+		pthread_mutex_unlock(&journal_data->lock);
+		return 0;
+	}
+
+	pthread_mutex_unlock(&journal_data->lock);
+
+	return -ENOENT;
+}
+
+void mqtt_journal_sent(uint32_t id)
+{
+	struct __journal_record *entry;
+
+	if (!journal_data)
+		return;
+
+	pthread_mutex_lock(&journal_data->lock);
+	if (id == journal_data->sent && id < journal_data->tail) {
+		entry = __record(id);
+		journal_data->sent += __record_len(entry->topic_len, entry->payload_len);
+		journal_data->inflight++;
+	}
+	pthread_mutex_unlock(&journal_data->lock);
+}
+
+void mqtt_journal_complete(uint32_t id, bool is_acked)
+{
+	struct __journal_record *entry;
+
+	if (!journal_data)
+		return;
+
+	pthread_mutex_lock(&journal_data->lock);
+	if (journal_data->inflight > 0)
+		journal_data->inflight--;
+
+	if (id >= journal_data->head && id < journal_data->tail) {
+		entry = __record(id);
+		if (is_acked)
+			entry->flags |= RECORD_FLAG_DONE;
+		else if (id + __record_len(entry->topic_len, entry->payload_len) == journal_data->sent)
+			journal_data->sent = id;	// nothing was sent after it, keep the replay order
+	}
+
+	__advance_head();
+	pthread_mutex_unlock(&journal_data->lock);
+}
@@ -31,13 +31,19 @@
 #include <unistd.h>
 #include <linux/limits.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
 #include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <service_app.h>
+#include <app_preference.h>
 
 #include "aws_iot_config.h"
 #include "sdk/aws_iot_log.h"
 #include "sdk/aws_iot_version.h"
 #include "sdk/aws_iot_mqtt_client_interface.h"
+#include "mqtt_journal.h"
 
 #include <peripheral_io.h>
 #include "resource/resource_servo_motor.h"
@@ -46,11 +52,26 @@
 
 #define HOST_ADDRESS_SIZE 255
 
-/* Max number of initial connect retries */
-#define CONNECT_MAX_ATTEMPT_COUNT 3
+/* Max number of attempts of the initial connect, auto reconnect takes over once it succeeded */
+#define CONNECT_MAX_ATTEMPT_COUNT 300
 
-/* Interval that each thread sleeps for */
-#define THREAD_SLEEP_INTERVAL_USEC 500000
+/* Time between two attempts of the initial connect */
+#define CONNECT_RETRY_INTERVAL_MS 2000
+
+/* Time given to the client each time the socket is readable or a deadline fires */
+#define YIELD_TIMEOUT_MS 1
+
+/* Time before the writer thread retries queued messages it could not send */
+#define WRITER_RETRY_INTERVAL_MS 1000
+
+/* Messages that could not be published are kept here until the connection is back */
+#define JOURNAL_FILENAME "mqtt_journal"
+#define JOURNAL_SIZE (256 * 1024)
+#define JOURNAL_MAX_AGE_SEC (24 * 60 * 60)
+
+// Preference keys of the idle intervals learned by the adaptive keep alive
+#define PREF_KEEPALIVE_SAFE_MS "mqtt_keepalive_safe_ms"
+#define PREF_KEEPALIVE_FAILED_MS "mqtt_keepalive_failed_ms"
 
 #define timersub(a, b, result) \
   do { \
@@ -68,6 +89,11 @@
 const char *TOPIC_SUB = "tizen/cmd";
 const char *TOPIC_PUB = "tizen/notify";
 
+/* Shadow and job updates keep headroom in the publish shaper while capture notifications burst */
+static const PublishPriorityRule publish_priority_rules[] = {
+	{ "$aws/things/", sizeof("$aws/things/") - 1, PUBLISH_PRIORITY_HIGH },
+};
+
 /**
  * @brief Default cert location
  */
@@ -89,11 +115,28 @@ uint32_t port = AWS_IOT_MQTT_PORT;
 uint32_t publishCount = 0;
 
 AWS_IoT_Client client;
+IoT_Client_Connect_Params connect_params;
 
 //pthread_t p_thread;
 bool terminate_yield_thread;
 pthread_t yield_thread;
+bool yield_thread_started;
+int yield_timer_fd = -1;
+/* wakes the yield thread to stop if terminate_yield_thread is set, to arm its timer again otherwise */
+int yield_wakeup_fd = -1;
+#ifdef _ENABLE_THREAD_SUPPORT_
+bool terminate_writer_thread;
+pthread_t writer_thread;
+bool writer_thread_started;
+int writer_wakeup_fd = -1;
+#endif
 bool mqtt_initalized = false;
+/* Set once the initial connect and subscribe succeeded, only used by the yield thread */
+bool mqtt_connected = false;
+/* Result of the last step of the initial connect, NETWORK_CONNECT_WANT_* while it is in progress */
+IoT_Error_t connect_rc = FAILURE;
+unsigned int connect_attempts = 0;
+struct timeval connect_start;
 
 extern peripheral_error_e resource_motor_driving(door_state_e mode);
 
@@ -168,6 +211,136 @@ void disconnectCallbackHandler(AWS_IoT_Client *pClient, void *data) {
 	}
 }
 
+static void load_keepalive_intervals(AWS_IoT_Client *pClient)
+{
+	int safe_ms = 0;
+	int failed_ms = 0;
+
+	if (preference_get_int(PREF_KEEPALIVE_SAFE_MS, &safe_ms) != PREFERENCE_ERROR_NONE)
+		return;
+	if (preference_get_int(PREF_KEEPALIVE_FAILED_MS, &failed_ms) != PREFERENCE_ERROR_NONE)
+		failed_ms = 0;
+
+	if (safe_ms < 0 || failed_ms < 0)
+		return;
+
+	INFO("keepalive intervals restored : safe %d ms, failed %d ms", safe_ms, failed_ms);
+	aws_iot_mqtt_set_keepalive_intervals(pClient, (uint32_t)safe_ms, (uint32_t)failed_ms);
+}
+
+static void save_keepalive_intervals(AWS_IoT_Client *pClient)
+{
+	static uint32_t saved_safe_ms;
+	static uint32_t saved_failed_ms;
+	KeepAliveStats stats;
+
+	if (aws_iot_mqtt_get_keepalive_stats(pClient, &stats) != SUCCESS)
+		return;
+
+	IOT_INFO("keepalive : interval %u ms, safe %u ms, failed %u ms, rtt %u ms (smoothed %u ms), pings %u, timeouts %u",
+			stats.pingIntervalMs, stats.safeIntervalMs, stats.failedIntervalMs, stats.lastRttMs,
+			stats.smoothedRttMs, stats.pingsSent, stats.pingTimeouts);
+
+	if (stats.safeIntervalMs == saved_safe_ms && stats.failedIntervalMs == saved_failed_ms)
+		return;
+
+	if (preference_set_int(PREF_KEEPALIVE_SAFE_MS, (int)stats.safeIntervalMs) != PREFERENCE_ERROR_NONE
+			|| preference_set_int(PREF_KEEPALIVE_FAILED_MS, (int)stats.failedIntervalMs) != PREFERENCE_ERROR_NONE) {
+		ERR("failed to save keepalive intervals");
+		return;
+	}
+
+	saved_safe_ms = stats.safeIntervalMs;
+	saved_failed_ms = stats.failedIntervalMs;
+}
+
+static int journal_message(const char *topic, const char *payload, size_t payload_len)
+{
+	int ret;
+
+	ret = mqtt_journal_append(topic, (uint16_t) strlen(topic), payload, payload_len);
+	if (ret != 0) {
+		ERR("journal append failed [%d], message dropped", ret);
+		return ret;
+	}
+
+	INFO("message journaled until the connection is back");
+	return 0;
+}
+
+static void journal_publish_complete(AWS_IoT_Client *pClient, uint16_t packetId, IoT_Error_t rc, void *pData)
+{
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(packetId);
+
+	mqtt_journal_complete((uint32_t) (uintptr_t) pData, SUCCESS == rc);
+#ifdef _ENABLE_THREAD_SUPPORT_
+	/* an in-flight entry was released, let the writer thread continue the replay */
+	if (eventfd_write(writer_wakeup_fd, 1) != 0)
+		ERR("eventfd_write failed [%d]", errno);
+#endif
+}
+
+/* Makes the yield thread fetch the next deadline again, e.g. after a publish armed a retransmission */
+static void wake_yield_thread(void)
+{
+	if (eventfd_write(yield_wakeup_fd, 1) != 0)
+		ERR("eventfd_write failed [%d]", errno);
+}
+
+/* Time after which the publish shaper lets the refused message through */
+static int get_throttle_retry_ms(AWS_IoT_Client *pClient)
+{
+	PublishShaperStats stats;
+
+	if (aws_iot_mqtt_get_publish_shaper_stats(pClient, &stats) != SUCCESS || stats.retryAfterMs == 0)
+		return WRITER_RETRY_INTERVAL_MS;
+
+	return (int) stats.retryAfterMs;
+}
+
+/*
+ * Replays journaled messages as QoS1 while the client is connected. Stops when
+ * the in-flight window is full, completions resume it. Records are removed from
+ * the journal once their PUBACK is received.
+ * Returns the time after which a replay stopped by the publish shaper should be
+ * retried, -1 if nothing needs a retry.
+ */
+static int replay_journal(AWS_IoT_Client *pClient)
+{
+	IoT_Publish_Message_Params paramsQOS1;
+	mqtt_journal_record_s record;
+	IoT_Error_t rc;
+	bool published = false;
+	int retry_ms = -1;
+
+	while (aws_iot_mqtt_is_client_connected(pClient) && mqtt_journal_peek(&record) == 0) {
+		paramsQOS1.qos = QOS1;
+		paramsQOS1.isRetained = 0;
+		paramsQOS1.payload = (void *) record.payload;
+		paramsQOS1.payloadLen = record.payload_len;
+
+		mqtt_journal_sent(record.id);
+		rc = aws_iot_mqtt_publish_async(pClient, record.topic, record.topic_len, &paramsQOS1,
+				journal_publish_complete, (void *) (uintptr_t) record.id);
+		if (rc != SUCCESS) {
+			mqtt_journal_complete(record.id, false);
+			if (rc == MQTT_PUBLISH_THROTTLED_ERROR)
+				retry_ms = get_throttle_retry_ms(pClient);
+			else if (rc != MQTT_INFLIGHT_WINDOW_FULL_ERROR)
+				IOT_DEBUG("journal replay failed [%d]\n", rc);
+			break;
+		}
+		published = true;
+	}
+
+	/* the yield thread may sleep until the next keepalive, past the retransmission deadline */
+	if (published)
+		wake_yield_thread();
+
+	return retry_ms;
+}
+
 int notify_mqtt(char *filename)
 {
 	IoT_Publish_Message_Params paramsQOS0;
@@ -187,25 +360,263 @@ int notify_mqtt(char *filename)
 	paramsQOS0.payloadLen = strlen(filename);
 
 	INFO("publish %d : %s", paramsQOS0.payloadLen, paramsQOS0.payload);
+	if (!aws_iot_mqtt_is_client_connected(&client))
+		return journal_message(TOPIC_PUB, filename, paramsQOS0.payloadLen);
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	/* Called from the camera and GPIO threads, leave the network write to the writer thread */
+	rc = aws_iot_mqtt_publish_enqueue(&client, TOPIC_PUB, strlen(TOPIC_PUB), &paramsQOS0);
+	if (rc != SUCCESS) {
+		ERR("QOS0 enqueue failed [%d].\n", rc);
+		return journal_message(TOPIC_PUB, filename, paramsQOS0.payloadLen);
+	}
+
+	if (eventfd_write(writer_wakeup_fd, 1) != 0)
+		ERR("eventfd_write failed [%d]", errno);
+#else
 	rc = aws_iot_mqtt_publish(&client, TOPIC_PUB, strlen(TOPIC_PUB), &paramsQOS0);
 	if (rc != SUCCESS) {
 		ERR("QOS0 publish failed [%d].\n", rc);
+		return journal_message(TOPIC_PUB, filename, paramsQOS0.payloadLen);
 	}
+#endif
 
 	return rc;
 }
 
+#ifdef _ENABLE_THREAD_SUPPORT_
+/*
+ * The writer thread is the only caller of aws_iot_mqtt_drain_outbound_queue.
+ * It sleeps until a producer signals writer_wakeup_fd; messages left queued
+ * while the connection is down are retried every WRITER_RETRY_INTERVAL_MS,
+ * messages held back by the publish shaper once it has refilled.
+ * Journaled messages are replayed after the queue, on reconnect and whenever
+ * a replayed message completes.
+ */
+static void *aws_iot_mqtt_writer_thread_runner(void *ptr)
+{
+	IoT_Error_t rc = SUCCESS;
+	AWS_IoT_Client *pClient = (AWS_IoT_Client *) ptr;
+	struct pollfd fds[1];
+	eventfd_t events;
+	int timeout_ms = -1;
+
+	while (terminate_writer_thread == false) {
+		fds[0].fd = writer_wakeup_fd;
+		fds[0].events = POLLIN;
+
+		if (poll(fds, 1, timeout_ms) < 0) {
+			if (errno == EINTR)
+				continue;
+			ERR("poll failed [%d]", errno);
+			break;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			if (eventfd_read(writer_wakeup_fd, &events) != 0)
+				IOT_DEBUG("eventfd read failed [%d]\n", errno);
+		}
+
+		if (terminate_writer_thread == true)
+			break;
+
+		rc = aws_iot_mqtt_drain_outbound_queue(pClient);
+		if (MQTT_PUBLISH_THROTTLED_ERROR == rc) {
+			timeout_ms = get_throttle_retry_ms(pClient);
+		} else if (SUCCESS != rc) {
+			IOT_DEBUG("Drain Returned : %d\n", rc);
+			timeout_ms = WRITER_RETRY_INTERVAL_MS;
+		} else {
+			/* a throttled replay gets no completion to resume it, poll again once the shaper refilled */
+			timeout_ms = replay_journal(pClient);
+		}
+	}
+	IOT_DEBUG("Writer Thread Runner terminating  rc : %d\n", rc);
+
+	return NULL;
+}
+#endif
+
+static void arm_yield_timer(uint32_t timeout_ms)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	if (timeout_ms != AWS_IOT_MQTT_NO_TIMEOUT_MS) {
+		its.it_value.tv_sec = timeout_ms / 1000;
+		its.it_value.tv_nsec = (timeout_ms % 1000) * 1000000;
+		if (timeout_ms == 0) {
+			/* an all zero value disarms the timer, fire right away instead */
+			its.it_value.tv_nsec = 1;
+		}
+	}
+
+	if (timerfd_settime(yield_timer_fd, 0, &its, NULL) != 0) {
+		ERR("timerfd_settime failed [%d]", errno);
+	}
+}
+
+static bool is_connect_in_progress(void)
+{
+	return connect_rc == NETWORK_CONNECT_WANT_READ || connect_rc == NETWORK_CONNECT_WANT_WRITE;
+}
+
+/*
+ * Called by the yield thread once the initial connect completed. The subscription
+ * is made before auto reconnect is enabled, so a failure leaves the client
+ * disconnected and the next attempt starts over.
+ */
+static void connect_complete_handler(AWS_IoT_Client *pClient, IoT_Error_t rc, void *pData)
+{
+	struct timeval end, connectTime;
+
+	IOT_UNUSED(pData);
+
+	gettimeofday(&end, NULL);
+	timersub(&end, &connect_start, &connectTime);
+
+	if (SUCCESS != rc) {
+		IOT_ERROR("## Connect attempt %u Failed. error code %d\n", connect_attempts, rc);
+		return;
+	}
+	IOT_DEBUG("## Connect Success. Time sec: %d, usec: %d\n", connectTime.tv_sec, connectTime.tv_usec);
+
+	IOT_INFO("Subscribing...");
+	rc = aws_iot_mqtt_subscribe(pClient, TOPIC_SUB, strlen(TOPIC_SUB), QOS0, iot_subscribe_callback_handler, NULL);
+	if (SUCCESS != rc) {
+		IOT_ERROR("Error subscribing : %d\n", rc);
+		aws_iot_mqtt_disconnect(pClient);
+		return;
+	}
+	INFO("OK\n");
+
+	/*
+	 * Enable Auto Reconnect functionality. Minimum and Maximum time of Exponential backoff are set in aws_iot_config.h
+	 *  #AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL
+	 *  #AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL
+	 */
+	rc = aws_iot_mqtt_autoreconnect_set_status(pClient, true);
+	if (SUCCESS != rc)
+		IOT_ERROR("Unable to set Auto Reconnect to true - %d\n", rc);
+
+	mqtt_connected = true;
+
+	/* replay what an earlier run or the time offline left in the journal */
+#ifdef _ENABLE_THREAD_SUPPORT_
+	if (eventfd_write(writer_wakeup_fd, 1) != 0)
+		ERR("eventfd_write failed [%d]", errno);
+#else
+	replay_journal(pClient);
+#endif
+}
+
+static void start_connect(AWS_IoT_Client *pClient)
+{
+	connect_attempts++;
+	IOT_DEBUG("Connecting Client, attempt %u\n", connect_attempts);
+
+	gettimeofday(&connect_start, NULL);
+	connect_rc = aws_iot_mqtt_connect_async(pClient, &connect_params, connect_complete_handler, NULL);
+}
+
+static uint32_t get_yield_timeout_ms(AWS_IoT_Client *pClient)
+{
+	if (mqtt_connected || is_connect_in_progress())
+		return aws_iot_mqtt_get_next_timeout_ms(pClient);
+
+	/* waiting for the next attempt of the initial connect */
+	if (connect_attempts < CONNECT_MAX_ATTEMPT_COUNT)
+		return CONNECT_RETRY_INTERVAL_MS;
+
+	return AWS_IOT_MQTT_NO_TIMEOUT_MS;
+}
+
+/*
+ * The yield thread sleeps in poll() until the MQTT socket is readable or the
+ * next keepalive/reconnect deadline armed on yield_timer_fd expires, so an
+ * idle connection causes no wakeups between keepalives.
+ * It also runs the initial connect: each step is taken when the socket is
+ * ready for the direction the handshake waits for, failed attempts are
+ * started again after CONNECT_RETRY_INTERVAL_MS.
+ */
 static void *aws_iot_mqtt_yield_thread_runner(void *ptr)
 {
 	IoT_Error_t rc = SUCCESS;
 	AWS_IoT_Client *pClient = (AWS_IoT_Client *) ptr;
-	while(SUCCESS == rc && terminate_yield_thread == false) {
+	struct pollfd fds[3];
+	uint64_t expirations;
+	eventfd_t events;
+
+	start_connect(pClient);
+
+	while (terminate_yield_thread == false) {
+		arm_yield_timer(get_yield_timeout_ms(pClient));
+
+		fds[0].fd = yield_wakeup_fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = yield_timer_fd;
+		fds[1].events = POLLIN;
+		/* negative while reconnecting, poll() skips it */
+		fds[2].fd = aws_iot_mqtt_get_network_fd(pClient);
+		fds[2].events = (connect_rc == NETWORK_CONNECT_WANT_WRITE) ? POLLOUT : POLLIN;
+
+		if (poll(fds, 3, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			ERR("poll failed [%d]", errno);
+			break;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			if (eventfd_read(yield_wakeup_fd, &events) != 0)
+				IOT_DEBUG("eventfd read failed [%d]\n", errno);
+			if (terminate_yield_thread == true)
+				break;
+			/* only asked to arm the timer again */
+			if (fds[1].revents == 0 && fds[2].revents == 0)
+				continue;
+		}
+
+		if (fds[1].revents & POLLIN) {
+			if (read(yield_timer_fd, &expirations, sizeof(expirations)) < 0)
+				IOT_DEBUG("timerfd read failed [%d]\n", errno);
+		}
+
+		if (is_connect_in_progress()) {
+			connect_rc = aws_iot_mqtt_connect_continue(pClient);
+			continue;
+		}
+
+		if (!mqtt_connected) {
+			if (connect_attempts < CONNECT_MAX_ATTEMPT_COUNT)
+				start_connect(pClient);
+			continue;
+		}
+
+		/*
+		 * A TLS record may carry several packets, drain what is already decrypted.
+		 * While a subscribe owns the client, yield sleeps until it is handed back;
+		 * publishes from other threads (notify_mqtt) never make it wait.
+		 */
 		do {
-			usleep(THREAD_SLEEP_INTERVAL_USEC);
-			rc = aws_iot_mqtt_yield(pClient, 100);
-		} while(MQTT_CLIENT_NOT_IDLE_ERROR == rc); // Client is busy, wait to get lock
+			rc = aws_iot_mqtt_yield(pClient, YIELD_TIMEOUT_MS);
+		} while (SUCCESS == rc && aws_iot_mqtt_has_pending_data(pClient));
+
+		if (NETWORK_RECONNECTED == rc) {
+			/* A lost connection is when the keep alive learns the most */
+			save_keepalive_intervals(pClient);
+#ifdef _ENABLE_THREAD_SUPPORT_
+			if (eventfd_write(writer_wakeup_fd, 1) != 0)
+				ERR("eventfd_write failed [%d]", errno);
+#else
+			replay_journal(pClient);
+#endif
+		}
 
-		if(SUCCESS != rc) {
+		if (NETWORK_RECONNECT_TIMED_OUT_ERROR == rc || NETWORK_MANUALLY_DISCONNECTED == rc
+				|| NETWORK_DISCONNECTED_ERROR == rc) {
+			break;
+		} else if (SUCCESS != rc) {
 			IOT_DEBUG("Yield Returned : %d\n", rc);
 		}
 	}
@@ -214,23 +625,84 @@ static void *aws_iot_mqtt_yield_thread_runner(void *ptr)
 	return NULL;
 }
 
+void terminate_mqtt(void)
+{
+#ifdef _ENABLE_THREAD_SUPPORT_
+	OutboundQueueStats stats;
+#endif
+	TLSHandshakeStats handshakeStats;
+
+	terminate_yield_thread = true;
+
+	if (yield_wakeup_fd >= 0) {
+		if (eventfd_write(yield_wakeup_fd, 1) != 0)
+			ERR("eventfd_write failed [%d]", errno);
+	}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	terminate_writer_thread = true;
+
+	if (writer_wakeup_fd >= 0) {
+		if (eventfd_write(writer_wakeup_fd, 1) != 0)
+			ERR("eventfd_write failed [%d]", errno);
+	}
+
+	if (writer_thread_started == true) {
+		pthread_join(writer_thread, NULL);
+		writer_thread_started = false;
+	}
+#endif
+
+	if (yield_thread_started == true) {
+		pthread_join(yield_thread, NULL);
+		yield_thread_started = false;
+	}
+
+	/* both threads are gone, nothing appends to the journal or updates the keepalive stats any more */
+	mqtt_journal_flush();
+	if (mqtt_initalized == true)
+		save_keepalive_intervals(&client);
+
+	if (mqtt_initalized == true && aws_iot_mqtt_get_tls_handshake_stats(&client, &handshakeStats) == SUCCESS) {
+		IOT_INFO("tls handshakes : %u resumed %u of %u offered, last %u ms full %u ms resumed %u ms",
+				handshakeStats.handshakes, handshakeStats.resumed, handshakeStats.resumptionsOffered,
+				handshakeStats.lastHandshakeMs, handshakeStats.lastFullHandshakeMs,
+				handshakeStats.lastResumedHandshakeMs);
+	}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	if (mqtt_initalized == true && aws_iot_mqtt_get_outbound_queue_stats(&client, &stats) == SUCCESS) {
+		IOT_INFO("outbound queue : depth %u max %u enqueued %u dropped %u written %u writes %u latency %u max %u ms",
+				stats.depth, stats.maxDepth, stats.enqueued, stats.dropped, stats.written, stats.writes,
+				stats.lastDrainLatencyMs, stats.maxDrainLatencyMs);
+	}
+#endif
+}
+
+/*
+ * Sets the client up and returns without waiting for the network, the yield
+ * thread connects in the background. Messages published until then go to the
+ * journal.
+ */
 int init_mqtt(void)
 {
-	char rootCA[PATH_MAX + 1];
-	char clientCRT[PATH_MAX + 1];
-	char clientKey[PATH_MAX + 1];
+	/* the client keeps pointers to the paths, the yield thread connects after this returns */
+	static char rootCA[PATH_MAX + 1];
+	static char clientCRT[PATH_MAX + 1];
+	static char clientKey[PATH_MAX + 1];
+	char journalPath[PATH_MAX + 1];
 	IoT_Error_t rc = FAILURE;
 	char *app_cert_path = NULL;
-	struct timeval connectTime;
-	struct timeval start, end;
-	unsigned int connectCounter = 0;
+	char *app_data_path = NULL;
 	int yieldThreadReturn = 0;
 
 	terminate_yield_thread = false;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	terminate_writer_thread = false;
+#endif
 
 	//AWS_IoT_Client client;
 	IoT_Client_Init_Params mqttInitParams = iotClientInitParamsDefault;
-	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
 
 	IOT_INFO("AWS IoT SDK Version %d.%d.%d-%s\n", VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH, VERSION_TAG);
 
@@ -248,7 +720,7 @@ int init_mqtt(void)
 	IOT_DEBUG("rootCA %s", rootCA);
 	IOT_DEBUG("clientCRT %s", clientCRT);
 	IOT_DEBUG("clientKey %s", clientKey);
-	mqttInitParams.enableAutoReconnect = false; // We enable this later below
+	mqttInitParams.enableAutoReconnect = false; // Enabled once the initial connect has subscribed
 	mqttInitParams.pHostURL = HostAddress;
 	mqttInitParams.port = port;
 	mqttInitParams.pRootCALocation = rootCA;
@@ -259,6 +731,10 @@ int init_mqtt(void)
 	mqttInitParams.isSSLHostnameVerify = true;
 	mqttInitParams.disconnectHandler = disconnectCallbackHandler;
 	mqttInitParams.disconnectHandlerData = NULL;
+#ifdef _ENABLE_THREAD_SUPPORT_
+	/* Callers sleep until the client is available instead of failing with MQTT_CLIENT_NOT_IDLE_ERROR */
+	mqttInitParams.isBlockOnThreadLockEnabled = true;
+#endif
 
 	rc = aws_iot_mqtt_init(&client, &mqttInitParams);
 	if(SUCCESS != rc) {
@@ -266,66 +742,63 @@ int init_mqtt(void)
 		return rc;
 	}
 
-	connectParams.keepAliveIntervalInSec = 600;
-	connectParams.isCleanSession = true;
-	connectParams.MQTTVersion = MQTT_3_1_1;
-	connectParams.pClientID = AWS_IOT_MQTT_CLIENT_ID;
-	connectParams.clientIDLen = (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID);
-	connectParams.isWillMsgPresent = false;
-
-	IOT_DEBUG("Connecting Client\n");
-	do {
-		gettimeofday(&start, NULL);
-		rc = aws_iot_mqtt_connect(&client, &connectParams);
-		gettimeofday(&end, NULL);
-		timersub(&end, &start, &connectTime);
-
-		connectCounter++;
-	} while(rc != SUCCESS && connectCounter < CONNECT_MAX_ATTEMPT_COUNT);
-
-	if(SUCCESS == rc) {
-		IOT_DEBUG("## Connect Success. Time sec: %d, usec: %d\n", connectTime.tv_sec, connectTime.tv_usec);
-	} else {
-		IOT_ERROR("## Connect Failed. error code %d\n", rc);
-		return -1;
+	app_data_path = app_get_data_path();
+	if (app_data_path) {
+		snprintf(journalPath, PATH_MAX + 1, "%s%s", app_data_path, JOURNAL_FILENAME);
+		free(app_data_path);
+		if (mqtt_journal_open(journalPath, JOURNAL_SIZE, JOURNAL_MAX_AGE_SEC) != 0)
+			IOT_WARN("Journal not available, messages are dropped while offline\n");
 	}
 
-	/*
-	 * Enable Auto Reconnect functionality. Minimum and Maximum time of Exponential backoff are set in aws_iot_config.h
-	 *  #AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL
-	 *  #AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL
-	 */
-	rc = aws_iot_mqtt_autoreconnect_set_status(&client, true);
-	if(SUCCESS != rc) {
-		IOT_ERROR("Unable to set Auto Reconnect to true - %d\n", rc);
-		return rc;
+	load_keepalive_intervals(&client);
+	aws_iot_mqtt_set_publish_priority_rules(&client, publish_priority_rules,
+			sizeof(publish_priority_rules) / sizeof(publish_priority_rules[0]));
+
+	connect_params = iotClientConnectParamsDefault;
+	connect_params.keepAliveIntervalInSec = 600;
+	/* Keep subscriptions on the broker, reconnects then skip resubscribing */
+	connect_params.isCleanSession = false;
+	/* MQTT 5 topic aliases keep the long topics off the wire after their first publish */
+	connect_params.MQTTVersion = MQTT_5;
+	connect_params.pClientID = AWS_IOT_MQTT_CLIENT_ID;
+	connect_params.clientIDLen = (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID);
+	connect_params.isWillMsgPresent = false;
+
+	mqtt_connected = false;
+	connect_attempts = 0;
+	connect_rc = FAILURE;
+	/* notify_mqtt journals messages from here on */
+	mqtt_initalized = true;
+
+	yield_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	yield_wakeup_fd = eventfd(0, EFD_CLOEXEC);
+	if (yield_timer_fd < 0 || yield_wakeup_fd < 0) {
+		IOT_ERROR("An error occurred creating the yield thread event descriptors.\n");
+		return FAILURE;
 	}
 
-	IOT_INFO("Subscribing...");
-	rc = aws_iot_mqtt_subscribe(&client, TOPIC_SUB, strlen(TOPIC_SUB), QOS0, iot_subscribe_callback_handler, NULL);
-	if(SUCCESS != rc) {
-		IOT_ERROR("Error subscribing : %d\n", rc);
-		return rc;
-	} else {
-		mqtt_initalized = true;
-		INFO("OK\n");
+#ifdef _ENABLE_THREAD_SUPPORT_
+	writer_wakeup_fd = eventfd(0, EFD_CLOEXEC);
+	if (writer_wakeup_fd < 0) {
+		IOT_ERROR("An error occurred creating the writer thread event descriptor.\n");
+		return FAILURE;
 	}
 
-#if 0
-	rc = aws_iot_mqtt_subscribe(&client, TOPIC_SUB, strlen(TOPIC_SUB), QOS1, iot_subscribe_callback_handler, NULL);
-	if(SUCCESS != rc) {
-		IOT_ERROR("Error subscribing : %d\n", rc);
-		return rc;
+	if (pthread_create(&writer_thread, NULL, aws_iot_mqtt_writer_thread_runner, &client) != 0) {
+		IOT_ERROR("An error occurred pthread_create.\n");
 	} else {
-		mqtt_initalized = true;
-		INFO("OK\n");
+		writer_thread_started = true;
+		IOT_INFO("pthread_create - writer_thread done\n");
 	}
 #endif
 
+	/* the journal is replayed once the yield thread has connected */
 	yieldThreadReturn = pthread_create(&yield_thread, NULL, aws_iot_mqtt_yield_thread_runner, &client);
 	if(SUCCESS != yieldThreadReturn) {
 		IOT_ERROR("An error occurred pthread_create.\n");
+		rc = FAILURE;
 	} else {
+		yield_thread_started = true;
 		IOT_INFO("pthread_create - yield_thread done\n");
 	}
 
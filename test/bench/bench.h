@@ -0,0 +1,71 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file bench.h
+ * @brief Timing helpers for the host benchmarks
+ *
+ * Results depend on the machine and the compiler flags, they are meant for comparing
+ * the variants measured in one run, not as absolute figures for the device.
+ */
+
+#ifndef AWS_IOT_TEST_BENCH_H
+#define AWS_IOT_TEST_BENCH_H
+
+#include <stdint.h>
+#include <time.h>
+
+/* Shortest time a measurement runs, iterations are doubled until it is reached */
+#define BENCH_MIN_RUN_NS 200000000ull
+
+static inline uint64_t benchClockNs(clockid_t clock) {
+	struct timespec now;
+
+	clock_gettime(clock, &now);
+	return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+/* Wall clock and CPU time spent by the process, in ns */
+static inline uint64_t benchWallNs(void) {
+	return benchClockNs(CLOCK_MONOTONIC);
+}
+
+static inline uint64_t benchCpuNs(void) {
+	return benchClockNs(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+/**
+ * @brief Time one operation
+ *
+ * Calls pOperation with pArg until a batch runs for at least BENCH_MIN_RUN_NS.
+ *
+ * @return Wall clock ns per call of the last batch
+ */
+static inline double benchRun(void (*pOperation)(void *), void *pArg) {
+	uint64_t iterations, itr, start, elapsed;
+
+	for(iterations = 1; ; iterations *= 2) {
+		start = benchWallNs();
+		for(itr = 0; itr < iterations; itr++) {
+			pOperation(pArg);
+		}
+		elapsed = benchWallNs() - start;
+		if(BENCH_MIN_RUN_NS <= elapsed) {
+			return (double) elapsed / (double) iterations;
+		}
+	}
+}
+
+#endif /* AWS_IOT_TEST_BENCH_H */
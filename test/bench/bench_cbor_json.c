@@ -0,0 +1,179 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file bench_cbor_json.c
+ * @brief CBOR documents against the shadow JSON documents of the same values
+ *
+ * Six door readings are encoded as a CBOR map, and as a reported shadow document with
+ * aws_iot_shadow_init_json_document, aws_iot_shadow_add_reported and
+ * aws_iot_finalize_json_document. Decoding parses each with jsmn, then updates every
+ * value, the way the shadow delta path does.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sdk/aws_iot_shadow_cbor.h"
+#include "sdk/aws_iot_shadow_json.h"
+#include "sdk/aws_iot_shadow_json_data.h"
+
+#include "bench.h"
+
+#define BENCH_DOC_LEN 512
+#define BENCH_FIELD_COUNT 6
+
+typedef struct {
+	char door[16];
+	bool isLocked;
+	uint8_t battery;
+	int16_t rssi;
+	uint32_t openCount;
+	double temperature;
+	jsonStruct_t fields[BENCH_FIELD_COUNT];
+} BenchReadings;
+
+typedef struct {
+	BenchReadings in, out;
+	unsigned char cbor[BENCH_DOC_LEN];
+	size_t cborLen;
+	char json[BENCH_DOC_LEN];
+	size_t jsonLen;
+	ShadowJsonParser_t parser;
+	IoT_Error_t rc;
+} BenchCborState;
+
+static void benchInitReadings(BenchReadings *pReadings) {
+	static const char *keys[BENCH_FIELD_COUNT] = { "door", "lock", "battery", "rssi", "openCount", "temperature" };
+	jsonStruct_t *pFields = pReadings->fields;
+	uint32_t itr;
+
+	pFields[0].pData = pReadings->door;
+	pFields[0].dataLength = sizeof(pReadings->door);
+	pFields[0].type = SHADOW_JSON_STRING;
+	pFields[1].pData = &(pReadings->isLocked);
+	pFields[1].dataLength = sizeof(bool);
+	pFields[1].type = SHADOW_JSON_BOOL;
+	pFields[2].pData = &(pReadings->battery);
+	pFields[2].dataLength = sizeof(uint8_t);
+	pFields[2].type = SHADOW_JSON_UINT8;
+	pFields[3].pData = &(pReadings->rssi);
+	pFields[3].dataLength = sizeof(int16_t);
+	pFields[3].type = SHADOW_JSON_INT16;
+	pFields[4].pData = &(pReadings->openCount);
+	pFields[4].dataLength = sizeof(uint32_t);
+	pFields[4].type = SHADOW_JSON_UINT32;
+	pFields[5].pData = &(pReadings->temperature);
+	pFields[5].dataLength = sizeof(double);
+	pFields[5].type = SHADOW_JSON_DOUBLE;
+	for(itr = 0; itr < BENCH_FIELD_COUNT; itr++) {
+		pFields[itr].pKey = keys[itr];
+		pFields[itr].cb = NULL;
+	}
+}
+
+static void benchCborEncode(void *pArg) {
+	BenchCborState *pState = pArg;
+	jsonStruct_t *pFields = pState->in.fields;
+
+	pState->rc |= aws_iot_cbor_encode_document(pState->cbor, sizeof(pState->cbor), &(pState->cborLen),
+											   BENCH_FIELD_COUNT, &pFields[0], &pFields[1], &pFields[2], &pFields[3],
+											   &pFields[4], &pFields[5]);
+}
+
+static void benchCborDecode(void *pArg) {
+	BenchCborState *pState = pArg;
+	jsonStruct_t *pFields = pState->out.fields;
+
+	pState->rc |= aws_iot_cbor_decode_document(pState->cbor, pState->cborLen, BENCH_FIELD_COUNT, &pFields[0],
+											   &pFields[1], &pFields[2], &pFields[3], &pFields[4], &pFields[5]);
+}
+
+static void benchJsonEncode(void *pArg) {
+	BenchCborState *pState = pArg;
+	jsonStruct_t *pFields = pState->in.fields;
+
+	pState->rc |= aws_iot_shadow_init_json_document(pState->json, sizeof(pState->json));
+	pState->rc |= aws_iot_shadow_add_reported(pState->json, sizeof(pState->json), BENCH_FIELD_COUNT, &pFields[0],
+											  &pFields[1], &pFields[2], &pFields[3], &pFields[4], &pFields[5]);
+	pState->rc |= aws_iot_finalize_json_document(pState->json, sizeof(pState->json));
+	pState->jsonLen = strlen(pState->json);
+}
+
+static void benchJsonDecode(void *pArg) {
+	BenchCborState *pState = pArg;
+	uint32_t itr, dataLength;
+	int32_t tokenCount, dataPosition;
+
+	if(!isJsonValidAndParse(pState->json, pState->jsonLen, &(pState->parser), &tokenCount)) {
+		pState->rc = JSON_PARSE_ERROR;
+		return;
+	}
+	for(itr = 0; itr < BENCH_FIELD_COUNT; itr++) {
+		if(!isJsonKeyMatchingAndUpdateValue(pState->json, &(pState->parser), tokenCount, &(pState->out.fields[itr]),
+											&dataLength, &dataPosition)) {
+			pState->rc = JSON_PARSE_ERROR;
+		}
+	}
+}
+
+static bool benchIsDecoded(BenchCborState *pState) {
+	bool isDecoded = 0 == strcmp(pState->in.door, pState->out.door) && pState->in.isLocked == pState->out.isLocked &&
+					 pState->in.battery == pState->out.battery && pState->in.rssi == pState->out.rssi &&
+					 pState->in.openCount == pState->out.openCount;
+
+	memset(pState->out.door, 0, sizeof(pState->out.door));
+	pState->out.isLocked = false;
+	pState->out.battery = 0;
+	pState->out.rssi = 0;
+	pState->out.openCount = 0;
+	pState->out.temperature = 0;
+	return isDecoded && SUCCESS == pState->rc;
+}
+
+int main(void) {
+	static BenchCborState state;
+	double encodeNs, decodeNs;
+
+	benchInitReadings(&state.in);
+	benchInitReadings(&state.out);
+	strcpy(state.in.door, "closed");
+	state.in.isLocked = true;
+	state.in.battery = 87;
+	state.in.rssi = -67;
+	state.in.openCount = 12873;
+	state.in.temperature = 21.37;
+	state.rc = SUCCESS;
+
+	printf("%-6s %8s %10s %10s %16s\n", "format", "bytes", "encode ns", "decode ns", "temperature out");
+
+	encodeNs = benchRun(benchCborEncode, &state);
+	decodeNs = benchRun(benchCborDecode, &state);
+	printf("%-6s %8zu %10.0f %10.0f %16.10g\n", "cbor", state.cborLen, encodeNs, decodeNs, state.out.temperature);
+	if(!benchIsDecoded(&state)) {
+		printf("cbor round trip failed\n");
+		return 1;
+	}
+
+	encodeNs = benchRun(benchJsonEncode, &state);
+	decodeNs = benchRun(benchJsonDecode, &state);
+	printf("%-6s %8zu %10.0f %10.0f %16.10g\n", "json", state.jsonLen, encodeNs, decodeNs, state.out.temperature);
+	if(!benchIsDecoded(&state)) {
+		printf("json round trip failed\n");
+		return 1;
+	}
+
+	return 0;
+}
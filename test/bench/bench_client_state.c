@@ -0,0 +1,250 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file bench_client_state.c
+ * @brief Taking and handing back the client state, compare and swap against the mutex
+ *
+ * An operation that owns the client, a yield for instance, acquires the state with
+ * aws_iot_mqtt_internal_acquire_client_state and hands it back with
+ * aws_iot_mqtt_set_client_state. The mutex variant is a copy of the transitions the SDK
+ * made before, which took the state change mutex for both. Contended runs have several
+ * threads acquiring and releasing the same client in a loop, and report wall time per
+ * acquire and release over all threads.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sdk/aws_iot_mqtt_client_interface.h"
+#include "sdk/aws_iot_mqtt_client_common_internal.h"
+
+#include "bench.h"
+
+#define BENCH_STATE_TIMEOUT_MS 1000
+#define BENCH_STATE_CONTENDED_OPS 200000
+#define BENCH_STATE_MAX_THREADS 4
+
+/* The state and its locking as they were before the compare and swap */
+typedef struct {
+	ClientState clientState;
+	uint32_t stateWaiterCount;
+	bool isBlockOnThreadLockEnabled;
+	IoT_Mutex_t state_change_mutex;
+	IoT_Cond_t state_change_cond;
+} BenchMutexClient;
+
+typedef struct {
+	AWS_IoT_Client client;
+	BenchMutexClient mutexClient;
+	bool isMutex;
+	uint32_t ops;
+	uint32_t errors;
+} BenchStateState;
+
+static IoT_Error_t benchMutexSetState(BenchMutexClient *pClient, ClientState expectedCurrentState,
+									  ClientState newState) {
+	IoT_Error_t rc;
+
+	rc = aws_iot_thread_mutex_lock(&(pClient->state_change_mutex));
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	if(expectedCurrentState == pClient->clientState) {
+		pClient->clientState = newState;
+		rc = SUCCESS;
+	} else {
+		rc = MQTT_UNEXPECTED_CLIENT_STATE_ERROR;
+	}
+	if(SUCCESS == rc) {
+		(void) aws_iot_thread_cond_broadcast(&(pClient->state_change_cond));
+	}
+	(void) aws_iot_thread_mutex_unlock(&(pClient->state_change_mutex));
+
+	return rc;
+}
+
+static IoT_Error_t benchMutexAcquireState(BenchMutexClient *pClient, ClientState newState, uint32_t timeout_ms,
+										  ClientState *pPrevState) {
+	ClientState clientState;
+	IoT_Error_t rc, threadRc;
+	bool hasWaited = false;
+	Timer timer;
+
+	init_timer(&timer);
+	countdown_ms(&timer, timeout_ms);
+
+	rc = aws_iot_thread_mutex_lock(&(pClient->state_change_mutex));
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	for(;;) {
+		clientState = pClient->clientState;
+		if(CLIENT_STATE_CONNECTED_IDLE > clientState || CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN < clientState) {
+			rc = NETWORK_DISCONNECTED_ERROR;
+			break;
+		}
+
+		if(CLIENT_STATE_CONNECTED_IDLE == clientState && (hasWaited || 0 == pClient->stateWaiterCount)) {
+			pClient->clientState = newState;
+			*pPrevState = clientState;
+			(void) aws_iot_thread_cond_broadcast(&(pClient->state_change_cond));
+			rc = SUCCESS;
+			break;
+		}
+
+		if(false == pClient->isBlockOnThreadLockEnabled || has_timer_expired(&timer)) {
+			rc = MQTT_CLIENT_NOT_IDLE_ERROR;
+			break;
+		}
+
+		if(!hasWaited) {
+			hasWaited = true;
+			pClient->stateWaiterCount++;
+		}
+		threadRc = aws_iot_thread_cond_wait(&(pClient->state_change_cond), &(pClient->state_change_mutex),
+											left_ms(&timer));
+		if(SUCCESS != threadRc && COND_WAIT_TIMEOUT_ERROR != threadRc) {
+			rc = threadRc;
+			break;
+		}
+	}
+
+	if(hasWaited) {
+		pClient->stateWaiterCount--;
+		(void) aws_iot_thread_cond_broadcast(&(pClient->state_change_cond));
+	}
+
+	(void) aws_iot_thread_mutex_unlock(&(pClient->state_change_mutex));
+	return rc;
+}
+
+/* One acquire and release, as a yield does */
+static void benchAcquireRelease(void *pArg) {
+	BenchStateState *pState = pArg;
+	ClientState prevState;
+	IoT_Error_t rc;
+
+	if(pState->isMutex) {
+		rc = benchMutexAcquireState(&(pState->mutexClient), CLIENT_STATE_CONNECTED_YIELD_IN_PROGRESS,
+									BENCH_STATE_TIMEOUT_MS, &prevState);
+		if(SUCCESS == rc) {
+			rc = benchMutexSetState(&(pState->mutexClient), CLIENT_STATE_CONNECTED_YIELD_IN_PROGRESS, prevState);
+		}
+	} else {
+		rc = aws_iot_mqtt_internal_acquire_client_state(&(pState->client), CLIENT_STATE_CONNECTED_YIELD_IN_PROGRESS,
+														false, BENCH_STATE_TIMEOUT_MS, &prevState);
+		if(SUCCESS == rc) {
+			rc = aws_iot_mqtt_set_client_state(&(pState->client), CLIENT_STATE_CONNECTED_YIELD_IN_PROGRESS,
+											   prevState);
+		}
+	}
+
+	if(SUCCESS != rc) {
+		__atomic_add_fetch(&(pState->errors), 1, __ATOMIC_RELAXED);
+	}
+}
+
+static void *benchContendedThread(void *pArg) {
+	BenchStateState *pState = pArg;
+	uint32_t itr;
+
+	for(itr = 0; itr < pState->ops; itr++) {
+		benchAcquireRelease(pState);
+	}
+	return NULL;
+}
+
+static double benchContended(BenchStateState *pState, uint32_t threadCount) {
+	pthread_t threads[BENCH_STATE_MAX_THREADS];
+	uint64_t start;
+	uint32_t itr;
+
+	pState->ops = BENCH_STATE_CONTENDED_OPS;
+	start = benchWallNs();
+	for(itr = 0; itr < threadCount; itr++) {
+		if(0 != pthread_create(&threads[itr], NULL, benchContendedThread, pState)) {
+			threadCount = itr;
+			pState->errors++;
+			break;
+		}
+	}
+	for(itr = 0; itr < threadCount; itr++) {
+		pthread_join(threads[itr], NULL);
+	}
+
+	return (double) (benchWallNs() - start) / ((double) threadCount * BENCH_STATE_CONTENDED_OPS);
+}
+
+static IoT_Error_t benchInit(BenchStateState *pState) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Error_t rc;
+
+	initParams.pHostURL = "broker";
+	initParams.port = 8883;
+	initParams.pRootCALocation = initParams.pDeviceCertLocation = initParams.pDevicePrivateKeyLocation = "";
+	initParams.enableAutoReconnect = false;
+	initParams.isBlockOnThreadLockEnabled = true;
+	rc = aws_iot_mqtt_init(&(pState->client), &initParams);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	aws_iot_mqtt_internal_force_client_state(&(pState->client), CLIENT_STATE_CONNECTED_IDLE);
+
+	pState->mutexClient.clientState = CLIENT_STATE_CONNECTED_IDLE;
+	pState->mutexClient.isBlockOnThreadLockEnabled = true;
+	rc = aws_iot_thread_mutex_init(&(pState->mutexClient.state_change_mutex));
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	return aws_iot_thread_cond_init(&(pState->mutexClient.state_change_cond));
+}
+
+int main(void) {
+	static const uint32_t threadCounts[] = { 2, BENCH_STATE_MAX_THREADS };
+	static BenchStateState state;
+	double casNs, mutexNs;
+	uint32_t itr;
+
+	if(SUCCESS != benchInit(&state)) {
+		printf("client init failed\n");
+		return 1;
+	}
+
+	printf("%-12s %8s %8s\n", "threads", "cas ns", "mutex ns");
+
+	state.isMutex = false;
+	casNs = benchRun(benchAcquireRelease, &state);
+	state.isMutex = true;
+	mutexNs = benchRun(benchAcquireRelease, &state);
+	printf("%-12s %8.0f %8.0f\n", "1", casNs, mutexNs);
+
+	for(itr = 0; itr < sizeof(threadCounts) / sizeof(threadCounts[0]); itr++) {
+		state.isMutex = false;
+		casNs = benchContended(&state, threadCounts[itr]);
+		state.isMutex = true;
+		mutexNs = benchContended(&state, threadCounts[itr]);
+		printf("%-12u %8.0f %8.0f\n", threadCounts[itr], casNs, mutexNs);
+	}
+
+	if(0 != state.errors) {
+		printf("%u acquires or releases failed\n", state.errors);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file bench_compress.c
+ * @brief Size and time of the LZ4 payload codec on the application's documents
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sdk/aws_iot_mqtt_client_compress.h"
+
+#include "bench.h"
+
+#define BENCH_COMPRESS_BUF_LEN 2048
+
+typedef struct {
+	const char *pName;
+	const char *pPayload;
+} BenchPayload;
+
+static const BenchPayload benchPayloads[] = {
+	{ "shadow update",
+	  "{\"state\":{\"reported\":{\"door\":\"closed\",\"lock\":\"locked\"}},\"clientToken\":\"door-control-0001-17\"}" },
+	{ "shadow document",
+	  "{\"state\":{\"desired\":{\"door\":\"open\",\"lock\":\"unlocked\"},\"reported\":{\"door\":\"closed\","
+	  "\"lock\":\"locked\",\"battery\":87}},\"metadata\":{\"desired\":{\"door\":{\"timestamp\":1539043200}}},"
+	  "\"version\":42,\"timestamp\":1539043260}" },
+	{ "job execution",
+	  "{\"execution\":{\"jobId\":\"update-0042\",\"status\":\"QUEUED\",\"queuedAt\":1539043200,"
+	  "\"lastUpdatedAt\":1539043200,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":"
+	  "{\"operation\":\"firmware\",\"url\":\"https://example.com/fw/door-control-1.2.3.tpk\"}}}" },
+	{ "door event",
+	  "{\"camera\":{\"motion\":true,\"image\":\"door-control-0001/2018-10-09/120000.jpg\"},"
+	  "\"sensor\":{\"door\":\"opening\",\"battery\":86},\"timestamp\":1539086400}" },
+};
+
+typedef struct {
+	const unsigned char *pIn;
+	size_t inLen;
+	unsigned char compressed[BENCH_COMPRESS_BUF_LEN];
+	size_t compressedLen;
+	unsigned char out[BENCH_COMPRESS_BUF_LEN];
+	size_t outLen;
+	IoT_Error_t rc;
+} BenchCompressState;
+
+static void benchCompress(void *pArg) {
+	BenchCompressState *pState = pArg;
+
+	pState->rc |= aws_iot_mqtt_compress_payload(pState->pIn, pState->inLen, pState->compressed,
+												sizeof(pState->compressed), &(pState->compressedLen));
+}
+
+static void benchDecompress(void *pArg) {
+	BenchCompressState *pState = pArg;
+
+	pState->rc |= aws_iot_mqtt_decompress_payload(pState->compressed, pState->compressedLen, pState->out,
+												  sizeof(pState->out), &(pState->outLen));
+}
+
+int main(void) {
+	static BenchCompressState state;
+	double compressNs, decompressNs;
+	uint32_t itr;
+
+	printf("%-16s %8s %8s %8s %12s %14s\n", "payload", "bytes", "encoded", "ratio", "compress ns", "decompress ns");
+	for(itr = 0; itr < sizeof(benchPayloads) / sizeof(benchPayloads[0]); itr++) {
+		state.pIn = (const unsigned char *) benchPayloads[itr].pPayload;
+		state.inLen = strlen(benchPayloads[itr].pPayload);
+		state.rc = SUCCESS;
+
+		compressNs = benchRun(benchCompress, &state);
+		decompressNs = benchRun(benchDecompress, &state);
+		if(SUCCESS != state.rc || state.outLen != state.inLen || 0 != memcmp(state.pIn, state.out, state.inLen)) {
+			printf("%-16s round trip failed\n", benchPayloads[itr].pName);
+			return 1;
+		}
+
+		printf("%-16s %8zu %8zu %8.2f %12.0f %14.0f\n", benchPayloads[itr].pName, state.inLen, state.compressedLen,
+			   (double) state.compressedLen / (double) state.inLen, compressNs, decompressNs);
+	}
+
+	return 0;
+}
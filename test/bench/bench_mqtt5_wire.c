@@ -0,0 +1,141 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file bench_mqtt5_wire.c
+ * @brief Bytes on the wire and time per publish with MQTT 3.1.1 and 5.0
+ *
+ * Publishes a shadow update in turn on three shadow topics through the in-memory
+ * network, so that MQTT 5 sends each topic once and its alias afterwards. Bytes are
+ * those of the PUBLISH packets, before TLS.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sdk/aws_iot_mqtt_client_interface.h"
+
+#include "bench.h"
+#include "fake_network.h"
+
+#define BENCH_WIRE_PUBLISHES 1000
+
+static const char *benchTopics[] = {
+	"$aws/things/door-control-0001/shadow/update",
+	"$aws/things/door-control-0001/shadow/update/accepted",
+	"$aws/things/door-control-0001/shadow/get",
+};
+
+static const char benchPayload[] =
+	"{\"state\":{\"reported\":{\"door\":\"locked\",\"battery\":87}},\"clientToken\":\"door-control-0001-42\"}";
+
+typedef struct {
+	AWS_IoT_Client client;
+	QoS qos;
+	uint32_t next;
+	IoT_Error_t rc;
+} BenchWireState;
+
+static void benchPublish(void *pArg) {
+	BenchWireState *pState = pArg;
+	IoT_Publish_Message_Params params;
+	const char *pTopic = benchTopics[pState->next++ % (sizeof(benchTopics) / sizeof(benchTopics[0]))];
+
+	params.qos = pState->qos;
+	params.isRetained = 0;
+	params.isDup = 0;
+	params.payload = (void *) benchPayload;
+	params.payloadLen = sizeof(benchPayload) - 1;
+	if(SUCCESS == pState->rc) {
+		pState->rc = aws_iot_mqtt_publish(&(pState->client), pTopic, (uint16_t) strlen(pTopic), &params);
+	}
+}
+
+static IoT_Error_t benchConnect(BenchWireState *pState, MQTT_Ver_t version) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	IoT_Error_t rc;
+
+	initParams.pHostURL = "broker";
+	initParams.port = 8883;
+	initParams.pRootCALocation = initParams.pDeviceCertLocation = initParams.pDevicePrivateKeyLocation = "";
+	initParams.enableAutoReconnect = false;
+	rc = aws_iot_mqtt_init(&(pState->client), &initParams);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	rc = fakeNetworkAttach(&(pState->client.networkStack));
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	rc = aws_iot_mqtt_set_publish_rate_limit(&(pState->client), 0, 0);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	connectParams.MQTTVersion = version;
+	connectParams.pClientID = "door-control-0001";
+	connectParams.clientIDLen = (uint16_t) strlen(connectParams.pClientID);
+	return aws_iot_mqtt_connect(&(pState->client), &connectParams);
+}
+
+static IoT_Error_t benchVersion(const char *pName, MQTT_Ver_t version, QoS qos) {
+	BenchWireState state;
+	FakeNetworkStats before, after;
+	uint32_t itr;
+	double ns;
+
+	state.qos = qos;
+	state.next = 0;
+	state.rc = benchConnect(&state, version);
+	if(SUCCESS != state.rc) {
+		printf("%-8s qos%d connect failed: %d\n", pName, qos, state.rc);
+		return state.rc;
+	}
+
+	fakeNetworkGetStats(&(state.client.networkStack), &before);
+	for(itr = 0; itr < BENCH_WIRE_PUBLISHES; itr++) {
+		benchPublish(&state);
+	}
+	fakeNetworkGetStats(&(state.client.networkStack), &after);
+	ns = benchRun(benchPublish, &state);
+
+	if(SUCCESS != state.rc) {
+		printf("%-8s qos%d publish failed: %d\n", pName, qos, state.rc);
+	} else {
+		printf("%-8s qos%d %8llu bytes per %u publishes %8.1f bytes each %8.0f ns per publish\n", pName, qos,
+			   (unsigned long long) (after.txBytes - before.txBytes), BENCH_WIRE_PUBLISHES,
+			   (double) (after.txBytes - before.txBytes) / BENCH_WIRE_PUBLISHES, ns);
+	}
+
+	(void) aws_iot_mqtt_disconnect(&(state.client));
+	fakeNetworkDetach(&(state.client.networkStack));
+	(void) aws_iot_mqtt_free(&(state.client));
+
+	return state.rc;
+}
+
+int main(void) {
+	int failed = 0;
+
+	printf("bench_mqtt5_wire: %d byte payload on %u topics\n", (int) sizeof(benchPayload) - 1,
+		   (unsigned int) (sizeof(benchTopics) / sizeof(benchTopics[0])));
+	failed |= (SUCCESS != benchVersion("3.1.1", MQTT_3_1_1, QOS0));
+	failed |= (SUCCESS != benchVersion("5.0", MQTT_5, QOS0));
+	failed |= (SUCCESS != benchVersion("3.1.1", MQTT_3_1_1, QOS1));
+	failed |= (SUCCESS != benchVersion("5.0", MQTT_5, QOS1));
+
+	return failed;
+}
@@ -0,0 +1,203 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file bench_reconnect_storm.c
+ * @brief Reconnects of many clients after their broker comes back
+ *
+ * All clients lose the broker at the same time and get it back after an outage. The
+ * clients run on the simulated clock of host/sim_timer.c and are stepped in turn, each
+ * step yields every client for the same slice of simulated time. Runs once with the
+ * reachability probe and once without it, times are in simulated ms after the broker
+ * is back. The peak counts the reconnects landing in the busiest 100 ms window.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdk/aws_iot_mqtt_client_interface.h"
+
+#include "fake_network.h"
+#include "sim_timer.h"
+
+#define BENCH_STORM_CLIENTS 256
+#define BENCH_STORM_STEP_MS 10
+#define BENCH_STORM_OUTAGE_START_MS 1000
+#define BENCH_STORM_OUTAGE_MS 20000
+/* Long enough for the back-off of a client that never sees the probe succeed */
+#define BENCH_STORM_MAX_WAIT_MS (2 * AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL)
+#define BENCH_STORM_WINDOW_MS 100
+
+typedef struct {
+	AWS_IoT_Client client;
+	char clientId[16];
+	bool isWaiting;		///< Lost the broker and not reconnected yet
+	uint64_t reconnectMs;	///< Reconnect time after the broker is back
+} BenchStormClient;
+
+typedef struct {
+	uint32_t reconnected;
+	uint32_t refused;
+	uint64_t p0Ms, p50Ms, p90Ms, p100Ms;
+	uint32_t peak;
+} BenchStormResult;
+
+static int benchCompareMs(const void *pA, const void *pB) {
+	uint64_t a = *(const uint64_t *) pA, b = *(const uint64_t *) pB;
+
+	return (a > b) - (a < b);
+}
+
+static IoT_Error_t benchConnect(BenchStormClient *pStorm, uint32_t index, bool isProbeEnabled) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	IoT_Error_t rc;
+
+	initParams.pHostURL = "broker";
+	initParams.port = 8883;
+	initParams.pRootCALocation = initParams.pDeviceCertLocation = initParams.pDevicePrivateKeyLocation = "";
+	initParams.enableAutoReconnect = true;
+	rc = aws_iot_mqtt_init(&(pStorm->client), &initParams);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	rc = fakeNetworkAttach(&(pStorm->client.networkStack));
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	if(!isProbeEnabled) {
+		pStorm->client.networkStack.probeReachability = NULL;
+	}
+
+	snprintf(pStorm->clientId, sizeof(pStorm->clientId), "door-%04u", index);
+	connectParams.MQTTVersion = MQTT_3_1_1;
+	connectParams.pClientID = pStorm->clientId;
+	connectParams.clientIDLen = (uint16_t) strlen(pStorm->clientId);
+	return aws_iot_mqtt_connect(&(pStorm->client), &connectParams);
+}
+
+static bool benchRunStorm(BenchStormClient *pStorms, uint32_t count, bool isProbeEnabled, BenchStormResult *pResult) {
+	uint64_t stepMs, upMs = BENCH_STORM_OUTAGE_START_MS + BENCH_STORM_OUTAGE_MS, *pReconnectMs;
+	uint32_t itr, waiting = 0, window, windowStart;
+	FakeNetworkStats stats;
+	IoT_Error_t rc;
+	bool isOk = true;
+
+	memset(pStorms, 0, count * sizeof(BenchStormClient));
+	memset(pResult, 0, sizeof(BenchStormResult));
+	for(itr = 0; itr < count; itr++) {
+		simTimerSetMs(0);
+		if(SUCCESS != benchConnect(&pStorms[itr], itr, isProbeEnabled)) {
+			printf("client %u failed to connect\n", itr);
+			return false;
+		}
+	}
+
+	for(stepMs = 0; stepMs < upMs + BENCH_STORM_MAX_WAIT_MS; stepMs += BENCH_STORM_STEP_MS) {
+		if(BENCH_STORM_OUTAGE_START_MS == stepMs || upMs == stepMs) {
+			for(itr = 0; itr < count; itr++) {
+				fakeNetworkSetBrokerUp(&(pStorms[itr].client.networkStack), upMs == stepMs);
+			}
+		}
+
+		for(itr = 0; itr < count; itr++) {
+			simTimerSetMs(stepMs);
+			rc = aws_iot_mqtt_yield(&(pStorms[itr].client), BENCH_STORM_STEP_MS);
+			if(NETWORK_RECONNECT_TIMED_OUT_ERROR == rc) {
+				printf("client %u gave up reconnecting\n", itr);
+				isOk = false;
+			}
+			if(!aws_iot_mqtt_is_client_connected(&(pStorms[itr].client))) {
+				waiting += pStorms[itr].isWaiting ? 0 : 1;
+				pStorms[itr].isWaiting = true;
+			} else if(pStorms[itr].isWaiting) {
+				pStorms[itr].isWaiting = false;
+				pStorms[itr].reconnectMs = simTimerGetMs() - upMs;
+				pResult->reconnected++;
+			}
+		}
+
+		if(upMs < stepMs && pResult->reconnected == waiting) {
+			break;
+		}
+	}
+
+	pReconnectMs = calloc(count, sizeof(uint64_t));
+	if(NULL == pReconnectMs) {
+		return false;
+	}
+	for(itr = 0; itr < count; itr++) {
+		fakeNetworkGetStats(&(pStorms[itr].client.networkStack), &stats);
+		pResult->refused += stats.connectsRefused;
+		pReconnectMs[itr] = pStorms[itr].reconnectMs;
+		isOk = isOk && !pStorms[itr].isWaiting;
+		(void) aws_iot_mqtt_disconnect(&(pStorms[itr].client));
+		fakeNetworkDetach(&(pStorms[itr].client.networkStack));
+		(void) aws_iot_mqtt_free(&(pStorms[itr].client));
+	}
+	if(waiting != count) {
+		printf("%u of %u clients noticed the outage\n", waiting, count);
+		isOk = false;
+	}
+
+	qsort(pReconnectMs, count, sizeof(uint64_t), benchCompareMs);
+	pResult->p0Ms = pReconnectMs[0];
+	pResult->p50Ms = pReconnectMs[count / 2];
+	pResult->p90Ms = pReconnectMs[count * 9 / 10];
+	pResult->p100Ms = pReconnectMs[count - 1];
+	for(windowStart = 0; windowStart < count; windowStart++) {
+		for(window = windowStart; window < count && pReconnectMs[window] < pReconnectMs[windowStart] + BENCH_STORM_WINDOW_MS;
+			window++) {
+		}
+		if(window - windowStart > pResult->peak) {
+			pResult->peak = window - windowStart;
+		}
+	}
+	free(pReconnectMs);
+
+	return isOk;
+}
+
+int main(int argc, char **argv) {
+	uint32_t count = (1 < argc) ? (uint32_t) atoi(argv[1]) : BENCH_STORM_CLIENTS;
+	BenchStormClient *pStorms;
+	BenchStormResult result;
+	int isProbeEnabled;
+
+	if(0 == count || 1000 < count) {
+		printf("usage: %s [clients, 1 to 1000]\n", argv[0]);
+		return 1;
+	}
+	pStorms = calloc(count, sizeof(BenchStormClient));
+	if(NULL == pStorms) {
+		return 1;
+	}
+
+	printf("%u clients, broker down for %u ms\n", count, BENCH_STORM_OUTAGE_MS);
+	printf("%-6s %8s %8s %8s %8s %8s %14s\n", "probe", "refused", "first", "median", "p90", "last", "peak / 100 ms");
+	for(isProbeEnabled = 1; 0 <= isProbeEnabled; isProbeEnabled--) {
+		if(!benchRunStorm(pStorms, count, isProbeEnabled, &result)) {
+			free(pStorms);
+			return 1;
+		}
+		printf("%-6s %8u %8llu %8llu %8llu %8llu %14u\n", isProbeEnabled ? "on" : "off", result.refused,
+			   (unsigned long long) result.p0Ms, (unsigned long long) result.p50Ms,
+			   (unsigned long long) result.p90Ms, (unsigned long long) result.p100Ms, result.peak);
+	}
+
+	free(pStorms);
+	return 0;
+}
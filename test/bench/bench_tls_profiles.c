@@ -0,0 +1,187 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file bench_tls_profiles.c
+ * @brief Handshake time, bulk throughput and CPU per MB of the TLS profiles
+ *
+ * Connects to a local TLS server through the mbedTLS network layer once per cipher and
+ * curve profile. The first connect of a profile loads the credentials and is not timed,
+ * the reconnects after it are. Throughput is the time to write the payload, the server
+ * must read and drop it. The certificate and key types are those of the files given.
+ *
+ * Untested: compiled against the headers in inc/mbedtls, never linked or run.
+ * See test/README.md.
+ *
+ * Usage: bench_tls_profiles <host> <port> <root CA> <device cert> <device key> [handshakes] [MB]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdk/network_interface.h"
+#include "sdk/timer_interface.h"
+#include "mbedtls/ssl.h"
+
+#include "bench.h"
+
+#define BENCH_TLS_HANDSHAKE_TIMEOUT_MS 10000
+#define BENCH_TLS_WRITE_TIMEOUT_MS 10000
+#define BENCH_TLS_CHUNK_LEN 4096
+
+typedef struct {
+	const char *pName;
+	TLSCipherProfile cipherProfile;
+	TLSCurveProfile curveProfile;
+} BenchTlsProfile;
+
+static const BenchTlsProfile benchProfiles[] = {
+	{ "default", TLS_CIPHER_PROFILE_DEFAULT, TLS_CURVE_PROFILE_DEFAULT },
+	{ "aes-gcm/p256", TLS_CIPHER_PROFILE_AES_GCM, TLS_CURVE_PROFILE_P256 },
+	{ "aes-gcm/x25519", TLS_CIPHER_PROFILE_AES_GCM, TLS_CURVE_PROFILE_X25519 },
+	{ "chachapoly/p256", TLS_CIPHER_PROFILE_CHACHAPOLY, TLS_CURVE_PROFILE_P256 },
+	{ "chachapoly/x25519", TLS_CIPHER_PROFILE_CHACHAPOLY, TLS_CURVE_PROFILE_X25519 },
+};
+
+static unsigned char benchChunk[BENCH_TLS_CHUNK_LEN];
+
+static IoT_Error_t benchWriteAll(Network *pNetwork, size_t len) {
+	Timer timer;
+	size_t written, chunkLen;
+	IoT_Error_t rc;
+
+	while(0 < len) {
+		chunkLen = (len < sizeof(benchChunk)) ? len : sizeof(benchChunk);
+		init_timer(&timer);
+		countdown_ms(&timer, BENCH_TLS_WRITE_TIMEOUT_MS);
+		rc = iot_tls_write(pNetwork, benchChunk, chunkLen, &timer, &written);
+		if(SUCCESS != rc) {
+			return rc;
+		}
+		len -= written;
+	}
+
+	return SUCCESS;
+}
+
+static void benchCloseConnection(Network *pNetwork) {
+	(void) iot_tls_disconnect(pNetwork);
+	(void) iot_tls_destroy(pNetwork);
+}
+
+static IoT_Error_t benchProfile(const BenchTlsProfile *pProfile, char **ppArgs, unsigned int handshakes,
+								unsigned int megabytes) {
+	Network network;
+	TLSConnectParams params;
+	TLSHandshakeStats before, after;
+	uint64_t wall, cpu, fullWallNs, fullCpuNs, resumedWallNs, resumedCpuNs;
+	unsigned int itr, full, resumed;
+	const char *pSuite;
+	IoT_Error_t rc;
+
+	rc = iot_tls_init(&network, ppArgs[2], ppArgs[3], ppArgs[4], ppArgs[0], (uint16_t) atoi(ppArgs[1]),
+					  BENCH_TLS_HANDSHAKE_TIMEOUT_MS, false);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	/* The first connect loads the credentials for the profile, it is not counted */
+	params = network.tlsConnectParams;
+	params.cipherProfile = pProfile->cipherProfile;
+	params.curveProfile = pProfile->curveProfile;
+	rc = iot_tls_connect(&network, &params);
+	if(SUCCESS != rc) {
+		printf("%-18s connect failed: %d\n", pProfile->pName, rc);
+		(void) iot_tls_destroy(&network);
+		(void) iot_tls_free(&network);
+		return rc;
+	}
+	pSuite = mbedtls_ssl_get_ciphersuite(&(network.tlsDataParams.ssl));
+	printf("%-18s %s\n", pProfile->pName, pSuite);
+
+	full = resumed = 0;
+	fullWallNs = fullCpuNs = resumedWallNs = resumedCpuNs = 0;
+	for(itr = 0; itr < handshakes && SUCCESS == rc; itr++) {
+		benchCloseConnection(&network);
+		(void) iot_tls_get_handshake_stats(&network, &before);
+		wall = benchWallNs();
+		cpu = benchCpuNs();
+		rc = iot_tls_connect(&network, NULL);
+		wall = benchWallNs() - wall;
+		cpu = benchCpuNs() - cpu;
+		(void) iot_tls_get_handshake_stats(&network, &after);
+		if(after.resumed != before.resumed) {
+			resumed++;
+			resumedWallNs += wall;
+			resumedCpuNs += cpu;
+		} else {
+			full++;
+			fullWallNs += wall;
+			fullCpuNs += cpu;
+		}
+	}
+	if(SUCCESS != rc) {
+		printf("%-18s reconnect failed: %d\n", pProfile->pName, rc);
+	} else {
+		if(0 < full) {
+			printf("%-18s full handshake    %8.2f ms wall %8.2f ms cpu (%u)\n", "", fullWallNs / 1e6 / full,
+				   fullCpuNs / 1e6 / full, full);
+		}
+		if(0 < resumed) {
+			printf("%-18s resumed handshake %8.2f ms wall %8.2f ms cpu (%u)\n", "", resumedWallNs / 1e6 / resumed,
+				   resumedCpuNs / 1e6 / resumed, resumed);
+		}
+
+		wall = benchWallNs();
+		cpu = benchCpuNs();
+		rc = benchWriteAll(&network, (size_t) megabytes * 1024 * 1024);
+		wall = benchWallNs() - wall;
+		cpu = benchCpuNs() - cpu;
+		if(SUCCESS != rc) {
+			printf("%-18s write failed: %d\n", pProfile->pName, rc);
+		} else if(0 < megabytes) {
+			printf("%-18s bulk write        %8.2f MB/s     %8.2f ms cpu per MB\n", "",
+				   megabytes / (wall / 1e9), cpu / 1e6 / megabytes);
+		}
+	}
+
+	benchCloseConnection(&network);
+	(void) iot_tls_free(&network);
+
+	return rc;
+}
+
+int main(int argc, char **argv) {
+	unsigned int handshakes, megabytes, itr, failed;
+
+	if(argc < 6) {
+		fprintf(stderr, "usage: %s <host> <port> <root CA> <device cert> <device key> [handshakes] [MB]\n",
+				argv[0]);
+		return 2;
+	}
+	handshakes = (argc > 6) ? (unsigned int) atoi(argv[6]) : 20;
+	megabytes = (argc > 7) ? (unsigned int) atoi(argv[7]) : 16;
+	memset(benchChunk, 'x', sizeof(benchChunk));
+
+	failed = 0;
+	for(itr = 0; itr < sizeof(benchProfiles) / sizeof(benchProfiles[0]); itr++) {
+		if(SUCCESS != benchProfile(&benchProfiles[itr], &argv[1], handshakes, megabytes)) {
+			failed++;
+		}
+	}
+
+	return (0 == failed) ? 0 : 1;
+}
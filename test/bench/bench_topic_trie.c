@@ -0,0 +1,219 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file bench_topic_trie.c
+ * @brief Publish dispatch through the topic trie against the linear scan it replaced
+ *
+ * Each device subscribes to its shadow and job topics, eight filters per device. The
+ * linear scan is the one of the SDK before the trie: every handler is compared with an
+ * exact compare, then with the wildcard matcher.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sdk/aws_iot_mqtt_client_interface.h"
+#include "sdk/aws_iot_mqtt_client_common_internal.h"
+
+#include "bench.h"
+
+#define BENCH_MAX_FILTERS 256
+#define BENCH_FILTER_LEN 64
+#define BENCH_FILTERS_PER_DEVICE 8
+
+static const char *benchFilterFormats[BENCH_FILTERS_PER_DEVICE] = {
+	"$aws/things/door-%u/shadow/update/accepted",
+	"$aws/things/door-%u/shadow/update/rejected",
+	"$aws/things/door-%u/shadow/update/delta",
+	"$aws/things/door-%u/shadow/get/accepted",
+	"$aws/things/door-%u/shadow/get/rejected",
+	"$aws/things/door-%u/shadow/delete/accepted",
+	"$aws/things/door-%u/shadow/delete/rejected",
+	"$aws/things/door-%u/jobs/+/get/accepted",
+};
+
+typedef struct {
+	AWS_IoT_Client client;
+	MessageHandlers handlers[BENCH_MAX_FILTERS];
+	TopicTrieNode nodes[4 * BENCH_MAX_FILTERS];
+	char filters[BENCH_MAX_FILTERS][BENCH_FILTER_LEN];
+	uint32_t filterCount;
+	char topic[BENCH_FILTER_LEN];
+	uint16_t topicLen;
+	IoT_Publish_Message_Params params;
+	uint32_t calls;
+} BenchTrieState;
+
+/* The wildcard matcher of the linear scan */
+static bool benchIsTopicMatched(char *pTopicFilter, char *pTopicName, uint16_t topicNameLen) {
+	char *curf, *curn, *curn_end;
+
+	if(NULL == pTopicFilter || NULL == pTopicName) {
+		return false;
+	}
+
+	curf = pTopicFilter;
+	curn = pTopicName;
+	curn_end = curn + topicNameLen;
+
+	while(*curf && (curn < curn_end)) {
+		if(*curn == '/' && *curf != '/') {
+			break;
+		}
+		if(*curf != '+' && *curf != '#' && *curf != *curn) {
+			break;
+		}
+		if(*curf == '+') {
+			/* skip until we meet the next separator, or end of string */
+			char *nextpos = curn + 1;
+			while(nextpos < curn_end && *nextpos != '/')
+				nextpos = ++curn + 1;
+		} else if(*curf == '#') {
+			/* skip until end of string */
+			curn = curn_end - 1;
+		}
+
+		curf++;
+		curn++;
+	};
+
+	return (curn == curn_end) && (*curf == '\0');
+}
+
+static void benchHandler(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+						 IoT_Publish_Message_Params *pParams, void *pData) {
+	BenchTrieState *pState = pData;
+
+	pState->calls++;
+}
+
+static void benchTrieDispatch(void *pArg) {
+	BenchTrieState *pState = pArg;
+
+	(void) aws_iot_mqtt_internal_trie_dispatch(&(pState->client), pState->topic, pState->topicLen, &(pState->params),
+											   0, 0, true);
+}
+
+static void benchLinearDispatch(void *pArg) {
+	BenchTrieState *pState = pArg;
+	MessageHandlers *pHandler;
+	uint32_t itr;
+
+	for(itr = 0; itr < pState->filterCount; itr++) {
+		pHandler = &(pState->handlers[itr]);
+		if(NULL != pHandler->topicName &&
+		   (((pState->topicLen == pHandler->topicNameLen) &&
+			 (strncmp(pState->topic, pHandler->topicName, pState->topicLen) == 0)) ||
+			benchIsTopicMatched((char *) pHandler->topicName, pState->topic, pState->topicLen))) {
+			if(NULL != pHandler->pApplicationHandler) {
+				pHandler->pApplicationHandler(&(pState->client), pState->topic, pState->topicLen, &(pState->params),
+											  pHandler->pApplicationHandlerData);
+			}
+		}
+	}
+}
+
+static bool benchSubscribe(BenchTrieState *pState, uint32_t filterCount) {
+	MessageHandlers *pHandler;
+	uint32_t itr;
+
+	memset(&(pState->client), 0, sizeof(pState->client));
+	memset(pState->handlers, 0, sizeof(pState->handlers));
+	if(SUCCESS != aws_iot_mqtt_set_subscription_table(&(pState->client), pState->handlers, filterCount, pState->nodes,
+													  4 * filterCount)) {
+		return false;
+	}
+
+	for(itr = 0; itr < filterCount; itr++) {
+		snprintf(pState->filters[itr], BENCH_FILTER_LEN, benchFilterFormats[itr % BENCH_FILTERS_PER_DEVICE],
+				 itr / BENCH_FILTERS_PER_DEVICE);
+		pHandler = &(pState->handlers[itr]);
+		pHandler->topicName = pState->filters[itr];
+		pHandler->topicNameLen = (uint16_t) strlen(pState->filters[itr]);
+		pHandler->pApplicationHandler = benchHandler;
+		pHandler->pApplicationHandlerData = pState;
+		if(SUCCESS != aws_iot_mqtt_internal_trie_insert(&(pState->client), itr)) {
+			return false;
+		}
+	}
+	pState->filterCount = filterCount;
+	return true;
+}
+
+static void benchSetTopic(BenchTrieState *pState, const char *pTopic) {
+	strcpy(pState->topic, pTopic);
+	pState->topicLen = (uint16_t) strlen(pTopic);
+}
+
+/* Both dispatches call the same handlers */
+static bool benchIsSameMatch(BenchTrieState *pState) {
+	uint32_t trieCalls;
+
+	pState->calls = 0;
+	benchTrieDispatch(pState);
+	trieCalls = pState->calls;
+	pState->calls = 0;
+	benchLinearDispatch(pState);
+	return trieCalls == pState->calls;
+}
+
+int main(void) {
+	static const uint32_t filterCounts[] = { 8, 16, 64, 256 };
+	static BenchTrieState state;
+	char topic[BENCH_FILTER_LEN];
+	double trieNs, linearNs;
+	uint32_t itr, lastDevice;
+
+	printf("%8s %-14s %10s %10s\n", "filters", "topic", "trie ns", "linear ns");
+	for(itr = 0; itr < sizeof(filterCounts) / sizeof(filterCounts[0]); itr++) {
+		if(!benchSubscribe(&state, filterCounts[itr])) {
+			printf("%8u subscribe failed\n", filterCounts[itr]);
+			return 1;
+		}
+		lastDevice = filterCounts[itr] / BENCH_FILTERS_PER_DEVICE - 1;
+
+		snprintf(topic, sizeof(topic), "$aws/things/door-%u/shadow/update/delta", lastDevice);
+		benchSetTopic(&state, topic);
+		if(!benchIsSameMatch(&state) || 1 != state.calls) {
+			printf("%8u dispatch mismatch on %s\n", filterCounts[itr], topic);
+			return 1;
+		}
+		trieNs = benchRun(benchTrieDispatch, &state);
+		linearNs = benchRun(benchLinearDispatch, &state);
+		printf("%8u %-14s %10.0f %10.0f\n", filterCounts[itr], "exact", trieNs, linearNs);
+
+		snprintf(topic, sizeof(topic), "$aws/things/door-%u/jobs/update-0042/get/accepted", lastDevice);
+		benchSetTopic(&state, topic);
+		if(!benchIsSameMatch(&state) || 1 != state.calls) {
+			printf("%8u dispatch mismatch on %s\n", filterCounts[itr], topic);
+			return 1;
+		}
+		trieNs = benchRun(benchTrieDispatch, &state);
+		linearNs = benchRun(benchLinearDispatch, &state);
+		printf("%8u %-14s %10.0f %10.0f\n", filterCounts[itr], "wildcard", trieNs, linearNs);
+
+		benchSetTopic(&state, "door-control/event");
+		if(!benchIsSameMatch(&state) || 0 != state.calls) {
+			printf("%8u dispatch mismatch on unsubscribed topic\n", filterCounts[itr]);
+			return 1;
+		}
+		trieNs = benchRun(benchTrieDispatch, &state);
+		linearNs = benchRun(benchLinearDispatch, &state);
+		printf("%8u %-14s %10.0f %10.0f\n", filterCounts[itr], "unsubscribed", trieNs, linearNs);
+	}
+
+	return 0;
+}
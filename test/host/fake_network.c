@@ -0,0 +1,390 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file fake_network.c
+ * @brief In-memory network layer with a minimal broker behind it
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aws_iot_config.h"
+#include "sdk/aws_iot_mqtt_client.h"
+#include "sdk/aws_iot_mqtt_client_common_internal.h"
+#include "fake_network.h"
+
+#define FAKE_NETWORK_MAX 1024
+
+typedef struct {
+	Network *pNetwork;
+	bool isConnected;
+	bool isBrokerUp;
+	bool isPubackEnabled;
+	uint8_t mqttVersion;
+	size_t rxHead, rxTail;
+	unsigned char rxBuf[FAKE_NETWORK_BUF_LEN];
+	size_t txLen;
+	unsigned char txBuf[FAKE_NETWORK_BUF_LEN];
+	FakeNetworkStats stats;
+} FakeNetwork;
+
+static pthread_mutex_t fakeNetworkMutex = PTHREAD_MUTEX_INITIALIZER;
+static FakeNetwork *fakeNetworks[FAKE_NETWORK_MAX];
+static FakeNetwork *pLastFakeNetwork;
+
+/* The host build has no TLS layer, aws_iot_mqtt_init and aws_iot_mqtt_free get these */
+IoT_Error_t iot_tls_init(Network *pNetwork, char *pRootCALocation, char *pDeviceCertLocation,
+						 char *pDevicePrivateKeyLocation, char *pDestinationURL,
+						 uint16_t destinationPort, uint32_t timeout_ms, bool ServerVerificationFlag) {
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_free(Network *pNetwork) {
+	return SUCCESS;
+}
+
+/* Called with fakeNetworkMutex held */
+static FakeNetwork *_fakeNetworkFind(Network *pNetwork) {
+	uint32_t itr;
+
+	if(NULL != pLastFakeNetwork && pNetwork == pLastFakeNetwork->pNetwork) {
+		return pLastFakeNetwork;
+	}
+	for(itr = 0; itr < FAKE_NETWORK_MAX; itr++) {
+		if(NULL != fakeNetworks[itr] && pNetwork == fakeNetworks[itr]->pNetwork) {
+			pLastFakeNetwork = fakeNetworks[itr];
+			return pLastFakeNetwork;
+		}
+	}
+	abort();
+}
+
+static void _fakeNetworkReply(FakeNetwork *pFake, const unsigned char *pData, size_t len) {
+	if(pFake->rxHead == pFake->rxTail) {
+		pFake->rxHead = pFake->rxTail = 0;
+	}
+	if(FAKE_NETWORK_BUF_LEN - pFake->rxTail < len) {
+		memmove(pFake->rxBuf, pFake->rxBuf + pFake->rxHead, pFake->rxTail - pFake->rxHead);
+		pFake->rxTail -= pFake->rxHead;
+		pFake->rxHead = 0;
+	}
+	if(FAKE_NETWORK_BUF_LEN - pFake->rxTail < len) {
+		abort();
+	}
+	memcpy(pFake->rxBuf + pFake->rxTail, pData, len);
+	pFake->rxTail += len;
+}
+
+/* Length of the complete packet at the start of the TX buffer, 0 if it is not all there */
+static size_t _fakeNetworkPacketLen(FakeNetwork *pFake, size_t *pHeaderLen) {
+	size_t remLen = 0, multiplier = 1, pos = 1;
+
+	do {
+		if(pos >= pFake->txLen || pos > 4) {
+			return 0;
+		}
+		remLen += (pFake->txBuf[pos] & 127) * multiplier;
+		multiplier *= 128;
+	} while(pFake->txBuf[pos++] & 128);
+
+	if(pos + remLen > FAKE_NETWORK_BUF_LEN) {
+		abort();
+	}
+	*pHeaderLen = pos;
+	return (pos + remLen <= pFake->txLen) ? pos + remLen : 0;
+}
+
+/* Answers one packet the client sent, pPacket points past the fixed header */
+static void _fakeNetworkHandlePacket(FakeNetwork *pFake, unsigned char type, const unsigned char *pPacket,
+									 size_t len) {
+	unsigned char reply[4 + AWS_IOT_MQTT_MAX_FILTERS_PER_PACKET + 1];
+	const unsigned char *ptr, *pEnd = pPacket + len;
+	size_t replyLen, topicLen;
+
+	switch(type >> 4) {
+		case 1: /* CONNECT: protocol name, then the protocol level */
+			pFake->mqttVersion = pPacket[6];
+			if(MQTT_5 == pFake->mqttVersion) {
+				const unsigned char connack[] = { 0x20, 0x06, 0x00, 0x00, 0x03, MQTT_PROPERTY_TOPIC_ALIAS_MAXIMUM,
+												  0x00, AWS_IOT_MQTT_TOPIC_ALIAS_MAX };
+				_fakeNetworkReply(pFake, connack, sizeof(connack));
+			} else {
+				const unsigned char connack[] = { 0x20, 0x02, 0x00, 0x00 };
+				_fakeNetworkReply(pFake, connack, sizeof(connack));
+			}
+			break;
+		case 3: /* PUBLISH */
+			pFake->stats.publishes++;
+			if(1 != ((type >> 1) & 3) || !pFake->isPubackEnabled) {
+				break;
+			}
+			topicLen = ((size_t) pPacket[0] << 8) | pPacket[1];
+			reply[0] = 0x40;
+			reply[1] = 0x02;
+			reply[2] = pPacket[2 + topicLen];
+			reply[3] = pPacket[3 + topicLen];
+			_fakeNetworkReply(pFake, reply, 4);
+			break;
+		case 8: /* SUBSCRIBE: every filter is granted the QoS it asked for */
+		case 10: /* UNSUBSCRIBE */
+			reply[0] = (8 == (type >> 4)) ? 0x90 : 0xB0;
+			reply[2] = pPacket[0];
+			reply[3] = pPacket[1];
+			replyLen = 4;
+			ptr = pPacket + 2;
+			if(MQTT_5 == pFake->mqttVersion) {
+				reply[replyLen++] = 0;	// no properties
+				ptr += 1 + *ptr;
+			}
+			while(ptr + 2 <= pEnd && replyLen < sizeof(reply)) {
+				topicLen = ((size_t) ptr[0] << 8) | ptr[1];
+				ptr += 2 + topicLen;
+				if(8 == (type >> 4)) {
+					reply[replyLen++] = *ptr++ & 3;
+				} else if(MQTT_5 == pFake->mqttVersion) {
+					reply[replyLen++] = 0;
+				}
+			}
+			reply[1] = (unsigned char) (replyLen - 2);
+			_fakeNetworkReply(pFake, reply, replyLen);
+			break;
+		case 12: /* PINGREQ */
+			reply[0] = 0xD0;
+			reply[1] = 0x00;
+			_fakeNetworkReply(pFake, reply, 2);
+			break;
+		default:
+			break;
+	}
+}
+
+static IoT_Error_t _fakeNetworkConnect(Network *pNetwork, TLSConnectParams *pParams) {
+	FakeNetwork *pFake;
+	IoT_Error_t rc = SUCCESS;
+
+	pthread_mutex_lock(&fakeNetworkMutex);
+	pFake = _fakeNetworkFind(pNetwork);
+	if(pFake->isBrokerUp) {
+		pFake->isConnected = true;
+		pFake->rxHead = pFake->rxTail = 0;
+		pFake->txLen = 0;
+		pFake->stats.connects++;
+	} else {
+		pFake->stats.connectsRefused++;
+		rc = NETWORK_ERR_NET_CONNECT_FAILED;
+	}
+	pthread_mutex_unlock(&fakeNetworkMutex);
+
+	return rc;
+}
+
+static IoT_Error_t _fakeNetworkRead(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer,
+									size_t *pReadLen) {
+	FakeNetwork *pFake;
+	IoT_Error_t rc;
+	size_t available;
+
+	pthread_mutex_lock(&fakeNetworkMutex);
+	pFake = _fakeNetworkFind(pNetwork);
+	available = pFake->rxTail - pFake->rxHead;
+	if(available > len) {
+		available = len;
+	}
+	memcpy(pMsg, pFake->rxBuf + pFake->rxHead, available);
+	pFake->rxHead += available;
+	*pReadLen = available;
+
+	if(!pFake->isConnected) {
+		rc = NETWORK_SSL_READ_ERROR;
+	} else if(available == len) {
+		rc = SUCCESS;
+	} else if(0 == available) {
+		rc = NETWORK_SSL_NOTHING_TO_READ;
+	} else {
+		rc = NETWORK_SSL_READ_TIMEOUT_ERROR;
+	}
+	pthread_mutex_unlock(&fakeNetworkMutex);
+
+	return rc;
+}
+
+static IoT_Error_t _fakeNetworkWrite(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer,
+									 size_t *pWrittenLen) {
+	FakeNetwork *pFake;
+	size_t chunkLen, packetLen, headerLen;
+
+	pthread_mutex_lock(&fakeNetworkMutex);
+	pFake = _fakeNetworkFind(pNetwork);
+	if(!pFake->isConnected) {
+		pthread_mutex_unlock(&fakeNetworkMutex);
+		*pWrittenLen = 0;
+		return NETWORK_SSL_WRITE_ERROR;
+	}
+
+	pFake->stats.txBytes += len;
+	*pWrittenLen = len;
+	while(0 < len) {
+		chunkLen = FAKE_NETWORK_BUF_LEN - pFake->txLen;
+		if(chunkLen > len) {
+			chunkLen = len;
+		}
+		memcpy(pFake->txBuf + pFake->txLen, pMsg, chunkLen);
+		pFake->txLen += chunkLen;
+		pMsg += chunkLen;
+		len -= chunkLen;
+
+		while(0 != (packetLen = _fakeNetworkPacketLen(pFake, &headerLen))) {
+			_fakeNetworkHandlePacket(pFake, pFake->txBuf[0], pFake->txBuf + headerLen, packetLen - headerLen);
+			memmove(pFake->txBuf, pFake->txBuf + packetLen, pFake->txLen - packetLen);
+			pFake->txLen -= packetLen;
+		}
+	}
+	pthread_mutex_unlock(&fakeNetworkMutex);
+
+	return SUCCESS;
+}
+
+static IoT_Error_t _fakeNetworkClose(Network *pNetwork) {
+	FakeNetwork *pFake;
+
+	pthread_mutex_lock(&fakeNetworkMutex);
+	pFake = _fakeNetworkFind(pNetwork);
+	pFake->isConnected = false;
+	pFake->rxHead = pFake->rxTail = 0;
+	pFake->txLen = 0;
+	pthread_mutex_unlock(&fakeNetworkMutex);
+
+	return SUCCESS;
+}
+
+/* Like the mbedTLS layer, whether the connection is alive only shows when it is used */
+static IoT_Error_t _fakeNetworkIsConnected(Network *pNetwork) {
+	return NETWORK_PHYSICAL_LAYER_CONNECTED;
+}
+
+static int _fakeNetworkGetSocketFd(Network *pNetwork) {
+	return -1;
+}
+
+static size_t _fakeNetworkGetBytesAvailable(Network *pNetwork) {
+	FakeNetwork *pFake;
+	size_t available;
+
+	pthread_mutex_lock(&fakeNetworkMutex);
+	pFake = _fakeNetworkFind(pNetwork);
+	available = pFake->rxTail - pFake->rxHead;
+	pthread_mutex_unlock(&fakeNetworkMutex);
+
+	return available;
+}
+
+static IoT_Error_t _fakeNetworkProbeReachability(Network *pNetwork) {
+	FakeNetwork *pFake;
+	bool isUp;
+
+	pthread_mutex_lock(&fakeNetworkMutex);
+	pFake = _fakeNetworkFind(pNetwork);
+	isUp = pFake->isBrokerUp;
+	pthread_mutex_unlock(&fakeNetworkMutex);
+
+	return isUp ? NETWORK_PHYSICAL_LAYER_CONNECTED : NETWORK_PHYSICAL_LAYER_DISCONNECTED;
+}
+
+IoT_Error_t fakeNetworkAttach(Network *pNetwork) {
+	FakeNetwork *pFake;
+	uint32_t itr;
+
+	pFake = calloc(1, sizeof(FakeNetwork));
+	if(NULL == pFake) {
+		return FAILURE;
+	}
+	pFake->pNetwork = pNetwork;
+	pFake->isBrokerUp = true;
+	pFake->isPubackEnabled = true;
+
+	pthread_mutex_lock(&fakeNetworkMutex);
+	for(itr = 0; itr < FAKE_NETWORK_MAX && NULL != fakeNetworks[itr]; itr++) {
+	}
+	if(FAKE_NETWORK_MAX == itr) {
+		pthread_mutex_unlock(&fakeNetworkMutex);
+		free(pFake);
+		return FAILURE;
+	}
+	fakeNetworks[itr] = pFake;
+	pthread_mutex_unlock(&fakeNetworkMutex);
+
+	pNetwork->connect = _fakeNetworkConnect;
+	pNetwork->read = _fakeNetworkRead;
+	pNetwork->write = _fakeNetworkWrite;
+	pNetwork->disconnect = _fakeNetworkClose;
+	pNetwork->isConnected = _fakeNetworkIsConnected;
+	pNetwork->destroy = _fakeNetworkClose;
+	pNetwork->getSocketFd = _fakeNetworkGetSocketFd;
+	pNetwork->getBytesAvailable = _fakeNetworkGetBytesAvailable;
+	pNetwork->probeReachability = _fakeNetworkProbeReachability;
+	pNetwork->getHandshakeStats = NULL;
+	pNetwork->connectStart = NULL;
+	pNetwork->connectContinue = NULL;
+
+	return SUCCESS;
+}
+
+void fakeNetworkDetach(Network *pNetwork) {
+	uint32_t itr;
+
+	pthread_mutex_lock(&fakeNetworkMutex);
+	for(itr = 0; itr < FAKE_NETWORK_MAX; itr++) {
+		if(NULL != fakeNetworks[itr] && pNetwork == fakeNetworks[itr]->pNetwork) {
+			if(pLastFakeNetwork == fakeNetworks[itr]) {
+				pLastFakeNetwork = NULL;
+			}
+			free(fakeNetworks[itr]);
+			fakeNetworks[itr] = NULL;
+		}
+	}
+	pthread_mutex_unlock(&fakeNetworkMutex);
+}
+
+void fakeNetworkPush(Network *pNetwork, const unsigned char *pData, size_t len) {
+	pthread_mutex_lock(&fakeNetworkMutex);
+	_fakeNetworkReply(_fakeNetworkFind(pNetwork), pData, len);
+	pthread_mutex_unlock(&fakeNetworkMutex);
+}
+
+void fakeNetworkSetBrokerUp(Network *pNetwork, bool isUp) {
+	FakeNetwork *pFake;
+
+	pthread_mutex_lock(&fakeNetworkMutex);
+	pFake = _fakeNetworkFind(pNetwork);
+	pFake->isBrokerUp = isUp;
+	if(!isUp) {
+		pFake->isConnected = false;
+	}
+	pthread_mutex_unlock(&fakeNetworkMutex);
+}
+
+void fakeNetworkSetPubackEnabled(Network *pNetwork, bool isEnabled) {
+	pthread_mutex_lock(&fakeNetworkMutex);
+	_fakeNetworkFind(pNetwork)->isPubackEnabled = isEnabled;
+	pthread_mutex_unlock(&fakeNetworkMutex);
+}
+
+void fakeNetworkGetStats(Network *pNetwork, FakeNetworkStats *pStats) {
+	pthread_mutex_lock(&fakeNetworkMutex);
+	*pStats = _fakeNetworkFind(pNetwork)->stats;
+	pthread_mutex_unlock(&fakeNetworkMutex);
+}
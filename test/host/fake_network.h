@@ -0,0 +1,57 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file fake_network.h
+ * @brief In-memory network layer with a minimal broker behind it
+ *
+ * Replaces the TLS layer of a client after aws_iot_mqtt_init. The broker answers CONNECT,
+ * SUBSCRIBE, UNSUBSCRIBE, QoS1 PUBLISH and PINGREQ right away, in the MQTT version the
+ * client connected with, and delivers what the test pushes. Reads never block, a read
+ * finding nothing returns NETWORK_SSL_NOTHING_TO_READ like an expired read timer does.
+ */
+
+#ifndef AWS_IOT_TEST_FAKE_NETWORK_H
+#define AWS_IOT_TEST_FAKE_NETWORK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdk/network_interface.h"
+
+/* Bytes buffered in each direction, a packet must fit */
+#define FAKE_NETWORK_BUF_LEN 4096
+
+typedef struct {
+	uint32_t connects;		///< Successful connects of the network layer
+	uint32_t connectsRefused;	///< Connects failed because the broker was down
+	uint32_t publishes;		///< PUBLISH packets written by the client
+	uint64_t txBytes;		///< Bytes written by the client
+} FakeNetworkStats;
+
+IoT_Error_t fakeNetworkAttach(Network *pNetwork);
+void fakeNetworkDetach(Network *pNetwork);
+
+/* Bytes the broker sends to the client */
+void fakeNetworkPush(Network *pNetwork, const unsigned char *pData, size_t len);
+
+/* A broker that is down refuses connects and drops the connection, PUBACKs can be held back */
+void fakeNetworkSetBrokerUp(Network *pNetwork, bool isUp);
+void fakeNetworkSetPubackEnabled(Network *pNetwork, bool isEnabled);
+
+void fakeNetworkGetStats(Network *pNetwork, FakeNetworkStats *pStats);
+
+#endif /* AWS_IOT_TEST_FAKE_NETWORK_H */
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dlog.h"
+
+int dlog_print(log_priority prio, const char *tag, const char *fmt, ...)
+{
+	static const char level[] = "UDVDIWEFS";
+	va_list args;
+	int ret;
+
+	if (!getenv("DLOG"))
+		return 0;
+
+	fprintf(stderr, "%c/%s: ", level[prio <= DLOG_SILENT ? prio : DLOG_UNKNOWN], tag);
+	va_start(args, fmt);
+	ret = vfprintf(stderr, fmt, args);
+	va_end(args);
+
+	return ret;
+}
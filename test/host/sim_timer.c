@@ -0,0 +1,75 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file sim_timer.c
+ * @brief Simulated clock behind the timer interface
+ */
+
+#include <stdbool.h>
+
+#include "sdk/timer_platform.h"
+#include "sim_timer.h"
+
+static uint64_t simNowMs;
+
+static uint64_t _simTimerRead(void) {
+	return simNowMs++;
+}
+
+void simTimerSetMs(uint64_t nowMs) {
+	simNowMs = nowMs;
+}
+
+uint64_t simTimerGetMs(void) {
+	return simNowMs;
+}
+
+bool has_timer_expired(Timer *timer) {
+	return _simTimerRead() >= timer->end_ms;
+}
+
+void countdown_ms(Timer *timer, uint32_t timeout) {
+	timer->end_ms = _simTimerRead() + timeout;
+}
+
+void countdown_sec(Timer *timer, uint32_t timeout) {
+	timer->end_ms = _simTimerRead() + (uint64_t) timeout * 1000;
+}
+
+uint32_t left_ms(Timer *timer) {
+	uint64_t now = _simTimerRead();
+
+	if(timer->end_ms <= now) {
+		return 0;
+	}
+	return (timer->end_ms - now > UINT32_MAX) ? UINT32_MAX : (uint32_t) (timer->end_ms - now);
+}
+
+void init_timer(Timer *timer) {
+	timer->end_ms = 0;
+}
+
+uint32_t get_time_ms(void) {
+	return (uint32_t) _simTimerRead();
+}
+
+uint32_t get_coarse_time_ms(void) {
+	return (uint32_t) _simTimerRead();
+}
+
+void sleep_ms(uint32_t timeout) {
+	simNowMs += timeout;
+}
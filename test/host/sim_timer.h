@@ -0,0 +1,34 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file sim_timer.h
+ * @brief Simulated clock behind the timer interface
+ *
+ * Linked instead of the Linux timer, so that many clients can run through minutes of
+ * back-off in one process. The clock only moves when it is read, by one ms per read, so
+ * a yield loop waiting for its timer still gets there. A benchmark stepping clients in
+ * turn sets the clock back to the start of the step before each one.
+ */
+
+#ifndef AWS_IOT_TEST_SIM_TIMER_H
+#define AWS_IOT_TEST_SIM_TIMER_H
+
+#include <stdint.h>
+
+void simTimerSetMs(uint64_t nowMs);
+uint64_t simTimerGetMs(void);
+
+#endif /* AWS_IOT_TEST_SIM_TIMER_H */
@@ -0,0 +1,414 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file test_cbor.c
+ * @brief CBOR documents of jsonStruct_t values
+ *
+ * Encodings are checked against the examples of RFC 8949 appendix A.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "sdk/aws_iot_shadow_cbor.h"
+
+#include "unit_test.h"
+
+static uint32_t testCallbackCount;
+static uint32_t testCallbackLength;
+static unsigned char testCallbackItem[64];
+
+static void testCallback(const char *pJsonValueBuffer, uint32_t valueLength, jsonStruct_t *pJsonStruct_t) {
+	testCallbackCount++;
+	testCallbackLength = valueLength;
+	memcpy(testCallbackItem, pJsonValueBuffer, (valueLength < sizeof(testCallbackItem)) ?
+		   valueLength : sizeof(testCallbackItem));
+}
+
+static void testInitStruct(jsonStruct_t *pStruct, const char *pKey, void *pData, size_t dataLength,
+						   JsonPrimitiveType type) {
+	pStruct->pKey = pKey;
+	pStruct->pData = pData;
+	pStruct->dataLength = dataLength;
+	pStruct->type = type;
+	pStruct->cb = testCallback;
+}
+
+/* Encodes {"a": value} and compares the value with the expected item */
+static bool testEncodesTo(jsonStruct_t *pStruct, const unsigned char *pExpected, size_t expectedLen) {
+	unsigned char buf[64];
+	size_t len;
+
+	pStruct->pKey = "a";
+	if(SUCCESS != aws_iot_cbor_encode_document(buf, sizeof(buf), &len, 1, pStruct)) {
+		return false;
+	}
+	return len == 3 + expectedLen && 0xA1 == buf[0] && 0x61 == buf[1] && 'a' == buf[2] &&
+		   0 == memcmp(buf + 3, pExpected, expectedLen);
+}
+
+/* Decodes {"v": item} into pStruct */
+static IoT_Error_t testDecodeItem(const unsigned char *pItem, size_t itemLen, jsonStruct_t *pStruct) {
+	unsigned char buf[64];
+
+	buf[0] = 0xA1;
+	buf[1] = 0x61;
+	buf[2] = 'v';
+	memcpy(buf + 3, pItem, itemLen);
+	pStruct->pKey = "v";
+	return aws_iot_cbor_decode_document(buf, 3 + itemLen, 1, pStruct);
+}
+
+static void testEncodeVectors(void) {
+	static const unsigned char one[] = { 0x01 };
+	static const unsigned char twentyFour[] = { 0x18, 0x18 };
+	static const unsigned char thousand[] = { 0x19, 0x03, 0xE8 };
+	static const unsigned char million[] = { 0x1A, 0x00, 0x0F, 0x42, 0x40 };
+	static const unsigned char minusOne[] = { 0x20 };
+	static const unsigned char minusHundred[] = { 0x38, 0x63 };
+	static const unsigned char minusThousand[] = { 0x39, 0x03, 0xE7 };
+	static const unsigned char floatHundredThousand[] = { 0xFA, 0x47, 0xC3, 0x50, 0x00 };
+	static const unsigned char doubleOnePointOne[] = { 0xFB, 0x3F, 0xF1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A };
+	static const unsigned char doubleAsFloat[] = { 0xFA, 0x3F, 0xC0, 0x00, 0x00 };
+	static const unsigned char isTrue[] = { 0xF5 };
+	static const unsigned char isFalse[] = { 0xF4 };
+	static const unsigned char ietf[] = { 0x64, 'I', 'E', 'T', 'F' };
+	static const unsigned char emptyText[] = { 0x60 };
+	jsonStruct_t s;
+	int32_t i32;
+	int16_t i16;
+	int8_t i8;
+	uint32_t u32;
+	uint8_t u8;
+	float f;
+	double d;
+	bool b;
+	char text[8];
+
+	testInitStruct(&s, "a", &i32, sizeof(i32), SHADOW_JSON_INT32);
+	i32 = 1;
+	UT_ASSERT(testEncodesTo(&s, one, sizeof(one)));
+	i32 = 1000000;
+	UT_ASSERT(testEncodesTo(&s, million, sizeof(million)));
+	i32 = -1;
+	UT_ASSERT(testEncodesTo(&s, minusOne, sizeof(minusOne)));
+	testInitStruct(&s, "a", &i16, sizeof(i16), SHADOW_JSON_INT16);
+	i16 = -1000;
+	UT_ASSERT(testEncodesTo(&s, minusThousand, sizeof(minusThousand)));
+	testInitStruct(&s, "a", &i8, sizeof(i8), SHADOW_JSON_INT8);
+	i8 = -100;
+	UT_ASSERT(testEncodesTo(&s, minusHundred, sizeof(minusHundred)));
+	testInitStruct(&s, "a", &u32, sizeof(u32), SHADOW_JSON_UINT32);
+	u32 = 1000;
+	UT_ASSERT(testEncodesTo(&s, thousand, sizeof(thousand)));
+	testInitStruct(&s, "a", &u8, sizeof(u8), SHADOW_JSON_UINT8);
+	u8 = 24;
+	UT_ASSERT(testEncodesTo(&s, twentyFour, sizeof(twentyFour)));
+
+	testInitStruct(&s, "a", &f, sizeof(f), SHADOW_JSON_FLOAT);
+	f = 100000.0f;
+	UT_ASSERT(testEncodesTo(&s, floatHundredThousand, sizeof(floatHundredThousand)));
+	testInitStruct(&s, "a", &d, sizeof(d), SHADOW_JSON_DOUBLE);
+	d = 1.1;
+	UT_ASSERT(testEncodesTo(&s, doubleOnePointOne, sizeof(doubleOnePointOne)));
+	d = 1.5;
+	UT_ASSERT(testEncodesTo(&s, doubleAsFloat, sizeof(doubleAsFloat)));
+
+	testInitStruct(&s, "a", &b, sizeof(b), SHADOW_JSON_BOOL);
+	b = true;
+	UT_ASSERT(testEncodesTo(&s, isTrue, sizeof(isTrue)));
+	b = false;
+	UT_ASSERT(testEncodesTo(&s, isFalse, sizeof(isFalse)));
+
+	testInitStruct(&s, "a", text, sizeof(text), SHADOW_JSON_STRING);
+	strcpy(text, "IETF");
+	UT_ASSERT(testEncodesTo(&s, ietf, sizeof(ietf)));
+	text[0] = '\0';
+	UT_ASSERT(testEncodesTo(&s, emptyText, sizeof(emptyText)));
+}
+
+static void testDecodeVectors(void) {
+	static const struct {
+		unsigned char item[9];
+		size_t len;
+		double value;
+	} numbers[] = {
+		{ { 0x00 }, 1, 0.0 },
+		{ { 0x17 }, 1, 23.0 },
+		{ { 0x18, 0x64 }, 2, 100.0 },
+		{ { 0x1A, 0x00, 0x0F, 0x42, 0x40 }, 5, 1000000.0 },
+		{ { 0x1B, 0x00, 0x00, 0x00, 0xE8, 0xD4, 0xA5, 0x10, 0x00 }, 9, 1000000000000.0 },
+		{ { 0x29 }, 1, -10.0 },
+		{ { 0x39, 0x03, 0xE7 }, 3, -1000.0 },
+		{ { 0xF9, 0x3C, 0x00 }, 3, 1.0 },
+		{ { 0xF9, 0x3E, 0x00 }, 3, 1.5 },
+		{ { 0xF9, 0x7B, 0xFF }, 3, 65504.0 },
+		{ { 0xF9, 0x00, 0x01 }, 3, 5.960464477539063e-8 },
+		{ { 0xF9, 0x04, 0x00 }, 3, 0.00006103515625 },
+		{ { 0xF9, 0xC4, 0x00 }, 3, -4.0 },
+		{ { 0xFA, 0x47, 0xC3, 0x50, 0x00 }, 5, 100000.0 },
+		{ { 0xFA, 0x7F, 0x7F, 0xFF, 0xFF }, 5, 3.4028234663852886e+38 },
+		{ { 0xFB, 0x3F, 0xF1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A }, 9, 1.1 },
+		{ { 0xFB, 0xC0, 0x10, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66 }, 9, -4.1 },
+	};
+	static const unsigned char halfInfinity[] = { 0xF9, 0x7C, 0x00 };
+	static const unsigned char halfNegativeZero[] = { 0xF9, 0x80, 0x00 };
+	static const unsigned char ietf[] = { 0x64, 'I', 'E', 'T', 'F' };
+	static const unsigned char isTrue[] = { 0xF5 };
+	static const unsigned char example[] = { 0xA1, 0x61, 0x61, 0x01 };
+	jsonStruct_t s;
+	double d;
+	int32_t i32;
+	bool b;
+	char text[8];
+	uint32_t itr;
+
+	testInitStruct(&s, "v", &d, sizeof(d), SHADOW_JSON_DOUBLE);
+	for(itr = 0; itr < sizeof(numbers) / sizeof(numbers[0]); itr++) {
+		d = 42.0;
+		UT_ASSERT(SUCCESS == testDecodeItem(numbers[itr].item, numbers[itr].len, &s));
+		UT_ASSERT(numbers[itr].value == d);
+	}
+	UT_ASSERT(SUCCESS == testDecodeItem(halfInfinity, sizeof(halfInfinity), &s));
+	UT_ASSERT(isinf(d) && d > 0);
+	UT_ASSERT(SUCCESS == testDecodeItem(halfNegativeZero, sizeof(halfNegativeZero), &s));
+	UT_ASSERT(0.0 == d && signbit(d));
+
+	testInitStruct(&s, "v", text, sizeof(text), SHADOW_JSON_STRING);
+	UT_ASSERT(SUCCESS == testDecodeItem(ietf, sizeof(ietf), &s));
+	UT_ASSERT(0 == strcmp("IETF", text));
+	testInitStruct(&s, "v", &b, sizeof(b), SHADOW_JSON_BOOL);
+	b = false;
+	UT_ASSERT(SUCCESS == testDecodeItem(isTrue, sizeof(isTrue), &s));
+	UT_ASSERT(b);
+
+	testInitStruct(&s, "a", &i32, sizeof(i32), SHADOW_JSON_INT32);
+	i32 = 0;
+	UT_ASSERT(SUCCESS == aws_iot_cbor_decode_document(example, sizeof(example), 1, &s));
+	UT_ASSERT(1 == i32);
+}
+
+static void testRoundTrip(void) {
+	unsigned char buf[256], nested[32];
+	size_t len, nestedLen;
+	int32_t i32 = INT32_MIN, i32Out = 0;
+	int16_t i16 = INT16_MAX, i16Out = 0;
+	int8_t i8 = INT8_MIN, i8Out = 0;
+	uint32_t u32 = UINT32_MAX, u32Out = 0;
+	uint16_t u16 = 300, u16Out = 0;
+	uint8_t u8 = UINT8_MAX, u8Out = 0;
+	float f = -0.1f, fOut = 0;
+	double d = 3.141592653589793, dOut = 0, d2 = 0.25, d2Out = 0;
+	bool b = true, bOut = false;
+	char text[] = "door-control", textOut[16] = "";
+	uint16_t inner = 7;
+	jsonStruct_t s[12], out[12], innerStruct;
+
+	testInitStruct(&innerStruct, "inner", &inner, sizeof(inner), SHADOW_JSON_UINT16);
+	UT_ASSERT(SUCCESS == aws_iot_cbor_encode_document(nested, sizeof(nested), &nestedLen, 1, &innerStruct));
+
+	testInitStruct(&s[0], "i32", &i32, sizeof(i32), SHADOW_JSON_INT32);
+	testInitStruct(&s[1], "i16", &i16, sizeof(i16), SHADOW_JSON_INT16);
+	testInitStruct(&s[2], "i8", &i8, sizeof(i8), SHADOW_JSON_INT8);
+	testInitStruct(&s[3], "u32", &u32, sizeof(u32), SHADOW_JSON_UINT32);
+	testInitStruct(&s[4], "u16", &u16, sizeof(u16), SHADOW_JSON_UINT16);
+	testInitStruct(&s[5], "u8", &u8, sizeof(u8), SHADOW_JSON_UINT8);
+	testInitStruct(&s[6], "f", &f, sizeof(f), SHADOW_JSON_FLOAT);
+	testInitStruct(&s[7], "d", &d, sizeof(d), SHADOW_JSON_DOUBLE);
+	testInitStruct(&s[8], "d2", &d2, sizeof(d2), SHADOW_JSON_DOUBLE);
+	testInitStruct(&s[9], "b", &b, sizeof(b), SHADOW_JSON_BOOL);
+	testInitStruct(&s[10], "text", text, sizeof(text), SHADOW_JSON_STRING);
+	testInitStruct(&s[11], "obj", nested, nestedLen, SHADOW_JSON_OBJECT);
+	UT_ASSERT(SUCCESS == aws_iot_cbor_encode_document(buf, sizeof(buf), &len, 12, &s[0], &s[1], &s[2], &s[3], &s[4],
+													  &s[5], &s[6], &s[7], &s[8], &s[9], &s[10], &s[11]));
+
+	memcpy(out, s, sizeof(out));
+	out[0].pData = &i32Out;
+	out[1].pData = &i16Out;
+	out[2].pData = &i8Out;
+	out[3].pData = &u32Out;
+	out[4].pData = &u16Out;
+	out[5].pData = &u8Out;
+	out[6].pData = &fOut;
+	out[7].pData = &dOut;
+	out[8].pData = &d2Out;
+	out[9].pData = &bOut;
+	out[10].pData = textOut;
+	out[10].dataLength = sizeof(textOut);
+	testCallbackCount = 0;
+	/* Arguments in another order than the document */
+	UT_ASSERT(SUCCESS == aws_iot_cbor_decode_document(buf, len, 12, &out[11], &out[10], &out[9], &out[8], &out[7],
+													  &out[6], &out[5], &out[4], &out[3], &out[2], &out[1], &out[0]));
+	UT_ASSERT(12 == testCallbackCount);
+	UT_ASSERT(i32 == i32Out && i16 == i16Out && i8 == i8Out);
+	UT_ASSERT(u32 == u32Out && u16 == u16Out && u8 == u8Out);
+	UT_ASSERT(f == fOut && d == dOut && d2 == d2Out && b == bOut);
+	UT_ASSERT(0 == strcmp(text, textOut));
+
+	/* The object callback comes last in the document, it gets the nested document as it was written */
+	UT_ASSERT(nestedLen == testCallbackLength && 0 == memcmp(nested, testCallbackItem, nestedLen));
+	inner = 0;
+	UT_ASSERT(SUCCESS == aws_iot_cbor_decode_document(testCallbackItem, testCallbackLength, 1, &innerStruct));
+	UT_ASSERT(7 == inner);
+}
+
+static void testEncodeTruncated(void) {
+	unsigned char buf[64];
+	size_t len, size;
+	int32_t value = 1000000;
+	char text[] = "IETF";
+	jsonStruct_t s[2];
+
+	testInitStruct(&s[0], "number", &value, sizeof(value), SHADOW_JSON_INT32);
+	testInitStruct(&s[1], "text", text, sizeof(text), SHADOW_JSON_STRING);
+	UT_ASSERT(SUCCESS == aws_iot_cbor_encode_document(buf, sizeof(buf), &len, 2, &s[0], &s[1]));
+	for(size = 0; size < len; size++) {
+		UT_ASSERT(SHADOW_JSON_BUFFER_TRUNCATED == aws_iot_cbor_encode_document(buf, size, &len, 2, &s[0], &s[1]));
+	}
+	s[1].pData = NULL;
+	UT_ASSERT(NULL_VALUE_ERROR == aws_iot_cbor_encode_document(buf, sizeof(buf), &len, 2, &s[0], &s[1]));
+}
+
+static void testDecodeRejected(void) {
+	static const struct {
+		unsigned char doc[12];
+		size_t len;
+	} rejected[] = {
+		{ { 0 }, 0 },	/* empty */
+		{ { 0xBF, 0x61, 'a', 0x01, 0xFF }, 5 },	/* indefinite length map */
+		{ { 0xA1, 0x61, 'a', 0x5F, 0x41, 0x00, 0xFF }, 7 },	/* indefinite length byte string */
+		{ { 0xA1, 0x61, 'a', 0x1C }, 4 },	/* reserved additional information */
+		{ { 0xA1, 0x61, 'a', 0x01, 0x00 }, 5 },	/* trailing bytes */
+		{ { 0x82, 0x01, 0x02 }, 3 },	/* array at the top level */
+		{ { 0x01 }, 1 },	/* integer at the top level */
+		{ { 0xBB, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, 9 },	/* more pairs than bytes */
+		{ { 0xA1, 0x61, 'a', 0x9B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, 12 },	/* huge array */
+		{ { 0xA1, 0x61, 'a', 0x7A, 0xFF, 0xFF, 0xFF, 0xFF }, 8 },	/* text past the end */
+	};
+	unsigned char doc[64], deep[64];
+	size_t len, itr, prefixLen;
+	int32_t value = 5;
+	jsonStruct_t s;
+
+	testInitStruct(&s, "a", &value, sizeof(value), SHADOW_JSON_INT32);
+	for(itr = 0; itr < sizeof(rejected) / sizeof(rejected[0]); itr++) {
+		UT_ASSERT(JSON_PARSE_ERROR == aws_iot_cbor_decode_document(rejected[itr].doc, rejected[itr].len, 1, &s));
+	}
+	UT_ASSERT(NULL_VALUE_ERROR == aws_iot_cbor_decode_document(NULL, 0, 1, &s));
+
+	/* Every strict prefix of a document is refused */
+	value = -1000;
+	UT_ASSERT(SUCCESS == aws_iot_cbor_encode_document(doc, sizeof(doc), &len, 1, &s));
+	for(prefixLen = 0; prefixLen < len; prefixLen++) {
+		UT_ASSERT(JSON_PARSE_ERROR == aws_iot_cbor_decode_document(doc, prefixLen, 1, &s));
+	}
+
+	/* Nesting: the top level map holds arrays nested 15 deep, one more is refused */
+	deep[0] = 0xA1;
+	deep[1] = 0x61;
+	deep[2] = 'x';
+	for(itr = 0; itr < 16; itr++) {
+		deep[3 + itr] = 0x81;
+	}
+	deep[3 + 15] = 0x00;
+	UT_ASSERT(SUCCESS == aws_iot_cbor_decode_document(deep, 3 + 15 + 1, 1, &s));
+	deep[3 + 15] = 0x81;
+	deep[3 + 16] = 0x00;
+	UT_ASSERT(JSON_PARSE_ERROR == aws_iot_cbor_decode_document(deep, 3 + 16 + 1, 1, &s));
+	UT_ASSERT(-1000 == value);
+}
+
+/* Values out of range or of another type leave the data and skip the callback */
+static void testDecodeMismatch(void) {
+	static const unsigned char int8Overflow[] = { 0x18, 0x80 };
+	static const unsigned char int8Min[] = { 0x38, 0x7F };
+	static const unsigned char int8Underflow[] = { 0x38, 0x80 };
+	static const unsigned char minusOne[] = { 0x20 };
+	static const unsigned char uint16Overflow[] = { 0x1A, 0x00, 0x01, 0x00, 0x00 };
+	static const unsigned char int32Overflow[] = { 0x1A, 0x80, 0x00, 0x00, 0x00 };
+	static const unsigned char one[] = { 0x01 };
+	static const unsigned char ietf[] = { 0x64, 'I', 'E', 'T', 'F' };
+	static const unsigned char null[] = { 0xF6 };
+	static const unsigned char floatItem[] = { 0xFA, 0x47, 0xC3, 0x50, 0x00 };
+	jsonStruct_t s;
+	int8_t i8 = 3;
+	uint8_t u8 = 3;
+	uint16_t u16 = 3;
+	int32_t i32 = 3;
+	bool b = false;
+	float f = 3.0f;
+	char text[4] = "abc";
+
+	testCallbackCount = 0;
+	testInitStruct(&s, "v", &i8, sizeof(i8), SHADOW_JSON_INT8);
+	UT_ASSERT(SUCCESS == testDecodeItem(int8Overflow, sizeof(int8Overflow), &s) && 3 == i8);
+	UT_ASSERT(SUCCESS == testDecodeItem(int8Underflow, sizeof(int8Underflow), &s) && 3 == i8);
+	UT_ASSERT(SUCCESS == testDecodeItem(floatItem, sizeof(floatItem), &s) && 3 == i8);
+	UT_ASSERT(0 == testCallbackCount);
+	UT_ASSERT(SUCCESS == testDecodeItem(int8Min, sizeof(int8Min), &s) && INT8_MIN == i8);
+	UT_ASSERT(1 == testCallbackCount && 2 == testCallbackLength && 0 == memcmp(int8Min, testCallbackItem, 2));
+
+	testCallbackCount = 0;
+	testInitStruct(&s, "v", &u8, sizeof(u8), SHADOW_JSON_UINT8);
+	UT_ASSERT(SUCCESS == testDecodeItem(minusOne, sizeof(minusOne), &s) && 3 == u8);
+	testInitStruct(&s, "v", &u16, sizeof(u16), SHADOW_JSON_UINT16);
+	UT_ASSERT(SUCCESS == testDecodeItem(uint16Overflow, sizeof(uint16Overflow), &s) && 3 == u16);
+	testInitStruct(&s, "v", &i32, sizeof(i32), SHADOW_JSON_INT32);
+	UT_ASSERT(SUCCESS == testDecodeItem(int32Overflow, sizeof(int32Overflow), &s) && 3 == i32);
+	UT_ASSERT(SUCCESS == testDecodeItem(ietf, sizeof(ietf), &s) && 3 == i32);
+	/* A buffer smaller than the type is not written */
+	s.dataLength = sizeof(int16_t);
+	UT_ASSERT(SUCCESS == testDecodeItem(one, sizeof(one), &s) && 3 == i32);
+	testInitStruct(&s, "v", &b, sizeof(b), SHADOW_JSON_BOOL);
+	UT_ASSERT(SUCCESS == testDecodeItem(one, sizeof(one), &s) && !b);
+	UT_ASSERT(SUCCESS == testDecodeItem(null, sizeof(null), &s) && !b);
+	testInitStruct(&s, "v", &f, sizeof(f), SHADOW_JSON_FLOAT);
+	UT_ASSERT(SUCCESS == testDecodeItem(null, sizeof(null), &s) && 3.0f == f);
+	/* The text and its terminator need to fit */
+	testInitStruct(&s, "v", text, sizeof(text), SHADOW_JSON_STRING);
+	UT_ASSERT(SUCCESS == testDecodeItem(ietf, sizeof(ietf), &s) && 0 == strcmp("abc", text));
+	UT_ASSERT(SUCCESS == testDecodeItem(one, sizeof(one), &s) && 0 == strcmp("abc", text));
+	UT_ASSERT(0 == testCallbackCount);
+}
+
+/* Keys that are not text or not registered are skipped, values of any shape in between */
+static void testDecodeSkipsOtherKeys(void) {
+	static const unsigned char doc[] = {
+		0xA4,
+		0x01, 0x02,	/* integer key */
+		0x62, 'v', 'v', 0x82, 0xA1, 0x61, 'v', 0x05, 0x40,	/* "vv": [{"v": 5}, h''] */
+		0x61, 'v', 0xC1, 0x18, 0x2A,	/* "v": 1(42) is tagged, not an integer */
+		0x61, 'w', 0x18, 0x2A,	/* "w": 42 */
+	};
+	jsonStruct_t v, w;
+	int32_t vValue = 3, wValue = 3;
+
+	testInitStruct(&v, "v", &vValue, sizeof(vValue), SHADOW_JSON_INT32);
+	testInitStruct(&w, "w", &wValue, sizeof(wValue), SHADOW_JSON_INT32);
+	UT_ASSERT(SUCCESS == aws_iot_cbor_decode_document(doc, sizeof(doc), 2, &v, &w));
+	UT_ASSERT(3 == vValue && 42 == wValue);
+}
+
+int main(void) {
+	UT_RUN(testEncodeVectors);
+	UT_RUN(testDecodeVectors);
+	UT_RUN(testRoundTrip);
+	UT_RUN(testEncodeTruncated);
+	UT_RUN(testDecodeRejected);
+	UT_RUN(testDecodeMismatch);
+	UT_RUN(testDecodeSkipsOtherKeys);
+	return UT_REPORT();
+}
@@ -0,0 +1,277 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file test_compress.c
+ * @brief LZ4 payload codec: round trips and malformed input
+ */
+
+#include <string.h>
+
+#include "sdk/aws_iot_mqtt_client_compress.h"
+
+#include "unit_test.h"
+
+#define TEST_BUF_LEN 4096
+#define TEST_CANARY_LEN 64
+#define TEST_CANARY 0xA5
+
+typedef struct {
+	unsigned char before[TEST_CANARY_LEN];
+	unsigned char data[TEST_BUF_LEN];
+	unsigned char after[TEST_CANARY_LEN];
+} TestGuardedBuf;
+
+static const char testShadowUpdate[] =
+	"{\"state\":{\"reported\":{\"door\":\"closed\",\"lock\":\"locked\"}},\"clientToken\":\"door-1-17\"}";
+static const char testShadowDocument[] =
+	"{\"state\":{\"desired\":{\"door\":\"open\",\"lock\":\"unlocked\"},\"reported\":{\"door\":\"closed\","
+	"\"lock\":\"locked\",\"battery\":87}},\"metadata\":{\"desired\":{\"door\":{\"timestamp\":1539043200}}},"
+	"\"version\":42,\"timestamp\":1539043260}";
+static const char testJobExecution[] =
+	"{\"execution\":{\"jobId\":\"update-0042\",\"status\":\"QUEUED\",\"queuedAt\":1539043200,"
+	"\"lastUpdatedAt\":1539043200,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":"
+	"{\"operation\":\"firmware\",\"url\":\"https://example.com/fw/door-control-1.2.3.tpk\"}}}";
+
+static uint32_t testRandomState;
+
+/* Deterministic, so a failure can be replayed */
+static uint32_t testRandom(void) {
+	testRandomState ^= testRandomState << 13;
+	testRandomState ^= testRandomState >> 17;
+	testRandomState ^= testRandomState << 5;
+	return testRandomState;
+}
+
+static void testGuardInit(TestGuardedBuf *pBuf) {
+	memset(pBuf, TEST_CANARY, sizeof(TestGuardedBuf));
+}
+
+static bool testGuardIntact(const TestGuardedBuf *pBuf, size_t usedLen) {
+	size_t itr;
+
+	for(itr = 0; itr < TEST_CANARY_LEN; itr++) {
+		if(TEST_CANARY != pBuf->before[itr] || TEST_CANARY != pBuf->after[itr]) {
+			return false;
+		}
+	}
+	for(itr = usedLen; itr < TEST_BUF_LEN; itr++) {
+		if(TEST_CANARY != pBuf->data[itr]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Compresses, checks the output stays in bounds, decompresses and compares */
+static bool testRoundTrip(const unsigned char *pIn, size_t inLen, size_t *pCompressedLen) {
+	static TestGuardedBuf compressed, decompressed;
+	size_t compressedLen, outLen;
+
+	testGuardInit(&compressed);
+	testGuardInit(&decompressed);
+	if(SUCCESS != aws_iot_mqtt_compress_payload(pIn, inLen, compressed.data, TEST_BUF_LEN, &compressedLen) ||
+	   !testGuardIntact(&compressed, compressedLen) ||
+	   !aws_iot_mqtt_is_payload_compressed(compressed.data, compressedLen)) {
+		return false;
+	}
+	/* An output buffer of exactly the original length is enough */
+	if(SUCCESS != aws_iot_mqtt_decompress_payload(compressed.data, compressedLen, decompressed.data, inLen, &outLen) ||
+	   outLen != inLen || 0 != memcmp(pIn, decompressed.data, inLen) || !testGuardIntact(&decompressed, inLen)) {
+		return false;
+	}
+	if(NULL != pCompressedLen) {
+		*pCompressedLen = compressedLen;
+	}
+	return true;
+}
+
+static void testRoundTripJson(void) {
+	size_t compressedLen;
+
+	UT_ASSERT(testRoundTrip((const unsigned char *) testShadowUpdate, sizeof(testShadowUpdate) - 1, &compressedLen));
+	UT_ASSERT(compressedLen < (sizeof(testShadowUpdate) - 1) / 2);
+	UT_ASSERT(testRoundTrip((const unsigned char *) testShadowDocument, sizeof(testShadowDocument) - 1,
+							&compressedLen));
+	UT_ASSERT(compressedLen < sizeof(testShadowDocument) - 1);
+	UT_ASSERT(testRoundTrip((const unsigned char *) testJobExecution, sizeof(testJobExecution) - 1, &compressedLen));
+	UT_ASSERT(compressedLen < sizeof(testJobExecution) - 1);
+}
+
+static void testRoundTripEdgeCases(void) {
+	static unsigned char buf[3000];
+	size_t len, compressedLen;
+
+	UT_ASSERT(testRoundTrip(buf, 0, NULL));
+	for(len = 1; len <= 20; len++) {
+		memset(buf, 'x', len);
+		UT_ASSERT(testRoundTrip(buf, len, NULL));
+	}
+
+	/* Long matches and overlapping copies need length continuation bytes */
+	memset(buf, 'a', sizeof(buf));
+	UT_ASSERT(testRoundTrip(buf, sizeof(buf), &compressedLen));
+	UT_ASSERT(compressedLen < 32);
+	for(len = 0; len < sizeof(buf); len++) {
+		buf[len] = "abc"[len % 3];
+	}
+	UT_ASSERT(testRoundTrip(buf, sizeof(buf), NULL));
+
+	/* Incompressible data is all literals, longer than one continuation byte */
+	testRandomState = 2463534242U;
+	for(len = 0; len < sizeof(buf); len++) {
+		buf[len] = (unsigned char) testRandom();
+	}
+	UT_ASSERT(testRoundTrip(buf, sizeof(buf), &compressedLen));
+	UT_ASSERT(compressedLen <= sizeof(buf) + AWS_IOT_MQTT_CODEC_HEADER_MAX_LEN + sizeof(buf) / 255 + 1);
+
+	/* Dictionary words and binary mixed */
+	for(len = 0; len < 1000; len++) {
+		buf[len] = (len % 100 < 50) ? (unsigned char) testShadowDocument[len % 100] : (unsigned char) testRandom();
+	}
+	UT_ASSERT(testRoundTrip(buf, 1000, NULL));
+}
+
+static void testCompressBounds(void) {
+	static TestGuardedBuf compressed;
+	static unsigned char big[65536];
+	size_t compressedLen, outSize;
+
+	UT_ASSERT(SUCCESS == aws_iot_mqtt_compress_payload((const unsigned char *) testShadowDocument,
+													   sizeof(testShadowDocument) - 1, compressed.data, TEST_BUF_LEN,
+													   &compressedLen));
+	/* Every output buffer too small is refused without writing past it */
+	for(outSize = 0; outSize < compressedLen; outSize++) {
+		testGuardInit(&compressed);
+		UT_ASSERT(FAILURE == aws_iot_mqtt_compress_payload((const unsigned char *) testShadowDocument,
+														   sizeof(testShadowDocument) - 1, compressed.data, outSize,
+														   &compressedLen));
+		UT_ASSERT(testGuardIntact(&compressed, outSize));
+	}
+
+	UT_ASSERT(MAX_SIZE_ERROR == aws_iot_mqtt_compress_payload(big, sizeof(big), compressed.data, TEST_BUF_LEN,
+															  &compressedLen));
+	UT_ASSERT(NULL_VALUE_ERROR == aws_iot_mqtt_compress_payload(NULL, 0, compressed.data, TEST_BUF_LEN,
+																&compressedLen));
+}
+
+static void testDecompressTooShort(void) {
+	unsigned char compressed[TEST_BUF_LEN], out[TEST_BUF_LEN];
+	size_t compressedLen, outLen;
+
+	UT_ASSERT(SUCCESS == aws_iot_mqtt_compress_payload((const unsigned char *) testShadowUpdate,
+													   sizeof(testShadowUpdate) - 1, compressed, sizeof(compressed),
+													   &compressedLen));
+	UT_ASSERT(MQTT_RX_BUFFER_TOO_SHORT_ERROR == aws_iot_mqtt_decompress_payload(compressed, compressedLen, out,
+																				 sizeof(testShadowUpdate) - 2,
+																				 &outLen));
+}
+
+/* Every strict prefix of a valid payload is refused */
+static void testDecompressPrefixes(void) {
+	static TestGuardedBuf out;
+	unsigned char compressed[TEST_BUF_LEN];
+	size_t compressedLen, prefixLen, outLen;
+
+	UT_ASSERT(SUCCESS == aws_iot_mqtt_compress_payload((const unsigned char *) testJobExecution,
+													   sizeof(testJobExecution) - 1, compressed, sizeof(compressed),
+													   &compressedLen));
+	for(prefixLen = 0; prefixLen < compressedLen; prefixLen++) {
+		testGuardInit(&out);
+		UT_ASSERT(SUCCESS != aws_iot_mqtt_decompress_payload(compressed, prefixLen, out.data, TEST_BUF_LEN, &outLen));
+		UT_ASSERT(testGuardIntact(&out, sizeof(testJobExecution) - 1));
+	}
+}
+
+static void testDecompressMalformed(void) {
+	static const struct {
+		unsigned char data[16];
+		size_t len;
+	} malformed[] = {
+		{ { '{', '}' }, 2 },	/* not compressed */
+		{ { 0xC1 }, 1 },	/* no length */
+		{ { 0xC1, 0x80, 0x80, 0x80, 0x80, 0x01 }, 6 },	/* length longer than four bytes */
+		{ { 0xC1, 0x03, 0x30, 'a', 'b' }, 5 },	/* literals past the end */
+		{ { 0xC1, 0x03, 0x20, 'a', 'b' }, 5 },	/* ends short of the original length */
+		{ { 0xC1, 0x02, 0x30, 'a', 'b', 'c' }, 6 },	/* more literals than the original length */
+		{ { 0xC1, 0x06, 0x10, 'a', 0x00, 0x00 }, 6 },	/* offset 0 */
+		{ { 0xC1, 0x06, 0x10, 'a', 0xFF, 0xFF }, 6 },	/* offset before the dictionary */
+		{ { 0xC1, 0x06, 0x10, 'a', 0x01 }, 5 },	/* offset cut */
+		{ { 0xC1, 0x05, 0x1F, 'a', 0x01, 0x00, 0x00 }, 7 },	/* match past the original length */
+		{ { 0xC1, 0x20, 0x1F, 'a', 0x01, 0x00 }, 6 },	/* match length continuation missing */
+		{ { 0xC1, 0x20, 0xF0 }, 3 },	/* literal length continuation missing */
+		{ { 0xC1, 0x20, 0xF0, 0xFF }, 4 },	/* literal length continuation unterminated */
+	};
+	static TestGuardedBuf out;
+	size_t itr, outLen;
+
+	for(itr = 0; itr < sizeof(malformed) / sizeof(malformed[0]); itr++) {
+		testGuardInit(&out);
+		UT_ASSERT(FAILURE == aws_iot_mqtt_decompress_payload(malformed[itr].data, malformed[itr].len, out.data, 64,
+															 &outLen));
+		UT_ASSERT(testGuardIntact(&out, 64));
+	}
+}
+
+/* Flipped bytes either decode to something of the announced length or fail, never write out of bounds */
+static void testDecompressCorrupted(void) {
+	static TestGuardedBuf out;
+	unsigned char compressed[TEST_BUF_LEN], corrupted[TEST_BUF_LEN];
+	const char *payloads[] = { testShadowUpdate, testShadowDocument, testJobExecution };
+	size_t compressedLen, outLen, itr, flips, flip;
+	IoT_Error_t rc;
+
+	testRandomState = 88172645U;
+	for(itr = 0; itr < sizeof(payloads) / sizeof(payloads[0]); itr++) {
+		UT_ASSERT(SUCCESS == aws_iot_mqtt_compress_payload((const unsigned char *) payloads[itr],
+														   strlen(payloads[itr]), compressed, sizeof(compressed),
+														   &compressedLen));
+		for(flips = 0; flips < 20000; flips++) {
+			memcpy(corrupted, compressed, compressedLen);
+			for(flip = 0; flip <= flips % 3; flip++) {
+				corrupted[1 + testRandom() % (compressedLen - 1)] = (unsigned char) testRandom();
+			}
+			testGuardInit(&out);
+			rc = aws_iot_mqtt_decompress_payload(corrupted, compressedLen, out.data, strlen(payloads[itr]) + 16,
+												 &outLen);
+			UT_ASSERT(SUCCESS == rc || FAILURE == rc || MQTT_RX_BUFFER_TOO_SHORT_ERROR == rc);
+			UT_ASSERT(SUCCESS != rc || outLen <= strlen(payloads[itr]) + 16);
+			UT_ASSERT(testGuardIntact(&out, strlen(payloads[itr]) + 16));
+		}
+	}
+
+	/* Random streams behind a codec byte */
+	for(flips = 0; flips < 20000; flips++) {
+		corrupted[0] = AWS_IOT_MQTT_CODEC_LZ4_JSON;
+		compressedLen = 2 + testRandom() % 64;
+		for(itr = 1; itr < compressedLen; itr++) {
+			corrupted[itr] = (unsigned char) testRandom();
+		}
+		testGuardInit(&out);
+		(void) aws_iot_mqtt_decompress_payload(corrupted, compressedLen, out.data, 256, &outLen);
+		UT_ASSERT(testGuardIntact(&out, 256));
+	}
+}
+
+int main(void) {
+	UT_RUN(testRoundTripJson);
+	UT_RUN(testRoundTripEdgeCases);
+	UT_RUN(testCompressBounds);
+	UT_RUN(testDecompressTooShort);
+	UT_RUN(testDecompressPrefixes);
+	UT_RUN(testDecompressMalformed);
+	UT_RUN(testDecompressCorrupted);
+	return UT_REPORT();
+}
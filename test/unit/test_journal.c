@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Recovery of the outbound message journal.
+ *
+ * The journal can be opened once per process, so every run of the application
+ * is a child process that ends without closing it, the way a crash does. The
+ * parent edits the file between runs to tear, corrupt or age records.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "mqtt_journal.h"
+
+#include "unit_test.h"
+
+#define HEADER_LEN 24
+#define RECORD_HEADER_LEN 20
+#define RECORD_LEN(topic_len, payload_len) ((RECORD_HEADER_LEN + (topic_len) + (payload_len) + 3) & ~3u)
+
+#define RECORD_CRC_OFFSET 0
+#define RECORD_TIMESTAMP_OFFSET 12
+
+#define TOPIC "door/event"
+#define JOURNAL_SIZE 4096
+#define MAX_AGE_SEC 3600
+
+/* "msg-00" on "t": 28 bytes per record, four fit in the small journal */
+#define SMALL_TOPIC "t"
+#define SMALL_JOURNAL_SIZE (HEADER_LEN + 4 * RECORD_LEN(1, 6))
+
+static char journal_path[] = "/tmp/test_journal_XXXXXX";
+
+/* State of the child, set before the fork */
+static size_t journal_size;
+static unsigned int journal_max_age;
+static const char *journal_topic;
+
+static bool __run(void (*run)(void))
+{
+	pid_t pid;
+	int status;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		return false;
+
+	if (pid == 0) {
+		utIsFailed = false;
+		if (mqtt_journal_open(journal_path, journal_size, journal_max_age) != 0) {
+			printf("  failed to open %s\n", journal_path);
+			utIsFailed = true;
+		} else {
+			run();
+		}
+		fflush(stdout);
+		_exit(utIsFailed ? 1 : 0);
+	}
+
+	if (waitpid(pid, &status, 0) != pid)
+		return false;
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool __create(size_t size, unsigned int max_age_sec, const char *topic)
+{
+	int fd;
+
+	strcpy(journal_path, "/tmp/test_journal_XXXXXX");
+	fd = mkstemp(journal_path);
+	if (fd < 0)
+		return false;
+
+	close(fd);
+	journal_size = size;
+	journal_max_age = max_age_sec;
+	journal_topic = topic;
+	return true;
+}
+
+static void __append(int first, int count)
+{
+	char payload[16];
+	int i;
+
+	for (i = first; i < first + count; i++) {
+		snprintf(payload, sizeof(payload), "msg-%02d", i);
+		UT_ASSERT(mqtt_journal_append(journal_topic, (uint16_t) strlen(journal_topic), payload, strlen(payload)) == 0);
+	}
+}
+
+static bool __is_record(const mqtt_journal_record_s *record, int number)
+{
+	char payload[16];
+
+	snprintf(payload, sizeof(payload), "msg-%02d", number);
+	return record->topic_len == strlen(journal_topic) && !memcmp(record->topic, journal_topic, record->topic_len)
+		&& record->payload_len == strlen(payload) && !memcmp(record->payload, payload, record->payload_len);
+}
+
+/*
+ * Replays the next records and checks they are the numbered ones, in order.
+ * They are acknowledged when is_acked is set, otherwise left in flight.
+ */
+static void __expect_next(const int *numbers, int count, bool is_acked)
+{
+	mqtt_journal_record_s record;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		UT_ASSERT(mqtt_journal_peek(&record) == 0);
+		if (!__is_record(&record, numbers[i])) {
+			printf("  record %d is %.*s\n", numbers[i], (int) record.payload_len, (const char *) record.payload);
+			UT_ASSERT(false);
+		}
+		mqtt_journal_sent(record.id);
+		if (is_acked)
+			mqtt_journal_complete(record.id, true);
+	}
+}
+
+/* Same, the numbered records are all the journal holds */
+static void __expect(const int *numbers, int count, bool is_acked)
+{
+	mqtt_journal_record_s record;
+
+	__expect_next(numbers, count, is_acked);
+	UT_ASSERT(!utIsFailed);
+	UT_ASSERT(mqtt_journal_peek(&record) == -ENOENT);
+	UT_ASSERT(mqtt_journal_is_empty() == (is_acked || count == 0));
+}
+
+static uint32_t __crc32(const unsigned char *buf, size_t len)
+{
+	uint32_t c = 0xffffffff;
+	size_t i;
+	int k;
+
+	for (i = 0; i < len; i++) {
+		c ^= buf[i];
+		for (k = 0; k < 8; k++)
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+	}
+
+	return c ^ 0xffffffff;
+}
+
+static bool __read_file(unsigned char *buf)
+{
+	int fd = open(journal_path, O_RDONLY);
+	bool ret;
+
+	if (fd < 0)
+		return false;
+	ret = pread(fd, buf, journal_size, 0) == (ssize_t) journal_size;
+	close(fd);
+	return ret;
+}
+
+static bool __write_file(const unsigned char *buf)
+{
+	int fd = open(journal_path, O_WRONLY);
+	bool ret;
+
+	if (fd < 0)
+		return false;
+	ret = pwrite(fd, buf, journal_size, 0) == (ssize_t) journal_size;
+	close(fd);
+	return ret;
+}
+
+/* Offset of the index-th record, counting from the start of the file */
+static uint32_t __record_offset(const unsigned char *buf, int index)
+{
+	uint32_t offset = HEADER_LEN, payload_len;
+	uint16_t topic_len;
+
+	while (index-- > 0) {
+		memcpy(&topic_len, buf + offset + 6, sizeof(topic_len));
+		memcpy(&payload_len, buf + offset + 16, sizeof(payload_len));
+		offset += RECORD_LEN(topic_len, payload_len);
+	}
+
+	return offset;
+}
+
+static void __update_crc(unsigned char *buf, uint32_t offset)
+{
+	uint32_t crc, payload_len;
+	uint16_t topic_len;
+
+	memcpy(&topic_len, buf + offset + 6, sizeof(topic_len));
+	memcpy(&payload_len, buf + offset + 16, sizeof(payload_len));
+	crc = __crc32(buf + offset + 6, RECORD_HEADER_LEN - 6 + topic_len + payload_len);
+	memcpy(buf + offset + RECORD_CRC_OFFSET, &crc, sizeof(crc));
+}
+
+static void __run_append_1_5(void)
+{
+	__append(1, 5);
+}
+
+static void __run_ack_1_2(void)
+{
+	static const int numbers[] = { 1, 2 };
+	mqtt_journal_record_s record;
+
+	__expect_next(numbers, 2, true);
+
+	/* one in flight and one failed when the process dies, both come back */
+	UT_ASSERT(mqtt_journal_peek(&record) == 0 && __is_record(&record, 3));
+	mqtt_journal_sent(record.id);
+	mqtt_journal_complete(record.id, false);
+	UT_ASSERT(mqtt_journal_peek(&record) == 0 && __is_record(&record, 3));
+	mqtt_journal_sent(record.id);
+	UT_ASSERT(mqtt_journal_peek(&record) == 0 && __is_record(&record, 4));
+	mqtt_journal_sent(record.id);
+}
+
+static void __run_expect_3_5(void)
+{
+	static const int numbers[] = { 3, 4, 5 };
+
+	__expect(numbers, 3, true);
+}
+
+static void __run_expect_none(void)
+{
+	__expect(NULL, 0, true);
+}
+
+static void test_reopen_keeps_order(void)
+{
+	UT_ASSERT(__create(JOURNAL_SIZE, 0, TOPIC));
+	UT_ASSERT(__run(__run_append_1_5));
+	UT_ASSERT(__run(__run_ack_1_2));
+	UT_ASSERT(__run(__run_expect_3_5));
+	UT_ASSERT(__run(__run_expect_none));
+	unlink(journal_path);
+}
+
+static void __run_append_1_3(void)
+{
+	__append(1, 3);
+}
+
+static void __run_expect_1_2_append_4(void)
+{
+	static const int numbers[] = { 1, 2 };
+
+	__expect(numbers, 2, false);
+	__append(4, 1);
+}
+
+static void __run_expect_1_2_4(void)
+{
+	static const int numbers[] = { 1, 2, 4 };
+
+	__expect(numbers, 3, true);
+}
+
+static void test_torn_record_dropped(void)
+{
+	unsigned char buf[JOURNAL_SIZE];
+	uint32_t offset;
+
+	UT_ASSERT(__create(JOURNAL_SIZE, 0, TOPIC));
+	UT_ASSERT(__run(__run_append_1_3));
+
+	/* the last record lost its tail */
+	UT_ASSERT(__read_file(buf));
+	offset = __record_offset(buf, 2);
+	memset(buf + offset + RECORD_HEADER_LEN + strlen(TOPIC), 0, strlen("msg-03"));
+	UT_ASSERT(__write_file(buf));
+
+	/* the next append takes its place */
+	UT_ASSERT(__run(__run_expect_1_2_append_4));
+	UT_ASSERT(__run(__run_expect_1_2_4));
+	unlink(journal_path);
+}
+
+static void __run_expect_1(void)
+{
+	static const int numbers[] = { 1 };
+
+	__expect(numbers, 1, true);
+}
+
+static void test_corrupt_record_ends_journal(void)
+{
+	unsigned char buf[JOURNAL_SIZE];
+
+	UT_ASSERT(__create(JOURNAL_SIZE, 0, TOPIC));
+	UT_ASSERT(__run(__run_append_1_3));
+
+	/* records after a corrupt one cannot be trusted either */
+	UT_ASSERT(__read_file(buf));
+	buf[__record_offset(buf, 1) + RECORD_CRC_OFFSET] ^= 0x01;
+	UT_ASSERT(__write_file(buf));
+
+	UT_ASSERT(__run(__run_expect_1));
+	unlink(journal_path);
+}
+
+static void test_bad_header_resets(void)
+{
+	unsigned char buf[JOURNAL_SIZE];
+
+	UT_ASSERT(__create(JOURNAL_SIZE, 0, TOPIC));
+	UT_ASSERT(__run(__run_append_1_3));
+
+	UT_ASSERT(__read_file(buf));
+	buf[0] ^= 0xff;
+	UT_ASSERT(__write_file(buf));
+	UT_ASSERT(__run(__run_expect_none));
+
+	/* a journal of another size starts over as well */
+	UT_ASSERT(__run(__run_append_1_3));
+	journal_size = JOURNAL_SIZE / 2;
+	UT_ASSERT(__run(__run_expect_none));
+	unlink(journal_path);
+}
+
+static void __run_fill_and_compact(void)
+{
+	static const int numbers[] = { 1, 2 };
+	mqtt_journal_record_s record;
+	char payload[JOURNAL_SIZE];
+
+	__append(1, 4);
+	__expect_next(numbers, 2, true);
+
+	/* 5 only fits once 3 and 4 are moved to the front */
+	__append(5, 1);
+
+	/* 6 fills the journal, 7 drops the oldest, 3 */
+	__append(6, 2);
+
+	/* records in flight point into the file, nothing moves or drops under them */
+	UT_ASSERT(mqtt_journal_peek(&record) == 0 && __is_record(&record, 4));
+	mqtt_journal_sent(record.id);
+	UT_ASSERT(mqtt_journal_append(SMALL_TOPIC, 1, "msg-08", 6) == -ENOSPC);
+	mqtt_journal_complete(record.id, false);
+
+	memset(payload, 'x', sizeof(payload));
+	UT_ASSERT(mqtt_journal_append(SMALL_TOPIC, 1, payload, SMALL_JOURNAL_SIZE - HEADER_LEN) == -EMSGSIZE);
+}
+
+static void __run_expect_4_7(void)
+{
+	static const int numbers[] = { 4, 5, 6, 7 };
+
+	__expect(numbers, 4, true);
+}
+
+static void test_compaction(void)
+{
+	UT_ASSERT(__create(SMALL_JOURNAL_SIZE, 0, SMALL_TOPIC));
+	UT_ASSERT(__run(__run_fill_and_compact));
+	UT_ASSERT(__run(__run_expect_4_7));
+	UT_ASSERT(__run(__run_expect_none));
+	unlink(journal_path);
+}
+
+static void __run_expect_1_3_in_flight(void)
+{
+	static const int numbers[] = { 1, 2, 3 };
+
+	__expect(numbers, 3, false);
+}
+
+static void __run_expect_1_3_skip_2(void)
+{
+	static const int numbers[] = { 1, 3 };
+
+	__expect(numbers, 2, true);
+}
+
+static void __set_timestamp(unsigned char *buf, int index, uint32_t timestamp)
+{
+	uint32_t offset = __record_offset(buf, index);
+
+	memcpy(buf + offset + RECORD_TIMESTAMP_OFFSET, &timestamp, sizeof(timestamp));
+	__update_crc(buf, offset);
+}
+
+static void test_expiry(void)
+{
+	unsigned char buf[JOURNAL_SIZE];
+	uint32_t now = (uint32_t) time(NULL);
+
+	UT_ASSERT(__create(JOURNAL_SIZE, MAX_AGE_SEC, TOPIC));
+	UT_ASSERT(__run(__run_append_1_3));
+
+	/* written before the clock was synced, too old, stamped in the future */
+	UT_ASSERT(__read_file(buf));
+	__set_timestamp(buf, 0, 0);
+	__set_timestamp(buf, 1, now - 2 * MAX_AGE_SEC);
+	__set_timestamp(buf, 2, now + 2 * MAX_AGE_SEC);
+	UT_ASSERT(__write_file(buf));
+
+	/* expiry disabled */
+	journal_max_age = 0;
+	UT_ASSERT(__run(__run_expect_1_3_in_flight));
+
+	journal_max_age = MAX_AGE_SEC;
+	UT_ASSERT(__run(__run_expect_1_3_skip_2));
+	UT_ASSERT(__run(__run_expect_none));
+	unlink(journal_path);
+}
+
+int main(void)
+{
+	UT_RUN(test_reopen_keeps_order);
+	UT_RUN(test_torn_record_dropped);
+	UT_RUN(test_corrupt_record_ends_journal);
+	UT_RUN(test_bad_header_resets);
+	UT_RUN(test_compaction);
+	UT_RUN(test_expiry);
+	return UT_REPORT();
+}
@@ -0,0 +1,391 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file test_mqtt5_properties.c
+ * @brief MQTT 5 property reader and inbound topic aliases
+ */
+
+#include <string.h>
+
+#include "sdk/aws_iot_mqtt_client_interface.h"
+#include "sdk/aws_iot_mqtt_client_common_internal.h"
+
+#include "fake_network.h"
+#include "unit_test.h"
+
+typedef struct {
+	uint32_t calls;
+	char topic[AWS_IOT_MQTT_TOPIC_ALIAS_LEN + 32];
+	uint16_t topicLen;
+	char payload[32];
+	size_t payloadLen;
+} TestDelivery;
+
+static TestDelivery testDelivery;
+
+/* Reads one property from the whole of buf */
+static IoT_Error_t testReadProperty(unsigned char *buf, size_t len, uint8_t *pId, uint32_t *pValue,
+									size_t *pConsumed) {
+	unsigned char *ptr = buf;
+	IoT_Error_t rc;
+
+	rc = aws_iot_mqtt_internal_read_property(&ptr, buf + len, pId, pValue);
+	*pConsumed = (size_t) (ptr - buf);
+	return rc;
+}
+
+static void testPropertyIntegers(void) {
+	unsigned char byteProp[] = { 0x01, 0x01 };
+	unsigned char twoByteProp[] = { MQTT_PROPERTY_TOPIC_ALIAS, 0x01, 0x02 };
+	unsigned char fourByteProp[] = { MQTT_PROPERTY_SESSION_EXPIRY_INTERVAL, 0x00, 0x01, 0x00, 0x02 };
+	unsigned char varintProp[] = { 0x0B, 0x80, 0x01 };
+	unsigned char varintMaxProp[] = { 0x0B, 0xFF, 0xFF, 0xFF, 0x7F };
+	uint32_t value;
+	size_t consumed;
+	uint8_t id;
+
+	UT_ASSERT(SUCCESS == testReadProperty(byteProp, sizeof(byteProp), &id, &value, &consumed));
+	UT_ASSERT(0x01 == id && 1 == value && 2 == consumed);
+	UT_ASSERT(SUCCESS == testReadProperty(twoByteProp, sizeof(twoByteProp), &id, &value, &consumed));
+	UT_ASSERT(MQTT_PROPERTY_TOPIC_ALIAS == id && 0x0102 == value && 3 == consumed);
+	UT_ASSERT(SUCCESS == testReadProperty(fourByteProp, sizeof(fourByteProp), &id, &value, &consumed));
+	UT_ASSERT(MQTT_PROPERTY_SESSION_EXPIRY_INTERVAL == id && 0x00010002 == value && 5 == consumed);
+	UT_ASSERT(SUCCESS == testReadProperty(varintProp, sizeof(varintProp), &id, &value, &consumed));
+	UT_ASSERT(0x0B == id && 128 == value && 3 == consumed);
+	UT_ASSERT(SUCCESS == testReadProperty(varintMaxProp, sizeof(varintMaxProp), &id, &value, &consumed));
+	UT_ASSERT(268435455 == value && 5 == consumed);
+}
+
+static void testPropertyStrings(void) {
+	unsigned char stringProp[] = { 0x03, 0x00, 0x03, 'a', 'b', 'c' };
+	unsigned char emptyProp[] = { 0x08, 0x00, 0x00 };
+	unsigned char userProp[] = { 0x26, 0x00, 0x01, 'k', 0x00, 0x02, 'v', 'w' };
+	uint32_t value;
+	size_t consumed;
+	uint8_t id;
+
+	UT_ASSERT(SUCCESS == testReadProperty(stringProp, sizeof(stringProp), &id, &value, &consumed));
+	UT_ASSERT(0x03 == id && 0 == value && 6 == consumed);
+	UT_ASSERT(SUCCESS == testReadProperty(emptyProp, sizeof(emptyProp), &id, &value, &consumed));
+	UT_ASSERT(3 == consumed);
+	UT_ASSERT(SUCCESS == testReadProperty(userProp, sizeof(userProp), &id, &value, &consumed));
+	UT_ASSERT(0x26 == id && 0 == value && 8 == consumed);
+}
+
+/* Every identifier of the specification is read with the size of its class, the others are refused */
+static void testPropertyIdentifiers(void) {
+	static const uint8_t byteIds[] = { 0x01, 0x17, 0x19, 0x24, 0x25, 0x28, 0x29, 0x2A };
+	static const uint8_t twoByteIds[] = { 0x13, 0x21, 0x22, 0x23 };
+	static const uint8_t fourByteIds[] = { 0x02, 0x11, 0x18, 0x27 };
+	static const uint8_t stringIds[] = { 0x03, 0x08, 0x09, 0x12, 0x15, 0x16, 0x1A, 0x1C, 0x1F };
+	unsigned char buf[9];
+	size_t expected, consumed;
+	uint32_t value, itr, id;
+	uint8_t readId;
+	IoT_Error_t rc;
+
+	for(id = 0; id < 256; id++) {
+		expected = 0;
+		for(itr = 0; itr < sizeof(byteIds); itr++) {
+			expected = (id == byteIds[itr]) ? 2 : expected;
+		}
+		for(itr = 0; itr < sizeof(twoByteIds); itr++) {
+			expected = (id == twoByteIds[itr]) ? 3 : expected;
+		}
+		for(itr = 0; itr < sizeof(fourByteIds); itr++) {
+			expected = (id == fourByteIds[itr]) ? 5 : expected;
+		}
+		for(itr = 0; itr < sizeof(stringIds); itr++) {
+			expected = (id == stringIds[itr]) ? 3 : expected;
+		}
+		expected = (0x0B == id) ? 2 : expected;
+		expected = (0x26 == id) ? 5 : expected;
+
+		memset(buf, 0, sizeof(buf));
+		buf[0] = (unsigned char) id;
+		rc = testReadProperty(buf, sizeof(buf), &readId, &value, &consumed);
+		if(0 == expected) {
+			UT_ASSERT(FAILURE == rc);
+		} else {
+			UT_ASSERT(SUCCESS == rc && id == readId && expected == consumed);
+		}
+	}
+}
+
+static void testPropertyTruncated(void) {
+	unsigned char props[][8] = {
+		{ 0x01 },
+		{ MQTT_PROPERTY_TOPIC_ALIAS, 0x00 },
+		{ MQTT_PROPERTY_SESSION_EXPIRY_INTERVAL, 0x00, 0x00, 0x00 },
+		{ 0x0B, 0x80 },
+		{ 0x03, 0x00 },
+		{ 0x03, 0x00, 0x04, 'a', 'b', 'c' },
+		{ 0x26, 0x00, 0x01, 'k' },
+		{ 0x26, 0x00, 0x01, 'k', 0x00 },
+		{ 0x26, 0x00, 0x01, 'k', 0x00, 0x02, 'v' },
+	};
+	static const size_t lens[] = { 1, 2, 4, 2, 2, 6, 4, 5, 7 };
+	unsigned char overlongVarint[] = { 0x0B, 0x80, 0x80, 0x80, 0x80, 0x01 };
+	uint32_t value, itr;
+	size_t consumed;
+	uint8_t id;
+
+	for(itr = 0; itr < sizeof(lens) / sizeof(lens[0]); itr++) {
+		UT_ASSERT(FAILURE == testReadProperty(props[itr], lens[itr], &id, &value, &consumed));
+		UT_ASSERT(0 == consumed);
+	}
+	UT_ASSERT(FAILURE == testReadProperty(overlongVarint, sizeof(overlongVarint), &id, &value, &consumed));
+	UT_ASSERT(FAILURE == testReadProperty(props[0], 0, &id, &value, &consumed));
+}
+
+/* The reader stops at the end of the list even if the packet goes on */
+static void testPropertyListBounds(void) {
+	unsigned char list[] = { 0x03, 0x23, 0x00, 0x01, 0x26, 0x00 };
+	unsigned char *ptr, *pEnd;
+	uint32_t value;
+	uint8_t id;
+
+	ptr = list;
+	UT_ASSERT(SUCCESS == aws_iot_mqtt_internal_read_properties_length(&ptr, list + sizeof(list), &pEnd));
+	UT_ASSERT(list + 1 == ptr && list + 4 == pEnd);
+	UT_ASSERT(SUCCESS == aws_iot_mqtt_internal_read_property(&ptr, pEnd, &id, &value));
+	UT_ASSERT(ptr == pEnd && 1 == value);
+	UT_ASSERT(FAILURE == aws_iot_mqtt_internal_read_property(&ptr, pEnd, &id, &value));
+
+	/* A user property whose second string starts at the end of the list */
+	list[0] = 0x02;
+	list[1] = 0x26;
+	list[2] = 0x00;
+	ptr = list;
+	UT_ASSERT(SUCCESS == aws_iot_mqtt_internal_read_properties_length(&ptr, list + sizeof(list), &pEnd));
+	UT_ASSERT(FAILURE == aws_iot_mqtt_internal_read_property(&ptr, pEnd, &id, &value));
+}
+
+static void testPropertiesLength(void) {
+	unsigned char empty[] = { 0x00, 0xAA };
+	unsigned char twoBytes[] = { 0x80, 0x01 };
+	unsigned char tooLong[] = { 0x05, 0x01 };
+	unsigned char overlong[] = { 0x80, 0x80, 0x80, 0x80, 0x00 };
+	unsigned char unterminated[] = { 0x80 };
+	unsigned char *ptr, *pEnd;
+
+	ptr = empty;
+	UT_ASSERT(SUCCESS == aws_iot_mqtt_internal_read_properties_length(&ptr, empty + sizeof(empty), &pEnd));
+	UT_ASSERT(empty + 1 == ptr && empty + 1 == pEnd);
+	ptr = twoBytes;
+	UT_ASSERT(FAILURE == aws_iot_mqtt_internal_read_properties_length(&ptr, twoBytes + sizeof(twoBytes), &pEnd));
+	ptr = tooLong;
+	UT_ASSERT(FAILURE == aws_iot_mqtt_internal_read_properties_length(&ptr, tooLong + sizeof(tooLong), &pEnd));
+	ptr = overlong;
+	UT_ASSERT(FAILURE == aws_iot_mqtt_internal_read_properties_length(&ptr, overlong + sizeof(overlong), &pEnd));
+	ptr = unterminated;
+	UT_ASSERT(FAILURE == aws_iot_mqtt_internal_read_properties_length(&ptr, unterminated + sizeof(unterminated),
+																	   &pEnd));
+	ptr = empty;
+	UT_ASSERT(FAILURE == aws_iot_mqtt_internal_read_properties_length(&ptr, empty, &pEnd));
+}
+
+static void testHandler(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+						IoT_Publish_Message_Params *pParams, void *pData) {
+	testDelivery.calls++;
+	testDelivery.topicLen = topicNameLen;
+	memcpy(testDelivery.topic, pTopicName, topicNameLen);
+	testDelivery.payloadLen = pParams->payloadLen;
+	memcpy(testDelivery.payload, pParams->payload, pParams->payloadLen);
+}
+
+/* Sends an MQTT 5 QoS0 PUBLISH from the broker, pProperties is the property list without its length */
+static void testPushPublish(AWS_IoT_Client *pClient, const char *pTopic, const unsigned char *pProperties,
+							size_t propertiesLen, const char *pPayload) {
+	unsigned char packet[256];
+	size_t topicLen = strlen(pTopic), payloadLen = strlen(pPayload), remLen, len;
+
+	remLen = 2 + topicLen + 1 + propertiesLen + payloadLen;
+	len = 0;
+	packet[len++] = 0x30;
+	if(remLen >= 128) {
+		packet[len++] = (unsigned char) (0x80 | (remLen & 127));
+		packet[len++] = (unsigned char) (remLen >> 7);
+	} else {
+		packet[len++] = (unsigned char) remLen;
+	}
+	packet[len++] = (unsigned char) (topicLen >> 8);
+	packet[len++] = (unsigned char) topicLen;
+	memcpy(packet + len, pTopic, topicLen);
+	len += topicLen;
+	packet[len++] = (unsigned char) propertiesLen;
+	if(0 < propertiesLen) {
+		memcpy(packet + len, pProperties, propertiesLen);
+		len += propertiesLen;
+	}
+	memcpy(packet + len, pPayload, payloadLen);
+	len += payloadLen;
+
+	fakeNetworkPush(&(pClient->networkStack), packet, len);
+}
+
+static bool testIsDelivered(const char *pTopic, const char *pPayload) {
+	return 1 == testDelivery.calls && strlen(pTopic) == testDelivery.topicLen &&
+		   0 == memcmp(pTopic, testDelivery.topic, testDelivery.topicLen) &&
+		   strlen(pPayload) == testDelivery.payloadLen &&
+		   0 == memcmp(pPayload, testDelivery.payload, testDelivery.payloadLen);
+}
+
+static IoT_Error_t testConnect(AWS_IoT_Client *pClient) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	IoT_Error_t rc;
+
+	initParams.pHostURL = "broker";
+	initParams.port = 8883;
+	initParams.pRootCALocation = initParams.pDeviceCertLocation = initParams.pDevicePrivateKeyLocation = "";
+	initParams.enableAutoReconnect = false;
+	rc = aws_iot_mqtt_init(pClient, &initParams);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	rc = fakeNetworkAttach(&(pClient->networkStack));
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	connectParams.MQTTVersion = MQTT_5;
+	connectParams.pClientID = "test";
+	connectParams.clientIDLen = 4;
+	rc = aws_iot_mqtt_connect(pClient, &connectParams);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	return aws_iot_mqtt_subscribe(pClient, "a/#", 3, QOS0, testHandler, NULL);
+}
+
+static void testDisconnect(AWS_IoT_Client *pClient) {
+	(void) aws_iot_mqtt_disconnect(pClient);
+	fakeNetworkDetach(&(pClient->networkStack));
+	(void) aws_iot_mqtt_free(pClient);
+}
+
+/* One publish from the broker, returns what yield returned */
+static IoT_Error_t testDeliver(AWS_IoT_Client *pClient, const char *pTopic, const unsigned char *pProperties,
+							   size_t propertiesLen, const char *pPayload) {
+	memset(&testDelivery, 0, sizeof(testDelivery));
+	testPushPublish(pClient, pTopic, pProperties, propertiesLen, pPayload);
+	return aws_iot_mqtt_yield(pClient, 5);
+}
+
+static void testTopicAlias(void) {
+	static const unsigned char alias1[] = { MQTT_PROPERTY_TOPIC_ALIAS, 0x00, 0x01 };
+	static const unsigned char alias2[] = { MQTT_PROPERTY_TOPIC_ALIAS, 0x00, 0x02 };
+	static const unsigned char aliasWithUserProperty[] = { 0x26, 0x00, 0x01, 'k', 0x00, 0x01, 'v',
+														   MQTT_PROPERTY_TOPIC_ALIAS, 0x00, 0x02 };
+	AWS_IoT_Client client;
+
+	UT_ASSERT(SUCCESS == testConnect(&client));
+
+	UT_ASSERT(SUCCESS == testDeliver(&client, "a/b", NULL, 0, "plain"));
+	UT_ASSERT(testIsDelivered("a/b", "plain"));
+
+	/* Setting an alias delivers on the topic, later publishes carry the alias alone */
+	UT_ASSERT(SUCCESS == testDeliver(&client, "a/b", alias1, sizeof(alias1), "set"));
+	UT_ASSERT(testIsDelivered("a/b", "set"));
+	UT_ASSERT(SUCCESS == testDeliver(&client, "", alias1, sizeof(alias1), "use"));
+	UT_ASSERT(testIsDelivered("a/b", "use"));
+
+	/* Other properties do not hide the alias, and an alias can be set again */
+	UT_ASSERT(SUCCESS == testDeliver(&client, "a/c", aliasWithUserProperty, sizeof(aliasWithUserProperty), "x"));
+	UT_ASSERT(testIsDelivered("a/c", "x"));
+	UT_ASSERT(SUCCESS == testDeliver(&client, "", alias2, sizeof(alias2), "y"));
+	UT_ASSERT(testIsDelivered("a/c", "y"));
+	UT_ASSERT(SUCCESS == testDeliver(&client, "a/d", alias2, sizeof(alias2), "z"));
+	UT_ASSERT(SUCCESS == testDeliver(&client, "", alias2, sizeof(alias2), "w"));
+	UT_ASSERT(testIsDelivered("a/d", "w"));
+	UT_ASSERT(SUCCESS == testDeliver(&client, "", alias1, sizeof(alias1), "v"));
+	UT_ASSERT(testIsDelivered("a/b", "v"));
+
+	testDisconnect(&client);
+}
+
+/* A topic too long to be held clears the alias instead of keeping the previous topic */
+static void testTopicAliasTooLong(void) {
+	static const unsigned char alias3[] = { MQTT_PROPERTY_TOPIC_ALIAS, 0x00, 0x03 };
+	char longTopic[AWS_IOT_MQTT_TOPIC_ALIAS_LEN + 5];
+	AWS_IoT_Client client;
+
+	memset(longTopic, 'x', sizeof(longTopic) - 1);
+	longTopic[0] = 'a';
+	longTopic[1] = '/';
+	longTopic[sizeof(longTopic) - 1] = '\0';
+
+	UT_ASSERT(SUCCESS == testConnect(&client));
+	UT_ASSERT(SUCCESS == testDeliver(&client, "a/b", alias3, sizeof(alias3), "short"));
+	UT_ASSERT(SUCCESS == testDeliver(&client, longTopic, alias3, sizeof(alias3), "long"));
+	UT_ASSERT(testIsDelivered(longTopic, "long"));
+	UT_ASSERT(SUCCESS != testDeliver(&client, "", alias3, sizeof(alias3), "dropped"));
+	UT_ASSERT(0 == testDelivery.calls);
+	UT_ASSERT(aws_iot_mqtt_is_client_connected(&client));
+
+	testDisconnect(&client);
+}
+
+/* Invalid publishes are dropped, the connection stays up and the next publish is delivered */
+static void testInvalidPublishDropped(void) {
+	static const unsigned char unknownAlias[] = { MQTT_PROPERTY_TOPIC_ALIAS, 0x00, 0x04 };
+	static const unsigned char aliasTooLarge[] = { MQTT_PROPERTY_TOPIC_ALIAS, 0x00, AWS_IOT_MQTT_TOPIC_ALIAS_MAX + 1 };
+	static const unsigned char unknownProperty[] = { 0x04, 0x00 };
+	static const unsigned char truncatedProperty[] = { MQTT_PROPERTY_TOPIC_ALIAS, 0x00 };
+	static const struct {
+		const char *pTopic;
+		const unsigned char *pProperties;
+		size_t propertiesLen;
+	} invalid[] = {
+		{ "", NULL, 0 },
+		{ "", unknownAlias, sizeof(unknownAlias) },
+		{ "", aliasTooLarge, sizeof(aliasTooLarge) },
+		{ "a/b", aliasTooLarge, sizeof(aliasTooLarge) },
+		{ "a/b", unknownProperty, sizeof(unknownProperty) },
+		{ "a/b", truncatedProperty, sizeof(truncatedProperty) },
+	};
+	AWS_IoT_Client client;
+	uint32_t itr;
+
+	UT_ASSERT(SUCCESS == testConnect(&client));
+	for(itr = 0; itr < sizeof(invalid) / sizeof(invalid[0]); itr++) {
+		memset(&testDelivery, 0, sizeof(testDelivery));
+		testPushPublish(&client, invalid[itr].pTopic, invalid[itr].pProperties, invalid[itr].propertiesLen, "bad");
+		testPushPublish(&client, "a/ok", NULL, 0, "good");
+		UT_ASSERT(SUCCESS != aws_iot_mqtt_yield(&client, 5));
+		UT_ASSERT(0 == testDelivery.calls);
+		UT_ASSERT(aws_iot_mqtt_is_client_connected(&client));
+		UT_ASSERT(SUCCESS == aws_iot_mqtt_yield(&client, 5));
+		UT_ASSERT(testIsDelivered("a/ok", "good"));
+	}
+
+	testDisconnect(&client);
+}
+
+int main(void) {
+	UT_RUN(testPropertyIntegers);
+	UT_RUN(testPropertyStrings);
+	UT_RUN(testPropertyIdentifiers);
+	UT_RUN(testPropertyTruncated);
+	UT_RUN(testPropertyListBounds);
+	UT_RUN(testPropertiesLength);
+	UT_RUN(testTopicAlias);
+	UT_RUN(testTopicAliasTooLong);
+	UT_RUN(testInvalidPublishDropped);
+	return UT_REPORT();
+}
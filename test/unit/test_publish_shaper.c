@@ -0,0 +1,130 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file test_publish_shaper.c
+ * @brief Blocking publishes held back by the publish shaper
+ *
+ * Runs on the simulated clock of host/sim_timer.c, waits for the shaper take no real time.
+ * A blocking publish over the rate waits for the shaper within the command timeout and is
+ * refused with MQTT_PUBLISH_THROTTLED_ERROR only when the wait would go past it.
+ */
+
+#include <string.h>
+
+#include "sdk/aws_iot_mqtt_client_interface.h"
+
+#include "fake_network.h"
+#include "sim_timer.h"
+#include "unit_test.h"
+
+#define TEST_RATE 10
+#define TEST_BURST (TEST_RATE * AWS_IOT_MQTT_PUBLISH_BURST_MS / 1000)
+
+static IoT_Error_t testConnect(AWS_IoT_Client *pClient, uint32_t commandTimeoutMs) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	IoT_Error_t rc;
+
+	simTimerSetMs(0);
+	initParams.pHostURL = "broker";
+	initParams.port = 8883;
+	initParams.pRootCALocation = initParams.pDeviceCertLocation = initParams.pDevicePrivateKeyLocation = "";
+	initParams.enableAutoReconnect = false;
+	initParams.mqttCommandTimeout_ms = commandTimeoutMs;
+	rc = aws_iot_mqtt_init(pClient, &initParams);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	rc = fakeNetworkAttach(&(pClient->networkStack));
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	connectParams.MQTTVersion = MQTT_3_1_1;
+	connectParams.pClientID = "test";
+	connectParams.clientIDLen = 4;
+	rc = aws_iot_mqtt_connect(pClient, &connectParams);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	return aws_iot_mqtt_set_publish_rate_limit(pClient, TEST_RATE, 0);
+}
+
+static void testDisconnect(AWS_IoT_Client *pClient) {
+	(void) aws_iot_mqtt_disconnect(pClient);
+	fakeNetworkDetach(&(pClient->networkStack));
+	(void) aws_iot_mqtt_free(pClient);
+}
+
+static IoT_Error_t testPublish(AWS_IoT_Client *pClient) {
+	IoT_Publish_Message_Params params;
+
+	memset(&params, 0, sizeof(params));
+	params.qos = QOS0;
+	params.payload = "open";
+	params.payloadLen = 4;
+	return aws_iot_mqtt_publish(pClient, "door/state", 10, &params);
+}
+
+/* Past the burst every publish waits for its token instead of failing */
+static void testWaitsForShaper(void) {
+	AWS_IoT_Client client;
+	FakeNetworkStats stats;
+	uint64_t startMs, elapsedMs;
+	uint32_t itr, failed = 0;
+
+	UT_ASSERT(SUCCESS == testConnect(&client, 20000));
+	startMs = simTimerGetMs();
+	for(itr = 0; itr < 3 * TEST_BURST; itr++) {
+		failed += (SUCCESS == testPublish(&client)) ? 0 : 1;
+	}
+	elapsedMs = simTimerGetMs() - startMs;
+	fakeNetworkGetStats(&(client.networkStack), &stats);
+	testDisconnect(&client);
+
+	UT_ASSERT(0 == failed);
+	UT_ASSERT(3 * TEST_BURST == stats.publishes);
+	UT_ASSERT(elapsedMs >= 2 * TEST_BURST * 1000 / TEST_RATE);
+}
+
+/* A wait longer than the command timeout is not started, nothing is sent */
+static void testThrottledPastTimeout(void) {
+	AWS_IoT_Client client;
+	FakeNetworkStats stats;
+	uint64_t startMs, elapsedMs;
+	uint32_t sent = 0;
+	IoT_Error_t rc;
+
+	UT_ASSERT(SUCCESS == testConnect(&client, 1000 / TEST_RATE / 2));
+	do {
+		startMs = simTimerGetMs();
+		rc = testPublish(&client);
+		sent += (SUCCESS == rc) ? 1 : 0;
+	} while(SUCCESS == rc && sent <= TEST_BURST);
+	elapsedMs = simTimerGetMs() - startMs;
+	fakeNetworkGetStats(&(client.networkStack), &stats);
+	testDisconnect(&client);
+
+	UT_ASSERT(MQTT_PUBLISH_THROTTLED_ERROR == rc);
+	UT_ASSERT(elapsedMs < 1000 / TEST_RATE / 2);
+	UT_ASSERT(sent == stats.publishes);
+}
+
+int main(void) {
+	UT_RUN(testWaitsForShaper);
+	UT_RUN(testThrottledPastTimeout);
+	return UT_REPORT();
+}
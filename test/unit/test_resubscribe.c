@@ -0,0 +1,143 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file test_resubscribe.c
+ * @brief Packing of the subscription table into SUBSCRIBE packets on resubscribe
+ *
+ * Two filters are subscribed one by one, then resubscribed together. Their lengths put
+ * the packet holding both right below or right at the size of the TX buffer, in MQTT 3.1.1
+ * and in MQTT 5, whose packets carry an empty property list after the packet id. The bytes
+ * the broker receives tell whether they went out in one packet or in two.
+ */
+
+#include <string.h>
+
+#include "sdk/aws_iot_mqtt_client_interface.h"
+
+#include "fake_network.h"
+#include "unit_test.h"
+
+#define TEST_FILTER_MAX_LEN 300
+
+static char testFilters[2][TEST_FILTER_MAX_LEN + 1];
+
+static void testHandler(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+						IoT_Publish_Message_Params *pParams, void *pData) {
+}
+
+/* Length of a packet with a fixed header of two length bytes */
+static uint64_t testPacketLen(uint32_t remLen) {
+	return 1 + 2 + remLen;
+}
+
+static IoT_Error_t testConnect(AWS_IoT_Client *pClient, MQTT_Ver_t version) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	IoT_Error_t rc;
+
+	initParams.pHostURL = "broker";
+	initParams.port = 8883;
+	initParams.pRootCALocation = initParams.pDeviceCertLocation = initParams.pDevicePrivateKeyLocation = "";
+	initParams.enableAutoReconnect = false;
+	rc = aws_iot_mqtt_init(pClient, &initParams);
+	if(SUCCESS != rc) {
+		return rc;
+	}
+	rc = fakeNetworkAttach(&(pClient->networkStack));
+	if(SUCCESS != rc) {
+		return rc;
+	}
+
+	connectParams.MQTTVersion = version;
+	connectParams.pClientID = "test";
+	connectParams.clientIDLen = 4;
+	return aws_iot_mqtt_connect(pClient, &connectParams);
+}
+
+static void testDisconnect(AWS_IoT_Client *pClient) {
+	(void) aws_iot_mqtt_disconnect(pClient);
+	fakeNetworkDetach(&(pClient->networkStack));
+	(void) aws_iot_mqtt_free(pClient);
+}
+
+/* Resubscribes filters of len1 and len2 bytes, returns the bytes sent or 0 on failure */
+static uint64_t testResubscribe(MQTT_Ver_t version, uint16_t len1, uint16_t len2) {
+	AWS_IoT_Client client;
+	FakeNetworkStats before, after;
+	IoT_Error_t rc;
+
+	memset(testFilters, 'f', sizeof(testFilters));
+	testFilters[0][len1] = '\0';
+	testFilters[1][len2] = '\0';
+	testFilters[1][0] = 'g';
+
+	rc = testConnect(&client, version);
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_subscribe(&client, testFilters[0], len1, QOS1, testHandler, NULL);
+	}
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_subscribe(&client, testFilters[1], len2, QOS1, testHandler, NULL);
+	}
+	fakeNetworkGetStats(&(client.networkStack), &before);
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_resubscribe(&client);
+	}
+	fakeNetworkGetStats(&(client.networkStack), &after);
+	testDisconnect(&client);
+
+	return (SUCCESS == rc) ? after.txBytes - before.txBytes : 0;
+}
+
+/* The variable header, then each filter with its length and requested QoS */
+static void testFitsInOnePacket(MQTT_Ver_t version, uint32_t headerLen) {
+	uint16_t len1 = 250, len2 = (uint16_t) (AWS_IOT_MQTT_TX_BUF_LEN - 1 - 9 - headerLen - len1);
+
+	UT_ASSERT(testPacketLen(headerLen + len1 + 3 + len2 + 3) == AWS_IOT_MQTT_TX_BUF_LEN - 1);
+	UT_ASSERT(testPacketLen(headerLen + len1 + 3 + len2 + 3) == testResubscribe(version, len1, len2));
+}
+
+/* A packet as long as the TX buffer is refused by the send, the filters go in two packets */
+static void testFillsTxBuffer(MQTT_Ver_t version, uint32_t headerLen) {
+	uint16_t len1 = 250, len2 = (uint16_t) (AWS_IOT_MQTT_TX_BUF_LEN - 9 - headerLen - len1);
+
+	UT_ASSERT(testPacketLen(headerLen + len1 + 3 + len2 + 3) == AWS_IOT_MQTT_TX_BUF_LEN);
+	UT_ASSERT(testPacketLen(headerLen + len1 + 3) + testPacketLen(headerLen + len2 + 3) ==
+			  testResubscribe(version, len1, len2));
+}
+
+static void testFitsInOnePacket311(void) {
+	testFitsInOnePacket(MQTT_3_1_1, 2);
+}
+
+static void testFillsTxBuffer311(void) {
+	testFillsTxBuffer(MQTT_3_1_1, 2);
+}
+
+static void testFitsInOnePacket5(void) {
+	testFitsInOnePacket(MQTT_5, 3);
+}
+
+static void testFillsTxBuffer5(void) {
+	testFillsTxBuffer(MQTT_5, 3);
+}
+
+int main(void) {
+	UT_RUN(testFitsInOnePacket311);
+	UT_RUN(testFillsTxBuffer311);
+	UT_RUN(testFitsInOnePacket5);
+	UT_RUN(testFillsTxBuffer5);
+	return UT_REPORT();
+}
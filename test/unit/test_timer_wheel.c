@@ -0,0 +1,229 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file test_timer_wheel.c
+ * @brief Deadlines of the hierarchical timing wheel
+ *
+ * Runs on the simulated clock of host/sim_timer.c, which the test steps one ms at a time
+ * and drains the wheel at every step. The deadline of an entry is the clock when it was
+ * scheduled plus its timeout. An entry must not expire before its deadline nor more than
+ * a tick after it, and next_timeout_ms must never point past the next expiry. As every
+ * read moves the simulated clock by a ms, schedule starts a ms after the deadline base,
+ * which the tick of lateness allowed covers.
+ */
+
+#include <string.h>
+
+#include "sdk/aws_iot_timer_wheel.h"
+#include "aws_iot_config.h"
+
+#include "sim_timer.h"
+#include "unit_test.h"
+
+#define TEST_TICK_MS AWS_IOT_TIMER_WHEEL_TICK_MS
+#define TEST_MAX_TIMERS 64
+
+typedef struct {
+	TimerWheelEntry entry;
+	uint64_t deadlineMs;
+	uint64_t expiredMs;
+	bool isExpired;
+} TestTimer;
+
+typedef struct {
+	uint32_t expired;
+	uint32_t early;		///< Expired before their deadline
+	uint32_t late;		///< Expired more than a tick after their deadline
+	uint32_t lateWakeups;	///< next_timeout_ms pointed past the next expiry
+} TestRunResult;
+
+static TimerWheel testWheel;
+static TestTimer testTimers[TEST_MAX_TIMERS];
+
+/* Level of the slot holding a scheduled entry */
+static uint32_t testLevel(const TestTimer *pTimer) {
+	return pTimer->entry.slotIndex / AWS_IOT_TIMER_WHEEL_SLOTS;
+}
+
+static void testSchedule(TestTimer *pTimer, uint32_t timeoutMs) {
+	pTimer->deadlineMs = simTimerGetMs() + timeoutMs;
+	pTimer->isExpired = false;
+	aws_iot_timer_wheel_init_entry(&(pTimer->entry), pTimer);
+	aws_iot_timer_wheel_schedule(&testWheel, &(pTimer->entry), timeoutMs);
+}
+
+/* Steps the clock from nowMs to endMs, draining the wheel at every ms */
+static void testRun(uint64_t nowMs, uint64_t endMs, TestRunResult *pResult) {
+	TimerWheelEntry *pEntry;
+	TestTimer *pTimer;
+	uint64_t wakeupMs = 0;
+	uint32_t nextMs;
+
+	memset(pResult, 0, sizeof(TestRunResult));
+	for(; nowMs <= endMs; nowMs++) {
+		simTimerSetMs(nowMs);
+		while(NULL != (pEntry = aws_iot_timer_wheel_expire(&testWheel))) {
+			pTimer = pEntry->pData;
+			pTimer->expiredMs = nowMs;
+			pTimer->isExpired = true;
+			pResult->expired++;
+			pResult->early += (nowMs < pTimer->deadlineMs) ? 1 : 0;
+			pResult->late += (nowMs > pTimer->deadlineMs + TEST_TICK_MS) ? 1 : 0;
+			/* Every wake-up asked for since the previous expiry had to come by now */
+			pResult->lateWakeups += (wakeupMs > nowMs) ? 1 : 0;
+			wakeupMs = 0;
+		}
+
+		simTimerSetMs(nowMs);
+		nextMs = aws_iot_timer_wheel_next_timeout_ms(&testWheel);
+		if(AWS_IOT_TIMER_WHEEL_NO_TIMEOUT != nextMs && nowMs + nextMs > wakeupMs) {
+			wakeupMs = nowMs + nextMs;
+		}
+	}
+}
+
+/* Schedules timeouts a tick either side of the first slot of levels 1 to 3 and runs them */
+static void testCascades(uint64_t startMs) {
+	TestRunResult result;
+	uint32_t level, boundary, count = 0, itr;
+
+	simTimerSetMs(startMs);
+	aws_iot_timer_wheel_init(&testWheel);
+	for(level = 1; level < AWS_IOT_TIMER_WHEEL_LEVELS; level++) {
+		boundary = 1u << (AWS_IOT_TIMER_WHEEL_LEVEL_BITS * level);
+		testSchedule(&testTimers[count], (boundary - 1) * TEST_TICK_MS);
+		UT_ASSERT(level - 1 == testLevel(&testTimers[count]));
+		count++;
+		testSchedule(&testTimers[count], boundary * TEST_TICK_MS);
+		UT_ASSERT(level == testLevel(&testTimers[count]));
+		count++;
+		testSchedule(&testTimers[count], (boundary + 1) * TEST_TICK_MS);
+		UT_ASSERT(level == testLevel(&testTimers[count]));
+		count++;
+		testSchedule(&testTimers[count], boundary * TEST_TICK_MS + TEST_TICK_MS / 2);
+		count++;
+	}
+
+	testRun(startMs, startMs + ((1u << (AWS_IOT_TIMER_WHEEL_LEVEL_BITS * 3)) + 8) * TEST_TICK_MS, &result);
+
+	UT_ASSERT(count == result.expired);
+	UT_ASSERT(0 == result.early);
+	UT_ASSERT(0 == result.late);
+	UT_ASSERT(0 == result.lateWakeups);
+	for(itr = 0; itr < count; itr++) {
+		UT_ASSERT(testTimers[itr].isExpired);
+		UT_ASSERT(!aws_iot_timer_wheel_is_scheduled(&(testTimers[itr].entry)));
+	}
+}
+
+static void testCascadesAligned(void) {
+	testCascades(0);
+}
+
+/* The lower levels are part way through their turn when the entries are scheduled */
+static void testCascadesUnaligned(void) {
+	testCascades(37 * TEST_TICK_MS + 3);
+}
+
+/* Timeouts of every size, scheduled at different times while the wheel is running */
+static void testNeverExpiresEarly(void) {
+	TestRunResult result;
+	uint64_t nowMs = 5;
+	uint32_t seed = 1, itr;
+
+	simTimerSetMs(nowMs);
+	aws_iot_timer_wheel_init(&testWheel);
+	for(itr = 0; itr < TEST_MAX_TIMERS; itr++) {
+		seed = seed * 1103515245 + 12345;
+		if(0 == itr % 8) {
+			testRun(nowMs, nowMs + (seed >> 16) % 1000, &result);
+			UT_ASSERT(0 == result.early);
+			nowMs = simTimerGetMs();
+		}
+		simTimerSetMs(nowMs);
+		/* From a few ms to about 100 min, around every level */
+		testSchedule(&testTimers[itr], (seed >> 8) % (1u << (6 + 3 * (itr % 8))));
+	}
+
+	testRun(nowMs, nowMs + (1u << 27), &result);
+
+	UT_ASSERT(0 == result.early);
+	UT_ASSERT(0 == result.late);
+	UT_ASSERT(0 == result.lateWakeups);
+	for(itr = 0; itr < TEST_MAX_TIMERS; itr++) {
+		UT_ASSERT(testTimers[itr].isExpired);
+	}
+}
+
+static void testCancelAfterExpiry(void) {
+	TestRunResult result;
+	TimerWheelEntry *pEntry;
+	TestTimer *pTaken, *pLeft;
+
+	simTimerSetMs(0);
+	aws_iot_timer_wheel_init(&testWheel);
+	UT_ASSERT(AWS_IOT_TIMER_WHEEL_NO_TIMEOUT == aws_iot_timer_wheel_next_timeout_ms(&testWheel));
+	testSchedule(&testTimers[0], 5 * TEST_TICK_MS);
+	testSchedule(&testTimers[1], 5 * TEST_TICK_MS);
+	testSchedule(&testTimers[2], 100 * TEST_TICK_MS);
+
+	/* Both expire on the same tick, one is taken and the other is left on the expired list */
+	simTimerSetMs(10 * TEST_TICK_MS);
+	pEntry = aws_iot_timer_wheel_expire(&testWheel);
+	UT_ASSERT(NULL != pEntry);
+	pTaken = pEntry->pData;
+	pLeft = (pTaken == &testTimers[0]) ? &testTimers[1] : &testTimers[0];
+	UT_ASSERT(!aws_iot_timer_wheel_is_scheduled(&(pTaken->entry)));
+	UT_ASSERT(aws_iot_timer_wheel_is_scheduled(&(pLeft->entry)));
+	UT_ASSERT(0 == aws_iot_timer_wheel_next_timeout_ms(&testWheel));
+
+	/* Cancelling the one handed out does nothing, cancelling the other takes it back */
+	aws_iot_timer_wheel_cancel(&testWheel, &(pTaken->entry));
+	aws_iot_timer_wheel_cancel(&testWheel, &(pLeft->entry));
+	UT_ASSERT(!aws_iot_timer_wheel_is_scheduled(&(pLeft->entry)));
+	UT_ASSERT(1 == testWheel.entryCount);
+	simTimerSetMs(10 * TEST_TICK_MS);
+	UT_ASSERT(NULL == aws_iot_timer_wheel_expire(&testWheel));
+	simTimerSetMs(10 * TEST_TICK_MS);
+	UT_ASSERT(0 < aws_iot_timer_wheel_next_timeout_ms(&testWheel));
+
+	/* A cancelled entry can be scheduled again, the remaining one still expires on time */
+	simTimerSetMs(10 * TEST_TICK_MS);
+	testSchedule(pLeft, 20 * TEST_TICK_MS);
+	pTaken->isExpired = false;
+	testRun(10 * TEST_TICK_MS, 200 * TEST_TICK_MS, &result);
+
+	UT_ASSERT(2 == result.expired);
+	UT_ASSERT(0 == result.early);
+	UT_ASSERT(0 == result.late);
+	UT_ASSERT(0 == result.lateWakeups);
+	UT_ASSERT(!pTaken->isExpired);
+	UT_ASSERT(pLeft->isExpired && testTimers[2].isExpired);
+	UT_ASSERT(pLeft->expiredMs < testTimers[2].expiredMs);
+
+	simTimerSetMs(200 * TEST_TICK_MS);
+	UT_ASSERT(AWS_IOT_TIMER_WHEEL_NO_TIMEOUT == aws_iot_timer_wheel_next_timeout_ms(&testWheel));
+	aws_iot_timer_wheel_cancel(&testWheel, &(testTimers[2].entry));
+	UT_ASSERT(0 == testWheel.entryCount);
+}
+
+int main(void) {
+	UT_RUN(testCascadesAligned);
+	UT_RUN(testCascadesUnaligned);
+	UT_RUN(testNeverExpiresEarly);
+	UT_RUN(testCancelAfterExpiry);
+	return UT_REPORT();
+}
@@ -0,0 +1,340 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file test_topic_trie.c
+ * @brief Topic filter trie dispatch
+ *
+ * Random filters and topics are checked against a reference matcher written from
+ * the MQTT 3.1.1 specification, section 4.7.
+ */
+
+#include <string.h>
+
+#include "sdk/aws_iot_mqtt_client_interface.h"
+#include "sdk/aws_iot_mqtt_client_common_internal.h"
+
+#include "unit_test.h"
+
+#define TEST_HANDLERS 64
+#define TEST_NODES 256
+#define TEST_MAX_LEVELS 8
+#define TEST_TOPIC_LEN 64
+
+typedef struct {
+	AWS_IoT_Client client;
+	MessageHandlers handlers[TEST_HANDLERS];
+	TopicTrieNode nodes[TEST_NODES];
+	char filters[TEST_HANDLERS][TEST_TOPIC_LEN];
+	uint32_t calls[TEST_HANDLERS];
+	uint32_t removeOnCall[TEST_HANDLERS];	///< Handler index + 1 to remove when called, 0 for none
+	const char *pNestedTopic;	///< Dispatched again from inside the first handler called, NULL for none
+} TestTrie;
+
+static TestTrie testTrie;
+static uint32_t testRandomState;
+
+static uint32_t testRandom(void) {
+	testRandomState ^= testRandomState << 13;
+	testRandomState ^= testRandomState >> 17;
+	testRandomState ^= testRandomState << 5;
+	return testRandomState;
+}
+
+/* Splits a topic or filter into levels, empty levels included */
+static uint32_t testSplit(const char *pTopic, const char *pLevels[], uint16_t levelLens[]) {
+	uint32_t count = 0;
+	const char *pStart = pTopic, *pCur;
+
+	for(pCur = pTopic; ; pCur++) {
+		if('/' == *pCur || '\0' == *pCur) {
+			pLevels[count] = pStart;
+			levelLens[count] = (uint16_t) (pCur - pStart);
+			count++;
+			if('\0' == *pCur) {
+				return count;
+			}
+			pStart = pCur + 1;
+		}
+	}
+}
+
+static bool testIsLevel(const char *pLevel, uint16_t levelLen, const char *pText) {
+	return strlen(pText) == levelLen && 0 == strncmp(pLevel, pText, levelLen);
+}
+
+/* Reference matcher, level by level as in the specification */
+static bool testReferenceMatch(const char *pFilter, const char *pTopic) {
+	const char *filterLevels[TEST_MAX_LEVELS], *topicLevels[TEST_MAX_LEVELS];
+	uint16_t filterLens[TEST_MAX_LEVELS], topicLens[TEST_MAX_LEVELS];
+	uint32_t filterCount, topicCount, itr;
+
+	filterCount = testSplit(pFilter, filterLevels, filterLens);
+	topicCount = testSplit(pTopic, topicLevels, topicLens);
+
+	/* 4.7.2: wildcards in the first level do not match topics starting with '$' */
+	if('$' == pTopic[0] && (testIsLevel(filterLevels[0], filterLens[0], "+") ||
+							testIsLevel(filterLevels[0], filterLens[0], "#"))) {
+		return false;
+	}
+
+	for(itr = 0; itr < filterCount; itr++) {
+		if(testIsLevel(filterLevels[itr], filterLens[itr], "#")) {
+			/* 4.7.1.2: also matches the parent level */
+			return true;
+		}
+		if(itr >= topicCount) {
+			return false;
+		}
+		if(!testIsLevel(filterLevels[itr], filterLens[itr], "+") &&
+		   (filterLens[itr] != topicLens[itr] || 0 != strncmp(filterLevels[itr], topicLevels[itr], topicLens[itr]))) {
+			return false;
+		}
+	}
+
+	return filterCount == topicCount;
+}
+
+static void testHandler(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+						IoT_Publish_Message_Params *pParams, void *pData) {
+	uint32_t index = (uint32_t) (uintptr_t) pData;
+	uint32_t toRemove = testTrie.removeOnCall[index];
+	const char *pNestedTopic = testTrie.pNestedTopic;
+
+	testTrie.calls[index]++;
+	if(0 < toRemove) {
+		testTrie.removeOnCall[index] = 0;
+		aws_iot_mqtt_internal_trie_remove(pClient, toRemove - 1);
+	}
+	if(NULL != pNestedTopic) {
+		testTrie.pNestedTopic = NULL;
+		(void) aws_iot_mqtt_internal_trie_dispatch(pClient, (char *) pNestedTopic, (uint16_t) strlen(pNestedTopic),
+												   pParams, 0, pParams->payloadLen, true);
+	}
+}
+
+static void testTrieInit(uint32_t handlerCount, uint32_t nodeCount) {
+	memset(&testTrie, 0, sizeof(testTrie));
+	(void) aws_iot_mqtt_set_subscription_table(&(testTrie.client), testTrie.handlers, handlerCount, testTrie.nodes,
+											   nodeCount);
+}
+
+static IoT_Error_t testSubscribe(uint32_t index, const char *pFilter) {
+	MessageHandlers *pHandler = &(testTrie.handlers[index]);
+
+	strcpy(testTrie.filters[index], pFilter);
+	pHandler->topicName = testTrie.filters[index];
+	pHandler->topicNameLen = (uint16_t) strlen(pFilter);
+	pHandler->pApplicationHandler = testHandler;
+	pHandler->pApplicationHandlerData = (void *) (uintptr_t) index;
+	return aws_iot_mqtt_internal_trie_insert(&(testTrie.client), index);
+}
+
+static uint32_t testDispatch(const char *pTopic) {
+	IoT_Publish_Message_Params params;
+
+	memset(testTrie.calls, 0, sizeof(testTrie.calls));
+	memset(&params, 0, sizeof(params));
+	return aws_iot_mqtt_internal_trie_dispatch(&(testTrie.client), (char *) pTopic, (uint16_t) strlen(pTopic),
+											   &params, 0, 0, true);
+}
+
+static uint32_t testFreeNodes(void) {
+	uint32_t itr, count = 0;
+
+	for(itr = 0; itr < testTrie.client.clientData.topicTrieNodeCount; itr++) {
+		count += (TOPIC_TRIE_LEVEL_FREE == testTrie.nodes[itr].levelType) ? 1 : 0;
+	}
+	return count;
+}
+
+static void testRandomTopic(char *pBuf, bool isFilter) {
+	static const char *levels[] = { "a", "b", "ab", "", "$x" };
+	uint32_t count, itr;
+	const char *pLevel;
+
+	pBuf[0] = '\0';
+	count = 1 + testRandom() % 4;
+	for(itr = 0; itr < count; itr++) {
+		pLevel = levels[testRandom() % (sizeof(levels) / sizeof(levels[0]))];
+		if(isFilter && 0 == testRandom() % 4) {
+			pLevel = "+";
+		}
+		if(isFilter && itr == count - 1 && 0 == testRandom() % 5) {
+			pLevel = "#";
+		}
+		if(0 < itr) {
+			strcat(pBuf, "/");
+		}
+		strcat(pBuf, pLevel);
+	}
+}
+
+static void testRandomAgainstReference(void) {
+	char topic[TEST_TOPIC_LEN], filter[TEST_TOPIC_LEN];
+	uint32_t round, itr, expected, filterCount;
+
+	testRandomState = 2463534242U;
+	for(round = 0; round < 200; round++) {
+		testTrieInit(TEST_HANDLERS, TEST_NODES);
+		filterCount = 1 + testRandom() % TEST_HANDLERS;
+		for(itr = 0; itr < filterCount; itr++) {
+			testRandomTopic(filter, true);
+			UT_ASSERT(SUCCESS == testSubscribe(itr, filter));
+		}
+
+		for(itr = 0; itr < 200; itr++) {
+			testRandomTopic(topic, false);
+			(void) testDispatch(topic);
+			for(expected = 0; expected < filterCount; expected++) {
+				if(testTrie.calls[expected] != (testReferenceMatch(testTrie.filters[expected], topic) ? 1u : 0u)) {
+					printf("  filter \"%s\" topic \"%s\" called %u times\n", testTrie.filters[expected], topic,
+						   testTrie.calls[expected]);
+					UT_ASSERT(false);
+				}
+			}
+		}
+
+		/* Remove half of the filters, the rest still match */
+		for(itr = 0; itr < filterCount; itr += 2) {
+			aws_iot_mqtt_internal_trie_remove(&(testTrie.client), itr);
+		}
+		for(itr = 0; itr < 50; itr++) {
+			testRandomTopic(topic, false);
+			(void) testDispatch(topic);
+			for(expected = 0; expected < filterCount; expected++) {
+				UT_ASSERT(testTrie.calls[expected] ==
+						  ((1 == expected % 2 && testReferenceMatch(testTrie.filters[expected], topic)) ? 1u : 0u));
+			}
+		}
+		for(itr = 1; itr < filterCount; itr += 2) {
+			aws_iot_mqtt_internal_trie_remove(&(testTrie.client), itr);
+		}
+		UT_ASSERT(TEST_NODES - 1 == testFreeNodes());
+	}
+}
+
+static void testSpecialTopics(void) {
+	testTrieInit(TEST_HANDLERS, TEST_NODES);
+	UT_ASSERT(SUCCESS == testSubscribe(0, "#"));
+	UT_ASSERT(SUCCESS == testSubscribe(1, "+/things/#"));
+	UT_ASSERT(SUCCESS == testSubscribe(2, "$aws/things/#"));
+	UT_ASSERT(SUCCESS == testSubscribe(3, "$aws/+/door/shadow/update"));
+	UT_ASSERT(SUCCESS == testSubscribe(4, "a/#"));
+	UT_ASSERT(SUCCESS == testSubscribe(5, "a/+"));
+	UT_ASSERT(SUCCESS == testSubscribe(6, "a//b"));
+	UT_ASSERT(SUCCESS == testSubscribe(7, "+/+"));
+	UT_ASSERT(SUCCESS == testSubscribe(8, "a/+/#"));
+
+	/* '$' topics only match filters starting with the same literal level */
+	UT_ASSERT(2 == testDispatch("$aws/things/door/shadow/update"));
+	UT_ASSERT(1 == testTrie.calls[2] && 1 == testTrie.calls[3]);
+	UT_ASSERT(2 == testDispatch("x/things/door"));
+	UT_ASSERT(1 == testTrie.calls[0] && 1 == testTrie.calls[1] && 0 == testTrie.calls[2]);
+
+	/* "a/#" matches "a", "a/+/#" matches "a/b" */
+	UT_ASSERT(2 == testDispatch("a"));
+	UT_ASSERT(1 == testTrie.calls[0] && 1 == testTrie.calls[4]);
+	UT_ASSERT(5 == testDispatch("a/b"));
+	UT_ASSERT(1 == testTrie.calls[5] && 1 == testTrie.calls[7] && 1 == testTrie.calls[8]);
+
+	/* Empty levels are levels */
+	UT_ASSERT(4 == testDispatch("a//b"));
+	UT_ASSERT(1 == testTrie.calls[6] && 1 == testTrie.calls[8] && 0 == testTrie.calls[5]);
+	UT_ASSERT(5 == testDispatch("a/"));
+	UT_ASSERT(1 == testTrie.calls[5] && 1 == testTrie.calls[7]);
+	UT_ASSERT(2 == testDispatch("/a"));
+	UT_ASSERT(1 == testTrie.calls[0] && 1 == testTrie.calls[7]);
+
+	/* Several handlers on one filter are all called */
+	UT_ASSERT(SUCCESS == testSubscribe(9, "a/b"));
+	UT_ASSERT(SUCCESS == testSubscribe(10, "a/b"));
+	UT_ASSERT(7 == testDispatch("a/b"));
+	UT_ASSERT(1 == testTrie.calls[9] && 1 == testTrie.calls[10]);
+}
+
+static void testNodePoolExhausted(void) {
+	uint32_t itr;
+
+	/* The root and four levels */
+	testTrieInit(4, 5);
+	UT_ASSERT(SUCCESS == testSubscribe(0, "a/b/c/d"));
+	UT_ASSERT(0 == testFreeNodes());
+
+	/* A failed insert leaves no node behind and the trie working */
+	UT_ASSERT(MQTT_MAX_SUBSCRIPTIONS_REACHED_ERROR == testSubscribe(1, "a/b/x/y"));
+	testTrie.handlers[1].topicName = NULL;
+	UT_ASSERT(0 == testFreeNodes());
+	UT_ASSERT(1 == testDispatch("a/b/c/d"));
+	UT_ASSERT(SUCCESS == testSubscribe(2, "a/b/c/d"));
+	UT_ASSERT(SUCCESS == testSubscribe(3, "a/b"));
+	UT_ASSERT(2 == testDispatch("a/b/c/d"));
+
+	/* Removing filters releases the nodes only they used */
+	aws_iot_mqtt_internal_trie_remove(&(testTrie.client), 0);
+	UT_ASSERT(0 == testFreeNodes());
+	aws_iot_mqtt_internal_trie_remove(&(testTrie.client), 2);
+	UT_ASSERT(2 == testFreeNodes());
+	UT_ASSERT(SUCCESS == testSubscribe(0, "a/b/x/y"));
+	UT_ASSERT(1 == testDispatch("a/b/x/y"));
+	UT_ASSERT(0 == testDispatch("a/b/c/d"));
+
+	for(itr = 0; itr < 4; itr++) {
+		aws_iot_mqtt_internal_trie_remove(&(testTrie.client), itr);
+	}
+	UT_ASSERT(4 == testFreeNodes());
+	UT_ASSERT(SUCCESS == testSubscribe(1, "w/x/y/z"));
+}
+
+/* Handlers removed by a callback are skipped right away and unlinked after the dispatch */
+static void testRemoveDuringDispatch(void) {
+	testTrieInit(TEST_HANDLERS, TEST_NODES);
+	UT_ASSERT(SUCCESS == testSubscribe(2, "a/#"));
+	UT_ASSERT(SUCCESS == testSubscribe(0, "a/b"));
+	UT_ASSERT(SUCCESS == testSubscribe(1, "a/b"));
+	UT_ASSERT(SUCCESS == testSubscribe(3, "x/y/z"));
+	UT_ASSERT(SUCCESS == testSubscribe(4, "a/b"));
+
+	/* Newer children and handlers come first: 4 removes 2 before "a/#" is visited, 1 removes 0 */
+	testTrie.removeOnCall[4] = 3;
+	testTrie.removeOnCall[1] = 1;
+	UT_ASSERT(testTrie.handlers[0].trieNode == testTrie.handlers[4].trieNode);
+	UT_ASSERT(2 == testDispatch("a/b"));
+	UT_ASSERT(1 == testTrie.calls[4] && 1 == testTrie.calls[1] && 0 == testTrie.calls[0] && 0 == testTrie.calls[2]);
+	UT_ASSERT(AWS_IOT_MQTT_TRIE_NONE == testTrie.handlers[0].trieNode);
+	UT_ASSERT(AWS_IOT_MQTT_TRIE_NONE == testTrie.handlers[2].trieNode);
+	UT_ASSERT(2 == testDispatch("a/b"));
+
+	/* A handler removing itself from a nested dispatch stays linked until the outer one returns */
+	testTrie.pNestedTopic = "x/y/z";
+	testTrie.removeOnCall[3] = 4;
+	UT_ASSERT(2 == testDispatch("a/b"));
+	UT_ASSERT(1 == testTrie.calls[3]);
+	UT_ASSERT(0 == testTrie.client.clientData.dispatchDepth);
+	UT_ASSERT(AWS_IOT_MQTT_TRIE_NONE == testTrie.handlers[3].trieNode);
+	UT_ASSERT(0 == testDispatch("x/y/z"));
+
+	aws_iot_mqtt_internal_trie_remove(&(testTrie.client), 1);
+	aws_iot_mqtt_internal_trie_remove(&(testTrie.client), 4);
+	UT_ASSERT(TEST_NODES - 1 == testFreeNodes());
+}
+
+int main(void) {
+	UT_RUN(testRandomAgainstReference);
+	UT_RUN(testSpecialTopics);
+	UT_RUN(testNodePoolExhausted);
+	UT_RUN(testRemoveDuringDispatch);
+	return UT_REPORT();
+}
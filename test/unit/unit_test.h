@@ -0,0 +1,57 @@
+/*
+* Copyright 2015-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file unit_test.h
+ * @brief Minimal assertions for the host unit tests
+ *
+ * Every test program is one translation unit: its main() runs the test functions
+ * with UT_RUN and returns UT_REPORT(). A failed UT_ASSERT returns from the test.
+ */
+
+#ifndef AWS_IOT_TEST_UNIT_TEST_H
+#define AWS_IOT_TEST_UNIT_TEST_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+static unsigned int utRunCount;
+static unsigned int utFailedCount;
+static bool utIsFailed;
+
+#define UT_ASSERT(cond) \
+	do { \
+		if(!(cond)) { \
+			printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			utIsFailed = true; \
+			return; \
+		} \
+	} while(0)
+
+#define UT_RUN(test) \
+	do { \
+		utIsFailed = false; \
+		test(); \
+		utRunCount++; \
+		if(utIsFailed) { \
+			utFailedCount++; \
+			printf("FAIL %s\n", #test); \
+		} \
+	} while(0)
+
+#define UT_REPORT() \
+	(printf("%s: %u tests, %u failed\n", __FILE__, utRunCount, utFailedCount), (0 == utFailedCount) ? 0 : 1)
+
+#endif /* AWS_IOT_TEST_UNIT_TEST_H */